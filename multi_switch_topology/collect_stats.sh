@@ -5,6 +5,7 @@
 # Configuration
 OUTPUT_FILE="switch_stats_$(date +%Y%m%d_%H%M%S).log"
 INTERVAL=5
+STATS_READER=${STATS_READER:-../three_port_switch/switch_stats}
 
 echo "Multi-Switch Statistics Collector"
 echo "=================================="
@@ -58,6 +59,16 @@ collect_stats() {
         
         echo "  Total: RX=$total_rx TX=$total_tx"
         
+        # Switch counters published in shared memory (switch_stats.h)
+        if [ -x "$STATS_READER" ]; then
+            for seg in /dev/shm/switch_stats_*; do
+                [ -e "$seg" ] || continue
+                echo ""
+                echo "Switch Counters ($(basename $seg)):"
+                "$STATS_READER" -n "$(basename $seg)" -k | grep -v " 0$" | sed 's/^/  /'
+            done
+        fi
+        
     } | tee -a $OUTPUT_FILE
 }
 
@@ -3,8 +3,8 @@
 echo "Building three_port_switch_veth..."
 
 gcc -O3 -g -Wall -Wextra $(pkg-config --cflags libdpdk) \
-    -o three_port_switch_veth three_port_switch_veth.c \
-    $(pkg-config --libs libdpdk)
+    -o three_port_switch_veth three_port_switch_veth.c veth_fdb.c sw_rss.c pkt_meta.c lcore_idle.c pkt_trace.c mbuf_pool.c sw_gso.c port_failover.c \
+    $(pkg-config --libs libdpdk) -pthread
 
 if [ $? -eq 0 ]; then
     echo "Build successful!"
@@ -13,3 +13,41 @@ else
     echo "Build failed!"
     exit 1
 fi
+
+echo "Building three_port_switch_veth_qos..."
+
+gcc -O3 -g -Wall -Wextra $(pkg-config --cflags libdpdk) \
+    -o three_port_switch_veth_qos three_port_switch_veth_qos.c veth_fdb.c sw_rss.c pkt_meta.c lcore_idle.c qos_sched.c net_checksum.c switch_stats.c mbuf_pool.c \
+    $(pkg-config --libs libdpdk) -pthread -lrt
+
+if [ $? -eq 0 ]; then
+    echo "Build successful!"
+    ls -lh three_port_switch_veth_qos
+else
+    echo "Build failed!"
+    exit 1
+fi
+
+echo "Building switch_stats reader..."
+
+gcc -O2 -g -Wall -Wextra -o switch_stats switch_stats_reader.c switch_stats.c -lrt
+
+if [ $? -eq 0 ]; then
+    echo "Build successful!"
+    ls -lh switch_stats
+else
+    echo "Build failed!"
+    exit 1
+fi
+
+echo "Building pkt_trace_decode..."
+
+gcc -O2 -g -Wall -Wextra -o pkt_trace_decode pkt_trace_decode.c pkt_trace.c
+
+if [ $? -eq 0 ]; then
+    echo "Build successful!"
+    ls -lh pkt_trace_decode
+else
+    echo "Build failed!"
+    exit 1
+fi
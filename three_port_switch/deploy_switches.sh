@@ -2,10 +2,13 @@
 
 NUM_SWITCHES=${1:-3}
 TOPOLOGY=${2:-line}
+LCORES=${3:-1}
+BACKEND=${4:-af_packet}
+MTU=${5:-1500}
 
 if [ "$NUM_SWITCHES" -lt 2 ] || [ "$NUM_SWITCHES" -gt 10 ]; then
     echo "Error: Number of switches must be between 2 and 10"
-    echo "Usage: $0 <num_switches> <topology>"
+    echo "Usage: $0 <num_switches> <topology> [lcores_per_switch] [af_packet|af_xdp] [mtu]"
     exit 1
 fi
 
@@ -15,6 +18,9 @@ NC='\033[0m'
 
 echo -e "${YELLOW}=== Deploying $NUM_SWITCHES DOCA Switches ===${NC}"
 echo "  Topology: $TOPOLOGY"
+echo "  Lcores per switch: $LCORES"
+echo "  Backend: $BACKEND"
+echo "  MTU: $MTU"
 echo ""
 
 # Create logs directory
@@ -34,6 +40,9 @@ for i in $(seq 1 $NUM_SWITCHES); do
         --switch-id $i \
         --topology $TOPOLOGY \
         --num-switches $NUM_SWITCHES \
+        --lcores $LCORES \
+        --backend $BACKEND \
+        --mtu $MTU \
         > logs/switch_${i}.log 2>&1 &
     
     sleep 1
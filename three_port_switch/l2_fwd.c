@@ -0,0 +1,308 @@
+/*
+ * L2 Forwarding Engine Implementation
+ */
+
+#include "l2_fwd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+/* Learning stops at 3/4 occupancy to keep probe sequences short */
+#define L2_FWD_MAX_LOAD(size) ((size) / 4 * 3)
+
+uint64_t l2_fwd_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+/* FNV-1a over the 6 MAC bytes */
+static uint32_t mac_hash(const uint8_t *mac)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < L2_FWD_MAC_LEN; i++) {
+        h ^= mac[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool entry_expired(const l2_fwd_t *fwd, const l2_fdb_entry_t *e,
+                          uint64_t now_ms)
+{
+    /* Another port's thread may have refreshed it with a later clock */
+    return now_ms > e->last_seen_ms && now_ms - e->last_seen_ms > fwd->age_ms;
+}
+
+/* Slot holding mac, or the empty slot ending its probe sequence */
+static uint32_t fdb_find_slot(const l2_fwd_t *fwd, const uint8_t *mac)
+{
+    uint32_t i = mac_hash(mac) & fwd->mask;
+    
+    while (fwd->table[i].used &&
+           memcmp(fwd->table[i].mac, mac, L2_FWD_MAC_LEN) != 0) {
+        i = (i + 1) & fwd->mask;
+    }
+    return i;
+}
+
+/*
+ * Backward-shift deletion: pull later members of the probe sequence into
+ * the hole so lookups never need tombstones.
+ */
+static void fdb_remove_slot(l2_fwd_t *fwd, uint32_t hole)
+{
+    uint32_t i = hole;
+    
+    for (;;) {
+        i = (i + 1) & fwd->mask;
+        if (!fwd->table[i].used) {
+            break;
+        }
+        uint32_t home = mac_hash(fwd->table[i].mac) & fwd->mask;
+        /* Move entry i unless its home lies cyclically in (hole, i] */
+        bool stays = (hole <= i) ? (hole < home && home <= i)
+                                 : (hole < home || home <= i);
+        if (!stays) {
+            fwd->table[hole] = fwd->table[i];
+            hole = i;
+        }
+    }
+    fwd->table[hole].used = false;
+    fwd->count--;
+}
+
+int l2_fwd_init(l2_fwd_t *fwd, uint32_t num_ports, uint32_t table_size,
+                uint32_t age_ms)
+{
+    if (!fwd || num_ports == 0 || num_ports > L2_FWD_MAX_PORTS) {
+        return -EINVAL;
+    }
+    
+    memset(fwd, 0, sizeof(*fwd));
+    
+    uint32_t size = 16;
+    if (table_size == 0) {
+        table_size = L2_FWD_DEFAULT_TABLE_SIZE;
+    }
+    while (size < table_size) {
+        size <<= 1;
+    }
+    
+    fwd->table = calloc(size, sizeof(l2_fdb_entry_t));
+    if (!fwd->table) {
+        return -ENOMEM;
+    }
+    
+    fwd->size = size;
+    fwd->mask = size - 1;
+    fwd->num_ports = num_ports;
+    fwd->age_ms = age_ms ? age_ms : L2_FWD_DEFAULT_AGE_MS;
+    pthread_mutex_init(&fwd->lock, NULL);
+    
+    return 0;
+}
+
+void l2_fwd_cleanup(l2_fwd_t *fwd)
+{
+    if (!fwd || !fwd->table) {
+        return;
+    }
+    
+    free(fwd->table);
+    fwd->table = NULL;
+    pthread_mutex_destroy(&fwd->lock);
+}
+
+int l2_fwd_set_port_state(l2_fwd_t *fwd, uint8_t port, l2_port_state_t state)
+{
+    if (!fwd || port >= fwd->num_ports) {
+        return -EINVAL;
+    }
+    
+    pthread_mutex_lock(&fwd->lock);
+    fwd->port_state[port] = state;
+    if (state == L2_PORT_BLOCKING) {
+        uint32_t i = 0;
+        while (i < fwd->size) {
+            if (fwd->table[i].used && fwd->table[i].port == port) {
+                fdb_remove_slot(fwd, i);   /* Re-check the slot refilled */
+            } else {
+                i++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&fwd->lock);
+    
+    return 0;
+}
+
+/* Ports a flood may leave on: all forwarding ports except ingress */
+static uint32_t flood_mask(const l2_fwd_t *fwd, uint8_t in_port)
+{
+    uint32_t mask = 0;
+    for (uint32_t p = 0; p < fwd->num_ports; p++) {
+        if (p != in_port && fwd->port_state[p] == L2_PORT_FORWARDING) {
+            mask |= 1u << p;
+        }
+    }
+    return mask;
+}
+
+static void fdb_learn(l2_fwd_t *fwd, const uint8_t *mac, uint8_t port,
+                      uint64_t now_ms)
+{
+    /* Group addresses are never a source */
+    if (mac[0] & 0x01) {
+        return;
+    }
+    
+    uint32_t i = fdb_find_slot(fwd, mac);
+    l2_fdb_entry_t *e = &fwd->table[i];
+    
+    if (e->used) {
+        if (e->port != port) {
+            e->port = port;
+            fwd->stats.moved++;
+        }
+        e->last_seen_ms = now_ms;
+        return;
+    }
+    
+    if (fwd->count >= L2_FWD_MAX_LOAD(fwd->size)) {
+        fwd->stats.table_full++;
+        return;
+    }
+    
+    memcpy(e->mac, mac, L2_FWD_MAC_LEN);
+    e->port = port;
+    e->last_seen_ms = now_ms;
+    e->used = true;
+    fwd->count++;
+    fwd->stats.learned++;
+}
+
+uint32_t l2_fwd_forward(l2_fwd_t *fwd, uint8_t in_port, const uint8_t *frame,
+                        uint16_t size, uint64_t now_ms)
+{
+    if (in_port >= fwd->num_ports || size < 14) {
+        return L2_FWD_DROP;
+    }
+    
+    const uint8_t *dst = frame;
+    const uint8_t *src = frame + L2_FWD_MAC_LEN;
+    uint32_t out;
+    
+    pthread_mutex_lock(&fwd->lock);
+    fwd->stats.frames++;
+    
+    if (fwd->port_state[in_port] != L2_PORT_FORWARDING) {
+        fwd->stats.blocked++;
+        pthread_mutex_unlock(&fwd->lock);
+        return L2_FWD_DROP;
+    }
+    
+    fdb_learn(fwd, src, in_port, now_ms);
+    
+    if (dst[0] & 0x01) {    /* Broadcast or multicast */
+        fwd->stats.broadcast++;
+        out = flood_mask(fwd, in_port);
+    } else {
+        uint32_t i = fdb_find_slot(fwd, dst);
+        l2_fdb_entry_t *e = &fwd->table[i];
+        
+        if (e->used && entry_expired(fwd, e, now_ms)) {
+            fdb_remove_slot(fwd, i);
+            fwd->stats.aged++;
+            e = NULL;
+        } else if (!e->used) {
+            e = NULL;
+        }
+        
+        if (!e) {
+            fwd->stats.unknown_unicast++;
+            out = flood_mask(fwd, in_port);
+        } else if (e->port == in_port) {
+            fwd->stats.filtered++;
+            out = L2_FWD_DROP;
+        } else {
+            fwd->stats.unicast++;
+            out = 1u << e->port;
+        }
+    }
+    
+    pthread_mutex_unlock(&fwd->lock);
+    return out;
+}
+
+int l2_fwd_lookup(l2_fwd_t *fwd, const uint8_t *mac, uint64_t now_ms)
+{
+    int port = -ENOENT;
+    
+    pthread_mutex_lock(&fwd->lock);
+    l2_fdb_entry_t *e = &fwd->table[fdb_find_slot(fwd, mac)];
+    if (e->used && !entry_expired(fwd, e, now_ms)) {
+        port = e->port;
+    }
+    pthread_mutex_unlock(&fwd->lock);
+    
+    return port;
+}
+
+uint32_t l2_fwd_age(l2_fwd_t *fwd, uint64_t now_ms)
+{
+    uint32_t removed = 0;
+    uint32_t i = 0;
+    
+    pthread_mutex_lock(&fwd->lock);
+    while (i < fwd->size) {
+        if (fwd->table[i].used && entry_expired(fwd, &fwd->table[i], now_ms)) {
+            fdb_remove_slot(fwd, i);
+            removed++;
+        } else {
+            i++;
+        }
+    }
+    fwd->stats.aged += removed;
+    pthread_mutex_unlock(&fwd->lock);
+    
+    return removed;
+}
+
+void l2_fwd_flush(l2_fwd_t *fwd)
+{
+    pthread_mutex_lock(&fwd->lock);
+    memset(fwd->table, 0, fwd->size * sizeof(l2_fdb_entry_t));
+    fwd->count = 0;
+    pthread_mutex_unlock(&fwd->lock);
+}
+
+void l2_fwd_get_stats(l2_fwd_t *fwd, l2_fwd_stats_t *stats)
+{
+    pthread_mutex_lock(&fwd->lock);
+    *stats = fwd->stats;
+    pthread_mutex_unlock(&fwd->lock);
+}
+
+void l2_fwd_print_stats(l2_fwd_t *fwd, const char *label)
+{
+    l2_fwd_stats_t s;
+    uint32_t count;
+    
+    pthread_mutex_lock(&fwd->lock);
+    s = fwd->stats;
+    count = fwd->count;
+    pthread_mutex_unlock(&fwd->lock);
+    
+    printf("  %s FDB: %u/%u entries, aging %u ms\n", label, count, fwd->size,
+           fwd->age_ms);
+    printf("    Frames %lu: unicast %lu, unknown unicast %lu, broadcast %lu, "
+           "filtered %lu, blocked %lu\n",
+           s.frames, s.unicast, s.unknown_unicast, s.broadcast,
+           s.filtered, s.blocked);
+    printf("    Learned %lu, moved %lu, aged %lu, table full %lu\n",
+           s.learned, s.moved, s.aged, s.table_full);
+}
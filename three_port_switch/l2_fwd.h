@@ -0,0 +1,121 @@
+/*
+ * L2 Forwarding Engine for the Switch Simulators
+ *
+ * Transparent-bridge forwarding plane shared by vhost_switch_test,
+ * vlink_switch_sim and three_port_switch_sim: source MAC learning into a
+ * hashed forwarding database, destination lookup, flooding only for
+ * broadcast/multicast and unknown unicast, and aging of idle entries.
+ *
+ * Ports can be put in a blocking state (as spanning tree would) so that
+ * flooding stays loop-free when switches are cabled in a ring.
+ */
+
+#ifndef L2_FWD_H
+#define L2_FWD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define L2_FWD_MAX_PORTS 8
+#define L2_FWD_MAC_LEN 6
+#define L2_FWD_DEFAULT_TABLE_SIZE 4096     /* Rounded up to a power of 2 */
+#define L2_FWD_DEFAULT_AGE_MS 300000       /* 802.1D default: 300 s */
+#define L2_FWD_DROP 0                      /* Empty egress port mask */
+
+/* Port state */
+typedef enum {
+    L2_PORT_FORWARDING = 0,
+    L2_PORT_BLOCKING                       /* No RX, TX or learning */
+} l2_port_state_t;
+
+/* Forwarding database entry */
+typedef struct {
+    uint8_t mac[L2_FWD_MAC_LEN];
+    uint8_t port;
+    bool used;
+    uint64_t last_seen_ms;
+} l2_fdb_entry_t;
+
+/* Forwarding statistics */
+typedef struct {
+    uint64_t frames;
+    uint64_t learned;          /* New FDB entries */
+    uint64_t moved;            /* Station moved to another port */
+    uint64_t aged;             /* Entries removed by aging */
+    uint64_t unicast;          /* Known unicast, single egress port */
+    uint64_t unknown_unicast;  /* Flooded on lookup miss */
+    uint64_t broadcast;        /* Broadcast/multicast floods */
+    uint64_t filtered;         /* Destination behind the ingress port */
+    uint64_t blocked;          /* Received on a blocking port */
+    uint64_t table_full;       /* Learning skipped, table at load limit */
+} l2_fwd_stats_t;
+
+/* Forwarding engine (one per switch) */
+typedef struct {
+    l2_fdb_entry_t *table;     /* Open addressing, linear probing */
+    uint32_t size;
+    uint32_t mask;
+    uint32_t count;
+    uint32_t num_ports;
+    uint32_t age_ms;
+    l2_port_state_t port_state[L2_FWD_MAX_PORTS];
+    l2_fwd_stats_t stats;
+    pthread_mutex_t lock;      /* Ports may be serviced by separate threads */
+} l2_fwd_t;
+
+/*
+ * Initialize engine for num_ports ports (table_size/age_ms of 0 select the
+ * defaults)
+ */
+int l2_fwd_init(l2_fwd_t *fwd, uint32_t num_ports, uint32_t table_size,
+                uint32_t age_ms);
+
+/*
+ * Free the forwarding database
+ */
+void l2_fwd_cleanup(l2_fwd_t *fwd);
+
+/*
+ * Set port state; blocking a port flushes the entries learned on it
+ */
+int l2_fwd_set_port_state(l2_fwd_t *fwd, uint8_t port, l2_port_state_t state);
+
+/*
+ * Learn the source of a frame received on in_port and return the bitmask
+ * of egress ports (L2_FWD_DROP to discard)
+ */
+uint32_t l2_fwd_forward(l2_fwd_t *fwd, uint8_t in_port, const uint8_t *frame,
+                        uint16_t size, uint64_t now_ms);
+
+/*
+ * Look up a MAC; returns its port or -ENOENT (also for aged entries)
+ */
+int l2_fwd_lookup(l2_fwd_t *fwd, const uint8_t *mac, uint64_t now_ms);
+
+/*
+ * Remove entries idle for longer than the aging time; returns the count
+ */
+uint32_t l2_fwd_age(l2_fwd_t *fwd, uint64_t now_ms);
+
+/*
+ * Remove all entries
+ */
+void l2_fwd_flush(l2_fwd_t *fwd);
+
+/*
+ * Get statistics snapshot
+ */
+void l2_fwd_get_stats(l2_fwd_t *fwd, l2_fwd_stats_t *stats);
+
+/*
+ * Print FDB occupancy and forwarding statistics
+ */
+void l2_fwd_print_stats(l2_fwd_t *fwd, const char *label);
+
+/*
+ * Monotonic clock in milliseconds for the now_ms arguments
+ */
+uint64_t l2_fwd_now_ms(void);
+
+#endif /* L2_FWD_H */
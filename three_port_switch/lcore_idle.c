@@ -0,0 +1,110 @@
+/*
+ * Adaptive Idle Policy for the veth Switch Lcores - Implementation
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <rte_ethdev.h>
+#include <rte_interrupts.h>
+#include <rte_cycles.h>
+#include <rte_pause.h>
+
+#include "lcore_idle.h"
+
+void lcore_idle_init(struct lcore_idle *idle)
+{
+    memset(idle, 0, sizeof(*idle));
+    idle->sleep_us = 1;
+    idle->start_tsc = rte_rdtsc();
+}
+
+int lcore_idle_add_rx_intr(struct lcore_idle *idle, uint16_t port_id, uint16_t queue_id)
+{
+    int ret;
+    
+    if (idle->nb_intr_queues >= LCORE_IDLE_MAX_QUEUES) {
+        return -ENOSPC;
+    }
+    
+    ret = rte_eth_dev_rx_intr_ctl_q(port_id, queue_id, RTE_EPOLL_PER_THREAD,
+                                    RTE_INTR_EVENT_ADD, NULL);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    idle->intr_port[idle->nb_intr_queues] = port_id;
+    idle->intr_queue[idle->nb_intr_queues] = queue_id;
+    idle->nb_intr_queues++;
+    return 0;
+}
+
+/* Arm every registered queue and wait until one has a packet or timeout */
+static void wait_rx_intr(struct lcore_idle *idle)
+{
+    struct rte_epoll_event events[LCORE_IDLE_MAX_QUEUES];
+    int n;
+    
+    for (uint16_t i = 0; i < idle->nb_intr_queues; i++) {
+        rte_eth_dev_rx_intr_enable(idle->intr_port[i], idle->intr_queue[i]);
+    }
+    
+    n = rte_epoll_wait(RTE_EPOLL_PER_THREAD, events, idle->nb_intr_queues,
+                       LCORE_IDLE_INTR_TIMEOUT_MS);
+    
+    for (uint16_t i = 0; i < idle->nb_intr_queues; i++) {
+        rte_eth_dev_rx_intr_disable(idle->intr_port[i], idle->intr_queue[i]);
+    }
+    
+    idle->intr_waits++;
+    if (n > 0) {
+        idle->intr_wakeups++;
+    }
+}
+
+void lcore_idle_end_poll(struct lcore_idle *idle)
+{
+    uint64_t start;
+    
+    if (idle->work > 0) {
+        idle->work = 0;
+        idle->empty_polls = 0;
+        idle->sleep_us = 1;
+        idle->busy_polls++;
+        return;
+    }
+    
+    idle->idle_polls++;
+    idle->empty_polls++;
+    if (idle->empty_polls < LCORE_IDLE_PAUSE_POLLS) {
+        return;
+    }
+    if (idle->empty_polls < LCORE_IDLE_SLEEP_POLLS) {
+        rte_pause();
+        return;
+    }
+    
+    start = rte_rdtsc();
+    /* Interrupts take over once sleeps have backed off all the way */
+    if (idle->nb_intr_queues > 0 && idle->sleep_us >= LCORE_IDLE_MAX_SLEEP_US) {
+        wait_rx_intr(idle);
+    } else {
+        rte_delay_us_sleep(idle->sleep_us);
+        idle->sleeps++;
+        idle->sleep_us *= 2;
+        if (idle->sleep_us > LCORE_IDLE_MAX_SLEEP_US) {
+            idle->sleep_us = LCORE_IDLE_MAX_SLEEP_US;
+        }
+    }
+    idle->sleep_tsc += rte_rdtsc() - start;
+}
+
+void lcore_idle_ratio(const struct lcore_idle *idle, double *idle_polls_pct,
+                      double *asleep_pct)
+{
+    uint64_t polls = idle->busy_polls + idle->idle_polls;
+    uint64_t elapsed = rte_rdtsc() - idle->start_tsc;
+
+    *idle_polls_pct = polls ? 100.0 * idle->idle_polls / polls : 0.0;
+    *asleep_pct = elapsed ? 100.0 * idle->sleep_tsc / elapsed : 0.0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Adaptive Idle Policy for the veth Switch Lcores
+ *
+ * Forwarding lcores poll their queues. While polls keep coming back empty
+ * an lcore backs off step by step: it keeps spinning for a few polls, then
+ * pauses between polls, then sleeps for exponentially longer periods. If
+ * RX interrupts were registered, it then waits in epoll for a packet
+ * instead of sleeping. The first poll that finds work returns it to busy
+ * polling.
+ *
+ * Sleeping lcores stay QSBR-online; they report quiescence every loop and
+ * sleep at most LCORE_IDLE_INTR_TIMEOUT_MS, which only delays FDB slot
+ * reclamation by as much.
+ */
+
+#ifndef LCORE_IDLE_H
+#define LCORE_IDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCORE_IDLE_PAUSE_POLLS 64           /* Empty polls before pausing */
+#define LCORE_IDLE_SLEEP_POLLS 1024         /* Empty polls before sleeping */
+#define LCORE_IDLE_MAX_SLEEP_US 1000
+#define LCORE_IDLE_INTR_TIMEOUT_MS 10
+#define LCORE_IDLE_MAX_QUEUES 16            /* RX interrupt queues per lcore */
+
+struct lcore_idle {
+    uint32_t work;                          /* Packets handled in this poll */
+    uint32_t empty_polls;                   /* Consecutive polls without work */
+    uint32_t sleep_us;                      /* Next sleep; doubles up to the max */
+    
+    uint16_t nb_intr_queues;
+    uint16_t intr_port[LCORE_IDLE_MAX_QUEUES];
+    uint16_t intr_queue[LCORE_IDLE_MAX_QUEUES];
+    
+    /* Statistics */
+    uint64_t busy_polls;
+    uint64_t idle_polls;
+    uint64_t sleeps;
+    uint64_t intr_waits;
+    uint64_t intr_wakeups;                  /* Waits ended by a packet */
+    uint64_t sleep_tsc;                     /* Cycles spent sleeping or in epoll */
+    uint64_t start_tsc;
+};
+
+/*
+ * Reset the policy and its statistics
+ */
+void lcore_idle_init(struct lcore_idle *idle);
+
+/*
+ * Register RX queue queue_id of port_id for interrupt wakeups of the
+ * calling lcore. The port must have been configured with intr_conf.rxq.
+ */
+int lcore_idle_add_rx_intr(struct lcore_idle *idle, uint16_t port_id, uint16_t queue_id);
+
+/*
+ * Count nb packets of work done in the current poll
+ */
+static inline void lcore_idle_work(struct lcore_idle *idle, uint32_t nb)
+{
+    idle->work += nb;
+}
+
+/*
+ * Whether ending the current poll will sleep; callers flush buffered TX
+ * packets first
+ */
+static inline bool lcore_idle_will_sleep(const struct lcore_idle *idle)
+{
+    return idle->work == 0 && idle->empty_polls + 1 >= LCORE_IDLE_SLEEP_POLLS;
+}
+
+/*
+ * End a poll: back to busy polling if it did any work, otherwise back off
+ * one step
+ */
+void lcore_idle_end_poll(struct lcore_idle *idle);
+
+/*
+ * Percentage of polls that found no work, and of time spent asleep
+ */
+void lcore_idle_ratio(const struct lcore_idle *idle, double *idle_polls_pct,
+                      double *asleep_pct);
+
+#endif /* LCORE_IDLE_H */
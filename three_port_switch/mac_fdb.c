@@ -0,0 +1,416 @@
+/*
+ * MAC Forwarding Database
+ *
+ * Copyright (c) 2024 Custom Application
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "mac_fdb.h"
+
+/* Breadth-first search budget for a free slot during insertion */
+#define MAC_FDB_BFS_NODES 512
+
+struct bfs_node {
+	uint32_t bucket;
+	int32_t parent;		/* Node index, -1 for a candidate bucket */
+	uint8_t slot;		/* Slot in parent whose entry moves here */
+};
+
+/* Pack VLAN and MAC into one 64-bit key */
+static inline uint64_t fdb_key(const uint8_t *mac, uint16_t vlan_id)
+{
+	return ((uint64_t)(vlan_id & 0x0FFF) << 48) |
+	       ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) |
+	       ((uint64_t)mac[2] << 24) | ((uint64_t)mac[3] << 16) |
+	       ((uint64_t)mac[4] << 8) | (uint64_t)mac[5];
+}
+
+/* 64-bit finalizer (MurmurHash3 fmix64): every key bit affects every output bit */
+static inline uint64_t fdb_hash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+static inline uint32_t hash_prim(const struct mac_fdb *fdb, uint64_t h)
+{
+	return (uint32_t)h & fdb->bucket_mask;
+}
+
+static inline uint32_t hash_sec(const struct mac_fdb *fdb, uint64_t h)
+{
+	uint32_t prim = (uint32_t)h & fdb->bucket_mask;
+	uint32_t sec = (uint32_t)(h >> 32) & fdb->bucket_mask;
+
+	/* Two distinct buckets give every key a real second choice */
+	return sec == prim ? (prim ^ 1) & fdb->bucket_mask : sec;
+}
+
+static inline uint16_t hash_sig(uint64_t h)
+{
+	return (uint16_t)(h >> 16);
+}
+
+/* Bitmask of slots whose signature equals sig (bit i = slot i) */
+static inline uint32_t bucket_sig_match(const struct mac_fdb_bucket *b, uint16_t sig)
+{
+#if defined(__SSE2__)
+	__m128i sigs = _mm_load_si128((const __m128i *)b->sig);
+	__m128i eq = _mm_cmpeq_epi16(sigs, _mm_set1_epi16((short)sig));
+
+	return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	static const uint16_t weights[MAC_FDB_BUCKET_ENTRIES] = {1, 2, 4, 8, 16, 32, 64, 128};
+	uint16x8_t eq = vceqq_u16(vld1q_u16(b->sig), vdupq_n_u16(sig));
+
+	return vaddvq_u16(vandq_u16(eq, vld1q_u16(weights)));
+#else
+	uint32_t mask = 0;
+
+	for (int i = 0; i < MAC_FDB_BUCKET_ENTRIES; i++)
+		if (b->sig[i] == sig)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* Slot of key in bucket, or -1 */
+static inline int bucket_find(const struct mac_fdb *fdb, const struct mac_fdb_bucket *b,
+			      uint16_t sig, uint64_t key)
+{
+	uint32_t mask = bucket_sig_match(b, sig);
+
+	while (mask) {
+		int slot = __builtin_ctz(mask);
+		uint32_t idx = b->idx[slot];
+
+		if (idx && fdb->entries[idx].key == key)
+			return slot;
+		mask &= mask - 1;
+	}
+	return -1;
+}
+
+static inline int bucket_free_slot(const struct mac_fdb_bucket *b)
+{
+	for (int i = 0; i < MAC_FDB_BUCKET_ENTRIES; i++)
+		if (b->idx[i] == 0)
+			return i;
+	return -1;
+}
+
+int mac_fdb_create(struct mac_fdb *fdb, uint32_t nb_entries)
+{
+	uint32_t nb_buckets = 1;
+	void *mem;
+
+	if (fdb == NULL)
+		return -EINVAL;
+
+	memset(fdb, 0, sizeof(*fdb));
+	if (nb_entries == 0)
+		nb_entries = MAC_FDB_DEFAULT_ENTRIES;
+
+	/* Size buckets for ~80% load at full capacity so inserts stay short */
+	while ((uint64_t)nb_buckets * MAC_FDB_BUCKET_ENTRIES * 4 < (uint64_t)nb_entries * 5)
+		nb_buckets <<= 1;
+	if (nb_buckets < 2)
+		nb_buckets = 2;
+
+	if (posix_memalign(&mem, 64, (size_t)nb_buckets * sizeof(struct mac_fdb_bucket)) != 0)
+		return -ENOMEM;
+	memset(mem, 0, (size_t)nb_buckets * sizeof(struct mac_fdb_bucket));
+	fdb->buckets = mem;
+
+	fdb->entries = calloc((size_t)nb_entries + 1, sizeof(struct mac_fdb_entry));
+	fdb->free_idx = malloc((size_t)nb_entries * sizeof(uint32_t));
+	if (fdb->entries == NULL || fdb->free_idx == NULL) {
+		mac_fdb_destroy(fdb);
+		return -ENOMEM;
+	}
+
+	fdb->nb_buckets = nb_buckets;
+	fdb->bucket_mask = nb_buckets - 1;
+	fdb->capacity = nb_entries;
+	mac_fdb_flush(fdb);
+
+	return 0;
+}
+
+void mac_fdb_destroy(struct mac_fdb *fdb)
+{
+	if (fdb == NULL)
+		return;
+
+	free(fdb->buckets);
+	free(fdb->entries);
+	free(fdb->free_idx);
+	memset(fdb, 0, sizeof(*fdb));
+}
+
+void mac_fdb_flush(struct mac_fdb *fdb)
+{
+	memset(fdb->buckets, 0, (size_t)fdb->nb_buckets * sizeof(struct mac_fdb_bucket));
+	memset(fdb->entries, 0, ((size_t)fdb->capacity + 1) * sizeof(struct mac_fdb_entry));
+
+	/* Pop order hands out low indexes first */
+	for (uint32_t i = 0; i < fdb->capacity; i++)
+		fdb->free_idx[i] = fdb->capacity - i;
+	fdb->nb_free = fdb->capacity;
+	fdb->count = 0;
+}
+
+/* Bucket an entry sitting in bucket cur would move to */
+static inline uint32_t alt_bucket(const struct mac_fdb *fdb, uint32_t idx, uint32_t cur)
+{
+	uint64_t h = fdb_hash(fdb->entries[idx].key);
+	uint32_t prim = hash_prim(fdb, h);
+
+	return cur == prim ? hash_sec(fdb, h) : prim;
+}
+
+/*
+ * Find a chain of moves that frees a slot in bucket b1 or b2, apply it
+ * from the far end backwards, and return the freed bucket/slot.
+ */
+static int cuckoo_make_room(struct mac_fdb *fdb, uint32_t b1, uint32_t b2,
+			    uint32_t *bucket, int *slot)
+{
+	struct bfs_node queue[MAC_FDB_BFS_NODES];
+	int head = 0, tail = 0;
+
+	queue[tail++] = (struct bfs_node){.bucket = b1, .parent = -1};
+	queue[tail++] = (struct bfs_node){.bucket = b2, .parent = -1};
+
+	while (head < tail) {
+		int node = head++;
+		struct mac_fdb_bucket *b = &fdb->buckets[queue[node].bucket];
+
+		for (int s = 0; s < MAC_FDB_BUCKET_ENTRIES; s++) {
+			uint32_t next = alt_bucket(fdb, b->idx[s], queue[node].bucket);
+			int free_slot = bucket_free_slot(&fdb->buckets[next]);
+
+			if (free_slot >= 0) {
+				/* Walk back to a candidate bucket, moving one entry per hop */
+				uint32_t dst_bucket = next;
+				int dst_slot = free_slot;
+				int src = node;
+				int src_slot = s;
+
+				while (src >= 0) {
+					struct mac_fdb_bucket *from = &fdb->buckets[queue[src].bucket];
+					struct mac_fdb_bucket *to = &fdb->buckets[dst_bucket];
+
+					to->sig[dst_slot] = from->sig[src_slot];
+					to->idx[dst_slot] = from->idx[src_slot];
+					from->idx[src_slot] = 0;
+					from->sig[src_slot] = 0;
+					fdb->stats.displaced++;
+
+					dst_bucket = queue[src].bucket;
+					dst_slot = src_slot;
+					src_slot = queue[src].slot;
+					src = queue[src].parent;
+				}
+				*bucket = dst_bucket;
+				*slot = dst_slot;
+				return 0;
+			}
+
+			if (tail < MAC_FDB_BFS_NODES)
+				queue[tail++] = (struct bfs_node){.bucket = next, .parent = node, .slot = s};
+		}
+	}
+	return -ENOSPC;
+}
+
+int mac_fdb_add(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id,
+		uint16_t port_id, uint32_t now)
+{
+	uint64_t key = fdb_key(mac, vlan_id);
+	uint64_t h = fdb_hash(key);
+	uint16_t sig = hash_sig(h);
+	uint32_t b1 = hash_prim(fdb, h);
+	uint32_t b2 = hash_sec(fdb, h);
+	struct mac_fdb_bucket *b = &fdb->buckets[b1];
+	int slot = bucket_find(fdb, b, sig, key);
+
+	if (slot < 0) {
+		b = &fdb->buckets[b2];
+		slot = bucket_find(fdb, b, sig, key);
+	}
+	if (slot >= 0) {
+		struct mac_fdb_entry *e = &fdb->entries[b->idx[slot]];
+
+		if (e->port_id != port_id) {
+			e->port_id = port_id;
+			fdb->stats.moves++;
+		}
+		e->last_seen = now;
+		fdb->stats.updates++;
+		return 0;
+	}
+
+	if (fdb->nb_free == 0) {
+		fdb->stats.insert_failures++;
+		return -ENOSPC;
+	}
+
+	uint32_t bucket = b1;
+
+	slot = bucket_free_slot(&fdb->buckets[b1]);
+	if (slot < 0) {
+		bucket = b2;
+		slot = bucket_free_slot(&fdb->buckets[b2]);
+	}
+	if (slot < 0 && cuckoo_make_room(fdb, b1, b2, &bucket, &slot) != 0) {
+		fdb->stats.insert_failures++;
+		return -ENOSPC;
+	}
+
+	uint32_t idx = fdb->free_idx[--fdb->nb_free];
+	struct mac_fdb_entry *e = &fdb->entries[idx];
+
+	e->key = key;
+	e->port_id = port_id;
+	e->last_seen = now;
+	e->in_use = 1;
+	fdb->buckets[bucket].sig[slot] = sig;
+	fdb->buckets[bucket].idx[slot] = idx;
+	fdb->count++;
+	fdb->stats.inserts++;
+
+	return 0;
+}
+
+int mac_fdb_lookup(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id,
+		   uint16_t *port_id)
+{
+	uint64_t key = fdb_key(mac, vlan_id);
+	uint64_t h = fdb_hash(key);
+	uint16_t sig = hash_sig(h);
+	struct mac_fdb_bucket *b = &fdb->buckets[hash_prim(fdb, h)];
+	int slot = bucket_find(fdb, b, sig, key);
+
+	fdb->stats.lookups++;
+	if (slot < 0) {
+		b = &fdb->buckets[hash_sec(fdb, h)];
+		slot = bucket_find(fdb, b, sig, key);
+		if (slot < 0)
+			return -ENOENT;
+	}
+
+	*port_id = fdb->entries[b->idx[slot]].port_id;
+	fdb->stats.hits++;
+	return 0;
+}
+
+uint32_t mac_fdb_lookup_bulk(struct mac_fdb *fdb, const uint8_t *const *macs,
+			     const uint16_t *vlan_ids, uint32_t nb_keys,
+			     uint16_t *port_ids, uint64_t *hit_mask)
+{
+	uint64_t keys[MAC_FDB_MAX_BURST];
+	uint64_t hashes[MAC_FDB_MAX_BURST];
+	uint64_t hits = 0;
+	uint32_t nb_hits = 0;
+
+	if (nb_keys > MAC_FDB_MAX_BURST)
+		nb_keys = MAC_FDB_MAX_BURST;
+
+	/* Stage 1: hash everything and start both bucket loads */
+	for (uint32_t i = 0; i < nb_keys; i++) {
+		keys[i] = fdb_key(macs[i], vlan_ids ? vlan_ids[i] : MAC_FDB_VLAN_NONE);
+		hashes[i] = fdb_hash(keys[i]);
+		__builtin_prefetch(&fdb->buckets[hash_prim(fdb, hashes[i])]);
+		__builtin_prefetch(&fdb->buckets[hash_sec(fdb, hashes[i])]);
+	}
+
+	/* Stage 2: signature compare and key check, buckets now in cache */
+	for (uint32_t i = 0; i < nb_keys; i++) {
+		uint16_t sig = hash_sig(hashes[i]);
+		struct mac_fdb_bucket *b = &fdb->buckets[hash_prim(fdb, hashes[i])];
+		int slot = bucket_find(fdb, b, sig, keys[i]);
+
+		if (slot < 0) {
+			b = &fdb->buckets[hash_sec(fdb, hashes[i])];
+			slot = bucket_find(fdb, b, sig, keys[i]);
+		}
+		if (slot >= 0) {
+			port_ids[i] = fdb->entries[b->idx[slot]].port_id;
+			hits |= 1ULL << i;
+			nb_hits++;
+		}
+	}
+
+	fdb->stats.lookups += nb_keys;
+	fdb->stats.hits += nb_hits;
+	if (hit_mask != NULL)
+		*hit_mask = hits;
+	return nb_hits;
+}
+
+/* Remove the entry at bucket/slot and return its index to the free stack */
+static void fdb_remove(struct mac_fdb *fdb, struct mac_fdb_bucket *b, int slot)
+{
+	uint32_t idx = b->idx[slot];
+
+	memset(&fdb->entries[idx], 0, sizeof(fdb->entries[idx]));
+	b->idx[slot] = 0;
+	b->sig[slot] = 0;
+	fdb->free_idx[fdb->nb_free++] = idx;
+	fdb->count--;
+}
+
+int mac_fdb_del(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id)
+{
+	uint64_t key = fdb_key(mac, vlan_id);
+	uint64_t h = fdb_hash(key);
+	uint16_t sig = hash_sig(h);
+	struct mac_fdb_bucket *b = &fdb->buckets[hash_prim(fdb, h)];
+	int slot = bucket_find(fdb, b, sig, key);
+
+	if (slot < 0) {
+		b = &fdb->buckets[hash_sec(fdb, h)];
+		slot = bucket_find(fdb, b, sig, key);
+		if (slot < 0)
+			return -ENOENT;
+	}
+
+	fdb_remove(fdb, b, slot);
+	fdb->stats.deletes++;
+	return 0;
+}
+
+uint32_t mac_fdb_age(struct mac_fdb *fdb, uint32_t now, uint32_t max_age)
+{
+	uint32_t removed = 0;
+
+	for (uint32_t i = 0; i < fdb->nb_buckets; i++) {
+		struct mac_fdb_bucket *b = &fdb->buckets[i];
+
+		for (int s = 0; s < MAC_FDB_BUCKET_ENTRIES; s++) {
+			uint32_t idx = b->idx[s];
+
+			if (idx && now - fdb->entries[idx].last_seen > max_age) {
+				fdb_remove(fdb, b, s);
+				removed++;
+			}
+		}
+	}
+
+	fdb->stats.aged += removed;
+	return removed;
+}
@@ -0,0 +1,152 @@
+/*
+ * MAC Forwarding Database
+ *
+ * Copyright (c) 2024 Custom Application
+ *
+ * Bucketized cuckoo hash keyed on 48-bit MAC + 12-bit VLAN. Every key has
+ * two candidate buckets of 8 slots; a slot holds a 16-bit signature and
+ * the index of the entry in a separate entry array, so a bucket probe is
+ * one SIMD compare of 8 signatures followed by at most a few key checks.
+ * Lookup and delete touch two buckets; insert moves at most a short chain
+ * of entries found by breadth-first search, so all three are O(1). The
+ * buckets are sized for at most 80% load at full capacity, and entry
+ * indexes never change while an entry is present.
+ *
+ * The table is not internally locked: one thread learns, and lookups from
+ * other threads must be serialized with it by the caller.
+ */
+
+#ifndef MAC_FDB_H_
+#define MAC_FDB_H_
+
+#include <stdint.h>
+
+#define MAC_FDB_BUCKET_ENTRIES 8
+#define MAC_FDB_DEFAULT_ENTRIES 65536
+#define MAC_FDB_MAX_BURST 64
+#define MAC_FDB_VLAN_NONE 0
+
+/* Forwarding entry */
+struct mac_fdb_entry {
+	uint64_t key;		/* VLAN << 48 | MAC */
+	uint16_t port_id;
+	uint8_t in_use;
+	uint32_t last_seen;	/* Caller's clock, seconds */
+};
+
+/* Bucket: signatures first so one 16-byte load covers all of them */
+struct mac_fdb_bucket {
+	uint16_t sig[MAC_FDB_BUCKET_ENTRIES];
+	uint32_t idx[MAC_FDB_BUCKET_ENTRIES];	/* Entry index, 0 = empty */
+} __attribute__((aligned(64)));
+
+/* FDB statistics */
+struct mac_fdb_stats {
+	uint64_t inserts;
+	uint64_t updates;	/* Existing key re-learned */
+	uint64_t moves;		/* Existing key learned on another port */
+	uint64_t deletes;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t displaced;	/* Entries relocated by cuckoo insertion */
+	uint64_t insert_failures;
+	uint64_t aged;
+};
+
+/* Forwarding database */
+struct mac_fdb {
+	struct mac_fdb_bucket *buckets;
+	struct mac_fdb_entry *entries;	/* [1..capacity]; 0 is the empty index */
+	uint32_t *free_idx;		/* Stack of unused entry indexes */
+	uint32_t nb_free;
+	uint32_t nb_buckets;
+	uint32_t bucket_mask;
+	uint32_t capacity;
+	uint32_t count;
+	struct mac_fdb_stats stats;
+};
+
+/*
+ * Create an FDB for at least nb_entries entries (0 selects the default)
+ *
+ * @fdb [out]: FDB to initialize
+ * @nb_entries [in]: minimum number of entries
+ * @return: 0 on success, -EINVAL or -ENOMEM otherwise
+ */
+int mac_fdb_create(struct mac_fdb *fdb, uint32_t nb_entries);
+
+/*
+ * Free all FDB memory
+ *
+ * @fdb [in]: FDB to destroy
+ */
+void mac_fdb_destroy(struct mac_fdb *fdb);
+
+/*
+ * Learn a MAC: insert it, or refresh its port and timestamp
+ *
+ * @fdb [in]: FDB
+ * @mac [in]: 6-byte MAC address
+ * @vlan_id [in]: VLAN ID (MAC_FDB_VLAN_NONE for untagged)
+ * @port_id [in]: port the MAC was seen on
+ * @now [in]: current time in seconds
+ * @return: 0 on success, -ENOSPC if no slot could be freed
+ */
+int mac_fdb_add(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id,
+		uint16_t port_id, uint32_t now);
+
+/*
+ * Look up the port of a MAC
+ *
+ * @fdb [in]: FDB
+ * @mac [in]: 6-byte MAC address
+ * @vlan_id [in]: VLAN ID
+ * @port_id [out]: port the MAC was learned on
+ * @return: 0 if found, -ENOENT otherwise
+ */
+int mac_fdb_lookup(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id,
+		   uint16_t *port_id);
+
+/*
+ * Look up a burst of MACs, prefetching all buckets before comparing
+ *
+ * @fdb [in]: FDB
+ * @macs [in]: nb_keys MAC address pointers
+ * @vlan_ids [in]: nb_keys VLAN IDs, or NULL for untagged
+ * @nb_keys [in]: burst size, at most MAC_FDB_MAX_BURST
+ * @port_ids [out]: port per key (valid where the hit bit is set)
+ * @hit_mask [out]: bit i set if key i was found
+ * @return: number of keys found
+ */
+uint32_t mac_fdb_lookup_bulk(struct mac_fdb *fdb, const uint8_t *const *macs,
+			     const uint16_t *vlan_ids, uint32_t nb_keys,
+			     uint16_t *port_ids, uint64_t *hit_mask);
+
+/*
+ * Remove a MAC
+ *
+ * @fdb [in]: FDB
+ * @mac [in]: 6-byte MAC address
+ * @vlan_id [in]: VLAN ID
+ * @return: 0 on success, -ENOENT if absent
+ */
+int mac_fdb_del(struct mac_fdb *fdb, const uint8_t *mac, uint16_t vlan_id);
+
+/*
+ * Remove entries not refreshed within max_age seconds
+ *
+ * @fdb [in]: FDB
+ * @now [in]: current time in seconds
+ * @max_age [in]: aging time in seconds
+ * @return: number of entries removed
+ */
+uint32_t mac_fdb_age(struct mac_fdb *fdb, uint32_t now, uint32_t max_age);
+
+/*
+ * Remove all entries
+ *
+ * @fdb [in]: FDB
+ */
+void mac_fdb_flush(struct mac_fdb *fdb);
+
+#endif /* MAC_FDB_H_ */
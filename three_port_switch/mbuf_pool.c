@@ -0,0 +1,194 @@
+/*
+ * Per-Socket Mbuf Pools for the veth Switches - Implementation
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include "mbuf_pool.h"
+
+/* A port of a virtual device has no socket; it lives where we run */
+static int port_socket(int socket_id)
+{
+    if (socket_id < 0 || socket_id >= RTE_MAX_NUMA_NODES) {
+        return rte_socket_id();
+    }
+    return socket_id;
+}
+
+void mbuf_pools_init(struct mbuf_pools *mp, uint16_t nb_lcores, uint32_t per_lcore,
+                     uint32_t frame_len)
+{
+    memset(mp, 0, sizeof(*mp));
+    mp->nb_lcores = nb_lcores;
+    mp->per_lcore = per_lcore;
+    mp->frame_len = frame_len;
+    mp->data_room = RTE_MBUF_DEFAULT_BUF_SIZE;
+}
+
+int mbuf_pools_add_port(struct mbuf_pools *mp, uint16_t port_id, uint16_t nb_queues,
+                        uint16_t nb_rx_desc, uint16_t nb_tx_desc, uint32_t ring_slots,
+                        bool scatter)
+{
+    int socket = port_socket(rte_eth_dev_socket_id(port_id));
+    struct mbuf_pool_demand *d = &mp->demand[socket];
+    
+    if (d->nb_ports == MBUF_POOL_MAX_PORTS) {
+        return -ENOSPC;
+    }
+    d->port_ids[d->nb_ports++] = port_id;
+    d->nb_desc += (uint32_t)nb_queues * (nb_rx_desc + nb_tx_desc);
+    d->nb_ring_slots += ring_slots;
+    if (!scatter && mp->frame_len + RTE_PKTMBUF_HEADROOM > mp->data_room) {
+        mp->data_room = mp->frame_len + RTE_PKTMBUF_HEADROOM;
+    }
+    return socket;
+}
+
+uint32_t mbuf_pool_size(const struct mbuf_pool_demand *d, uint16_t nb_lcores,
+                        uint32_t per_lcore, uint32_t segs)
+{
+    /* A cache holds up to 1.5 times its size before flushing */
+    uint32_t cache = MBUF_POOL_CACHE_SIZE * 3 / 2;
+    uint32_t n = d->nb_desc + (d->nb_ring_slots + nb_lcores * per_lcore) * segs +
+                 nb_lcores * cache;
+    
+    return RTE_ALIGN_CEIL(n, MBUF_POOL_CACHE_SIZE);
+}
+
+int mbuf_pools_create(struct mbuf_pools *mp, const char *name)
+{
+    char pool_name[RTE_MEMPOOL_NAMESIZE];
+    uint32_t seg_len = mp->data_room - RTE_PKTMBUF_HEADROOM;
+    uint32_t segs = (mp->frame_len + seg_len - 1) / seg_len;
+    
+    for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+        uint32_t n;
+        
+        if (mp->demand[s].nb_ports == 0) {
+            continue;
+        }
+        n = mbuf_pool_size(&mp->demand[s], mp->nb_lcores, mp->per_lcore, segs);
+        snprintf(pool_name, sizeof(pool_name), "%s_s%d", name, s);
+        mp->pool[s] = rte_pktmbuf_pool_create(pool_name, n, MBUF_POOL_CACHE_SIZE, 0,
+                                              mp->data_room, s);
+        if (!mp->pool[s]) {
+            int err = -rte_errno;
+            
+            mbuf_pools_free(mp);
+            return err;
+        }
+        printf("Mbuf pool %s: %u mbufs of %u bytes (%u descriptors, %u ring slots, "
+               "%u lcores x %u, %u per packet)\n",
+               pool_name, n, mp->data_room, mp->demand[s].nb_desc, mp->demand[s].nb_ring_slots,
+               mp->nb_lcores, mp->per_lcore, segs);
+    }
+    return 0;
+}
+
+int mbuf_pools_create_indirect(struct mbuf_pools *mp, const char *name)
+{
+    char pool_name[RTE_MEMPOOL_NAMESIZE];
+    
+    for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+        if (!mp->pool[s]) {
+            continue;
+        }
+        snprintf(pool_name, sizeof(pool_name), "%s_i%d", name, s);
+        mp->indirect[s] = rte_pktmbuf_pool_create(pool_name, mp->pool[s]->size,
+                                                  MBUF_POOL_CACHE_SIZE, 0, 0, s);
+        if (!mp->indirect[s]) {
+            return -rte_errno;
+        }
+        printf("Mbuf pool %s: %u indirect mbufs\n", pool_name, mp->pool[s]->size);
+    }
+    return 0;
+}
+
+struct rte_mempool *mbuf_pools_get(const struct mbuf_pools *mp, int socket_id)
+{
+    return mp->pool[port_socket(socket_id)];
+}
+
+struct rte_mempool *mbuf_pools_get_indirect(const struct mbuf_pools *mp, int socket_id)
+{
+    return mp->indirect[port_socket(socket_id)];
+}
+
+void mbuf_pools_free(struct mbuf_pools *mp)
+{
+    for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+        rte_mempool_free(mp->pool[s]);
+        rte_mempool_free(mp->indirect[s]);
+        mp->pool[s] = NULL;
+        mp->indirect[s] = NULL;
+    }
+}
+
+/* Packets the ports of a pool dropped because it was empty */
+static uint64_t pool_rx_nombuf(const struct mbuf_pool_demand *d)
+{
+    struct rte_eth_stats stats;
+    uint64_t nombuf = 0;
+    
+    for (uint16_t i = 0; i < d->nb_ports; i++) {
+        if (rte_eth_stats_get(d->port_ids[i], &stats) == 0) {
+            nombuf += stats.rx_nombuf;
+        }
+    }
+    return nombuf;
+}
+
+void mbuf_pools_print(const struct mbuf_pools *mp)
+{
+    for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+        const struct rte_mempool *pool = mp->pool[s];
+        
+        if (!pool) {
+            continue;
+        }
+        printf("  Pool %s: %u/%u in use, %lu RX alloc failures\n", pool->name,
+               rte_mempool_in_use_count(pool), pool->size,
+               pool_rx_nombuf(&mp->demand[s]));
+        if (mp->indirect[s]) {
+            printf("  Pool %s: %u/%u in use\n", mp->indirect[s]->name,
+                   rte_mempool_in_use_count(mp->indirect[s]), mp->indirect[s]->size);
+        }
+    }
+}
+
+int mbuf_pools_telemetry(const struct mbuf_pools *mp, struct rte_tel_data *d)
+{
+    rte_tel_data_start_dict(d);
+    for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+        const struct rte_mempool *pool = mp->pool[s];
+        struct rte_tel_data *pd;
+        
+        if (!pool) {
+            continue;
+        }
+        pd = rte_tel_data_alloc();
+        if (!pd) {
+            return -ENOMEM;
+        }
+        rte_tel_data_start_dict(pd);
+        rte_tel_data_add_dict_uint(pd, "socket", s);
+        rte_tel_data_add_dict_uint(pd, "size", pool->size);
+        rte_tel_data_add_dict_uint(pd, "in_use", rte_mempool_in_use_count(pool));
+        rte_tel_data_add_dict_uint(pd, "avail", rte_mempool_avail_count(pool));
+        rte_tel_data_add_dict_uint(pd, "rx_nombuf", pool_rx_nombuf(&mp->demand[s]));
+        if (mp->indirect[s]) {
+            rte_tel_data_add_dict_uint(pd, "indirect_size", mp->indirect[s]->size);
+            rte_tel_data_add_dict_uint(pd, "indirect_in_use",
+                                       rte_mempool_in_use_count(mp->indirect[s]));
+        }
+        rte_tel_data_add_dict_container(d, pool->name, pd, 0);
+    }
+    return 0;
+}
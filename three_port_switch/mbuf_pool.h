@@ -0,0 +1,135 @@
+/*
+ * Per-Socket Mbuf Pools for the veth Switches
+ *
+ * Every mbuf a switch can hold at once has to come from its pool: the RX
+ * descriptors the PMD fills up front, TX descriptors waiting for
+ * completion, software rings, the packets each lcore holds in bursts, TX
+ * buffers and QoS queues, and the per-lcore mempool caches. A switch
+ * declares these per port and per lcore and gets one pool per NUMA socket
+ * with ports, sized for the worst case instead of a fixed count, so a busy
+ * switch does not run dry and an idle one does not over-allocate.
+ *
+ * Ports are given the pool of their own socket. Packets may be held by
+ * lcores of any socket, so every pool also covers the per-lcore demand.
+ *
+ * Jumbo frames are received into chained default-size mbufs on ports with
+ * scatter RX. If a port cannot scatter, the pool's buffers grow to hold a
+ * whole frame instead.
+ *
+ * Switches that cut packets into segments referencing the original's
+ * data (software GSO) also get a pool of indirect mbufs per socket.
+ */
+
+#ifndef MBUF_POOL_H
+#define MBUF_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ether.h>
+#include <rte_mempool.h>
+#include <rte_telemetry.h>
+
+#define MBUF_POOL_MAX_PORTS 16
+#define MBUF_POOL_CACHE_SIZE 256            /* Per-lcore cache; <= RTE_MEMPOOL_CACHE_MAX_SIZE */
+
+/* Frame bytes beyond the MTU: Ethernet header, two VLAN tags and the CRC */
+#define MBUF_POOL_FRAME_OVERHEAD (RTE_ETHER_HDR_LEN + 2 * RTE_VLAN_HLEN + RTE_ETHER_CRC_LEN)
+
+/* What one socket's pool must hold at once */
+struct mbuf_pool_demand {
+    uint32_t nb_desc;                       /* RX and TX descriptors of its ports */
+    uint32_t nb_ring_slots;                 /* Software rings between lcores */
+    uint16_t nb_ports;
+    uint16_t port_ids[MBUF_POOL_MAX_PORTS];
+};
+
+struct mbuf_pools {
+    struct rte_mempool *pool[RTE_MAX_NUMA_NODES];
+    struct rte_mempool *indirect[RTE_MAX_NUMA_NODES];  /* Data-less, if created */
+    struct mbuf_pool_demand demand[RTE_MAX_NUMA_NODES];
+    uint32_t per_lcore;                     /* Packets one lcore holds outside rings */
+    uint32_t frame_len;                     /* Largest frame */
+    uint16_t nb_lcores;
+    uint16_t data_room;                     /* Buffer size incl. headroom */
+};
+
+/*
+ * Largest frame for an MTU
+ */
+static inline uint32_t mbuf_pool_frame_len(uint16_t mtu)
+{
+    return mtu + MBUF_POOL_FRAME_OVERHEAD;
+}
+
+/*
+ * Whether frames of frame_len bytes span several default-size mbufs
+ */
+static inline bool mbuf_pool_needs_scatter(uint32_t frame_len)
+{
+    return frame_len > RTE_MBUF_DEFAULT_BUF_SIZE - RTE_PKTMBUF_HEADROOM;
+}
+
+/*
+ * Start sizing pools for nb_lcores forwarding lcores that each hold up to
+ * per_lcore packets of up to frame_len bytes in bursts, TX buffers and
+ * queues of their own
+ */
+void mbuf_pools_init(struct mbuf_pools *mp, uint16_t nb_lcores, uint32_t per_lcore,
+                     uint32_t frame_len);
+
+/*
+ * Account for a port with nb_queues queue pairs of nb_rx_desc/nb_tx_desc
+ * descriptors and ring_slots slots of software rings. scatter tells
+ * whether the port receives frames into chained mbufs; if not, buffers are
+ * made large enough for a whole frame. Returns the socket whose pool the
+ * port must use, or -ENOSPC if the socket has too many ports.
+ */
+int mbuf_pools_add_port(struct mbuf_pools *mp, uint16_t port_id, uint16_t nb_queues,
+                        uint16_t nb_rx_desc, uint16_t nb_tx_desc, uint32_t ring_slots,
+                        bool scatter);
+
+/*
+ * Mbufs needed for demand d when a packet takes up to segs mbufs, rounded
+ * up to a whole number of caches
+ */
+uint32_t mbuf_pool_size(const struct mbuf_pool_demand *d, uint16_t nb_lcores,
+                        uint32_t per_lcore, uint32_t segs);
+
+/*
+ * Create the pool of every socket that has ports, named <name>_s<socket>
+ */
+int mbuf_pools_create(struct mbuf_pools *mp, const char *name);
+
+/*
+ * Create an indirect-mbuf pool next to every packet pool, named
+ * <name>_i<socket> and as large as the packet pool: an indirect mbuf
+ * only exists while it references a packet mbuf
+ */
+int mbuf_pools_create_indirect(struct mbuf_pools *mp, const char *name);
+
+/*
+ * Pool for a port on socket_id; SOCKET_ID_ANY means the caller's socket
+ */
+struct rte_mempool *mbuf_pools_get(const struct mbuf_pools *mp, int socket_id);
+
+/*
+ * Indirect-mbuf pool of socket_id, or NULL if none was created
+ */
+struct rte_mempool *mbuf_pools_get_indirect(const struct mbuf_pools *mp, int socket_id);
+
+void mbuf_pools_free(struct mbuf_pools *mp);
+
+/*
+ * Print size and occupancy of every pool and the RX allocation failures of
+ * its ports
+ */
+void mbuf_pools_print(const struct mbuf_pools *mp);
+
+/*
+ * Fill d with a dict per pool: size, in_use, avail and rx_nombuf, the
+ * packets its ports dropped because the pool was empty
+ */
+int mbuf_pools_telemetry(const struct mbuf_pools *mp, struct rte_tel_data *d);
+
+#endif /* MBUF_POOL_H */
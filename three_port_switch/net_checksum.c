@@ -0,0 +1,302 @@
+/*
+ * Internet Checksum Library Implementation
+ *
+ * Every implementation sums the buffer as native-endian 16-bit words into
+ * wide accumulators and folds at the end. One's complement addition
+ * commutes with byte swapping (RFC 1071 section 2(B)), so the native sum
+ * is swapped once to big-endian instead of swapping every word.
+ */
+
+#include "net_checksum.h"
+#include <string.h>
+#include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NET_CSUM_X86 1
+#include <immintrin.h>
+#endif
+
+/* Below this the scalar loop beats vector setup and horizontal sums */
+#define CSUM_VEC_MIN_LEN 256
+
+typedef uint64_t (*net_csum_fn_t)(const uint8_t *data, size_t len);
+
+/* Fold a 64-bit native accumulator to a 16-bit big-endian word sum */
+static uint32_t fold64_be(uint64_t acc)
+{
+    acc = (acc & 0xFFFFFFFFULL) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFFULL) + (acc >> 32);
+    uint32_t sum = (uint32_t)acc;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    sum = ((sum & 0xFF) << 8) | (sum >> 8);
+#endif
+    return sum;
+}
+
+/* Tail of up to 7 bytes (and the whole buffer for short ones) */
+static uint64_t csum_tail(const uint8_t *data, size_t len)
+{
+    uint64_t acc = 0;
+    
+    while (len >= 2) {
+        uint16_t w;
+        memcpy(&w, data, 2);
+        acc += w;
+        data += 2;
+        len -= 2;
+    }
+    if (len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        acc += data[0];
+#else
+        acc += (uint64_t)data[0] << 8;
+#endif
+    }
+    return acc;
+}
+
+/* Scalar: 32-bit loads into a 64-bit accumulator, unrolled by four */
+static uint64_t csum_scalar(const uint8_t *data, size_t len)
+{
+    uint64_t acc0 = 0, acc1 = 0;
+    uint32_t w[4];
+    
+    while (len >= 16) {
+        memcpy(w, data, 16);
+        acc0 += (uint64_t)w[0] + w[1];
+        acc1 += (uint64_t)w[2] + w[3];
+        data += 16;
+        len -= 16;
+    }
+    while (len >= 4) {
+        memcpy(w, data, 4);
+        acc0 += w[0];
+        data += 4;
+        len -= 4;
+    }
+    return acc0 + acc1 + csum_tail(data, len);
+}
+
+#ifdef NET_CSUM_X86
+/*
+ * 16-bit words are widened to 32-bit lanes before adding, so a lane can
+ * absorb 65537 words without overflow. Accumulators are spilled to the
+ * 64-bit total every CSUM_VEC_SPILL iterations to stay below that.
+ */
+#define CSUM_VEC_SPILL 16384
+
+__attribute__((target("sse2")))
+static uint64_t hsum_epi32_sse2(__m128i v)
+{
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, v);
+    return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/* SSE2: 32 bytes per iteration */
+__attribute__((target("sse2")))
+static uint64_t csum_sse2(const uint8_t *data, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t total = 0;
+    
+    while (len >= 32) {
+        __m128i acc0 = zero, acc1 = zero;
+        size_t n = len / 32;
+        if (n > CSUM_VEC_SPILL) {
+            n = CSUM_VEC_SPILL;
+        }
+        len -= n * 32;
+        
+        while (n--) {
+            __m128i a = _mm_loadu_si128((const __m128i *)data);
+            __m128i b = _mm_loadu_si128((const __m128i *)(data + 16));
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(a, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(a, zero));
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(b, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(b, zero));
+            data += 32;
+        }
+        total += hsum_epi32_sse2(acc0) + hsum_epi32_sse2(acc1);
+    }
+    return total + csum_scalar(data, len);
+}
+
+__attribute__((target("avx2")))
+static uint64_t hsum_epi32_avx2(__m256i v)
+{
+    uint32_t lanes[8];
+    uint64_t sum = 0;
+    _mm256_storeu_si256((__m256i *)lanes, v);
+    for (int i = 0; i < 8; i++) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+/* AVX2: 64 bytes per iteration */
+__attribute__((target("avx2")))
+static uint64_t csum_avx2(const uint8_t *data, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t total = 0;
+    
+    while (len >= 64) {
+        __m256i acc0 = zero, acc1 = zero;
+        size_t n = len / 64;
+        if (n > CSUM_VEC_SPILL) {
+            n = CSUM_VEC_SPILL;
+        }
+        len -= n * 64;
+        
+        while (n--) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)data);
+            __m256i b = _mm256_loadu_si256((const __m256i *)(data + 32));
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(a, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(a, zero));
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(b, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(b, zero));
+            data += 64;
+        }
+        total += hsum_epi32_avx2(acc0) + hsum_epi32_avx2(acc1);
+    }
+    _mm256_zeroupper();
+    return total + csum_scalar(data, len);
+}
+#endif /* NET_CSUM_X86 */
+
+static const struct {
+    const char *name;
+    net_csum_fn_t fn;
+} impls[NET_CSUM_IMPL_COUNT] = {
+    [NET_CSUM_IMPL_AUTO]   = { "auto",   NULL },
+    [NET_CSUM_IMPL_SCALAR] = { "scalar", csum_scalar },
+#ifdef NET_CSUM_X86
+    [NET_CSUM_IMPL_SSE2]   = { "sse2",   csum_sse2 },
+    [NET_CSUM_IMPL_AVX2]   = { "avx2",   csum_avx2 },
+#else
+    [NET_CSUM_IMPL_SSE2]   = { "sse2",   NULL },
+    [NET_CSUM_IMPL_AVX2]   = { "avx2",   NULL },
+#endif
+};
+
+static net_csum_impl_t active_impl;
+static net_csum_fn_t active_fn;
+
+int net_csum_impl_supported(net_csum_impl_t impl)
+{
+    if (impl >= NET_CSUM_IMPL_COUNT) {
+        return 0;
+    }
+    if (impl == NET_CSUM_IMPL_AUTO || impl == NET_CSUM_IMPL_SCALAR) {
+        return 1;
+    }
+#ifdef NET_CSUM_X86
+    __builtin_cpu_init();
+    if (impl == NET_CSUM_IMPL_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (impl == NET_CSUM_IMPL_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return 0;
+}
+
+static net_csum_impl_t csum_best_impl(void)
+{
+    if (net_csum_impl_supported(NET_CSUM_IMPL_AVX2)) {
+        return NET_CSUM_IMPL_AVX2;
+    }
+    if (net_csum_impl_supported(NET_CSUM_IMPL_SSE2)) {
+        return NET_CSUM_IMPL_SSE2;
+    }
+    return NET_CSUM_IMPL_SCALAR;
+}
+
+int net_csum_set_impl(net_csum_impl_t impl)
+{
+    if (!net_csum_impl_supported(impl)) {
+        return -ENOTSUP;
+    }
+    if (impl == NET_CSUM_IMPL_AUTO) {
+        impl = csum_best_impl();
+    }
+    
+    /* Racing selections store the same pointer; a torn read is impossible */
+    __atomic_store_n(&active_impl, impl, __ATOMIC_RELAXED);
+    __atomic_store_n(&active_fn, impls[impl].fn, __ATOMIC_RELEASE);
+    return 0;
+}
+
+net_csum_impl_t net_csum_get_impl(void)
+{
+    if (!__atomic_load_n(&active_fn, __ATOMIC_ACQUIRE)) {
+        net_csum_set_impl(NET_CSUM_IMPL_AUTO);
+    }
+    return __atomic_load_n(&active_impl, __ATOMIC_RELAXED);
+}
+
+const char *net_csum_impl_name(net_csum_impl_t impl)
+{
+    if (impl >= NET_CSUM_IMPL_COUNT) {
+        return "unknown";
+    }
+    return impls[impl].name;
+}
+
+uint32_t net_csum_partial(const void *data, size_t len, uint32_t sum)
+{
+    net_csum_fn_t fn = __atomic_load_n(&active_fn, __ATOMIC_ACQUIRE);
+    
+    if (!fn) {
+        net_csum_set_impl(NET_CSUM_IMPL_AUTO);
+        fn = __atomic_load_n(&active_fn, __ATOMIC_ACQUIRE);
+    }
+    
+    if (len < CSUM_VEC_MIN_LEN) {
+        fn = csum_scalar;
+    }
+    
+    uint32_t add = fold64_be(fn((const uint8_t *)data, len));
+    sum += add;
+    if (sum < add) {
+        sum++;    /* End-around carry */
+    }
+    return sum;
+}
+
+uint16_t net_checksum(const void *data, size_t len)
+{
+    return net_csum_fold(net_csum_partial(data, len, 0));
+}
+
+uint32_t net_csum_pseudo_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                              uint8_t proto, uint16_t l4_len)
+{
+    uint32_t sum = 0;
+    
+    sum += ((uint32_t)src_ip[0] << 8) | src_ip[1];
+    sum += ((uint32_t)src_ip[2] << 8) | src_ip[3];
+    sum += ((uint32_t)dst_ip[0] << 8) | dst_ip[1];
+    sum += ((uint32_t)dst_ip[2] << 8) | dst_ip[3];
+    sum += proto;
+    sum += l4_len;
+    return sum;
+}
+
+uint16_t net_l4_checksum_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                              uint8_t proto, const void *l4, uint16_t l4_len)
+{
+    uint32_t sum = net_csum_pseudo_ipv4(src_ip, dst_ip, proto, l4_len);
+    return net_csum_fold(net_csum_partial(l4, l4_len, sum));
+}
+
+uint16_t net_udp_checksum_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                               const void *udp, uint16_t udp_len)
+{
+    uint16_t csum = net_l4_checksum_ipv4(src_ip, dst_ip, 17, udp, udp_len);
+    return csum ? csum : 0xFFFF;
+}
@@ -0,0 +1,126 @@
+/*
+ * Internet Checksum Library (RFC 1071 / RFC 1624)
+ *
+ * Full-buffer one's complement sums with scalar, SSE2 and AVX2
+ * implementations selected at runtime from the CPU's feature flags,
+ * incremental update helpers for fields rewritten on the forwarding path
+ * (TTL, addresses, ports) and the IPv4 UDP/TCP pseudo-header sum.
+ *
+ * Partial sums are 32-bit accumulators of big-endian 16-bit words, so they
+ * combine with plain additions and fold to the value stored on the wire
+ * with net_csum_fold(). Checksums are returned in host byte order; store
+ * them high byte first.
+ */
+
+#ifndef NET_CHECKSUM_H
+#define NET_CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Full-buffer implementations */
+typedef enum {
+    NET_CSUM_IMPL_AUTO = 0,   /* Best supported by this CPU */
+    NET_CSUM_IMPL_SCALAR,
+    NET_CSUM_IMPL_SSE2,
+    NET_CSUM_IMPL_AVX2,
+    NET_CSUM_IMPL_COUNT
+} net_csum_impl_t;
+
+/*
+ * Add the big-endian 16-bit words of data to a partial sum
+ */
+uint32_t net_csum_partial(const void *data, size_t len, uint32_t sum);
+
+/*
+ * Checksum of a buffer (e.g. an IPv4 header with its checksum field zeroed)
+ */
+uint16_t net_checksum(const void *data, size_t len);
+
+/*
+ * Partial sum of the IPv4 pseudo-header used by UDP and TCP
+ */
+uint32_t net_csum_pseudo_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                              uint8_t proto, uint16_t l4_len);
+
+/*
+ * UDP/TCP checksum over pseudo-header and segment (checksum field zeroed).
+ * For UDP, a result of 0 must be sent as 0xFFFF (see net_udp_checksum_ipv4).
+ */
+uint16_t net_l4_checksum_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                              uint8_t proto, const void *l4, uint16_t l4_len);
+
+/*
+ * UDP checksum with the zero-means-none substitution applied
+ */
+uint16_t net_udp_checksum_ipv4(const uint8_t *src_ip, const uint8_t *dst_ip,
+                               const void *udp, uint16_t udp_len);
+
+/*
+ * Force an implementation (NET_CSUM_IMPL_AUTO restores CPU dispatch).
+ * Returns -ENOTSUP if the CPU or the build lacks it.
+ */
+int net_csum_set_impl(net_csum_impl_t impl);
+
+/*
+ * Implementation currently used by net_csum_partial()
+ */
+net_csum_impl_t net_csum_get_impl(void);
+
+/*
+ * Whether an implementation can run on this CPU
+ */
+int net_csum_impl_supported(net_csum_impl_t impl);
+
+/*
+ * Name of an implementation
+ */
+const char *net_csum_impl_name(net_csum_impl_t impl);
+
+/* Fold a partial sum to 16 bits and complement it */
+static inline uint16_t net_csum_fold(uint32_t sum)
+{
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/*
+ * RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m') for a checksum stored big-endian
+ * at csum after one 16-bit word changed from old_word to new_word.
+ */
+static inline void net_csum_replace16(uint8_t *csum, uint16_t old_word,
+                                      uint16_t new_word)
+{
+    uint32_t sum = (uint16_t)~(((uint16_t)csum[0] << 8) | csum[1]);
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~sum & 0xFFFF;
+    csum[0] = sum >> 8;
+    csum[1] = sum & 0xFF;
+}
+
+/* Same for a 32-bit field such as an IPv4 address */
+static inline void net_csum_replace32(uint8_t *csum, uint32_t old_val,
+                                      uint32_t new_val)
+{
+    net_csum_replace16(csum, old_val >> 16, new_val >> 16);
+    net_csum_replace16(csum, old_val & 0xFFFF, new_val & 0xFFFF);
+}
+
+/*
+ * Decrement the TTL of the IPv4 header at ip and patch its checksum.
+ * Touches only the TTL/protocol word; returns the new TTL.
+ */
+static inline uint8_t net_ipv4_dec_ttl(uint8_t *ip)
+{
+    uint16_t old_word = ((uint16_t)ip[8] << 8) | ip[9];
+    
+    ip[8]--;
+    net_csum_replace16(ip + 10, old_word, old_word - 0x0100);
+    return ip[8];
+}
+
+#endif /* NET_CHECKSUM_H */
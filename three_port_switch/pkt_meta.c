@@ -0,0 +1,117 @@
+/*
+ * Packet Metadata for the veth Switches - Implementation
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_ether.h>
+#include <rte_net.h>
+
+#include "pkt_meta.h"
+
+#define OUTER_PTYPE_MASK (RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK | RTE_PTYPE_L4_MASK)
+
+/* Lengths implied by a PMD-provided ptype; false if the PMD left L3 unknown */
+static inline bool parse_ptype(struct rte_mbuf *m, struct pkt_meta *md)
+{
+    uint32_t ptype = m->packet_type & OUTER_PTYPE_MASK;
+    
+    if ((ptype & RTE_PTYPE_L3_MASK) == 0) {
+        return false;
+    }
+    
+    md->ptype = ptype;
+    switch (ptype & RTE_PTYPE_L2_MASK) {
+    case RTE_PTYPE_L2_ETHER_VLAN:
+        md->l2_len = sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr);
+        break;
+    case RTE_PTYPE_L2_ETHER_QINQ:
+        md->l2_len = sizeof(struct rte_ether_hdr) + 2 * sizeof(struct rte_vlan_hdr);
+        break;
+    default:
+        md->l2_len = sizeof(struct rte_ether_hdr);
+        break;
+    }
+    
+    if (!RTE_ETH_IS_IPV4_HDR(ptype)) {
+        md->l3_len = 0;
+    } else if ((ptype & RTE_PTYPE_L3_MASK) == RTE_PTYPE_L3_IPV4) {
+        md->l3_len = sizeof(struct rte_ipv4_hdr);           /* No options */
+    } else {
+        const struct rte_ipv4_hdr *ip =
+            rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, md->l2_len);
+        
+        md->l3_len = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+    }
+    return true;
+}
+
+/* Software fallback; the result is cached in packet_type for later stages */
+static void parse_sw(struct rte_mbuf *m, struct pkt_meta *md)
+{
+    struct rte_net_hdr_lens hdr_lens;
+    uint32_t ptype = rte_net_get_ptype(m, &hdr_lens, OUTER_PTYPE_MASK);
+    
+    m->packet_type = ptype;
+    md->ptype = ptype;
+    md->l2_len = hdr_lens.l2_len;
+    md->l3_len = RTE_ETH_IS_IPV4_HDR(ptype) ? hdr_lens.l3_len : 0;
+}
+
+int pkt_meta_pullup_slow(struct rte_mbuf *m, uint32_t len)
+{
+    uint8_t *base = m->buf_addr;
+    
+    if (len > rte_pktmbuf_pkt_len(m) || len > m->buf_len ||
+        !RTE_MBUF_DIRECT(m) || rte_mbuf_refcnt_read(m) != 1) {
+        return -ENOSPC;
+    }
+    
+    /* Give up headroom if the tail cannot take the rest */
+    if (rte_pktmbuf_tailroom(m) < len - m->data_len) {
+        uint16_t off = m->buf_len - len;
+        
+        memmove(base + off, base + m->data_off, m->data_len);
+        m->data_off = off;
+    }
+    
+    while (m->data_len < len) {
+        struct rte_mbuf *seg = m->next;
+        uint16_t n = RTE_MIN((uint32_t)seg->data_len, len - m->data_len);
+        
+        memcpy(base + m->data_off + m->data_len, rte_pktmbuf_mtod(seg, uint8_t *), n);
+        m->data_len += n;
+        seg->data_off += n;
+        seg->data_len -= n;
+        if (seg->data_len == 0) {
+            m->next = seg->next;
+            m->nb_segs--;
+            seg->next = NULL;
+            rte_pktmbuf_free_seg(seg);
+        }
+    }
+    return 0;
+}
+
+void pkt_meta_parse_burst(struct rte_mbuf **pkts, uint16_t nb_pkts, struct pkt_meta *md)
+{
+    for (uint16_t i = 0; i < nb_pkts; i++) {
+        struct rte_mbuf *m = pkts[i];
+        bool split = pkt_meta_pullup(m, RTE_MIN(rte_pktmbuf_pkt_len(m), PKT_META_HDR_ROOM)) < 0;
+        
+        /* Only the software parser reads across segments */
+        if (split || !parse_ptype(m, &md[i])) {
+            parse_sw(m, &md[i]);
+        }
+        if (split) {
+            md[i].l3_len = 0;
+        }
+        
+        md[i].flags = 0;
+        md[i].reserved = 0;
+        if ((m->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) == RTE_MBUF_F_RX_IP_CKSUM_BAD) {
+            md[i].flags |= PKT_META_L3_CKSUM_BAD;
+        }
+    }
+}
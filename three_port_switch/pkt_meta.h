@@ -0,0 +1,95 @@
+/*
+ * Packet Metadata for the veth Switches
+ *
+ * Parses a packet's headers once per hop. When the PMD classified the
+ * packet on receive, mbuf->packet_type is trusted and the header lengths
+ * follow from it; otherwise rte_net_get_ptype() parses the headers in
+ * software and the result is written back to packet_type, so a later stage
+ * or another lcore (e.g. a software RSS worker) reuses it without parsing
+ * again.
+ *
+ * Header accessors assume the headers are in the first segment. A chained
+ * (scatter-RX) packet whose first segment is shorter is pulled up first;
+ * if that fails it is treated as non-IP and only switched at layer 2.
+ */
+
+#ifndef PKT_META_H
+#define PKT_META_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_mbuf.h>
+#include <rte_ip.h>
+
+#define PKT_META_L3_CKSUM_BAD 0x01          /* PMD found a bad IPv4 header checksum */
+#define PKT_META_HDR_ROOM 128               /* Bytes kept in the first segment: L2 to L4 ports */
+
+struct pkt_meta {
+    uint32_t ptype;                         /* RTE_PTYPE_L2/L3/L4 bits */
+    uint8_t l2_len;
+    uint8_t l3_len;                         /* IPv4 header length, 0 if not IPv4 */
+    uint8_t flags;                          /* PKT_META_* */
+    uint8_t reserved;
+};
+
+/*
+ * Move data from the following segments into the first one until it holds
+ * len bytes. The packet must not be shared. Returns -ENOSPC if the first
+ * segment's buffer is too small.
+ */
+int pkt_meta_pullup_slow(struct rte_mbuf *m, uint32_t len);
+
+static inline int pkt_meta_pullup(struct rte_mbuf *m, uint32_t len)
+{
+    if (likely(rte_pktmbuf_data_len(m) >= len)) {
+        return 0;
+    }
+    return pkt_meta_pullup_slow(m, len);
+}
+
+/*
+ * Fill md for each of the nb_pkts packets; headers should already be
+ * prefetched
+ */
+void pkt_meta_parse_burst(struct rte_mbuf **pkts, uint16_t nb_pkts, struct pkt_meta *md);
+
+/*
+ * Same for a single packet
+ */
+static inline void pkt_meta_parse(struct rte_mbuf *m, struct pkt_meta *md)
+{
+    pkt_meta_parse_burst(&m, 1, md);
+}
+
+/*
+ * IPv4 header of the packet, or NULL if it is not IPv4
+ */
+static inline struct rte_ipv4_hdr *pkt_meta_ipv4(struct rte_mbuf *m, const struct pkt_meta *md)
+{
+    if (md->l3_len == 0) {
+        return NULL;
+    }
+    return rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, md->l2_len);
+}
+
+/*
+ * Whether the packet is an IPv4 TCP or UDP packet carrying its ports,
+ * i.e. not a non-first fragment
+ */
+static inline bool pkt_meta_has_ports(const struct pkt_meta *md)
+{
+    uint32_t l4 = md->ptype & RTE_PTYPE_L4_MASK;
+    
+    return md->l3_len != 0 && (l4 == RTE_PTYPE_L4_TCP || l4 == RTE_PTYPE_L4_UDP);
+}
+
+/*
+ * TCP/UDP header of the packet; only valid if pkt_meta_has_ports()
+ */
+static inline void *pkt_meta_l4(struct rte_mbuf *m, const struct pkt_meta *md)
+{
+    return rte_pktmbuf_mtod_offset(m, uint8_t *, md->l2_len + md->l3_len);
+}
+
+#endif /* PKT_META_H */
@@ -0,0 +1,187 @@
+/*
+ * Binary Packet-Path Tracer - Implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "pkt_trace.h"
+
+#define CLOCK_CALIBRATE_NS 20000000         /* Measure pkt_trace_clock() over 20 ms */
+
+uint32_t pkt_trace_mask;
+
+const struct pkt_trace_event_desc pkt_trace_events[PKT_TRACE_NB_EVENTS] = {
+    [PKT_TRACE_RX_BURST] = { "rx", { "port", "nb" },
+                             { PKT_TRACE_ARG_UINT, PKT_TRACE_ARG_UINT } },
+    [PKT_TRACE_FWD] = { "fwd", { "in", "dst", "out" },
+                        { PKT_TRACE_ARG_UINT, PKT_TRACE_ARG_MAC, PKT_TRACE_ARG_INT } },
+    [PKT_TRACE_FLOOD] = { "flood", { "in", "nb_ports" },
+                          { PKT_TRACE_ARG_UINT, PKT_TRACE_ARG_UINT } },
+    [PKT_TRACE_TX_DROP] = { "tx_drop", { "nb" }, { PKT_TRACE_ARG_UINT } },
+    [PKT_TRACE_IDLE] = { "idle", { "intr", "dur" },
+                         { PKT_TRACE_ARG_UINT, PKT_TRACE_ARG_CYCLES } },
+    [PKT_TRACE_FDB_UPDATE] = { "fdb", { "applied", "entries" },
+                               { PKT_TRACE_ARG_UINT, PKT_TRACE_ARG_UINT } },
+};
+
+int pkt_trace_ring_init(struct pkt_trace_ring *r, uint16_t lcore)
+{
+    memset(r, 0, sizeof(*r));
+    r->recs = calloc(PKT_TRACE_RING_SIZE, sizeof(*r->recs));
+    if (!r->recs) {
+        return -ENOMEM;
+    }
+    r->lcore = lcore;
+    return 0;
+}
+
+void pkt_trace_ring_free(struct pkt_trace_ring *r)
+{
+    free(r->recs);
+    r->recs = NULL;
+}
+
+int pkt_trace_parse_mask(const char *list, uint32_t *mask)
+{
+    char buf[256];
+    char *tok, *save;
+
+    *mask = 0;
+    if (strcmp(list, "all") == 0) {
+        *mask = (1u << PKT_TRACE_NB_EVENTS) - 1;
+        return 0;
+    }
+    if (strcmp(list, "off") == 0) {
+        return 0;
+    }
+    
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int ev;
+        
+        for (ev = 0; ev < PKT_TRACE_NB_EVENTS; ev++) {
+            if (strcmp(tok, pkt_trace_events[ev].name) == 0) {
+                break;
+            }
+        }
+        if (ev == PKT_TRACE_NB_EVENTS) {
+            return -EINVAL;
+        }
+        *mask |= 1u << ev;
+    }
+    return 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Ticks per second of pkt_trace_clock() */
+static uint64_t clock_hz(void)
+{
+#if defined(__aarch64__)
+    uint64_t hz;
+    
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+    return hz;
+#elif defined(__x86_64__) || defined(__i386__)
+    struct timespec delay = { 0, CLOCK_CALIBRATE_NS };
+    uint64_t ns = now_ns();
+    uint64_t start = pkt_trace_clock();
+    
+    nanosleep(&delay, NULL);
+    return (pkt_trace_clock() - start) * 1000000000ULL / (now_ns() - ns);
+#else
+    return 1000000000ULL;
+#endif
+}
+
+/*
+ * Copy the intact records of one ring into out. Records written while
+ * copying are left out, and so is the slot the lcore may be overwriting.
+ */
+static uint32_t copy_ring(const struct pkt_trace_ring *r, struct pkt_trace_rec *out)
+{
+    uint64_t end = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t start = end > PKT_TRACE_RING_SIZE ? end - PKT_TRACE_RING_SIZE : 0;
+    uint64_t head;
+    uint32_t n = 0;
+    
+    for (uint64_t i = start; i < end; i++) {
+        out[n++] = r->recs[i & (PKT_TRACE_RING_SIZE - 1)];
+    }
+    
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    if (head + 1 > start + PKT_TRACE_RING_SIZE) {
+        uint64_t lost = head + 1 - PKT_TRACE_RING_SIZE - start;
+        
+        if (lost >= n) {
+            return 0;
+        }
+        memmove(out, out + lost, (n - lost) * sizeof(*out));
+        n -= lost;
+    }
+    return n;
+}
+
+int pkt_trace_dump(const char *path, struct pkt_trace_ring *rings, int nb_rings,
+                   uint32_t switch_id)
+{
+    struct pkt_trace_file_hdr hdr = {
+        .magic = PKT_TRACE_MAGIC,
+        .version = PKT_TRACE_VERSION,
+        .rec_size = sizeof(struct pkt_trace_rec),
+        .switch_id = switch_id,
+    };
+    struct pkt_trace_rec *buf;
+    FILE *f;
+    int err = 0;
+    
+    buf = malloc(PKT_TRACE_RING_SIZE * sizeof(*buf));
+    if (!buf) {
+        return -ENOMEM;
+    }
+    f = fopen(path, "wb");
+    if (!f) {
+        err = -errno;
+        free(buf);
+        return err;
+    }
+    
+    /* The record count is rewritten once known */
+    hdr.tsc_hz = clock_hz();
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    for (int i = 0; i < nb_rings; i++) {
+        uint32_t n;
+        
+        if (!rings[i].recs) {
+            continue;
+        }
+        n = copy_ring(&rings[i], buf);
+        if (fwrite(buf, sizeof(*buf), n, f) != n) {
+            err = -EIO;
+            break;
+        }
+        hdr.nb_recs += n;
+    }
+    if (err == 0) {
+        rewind(f);
+        if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+            err = -EIO;
+        }
+    }
+    if (fclose(f) != 0 && err == 0) {
+        err = -errno;
+    }
+    
+    free(buf);
+    return err < 0 ? err : (int)hdr.nb_recs;
+}
@@ -0,0 +1,156 @@
+/*
+ * Binary Packet-Path Tracer
+ *
+ * Each forwarding lcore owns a ring of fixed-size records (timestamp,
+ * event ID and three arguments) that it overwrites like a flight recorder.
+ * Events are enabled one by one at runtime through a global mask; a
+ * disabled trace point costs one load and a predicted-not-taken branch.
+ * The rings are dumped to a file on request or at exit and decoded offline
+ * by pkt_trace_decode, so tracing works at full packet rate without
+ * printf or a special build.
+ *
+ * The ring is written by its lcore only. A dump from another thread skips
+ * records overwritten while it was copying them.
+ */
+
+#ifndef PKT_TRACE_H
+#define PKT_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define PKT_TRACE_MAGIC 0x3145434152545450ULL   /* "PTTRACE1" */
+#define PKT_TRACE_VERSION 1
+#define PKT_TRACE_RING_SIZE 65536           /* Records per lcore; power of 2 */
+
+enum pkt_trace_event {
+    PKT_TRACE_RX_BURST = 0,                 /* port, packets */
+    PKT_TRACE_FWD,                          /* RX port, destination MAC, TX port or -1 */
+    PKT_TRACE_FLOOD,                        /* RX port, output ports */
+    PKT_TRACE_TX_DROP,                      /* packets the PMD refused */
+    PKT_TRACE_IDLE,                         /* interrupt wait (1) or sleep (0), cycles */
+    PKT_TRACE_FDB_UPDATE,                   /* learn requests applied, table entries */
+    PKT_TRACE_NB_EVENTS
+};
+
+/* How the decoder prints an argument */
+enum pkt_trace_arg {
+    PKT_TRACE_ARG_NONE = 0,
+    PKT_TRACE_ARG_UINT,
+    PKT_TRACE_ARG_INT,
+    PKT_TRACE_ARG_MAC,
+    PKT_TRACE_ARG_CYCLES,                   /* Duration ending at the record's time */
+};
+
+struct pkt_trace_event_desc {
+    const char *name;
+    const char *arg_names[3];
+    uint8_t arg_types[3];                   /* enum pkt_trace_arg */
+};
+
+/* 32 bytes */
+struct pkt_trace_rec {
+    uint64_t tsc;
+    uint16_t event;
+    uint16_t lcore;
+    uint32_t arg0;
+    uint64_t arg1;
+    uint64_t arg2;
+};
+
+struct pkt_trace_ring {
+    struct pkt_trace_rec *recs;
+    uint64_t head;                          /* Records ever written */
+    uint16_t lcore;
+} __attribute__((aligned(64)));
+
+/* Dump file: this header, then nb_recs records in no particular order */
+struct pkt_trace_file_hdr {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t tsc_hz;
+    uint32_t nb_recs;
+    uint32_t switch_id;
+};
+
+extern const struct pkt_trace_event_desc pkt_trace_events[PKT_TRACE_NB_EVENTS];
+
+/* Bit e set while event e is traced */
+extern uint32_t pkt_trace_mask;
+
+static inline uint64_t pkt_trace_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    struct timespec ts;                     /* Nanoseconds */
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline bool pkt_trace_on(enum pkt_trace_event ev)
+{
+    return __builtin_expect(__atomic_load_n(&pkt_trace_mask, __ATOMIC_RELAXED) & (1u << ev), 0);
+}
+
+static inline void pkt_trace_emit(struct pkt_trace_ring *r, enum pkt_trace_event ev,
+                                  uint32_t arg0, uint64_t arg1, uint64_t arg2)
+{
+    uint64_t head = r->head;
+    struct pkt_trace_rec *rec = &r->recs[head & (PKT_TRACE_RING_SIZE - 1)];
+    
+    rec->tsc = pkt_trace_clock();
+    rec->event = ev;
+    rec->lcore = r->lcore;
+    rec->arg0 = arg0;
+    rec->arg1 = arg1;
+    rec->arg2 = arg2;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Trace point: only the mask test runs while ev is disabled */
+#define PKT_TRACE(r, ev, a0, a1, a2) do { \
+    if (pkt_trace_on(ev)) \
+        pkt_trace_emit((r), (ev), (a0), (a1), (a2)); \
+} while (0)
+
+/*
+ * Allocate the ring of lcore
+ */
+int pkt_trace_ring_init(struct pkt_trace_ring *r, uint16_t lcore);
+
+void pkt_trace_ring_free(struct pkt_trace_ring *r);
+
+/*
+ * Parse a comma-separated list of event names, "all" or "off" into a mask.
+ * Returns -EINVAL on an unknown name.
+ */
+int pkt_trace_parse_mask(const char *list, uint32_t *mask);
+
+/*
+ * Set the traced events; takes effect on every lcore within a poll
+ */
+static inline void pkt_trace_set_mask(uint32_t mask)
+{
+    __atomic_store_n(&pkt_trace_mask, mask, __ATOMIC_RELAXED);
+}
+
+/*
+ * Write the records still in the rings to path, with the rate of
+ * pkt_trace_clock() measured for the decoder. Returns the number of
+ * records written or -errno.
+ */
+int pkt_trace_dump(const char *path, struct pkt_trace_ring *rings, int nb_rings,
+                   uint32_t switch_id);
+
+#endif /* PKT_TRACE_H */
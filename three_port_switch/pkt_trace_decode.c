@@ -0,0 +1,194 @@
+/*
+ * Packet-Path Trace Decoder
+ *
+ * Turns a dump written by pkt_trace_dump() into one line per record, or
+ * with -j into Chrome trace JSON (chrome://tracing, ui.perfetto.dev) with
+ * one track per lcore. Times are microseconds from the first record.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#include "pkt_trace.h"
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [OPTIONS] TRACE_FILE\n", prog);
+    printf("Decode a switch packet-path trace\n\n");
+    printf("Options:\n");
+    printf("  -j          Chrome trace JSON instead of text\n");
+    printf("  -e EVENTS   Only these events (comma-separated, default: all)\n");
+    printf("  -h          Show this help\n");
+    printf("\nEvents:");
+    for (int ev = 0; ev < PKT_TRACE_NB_EVENTS; ev++) {
+        printf(" %s", pkt_trace_events[ev].name);
+    }
+    printf("\n");
+}
+
+static int cmp_tsc(const void *a, const void *b)
+{
+    const struct pkt_trace_rec *ra = a, *rb = b;
+    
+    return ra->tsc < rb->tsc ? -1 : ra->tsc > rb->tsc;
+}
+
+static uint64_t rec_arg(const struct pkt_trace_rec *rec, int i)
+{
+    return i == 0 ? rec->arg0 : i == 1 ? rec->arg1 : rec->arg2;
+}
+
+/* One argument as text; JSON needs MACs quoted */
+static void format_arg(char *buf, size_t len, enum pkt_trace_arg type, uint64_t v,
+                       double us_per_tick, bool json)
+{
+    switch (type) {
+    case PKT_TRACE_ARG_INT:
+        snprintf(buf, len, "%ld", (long)(int64_t)v);
+        break;
+    case PKT_TRACE_ARG_MAC:
+        snprintf(buf, len, "%s%02x:%02x:%02x:%02x:%02x:%02x%s", json ? "\"" : "",
+                 (unsigned)(v >> 40) & 0xff, (unsigned)(v >> 32) & 0xff,
+                 (unsigned)(v >> 24) & 0xff, (unsigned)(v >> 16) & 0xff,
+                 (unsigned)(v >> 8) & 0xff, (unsigned)v & 0xff, json ? "\"" : "");
+        break;
+    case PKT_TRACE_ARG_CYCLES:
+        snprintf(buf, len, "%.3f%s", v * us_per_tick, json ? "" : "us");
+        break;
+    default:
+        snprintf(buf, len, "%lu", v);
+        break;
+    }
+}
+
+static void print_text(const struct pkt_trace_rec *rec, uint64_t t0, double us_per_tick)
+{
+    const struct pkt_trace_event_desc *desc = &pkt_trace_events[rec->event];
+    char arg[32];
+    
+    printf("%14.3f lcore %-2u %-8s", (rec->tsc - t0) * us_per_tick, rec->lcore, desc->name);
+    for (int i = 0; i < 3 && desc->arg_names[i]; i++) {
+        format_arg(arg, sizeof(arg), desc->arg_types[i], rec_arg(rec, i), us_per_tick, false);
+        printf(" %s=%s", desc->arg_names[i], arg);
+    }
+    printf("\n");
+}
+
+/* Events with a duration become complete ("X") events ending at their time */
+static void print_json(const struct pkt_trace_rec *rec, uint64_t t0, double us_per_tick,
+                       uint32_t switch_id, bool first)
+{
+    const struct pkt_trace_event_desc *desc = &pkt_trace_events[rec->event];
+    double ts = (rec->tsc - t0) * us_per_tick;
+    double dur = -1.0;
+    char arg[32];
+    
+    for (int i = 0; i < 3 && desc->arg_names[i]; i++) {
+        if (desc->arg_types[i] == PKT_TRACE_ARG_CYCLES) {
+            dur = rec_arg(rec, i) * us_per_tick;
+        }
+    }
+    
+    printf("%s\n{\"name\":\"%s\",\"cat\":\"switch\",\"pid\":%u,\"tid\":%u,",
+           first ? "" : ",", desc->name, switch_id, rec->lcore);
+    if (dur >= 0) {
+        printf("\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,", ts - dur, dur);
+    } else {
+        printf("\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,", ts);
+    }
+    printf("\"args\":{");
+    for (int i = 0; i < 3 && desc->arg_names[i]; i++) {
+        format_arg(arg, sizeof(arg), desc->arg_types[i], rec_arg(rec, i), us_per_tick, true);
+        printf("%s\"%s\":%s", i ? "," : "", desc->arg_names[i], arg);
+    }
+    printf("}}");
+}
+
+int main(int argc, char **argv)
+{
+    struct pkt_trace_file_hdr hdr;
+    struct pkt_trace_rec *recs;
+    uint32_t mask = (1u << PKT_TRACE_NB_EVENTS) - 1;
+    bool json = false, first = true;
+    double us_per_tick;
+    FILE *f;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "je:h")) != -1) {
+        switch (opt) {
+            case 'j':
+                json = true;
+                break;
+            case 'e':
+                if (pkt_trace_parse_mask(optarg, &mask) < 0) {
+                    fprintf(stderr, "Unknown event in '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != PKT_TRACE_MAGIC ||
+        hdr.version != PKT_TRACE_VERSION || hdr.rec_size != sizeof(struct pkt_trace_rec)) {
+        fprintf(stderr, "%s: not a version %d packet trace\n", argv[optind], PKT_TRACE_VERSION);
+        fclose(f);
+        return 1;
+    }
+    
+    recs = malloc((size_t)hdr.nb_recs * sizeof(*recs) + 1);
+    if (!recs || fread(recs, sizeof(*recs), hdr.nb_recs, f) != hdr.nb_recs) {
+        fprintf(stderr, "%s: truncated trace\n", argv[optind]);
+        fclose(f);
+        free(recs);
+        return 1;
+    }
+    fclose(f);
+    
+    qsort(recs, hdr.nb_recs, sizeof(*recs), cmp_tsc);
+    us_per_tick = hdr.tsc_hz ? 1e6 / hdr.tsc_hz : 0.0;
+    
+    if (json) {
+        printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    } else {
+        printf("# switch %u, %u records, clock %.1f MHz\n", hdr.switch_id, hdr.nb_recs,
+               hdr.tsc_hz / 1e6);
+    }
+    for (uint32_t i = 0; i < hdr.nb_recs; i++) {
+        const struct pkt_trace_rec *rec = &recs[i];
+        
+        if (rec->event >= PKT_TRACE_NB_EVENTS || !(mask & (1u << rec->event))) {
+            continue;
+        }
+        if (json) {
+            print_json(rec, recs[0].tsc, us_per_tick, hdr.switch_id, first);
+            first = false;
+        } else {
+            print_text(rec, recs[0].tsc, us_per_tick);
+        }
+    }
+    if (json) {
+        printf("\n]}\n");
+    }
+    
+    free(recs);
+    return 0;
+}
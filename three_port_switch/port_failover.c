@@ -0,0 +1,116 @@
+/*
+ * Precomputed Link Failover for the veth Switches - Implementation
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include "port_failover.h"
+
+void port_failover_init(struct port_failover *pf)
+{
+    memset(pf, 0, sizeof(*pf));
+    memset(pf->backup, -1, sizeof(pf->backup));
+    memset(pf->link_bit, -1, sizeof(pf->link_bit));
+}
+
+static bool has_port(const struct port_failover *pf, uint16_t port_id)
+{
+    for (uint16_t i = 0; i < pf->nb_ports; i++) {
+        if (pf->port_ids[i] == port_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int port_failover_add_port(struct port_failover *pf, uint16_t port_id, bool monitored)
+{
+    if (port_id >= PORT_FAILOVER_MAX_PORTS || has_port(pf, port_id)) {
+        return -EINVAL;
+    }
+    if (pf->nb_ports == PORT_FAILOVER_MAX_PORTS ||
+        (monitored && pf->nb_links == PORT_FAILOVER_MAX_LINKS)) {
+        return -ENOSPC;
+    }
+    pf->port_ids[pf->nb_ports++] = port_id;
+    if (monitored) {
+        pf->link_bit[port_id] = pf->nb_links;
+        pf->link_ports[pf->nb_links++] = port_id;
+    }
+    return 0;
+}
+
+int port_failover_set_backup(struct port_failover *pf, uint16_t port_id, uint16_t backup_id)
+{
+    if (!has_port(pf, port_id) || !has_port(pf, backup_id) || port_id == backup_id) {
+        return -EINVAL;
+    }
+    pf->backup[port_id] = backup_id;
+    return 0;
+}
+
+static bool port_up(const struct port_failover *pf, int port_id, uint32_t link_mask)
+{
+    return pf->link_bit[port_id] < 0 || (link_mask & (1u << pf->link_bit[port_id]));
+}
+
+/* TX port for FDB port fdb on a packet from rx while link_mask is up */
+static int egress(const struct port_failover *pf, uint16_t rx, uint16_t fdb, uint32_t link_mask)
+{
+    int backup = pf->backup[fdb];
+    
+    if (fdb == rx) {
+        return PORT_FAILOVER_FLOOD;
+    }
+    if (port_up(pf, fdb, link_mask)) {
+        return fdb;
+    }
+    if (backup >= 0 && backup != rx && port_up(pf, backup, link_mask)) {
+        return backup;
+    }
+    return PORT_FAILOVER_FLOOD;
+}
+
+static void build_state(const struct port_failover *pf, struct port_failover_state *st,
+                        uint32_t link_mask)
+{
+    memset(st->egress, PORT_FAILOVER_FLOOD, sizeof(st->egress));
+    memset(st->nb_flood, 0, sizeof(st->nb_flood));
+    
+    for (uint16_t i = 0; i < pf->nb_ports; i++) {
+        uint16_t rx = pf->port_ids[i];
+        
+        for (uint16_t j = 0; j < pf->nb_ports; j++) {
+            uint16_t out = pf->port_ids[j];
+            
+            st->egress[rx][out] = egress(pf, rx, out, link_mask);
+            if (out != rx && port_up(pf, out, link_mask)) {
+                st->flood[rx][st->nb_flood[rx]++] = out;
+            }
+        }
+    }
+}
+
+void port_failover_build(struct port_failover *pf)
+{
+    uint32_t nb_states = 1u << pf->nb_links;
+    
+    for (uint32_t mask = 0; mask < nb_states; mask++) {
+        build_state(pf, &pf->states[mask], mask);
+    }
+    __atomic_store_n(&pf->link_mask, nb_states - 1, __ATOMIC_RELEASE);
+}
+
+uint32_t port_failover_set_links(struct port_failover *pf, uint32_t link_mask)
+{
+    uint32_t changed;
+    
+    link_mask &= (1u << pf->nb_links) - 1;
+    changed = link_mask ^ __atomic_load_n(&pf->link_mask, __ATOMIC_RELAXED);
+    if (changed) {
+        __atomic_store_n(&pf->link_mask, link_mask, __ATOMIC_RELEASE);
+        pf->flips++;
+    }
+    return changed;
+}
@@ -0,0 +1,104 @@
+/*
+ * Precomputed Link Failover for the veth Switches
+ *
+ * The FDB names one port per destination. Each port may have a backup
+ * port, e.g. the other direction around a ring. For every combination of
+ * link states of the monitored ports, a forwarding state is computed up
+ * front: the TX port for each pair of RX port and FDB port, and the flood
+ * list of each RX port without the ports that are down. The link mask
+ * selects the state in use, so a link event flips every path with one
+ * atomic store. Readers load the state once per burst and never wait.
+ *
+ * A packet goes to its backup port when its FDB port is down. A packet
+ * whose FDB port is the one it arrived on, or that has no usable port, is
+ * flooded.
+ */
+
+#ifndef PORT_FAILOVER_H
+#define PORT_FAILOVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PORT_FAILOVER_MAX_PORTS 16          /* DPDK port ids below this */
+#define PORT_FAILOVER_MAX_LINKS 4           /* Monitored ports; 2^n states */
+#define PORT_FAILOVER_FLOOD (-1)
+
+/* Where packets go while one set of links is up */
+struct port_failover_state {
+    int8_t egress[PORT_FAILOVER_MAX_PORTS][PORT_FAILOVER_MAX_PORTS];  /* [RX][FDB]: TX or FLOOD */
+    uint16_t nb_flood[PORT_FAILOVER_MAX_PORTS];                       /* By RX port */
+    uint16_t flood[PORT_FAILOVER_MAX_PORTS][PORT_FAILOVER_MAX_PORTS - 1];
+};
+
+struct port_failover {
+    uint16_t nb_ports;
+    uint16_t port_ids[PORT_FAILOVER_MAX_PORTS];
+    int8_t backup[PORT_FAILOVER_MAX_PORTS];     /* By port id; -1 if none */
+    int8_t link_bit[PORT_FAILOVER_MAX_PORTS];   /* By port id; -1 if not monitored */
+    uint16_t nb_links;
+    uint16_t link_ports[PORT_FAILOVER_MAX_LINKS];
+    uint32_t link_mask;                         /* Bit per monitored port with link */
+    uint64_t flips;                             /* Link mask changes */
+    struct port_failover_state states[1 << PORT_FAILOVER_MAX_LINKS];
+};
+
+void port_failover_init(struct port_failover *pf);
+
+/*
+ * Add a forwarding port. A monitored port's link state is tracked; any
+ * other port counts as always up. Returns -EINVAL for a bad or duplicate
+ * port id, -ENOSPC if there are too many ports or monitored ports.
+ */
+int port_failover_add_port(struct port_failover *pf, uint16_t port_id, bool monitored);
+
+/*
+ * Send traffic for port_id to backup_id when port_id cannot take it
+ */
+int port_failover_set_backup(struct port_failover *pf, uint16_t port_id, uint16_t backup_id);
+
+/*
+ * Compute the state of every link mask once the ports are added, and
+ * start with all links up
+ */
+void port_failover_build(struct port_failover *pf);
+
+/*
+ * State in use; load once per burst
+ */
+static inline const struct port_failover_state *port_failover_state(const struct port_failover *pf)
+{
+    return &pf->states[__atomic_load_n(&pf->link_mask, __ATOMIC_ACQUIRE)];
+}
+
+/*
+ * TX port for a packet received on rx_port whose destination the FDB puts
+ * on fdb_port (-1 if unknown); PORT_FAILOVER_FLOOD to flood it
+ */
+static inline int port_failover_egress(const struct port_failover_state *st, uint16_t rx_port,
+                                       int fdb_port)
+{
+    if ((unsigned int)fdb_port >= PORT_FAILOVER_MAX_PORTS || rx_port >= PORT_FAILOVER_MAX_PORTS) {
+        return PORT_FAILOVER_FLOOD;
+    }
+    return st->egress[rx_port][fdb_port];
+}
+
+/*
+ * Bit of a monitored port in the link mask, or 0
+ */
+static inline uint32_t port_failover_link_bit(const struct port_failover *pf, uint16_t port_id)
+{
+    if (port_id >= PORT_FAILOVER_MAX_PORTS || pf->link_bit[port_id] < 0) {
+        return 0;
+    }
+    return 1u << pf->link_bit[port_id];
+}
+
+/*
+ * Switch every path to the state of link_mask in one store. Returns the
+ * bits that changed.
+ */
+uint32_t port_failover_set_links(struct port_failover *pf, uint32_t link_mask);
+
+#endif /* PORT_FAILOVER_H */
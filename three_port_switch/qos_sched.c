@@ -0,0 +1,355 @@
+/*
+ * Egress QoS Scheduler for the veth QoS Switch - Implementation
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include <rte_ether.h>
+#include <rte_ip.h>
+
+#include "qos_sched.h"
+#include "net_checksum.h"
+
+#define QUEUE_MASK (QOS_SCHED_QUEUE_SIZE - 1)
+#define EF_BIT (1u << QOS_SCHED_EF_CLASS)
+#define DRR_CLASSES (((1u << QOS_SCHED_NB_CLASSES) - 1) & ~EF_BIT)
+
+void qos_sched_port_init(struct qos_sched_port *p, const uint32_t *quanta,
+                         uint64_t rate_bps, uint64_t tsc_hz, uint32_t max_frame)
+{
+    memset(p, 0, sizeof(*p));
+    
+    for (int c = 0; c < QOS_SCHED_NB_CLASSES; c++) {
+        p->queues[c].quantum = quanta[c];
+    }
+    p->drr_new_turn = 1;
+    
+    p->rate = rate_bps / 8;
+    p->tsc_hz = tsc_hz;
+    p->max_frame = max_frame;
+    /* 1 ms of traffic, but always room for a couple of full frames */
+    p->tb_size = p->rate / 1000;
+    if (p->tb_size < 2 * max_frame) {
+        p->tb_size = 2 * max_frame;
+    }
+    p->tb_tokens = p->tb_size;
+    if (p->rate) {
+        p->tb_fill_tsc = p->tb_size * tsc_hz / p->rate + 1;
+    }
+}
+
+void qos_sched_set_codel(struct qos_sched_port *p, uint32_t class_mask,
+                         uint32_t target_us, uint32_t interval_us)
+{
+    for (int c = 0; c < QOS_SCHED_NB_CLASSES; c++) {
+        struct qos_codel *cd = &p->queues[c].codel;
+        
+        if (!(class_mask & (1u << c))) {
+            continue;
+        }
+        memset(cd, 0, sizeof(*cd));
+        cd->enabled = 1;
+        cd->maxpacket = p->max_frame;
+        cd->target = (uint64_t)target_us * p->tsc_hz / 1000000;
+        cd->interval = (uint64_t)interval_us * p->tsc_hz / 1000000;
+    }
+}
+
+int qos_sched_enqueue(struct qos_sched_port *p, uint8_t cls, struct rte_mbuf *m,
+                      uint64_t now)
+{
+    struct qos_class_queue *q = &p->queues[cls];
+    
+    if (q->count >= QOS_SCHED_QUEUE_SIZE) {
+        q->dropped++;
+        rte_pktmbuf_free(m);
+        return -ENOBUFS;
+    }
+    
+    q->pkts[q->tail] = m;
+    q->enq_tsc[q->tail] = now;
+    q->tail = (q->tail + 1) & QUEUE_MASK;
+    q->count++;
+    q->bytes += rte_pktmbuf_pkt_len(m);
+    q->enqueued++;
+    p->active |= 1u << cls;
+    
+    return 0;
+}
+
+static inline struct rte_mbuf *queue_pop(struct qos_sched_port *p, uint8_t cls,
+                                         uint64_t *enq_tsc)
+{
+    struct qos_class_queue *q = &p->queues[cls];
+    struct rte_mbuf *m = q->pkts[q->head];
+    
+    *enq_tsc = q->enq_tsc[q->head];
+    q->head = (q->head + 1) & QUEUE_MASK;
+    q->count--;
+    q->bytes -= rte_pktmbuf_pkt_len(m);
+    q->dequeued++;
+    if (q->count == 0) {
+        p->active &= ~(1u << cls);
+    }
+    return m;
+}
+
+/* First active DRR class at or after the current one, wrapping around */
+static inline uint8_t drr_next_class(const struct qos_sched_port *p, uint32_t mask)
+{
+    uint32_t ahead = mask & ~((1u << p->drr_current) - 1);
+    
+    return __builtin_ctz(ahead ? ahead : mask);
+}
+
+/*
+ * Pick the DRR class that may send next and return it, or -1 if no DRR
+ * class has packets. A class keeps its turn while its head packet fits its
+ * deficit; a class that empties forfeits what is left of the deficit.
+ */
+static int drr_select(struct qos_sched_port *p)
+{
+    uint32_t mask = p->active & DRR_CLASSES;
+    
+    if (mask == 0) {
+        return -1;
+    }
+    
+    for (;;) {
+        uint8_t c = drr_next_class(p, mask);
+        struct qos_class_queue *q = &p->queues[c];
+        
+        if (c != p->drr_current) {
+            p->drr_current = c;
+            p->drr_new_turn = 1;
+        }
+        if (p->drr_new_turn) {
+            q->deficit += q->quantum;
+            p->drr_new_turn = 0;
+        }
+        if ((int32_t)rte_pktmbuf_pkt_len(q->pkts[q->head]) <= q->deficit) {
+            return c;
+        }
+        
+        /* Turn over: the deficit carries to the next round */
+        p->drr_current = (c + 1) % QOS_SCHED_NB_CLASSES;
+        p->drr_new_turn = 1;
+    }
+}
+
+static uint32_t isqrt(uint32_t x)
+{
+    uint32_t r = 0;
+    
+    for (uint32_t bit = 1u << 30; bit; bit >>= 2) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+/* Next drop time: t + interval / sqrt(count) */
+static inline uint64_t codel_control_law(const struct qos_codel *cd, uint64_t t)
+{
+    uint32_t count = cd->count < 65535 ? cd->count : 65535;
+    
+    /* isqrt(count << 16) is sqrt(count) in 8.8 fixed point */
+    return t + cd->interval * 256 / isqrt(count << 16);
+}
+
+/*
+ * Whether the sojourn time has stayed above target for a whole interval.
+ * A queue holding at most one frame is never judged persistent.
+ */
+static bool codel_ok_to_drop(struct qos_class_queue *q, uint64_t sojourn, uint64_t now)
+{
+    struct qos_codel *cd = &q->codel;
+    
+    if (sojourn < cd->target || q->bytes <= cd->maxpacket) {
+        cd->first_above_time = 0;
+        return false;
+    }
+    if (cd->first_above_time == 0) {
+        cd->first_above_time = now + cd->interval;
+        return false;
+    }
+    return now >= cd->first_above_time;
+}
+
+/*
+ * RFC 8289 dequeue decision for the packet just taken off q: true if it
+ * must be dropped (or marked). Called once per packet, so the dropping
+ * state's loop over successive packets runs across calls.
+ */
+static bool codel_should_drop(struct qos_class_queue *q, uint64_t sojourn, uint64_t now)
+{
+    struct qos_codel *cd = &q->codel;
+    bool ok_to_drop = codel_ok_to_drop(q, sojourn, now);
+    uint32_t delta;
+    
+    if (cd->dropping) {
+        if (!ok_to_drop) {
+            cd->dropping = 0;
+            return false;
+        }
+        if ((int64_t)(now - cd->drop_next) < 0) {
+            return false;
+        }
+        cd->count++;
+        cd->drop_next = codel_control_law(cd, cd->drop_next);
+        return true;
+    }
+    
+    if (!ok_to_drop) {
+        return false;
+    }
+    
+    /* Resume near the previous drop rate if the last episode was recent */
+    cd->dropping = 1;
+    delta = cd->count - cd->lastcount;
+    if (delta > 1 && now - cd->drop_next < 16 * cd->interval) {
+        cd->count = delta;
+    } else {
+        cd->count = 1;
+    }
+    cd->lastcount = cd->count;
+    cd->drop_next = codel_control_law(cd, now);
+    return true;
+}
+
+/* Set CE on an ECN-capable IPv4 packet; false if it is not ECN-capable */
+static bool ecn_mark(struct rte_mbuf *m)
+{
+    struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    uint8_t *ip = (uint8_t *)(eth + 1);
+    uint16_t old_word;
+    
+    if (eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+        rte_pktmbuf_data_len(m) < sizeof(*eth) + sizeof(struct rte_ipv4_hdr)) {
+        return false;
+    }
+    if ((ip[1] & 0x03) == 0) {
+        return false;                       /* Not-ECT */
+    }
+    if ((ip[1] & 0x03) == 0x03) {
+        return true;                        /* Already CE */
+    }
+    
+    old_word = ((uint16_t)ip[0] << 8) | ip[1];
+    ip[1] |= 0x03;
+    net_csum_replace16(ip + 10, old_word, old_word | 0x03);
+    return true;
+}
+
+static inline void tb_refill(struct qos_sched_port *p, uint64_t now)
+{
+    uint64_t elapsed = now - p->tb_time;
+    uint64_t add;
+    
+    if (elapsed >= p->tb_fill_tsc) {
+        p->tb_tokens = p->tb_size;
+        p->tb_time = now;
+        return;
+    }
+    
+    /* Credit whole bytes only and keep the leftover time for the next call */
+    add = elapsed * p->rate / p->tsc_hz;
+    if (add == 0) {
+        return;
+    }
+    p->tb_tokens += add;
+    if (p->tb_tokens > p->tb_size) {
+        p->tb_tokens = p->tb_size;
+    }
+    p->tb_time += add * p->tsc_hz / p->rate;
+}
+
+uint16_t qos_sched_dequeue_burst(struct qos_sched_port *p, struct rte_mbuf **pkts,
+                                 uint16_t nb_pkts, uint64_t now)
+{
+    uint16_t n = 0;
+    
+    if (p->active == 0) {
+        return 0;
+    }
+    if (p->rate) {
+        tb_refill(p, now);
+    }
+    
+    while (n < nb_pkts && p->active) {
+        struct qos_class_queue *q;
+        struct rte_mbuf *m;
+        uint64_t enq_tsc, sojourn;
+        int cls;
+        uint32_t len;
+        
+        if (p->active & EF_BIT) {
+            cls = QOS_SCHED_EF_CLASS;
+        } else {
+            cls = drr_select(p);
+        }
+        q = &p->queues[cls];
+        
+        len = rte_pktmbuf_pkt_len(q->pkts[q->head]);
+        if (p->rate && p->tb_tokens < len) {
+            p->shaped++;
+            break;
+        }
+        
+        m = queue_pop(p, cls, &enq_tsc);
+        sojourn = now > enq_tsc ? now - enq_tsc : 0;
+        
+        if (q->codel.enabled && codel_should_drop(q, sojourn, now)) {
+            if (ecn_mark(m)) {
+                q->ecn_marked++;
+            } else {
+                q->aqm_dropped++;
+                rte_pktmbuf_free(m);
+                m = NULL;
+            }
+        }
+        
+        if (m) {
+            if (p->rate) {
+                p->tb_tokens -= len;
+            }
+            if (cls != QOS_SCHED_EF_CLASS) {
+                q->deficit -= len;
+            }
+            q->sojourn_sum += sojourn;
+            if (sojourn > q->sojourn_max) {
+                q->sojourn_max = sojourn;
+            }
+            pkts[n++] = m;
+        }
+        
+        /* A class that empties forfeits its deficit and its turn */
+        if (cls != QOS_SCHED_EF_CLASS && q->count == 0) {
+            q->deficit = 0;
+            p->drr_current = (cls + 1) % QOS_SCHED_NB_CLASSES;
+            p->drr_new_turn = 1;
+        }
+    }
+    
+    return n;
+}
+
+void qos_sched_port_flush(struct qos_sched_port *p)
+{
+    uint64_t enq_tsc;
+    
+    while (p->active) {
+        uint8_t cls = __builtin_ctz(p->active);
+        
+        rte_pktmbuf_free(queue_pop(p, cls, &enq_tsc));
+    }
+    for (int c = 0; c < QOS_SCHED_NB_CLASSES; c++) {
+        p->queues[c].deficit = 0;
+    }
+}
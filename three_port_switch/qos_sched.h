@@ -0,0 +1,117 @@
+/*
+ * Egress QoS Scheduler for the veth QoS Switch
+ *
+ * One scheduler per output port and lcore. Class QOS_SCHED_EF_CLASS
+ * (expedited forwarding) is served with strict priority; the other
+ * classes share the remaining bandwidth by byte-based deficit round robin,
+ * so a class's share follows its quantum whatever its packet sizes. An
+ * occupancy bitmap marks the non-empty classes, so picking the next class
+ * is a find-first-set and empty classes cost nothing. An optional token
+ * bucket shapes the port to a configured rate.
+ *
+ * Classes may run CoDel (RFC 8289) active queue management: packets are
+ * stamped on enqueue, and once the sojourn time stays above the target
+ * for an interval, packets are dropped at dequeue at an increasing rate.
+ * ECN-capable IPv4 packets are marked CE instead of dropped.
+ */
+
+#ifndef QOS_SCHED_H
+#define QOS_SCHED_H
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+
+#define QOS_SCHED_NB_CLASSES 8
+#define QOS_SCHED_QUEUE_SIZE 512            /* Packets per class; power of 2 */
+#define QOS_SCHED_EF_CLASS 7
+#define QOS_SCHED_MTU 1518                  /* Standard frame bytes incl. Ethernet header */
+#define QOS_SCHED_CODEL_TARGET_US 5000
+#define QOS_SCHED_CODEL_INTERVAL_US 100000
+
+/* CoDel state of one class; times in TSC cycles */
+struct qos_codel {
+    uint64_t target;
+    uint64_t interval;
+    uint64_t first_above_time;              /* End of the first interval above target */
+    uint64_t drop_next;
+    uint32_t maxpacket;                     /* Bytes of the largest frame */
+    uint32_t count;                         /* Drops in the current dropping state */
+    uint32_t lastcount;
+    uint8_t enabled;
+    uint8_t dropping;
+};
+
+struct qos_class_queue {
+    struct rte_mbuf *pkts[QOS_SCHED_QUEUE_SIZE];
+    uint64_t enq_tsc[QOS_SCHED_QUEUE_SIZE];    /* Enqueue timestamps */
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+    uint32_t bytes;                         /* Bytes queued */
+    uint32_t quantum;                       /* DRR bytes added per round */
+    int32_t deficit;
+    uint64_t enqueued;
+    uint64_t dequeued;
+    uint64_t dropped;                       /* Queue full */
+    
+    struct qos_codel codel;
+    uint64_t aqm_dropped;
+    uint64_t ecn_marked;
+    uint64_t sojourn_sum;                   /* TSC cycles over dequeued packets */
+    uint64_t sojourn_max;
+};
+
+struct qos_sched_port {
+    struct qos_class_queue queues[QOS_SCHED_NB_CLASSES];
+    uint32_t active;                        /* Bit c set while class c is non-empty */
+    uint8_t drr_current;                    /* Class whose DRR turn it is */
+    uint8_t drr_new_turn;                   /* Its quantum has not been added yet */
+    
+    /* Token bucket shaper; rate 0 leaves the port unshaped */
+    uint64_t rate;                          /* Bytes per second */
+    uint64_t tb_size;                       /* Bucket depth in bytes */
+    uint64_t tb_tokens;
+    uint64_t tb_time;                       /* TSC up to which tokens were credited */
+    uint64_t tb_fill_tsc;                   /* TSC to fill an empty bucket */
+    uint64_t tsc_hz;
+    uint32_t max_frame;                     /* Largest frame in bytes */
+    uint64_t shaped;                        /* Dequeues stopped for lack of tokens */
+};
+
+/*
+ * Initialize a port scheduler. quanta gives the DRR bytes per round of
+ * each class (the EF entry is ignored); rate_bps of 0 disables shaping.
+ * max_frame is the largest frame the port sends, QOS_SCHED_MTU unless
+ * jumbo frames are enabled.
+ */
+void qos_sched_port_init(struct qos_sched_port *p, const uint32_t *quanta,
+                         uint64_t rate_bps, uint64_t tsc_hz, uint32_t max_frame);
+
+/*
+ * Enable CoDel on every class in class_mask (bit c for class c)
+ */
+void qos_sched_set_codel(struct qos_sched_port *p, uint32_t class_mask,
+                         uint32_t target_us, uint32_t interval_us);
+
+/*
+ * Queue a packet in class cls at time now (TSC); a full queue frees it and
+ * returns -ENOBUFS
+ */
+int qos_sched_enqueue(struct qos_sched_port *p, uint8_t cls, struct rte_mbuf *m,
+                      uint64_t now);
+
+/*
+ * Dequeue up to nb_pkts packets in scheduling order, within the port's
+ * token budget at time now (TSC). Packets dropped by CoDel are freed here.
+ * Returns the number dequeued.
+ */
+uint16_t qos_sched_dequeue_burst(struct qos_sched_port *p, struct rte_mbuf **pkts,
+                                 uint16_t nb_pkts, uint64_t now);
+
+/*
+ * Free every queued packet
+ */
+void qos_sched_port_flush(struct qos_sched_port *p);
+
+#endif /* QOS_SCHED_H */
@@ -4,12 +4,18 @@
 # Accept number of switches as argument (default 3, max 10)
 NUM_SWITCHES=${1:-3}
 TOPOLOGY=${2:-line}  # line or ring
+BACKEND=${3:-af_packet}  # af_packet or af_xdp
+QUEUES=${4:-1}       # Queue pairs per veth (lcores per switch with af_xdp)
+MTU=${5:-1500}       # 9000 for jumbo frames; start the switches with the same MTU
 
 if [ "$NUM_SWITCHES" -lt 2 ] || [ "$NUM_SWITCHES" -gt 10 ]; then
     echo "Error: Number of switches must be between 2 and 10"
-    echo "Usage: $0 <num_switches> <topology>"
+    echo "Usage: $0 <num_switches> <topology> [backend] [queues] [mtu]"
     echo "  num_switches: 2-10 (default: 3)"
     echo "  topology: line or ring (default: line)"
+    echo "  backend: af_packet or af_xdp (default: af_packet)"
+    echo "  queues: queue pairs per veth (default: 1)"
+    echo "  mtu: MTU of every veth (default: 1500)"
     exit 1
 fi
 
@@ -20,6 +26,22 @@ NC='\033[0m'
 echo -e "${YELLOW}=== Setting up $NUM_SWITCHES-Switch $TOPOLOGY Topology ===${NC}"
 echo ""
 
+# Create a veth pair with QUEUES queue pairs and an MTU of MTU per end
+add_veth_pair() {
+    sudo ip link add $1 mtu $MTU numtxqueues $QUEUES numrxqueues $QUEUES type veth \
+        peer name $2 mtu $MTU numtxqueues $QUEUES numrxqueues $QUEUES
+}
+
+# Prepare a switch-side veth for AF_XDP busy polling: hard IRQs are
+# deferred while the switch polls its XSKs, and NAPI runs from its context
+prepare_af_xdp() {
+    if [ "$BACKEND" != "af_xdp" ]; then
+        return
+    fi
+    echo 2 | sudo tee /sys/class/net/$1/napi_defer_hard_irqs > /dev/null
+    echo 200000 | sudo tee /sys/class/net/$1/gro_flush_timeout > /dev/null
+}
+
 # Cleanup function
 cleanup() {
     echo "Cleaning up existing setup..."
@@ -59,7 +81,7 @@ for i in $(seq 1 $NUM_SWITCHES); do
     VETH_SW="veth_s${i}_h${i}"
     VETH_NS="veth_h${i}_s${i}"
     
-    sudo ip link add $VETH_SW type veth peer name $VETH_NS
+    add_veth_pair $VETH_SW $VETH_NS
     sudo ip link set $VETH_NS netns ns$i
     
     # Configure host interface in namespace
@@ -70,6 +92,7 @@ for i in $(seq 1 $NUM_SWITCHES); do
     # Configure switch-side interface
     sudo ip link set $VETH_SW up
     sudo ip link set $VETH_SW promisc on
+    prepare_af_xdp $VETH_SW
     
     echo -e "  ${GREEN}✓${NC} Created ns$i with host link $VETH_SW"
 done
@@ -85,11 +108,13 @@ if [ "$TOPOLOGY" == "line" ]; then
         VETH_A="veth_s${i}_s${j}"
         VETH_B="veth_s${j}_s${i}"
         
-        sudo ip link add $VETH_A type veth peer name $VETH_B
+        add_veth_pair $VETH_A $VETH_B
         sudo ip link set $VETH_A up
         sudo ip link set $VETH_B up
         sudo ip link set $VETH_A promisc on
         sudo ip link set $VETH_B promisc on
+        prepare_af_xdp $VETH_A
+        prepare_af_xdp $VETH_B
         
         echo -e "  ${GREEN}✓${NC} Connected Switch $i <-> Switch $j"
     done
@@ -104,11 +129,13 @@ elif [ "$TOPOLOGY" == "ring" ]; then
             VETH_A="veth_s${i}_s${j}"
             VETH_B="veth_s${j}_s${i}"
             
-            sudo ip link add $VETH_A type veth peer name $VETH_B
+            add_veth_pair $VETH_A $VETH_B
             sudo ip link set $VETH_A up
             sudo ip link set $VETH_B up
             sudo ip link set $VETH_A promisc on
             sudo ip link set $VETH_B promisc on
+            prepare_af_xdp $VETH_A
+            prepare_af_xdp $VETH_B
             
             echo -e "  ${GREEN}✓${NC} Connected Switch $i <-> Switch $j"
         fi
@@ -118,7 +145,7 @@ fi
 echo ""
 echo -e "${GREEN}=== Topology Setup Complete! ===${NC}"
 echo ""
-echo "Created $NUM_SWITCHES switches in $TOPOLOGY topology:"
+echo "Created $NUM_SWITCHES switches in $TOPOLOGY topology ($BACKEND, $QUEUES queue pair(s) per veth):"
 for i in $(seq 1 $NUM_SWITCHES); do
     echo "  • Switch $i (ns$i): 10.0.${i}.2/16"
 done
@@ -132,4 +159,4 @@ echo "Next steps:"
 echo -e "  ${YELLOW}./setup_static_arp.sh${NC}"
 echo -e "  ${YELLOW}./generate_mac_tables.sh $NUM_SWITCHES $TOPOLOGY${NC}"
 echo -e "  ${YELLOW}./build_veth.sh${NC}"
-echo -e "  ${YELLOW}./deploy_switches.sh $NUM_SWITCHES $TOPOLOGY${NC}"
\ No newline at end of file
+echo -e "  ${YELLOW}./deploy_switches.sh $NUM_SWITCHES $TOPOLOGY $QUEUES $BACKEND${NC}"
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+ * Software GRO/GSO for the veth Switches - Implementation
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+#include <rte_vxlan.h>
+
+#include "sw_gso.h"
+
+#define VXLAN_FLAG_VNI 0x08000000           /* I flag: the VNI is valid */
+#define VXLAN_TUNNEL_LEN (sizeof(struct rte_udp_hdr) + sizeof(struct rte_vxlan_hdr) + \
+                          RTE_ETHER_HDR_LEN)
+
+#define TCP4_PTYPE (RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_TCP)
+#define VXLAN_TCP4_PTYPE (RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_UDP | \
+                          RTE_PTYPE_TUNNEL_VXLAN | RTE_PTYPE_INNER_L2_ETHER | \
+                          RTE_PTYPE_INNER_L3_IPV4 | RTE_PTYPE_INNER_L4_TCP)
+
+int sw_gso_init(struct sw_gso *s, struct rte_mempool *direct, struct rte_mempool *indirect,
+                uint16_t mtu, uint16_t burst)
+{
+    if (!direct || !indirect) {
+        return -EINVAL;
+    }
+    memset(s, 0, sizeof(*s));
+    
+    /* Burst mode keeps no tables; the limits only bound one burst */
+    s->gro.gro_types = RTE_GRO_TCP_IPV4 | RTE_GRO_IPV4_VXLAN_TCP_IPV4;
+    s->gro.max_flow_num = burst;
+    s->gro.max_item_per_flow = burst;
+    
+    s->gso.direct_pool = direct;
+    s->gso.indirect_pool = indirect;
+    s->gso.gso_types = RTE_ETH_TX_OFFLOAD_TCP_TSO | RTE_ETH_TX_OFFLOAD_VXLAN_TNL_TSO;
+    s->gso.gso_size = mtu + RTE_ETHER_HDR_LEN;
+    s->gso.flag = 0;                        /* IP IDs increase per segment */
+    return 0;
+}
+
+/* Length of an unfragmented IPv4 header for proto at off, or 0 */
+static uint32_t ipv4_hdr_at(const struct rte_mbuf *m, uint32_t off, uint8_t proto)
+{
+    const struct rte_ipv4_hdr *ip;
+    uint32_t len;
+    
+    if (rte_pktmbuf_data_len(m) < off + sizeof(*ip)) {
+        return 0;
+    }
+    ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, off);
+    len = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+    if ((ip->version_ihl >> 4) != 4 || len < sizeof(*ip) || ip->next_proto_id != proto ||
+        rte_ipv4_frag_pkt_is_fragmented(ip)) {
+        return 0;
+    }
+    return len;
+}
+
+/* Length of the TCP header at off, or 0 if it is not in the first segment */
+static uint32_t tcp_hdr_at(const struct rte_mbuf *m, uint32_t off)
+{
+    const struct rte_tcp_hdr *tcp;
+    uint32_t len;
+    
+    if (rte_pktmbuf_data_len(m) < off + sizeof(*tcp)) {
+        return 0;
+    }
+    tcp = rte_pktmbuf_mtod_offset(m, const struct rte_tcp_hdr *, off);
+    len = (tcp->data_off >> 4) * 4;
+    if (len < sizeof(*tcp) || rte_pktmbuf_data_len(m) < off + len) {
+        return 0;
+    }
+    return len;
+}
+
+/*
+ * Set packet_type and the header lengths GRO and GSO work from. Anything
+ * but TCP/IPv4 or VXLAN TCP/IPv4 with all headers in the first segment
+ * gets an unknown type, so GRO passes it through.
+ */
+static bool classify(struct rte_mbuf *m)
+{
+    const struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+    const struct rte_udp_hdr *udp;
+    const struct rte_vxlan_hdr *vxlan;
+    uint32_t l3, l4, off;
+    
+    m->packet_type = RTE_PTYPE_UNKNOWN;
+    if (rte_pktmbuf_data_len(m) < RTE_ETHER_HDR_LEN ||
+        eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+        return false;
+    }
+    
+    l3 = ipv4_hdr_at(m, RTE_ETHER_HDR_LEN, IPPROTO_TCP);
+    if (l3 != 0) {
+        l4 = tcp_hdr_at(m, RTE_ETHER_HDR_LEN + l3);
+        if (l4 == 0) {
+            return false;
+        }
+        m->packet_type = TCP4_PTYPE;
+        m->l2_len = RTE_ETHER_HDR_LEN;
+        m->l3_len = l3;
+        m->l4_len = l4;
+        return true;
+    }
+    
+    /* VXLAN: UDP to the IANA port, then Ethernet, IPv4 and TCP */
+    l3 = ipv4_hdr_at(m, RTE_ETHER_HDR_LEN, IPPROTO_UDP);
+    off = RTE_ETHER_HDR_LEN + l3;
+    if (l3 == 0 || rte_pktmbuf_data_len(m) < off + VXLAN_TUNNEL_LEN) {
+        return false;
+    }
+    udp = rte_pktmbuf_mtod_offset(m, const struct rte_udp_hdr *, off);
+    vxlan = (const struct rte_vxlan_hdr *)(udp + 1);
+    eth = (const struct rte_ether_hdr *)(vxlan + 1);
+    if (udp->dst_port != rte_cpu_to_be_16(RTE_VXLAN_DEFAULT_PORT) ||
+        !(vxlan->vx_flags & rte_cpu_to_be_32(VXLAN_FLAG_VNI)) ||
+        eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+        return false;
+    }
+    
+    off += VXLAN_TUNNEL_LEN;
+    m->l3_len = ipv4_hdr_at(m, off, IPPROTO_TCP);
+    m->l4_len = m->l3_len ? tcp_hdr_at(m, off + m->l3_len) : 0;
+    if (m->l4_len == 0) {
+        return false;
+    }
+    m->packet_type = VXLAN_TCP4_PTYPE;
+    m->outer_l2_len = RTE_ETHER_HDR_LEN;
+    m->outer_l3_len = l3;
+    m->l2_len = VXLAN_TUNNEL_LEN;
+    return true;
+}
+
+static inline bool is_vxlan(const struct rte_mbuf *m)
+{
+    return (m->packet_type & RTE_PTYPE_TUNNEL_MASK) == RTE_PTYPE_TUNNEL_VXLAN;
+}
+
+static void ipv4_cksum_update(struct rte_mbuf *m, uint32_t off)
+{
+    struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, off);
+    
+    ip->hdr_checksum = 0;
+    ip->hdr_checksum = rte_ipv4_cksum(ip);
+}
+
+/*
+ * Redo the header checksums of seg after GRO or GSO rewrote lengths and
+ * IDs; hdr is the packet the header offsets were classified on
+ */
+static void headers_update(struct rte_mbuf *seg, const struct rte_mbuf *hdr)
+{
+    if (is_vxlan(hdr)) {
+        uint32_t udp_off = hdr->outer_l2_len + hdr->outer_l3_len;
+        struct rte_udp_hdr *udp = rte_pktmbuf_mtod_offset(seg, struct rte_udp_hdr *, udp_off);
+        
+        ipv4_cksum_update(seg, hdr->outer_l2_len);
+        udp->dgram_cksum = 0;               /* Optional over IPv4, and stale now */
+        ipv4_cksum_update(seg, udp_off + hdr->l2_len);
+    } else {
+        ipv4_cksum_update(seg, hdr->l2_len);
+    }
+}
+
+uint16_t sw_gro_burst(struct sw_gso *s, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+    uint16_t nb_tcp = 0;
+    uint16_t n;
+    
+    for (uint16_t i = 0; i < nb_pkts; i++) {
+        nb_tcp += classify(pkts[i]);
+    }
+    if (nb_tcp < 2) {
+        return nb_pkts;
+    }
+    
+    n = rte_gro_reassemble_burst(pkts, nb_pkts, &s->gro);
+    s->gro_in += nb_tcp;
+    s->gro_out += nb_tcp - (nb_pkts - n);
+    if (n == nb_pkts) {
+        return n;
+    }
+    
+    /* Merged packets are chains; redoing an intact checksum changes nothing */
+    for (uint16_t i = 0; i < n; i++) {
+        if (pkts[i]->nb_segs > 1 && pkts[i]->packet_type != RTE_PTYPE_UNKNOWN) {
+            headers_update(pkts[i], pkts[i]);
+        }
+    }
+    return n;
+}
+
+int sw_gso_segment(struct sw_gso *s, struct rte_mbuf *m, struct rte_mbuf **out,
+                   uint16_t nb_out)
+{
+    int ret;
+    
+    /* GSO clears the flags it segments by; a flooded packet comes by once per port */
+    if (m->packet_type == TCP4_PTYPE) {
+        m->ol_flags |= RTE_MBUF_F_TX_TCP_SEG | RTE_MBUF_F_TX_IPV4;
+    } else if (m->packet_type == VXLAN_TCP4_PTYPE) {
+        m->ol_flags |= RTE_MBUF_F_TX_TCP_SEG | RTE_MBUF_F_TX_IPV4 |
+                       RTE_MBUF_F_TX_OUTER_IPV4 | RTE_MBUF_F_TX_TUNNEL_VXLAN;
+    } else {
+        return 0;
+    }
+    
+    ret = rte_gso_segment(m, &s->gso, out, nb_out);
+    if (ret < 0) {
+        s->gso_failed++;
+        return ret;
+    }
+    if (ret == 0) {
+        return 0;
+    }
+    
+    for (int i = 0; i < ret; i++) {
+        headers_update(out[i], m);
+    }
+    s->gso_in++;
+    s->gso_out += ret;
+    
+    /* The segments hold their own references to the payload */
+    rte_pktmbuf_free(m);
+    return ret;
+}
@@ -0,0 +1,74 @@
+/*
+ * Software GRO/GSO for the veth Switches
+ *
+ * Hosts behind a switch send TCP through their veth in MTU-sized packets,
+ * and every one of them costs a lookup, a TX buffer slot and a PMD call.
+ * GRO merges the TCP/IPv4 and VXLAN TCP/IPv4 segments of each flow within
+ * an RX burst into one chained packet, so the forwarding pipeline handles
+ * a few large packets instead of many small ones. Nothing is held across
+ * bursts, so merging adds no latency. GSO cuts a merged packet back into
+ * MTU-sized segments just before it is queued for TX; each segment is a
+ * header copy followed by indirect mbufs that reference the payload.
+ *
+ * GRO and GSO leave L4 checksums alone; IPv4 header checksums are redone
+ * whenever a header changes. A veth marks frames injected through its
+ * peer as checksum-verified, and hosts behind a veth leave their TCP
+ * checksums to offload anyway.
+ */
+
+#ifndef SW_GSO_H
+#define SW_GSO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_gro.h>
+#include <rte_gso.h>
+
+#define SW_GSO_MAX_SEGS 64                  /* Segments of one merged packet */
+
+/* Per-lcore GRO/GSO state */
+struct sw_gso {
+    struct rte_gro_param gro;
+    struct rte_gso_ctx gso;
+    uint64_t gro_in;                        /* Packets offered to GRO */
+    uint64_t gro_out;                       /* Packets left after merging */
+    uint64_t gso_in;                        /* Merged packets segmented */
+    uint64_t gso_out;                       /* Segments sent for them */
+    uint64_t gso_failed;                    /* Out of mbufs; packet dropped */
+};
+
+/*
+ * Set up GRO for bursts of up to burst packets and GSO to frames of at
+ * most mtu bytes plus the Ethernet header. Segment headers come from
+ * direct, payload references from indirect.
+ */
+int sw_gso_init(struct sw_gso *s, struct rte_mempool *direct, struct rte_mempool *indirect,
+                uint16_t mtu, uint16_t burst);
+
+/*
+ * Merge the TCP segments of each flow in pkts. Returns the number of
+ * packets left, compacted at the front of pkts.
+ */
+uint16_t sw_gro_burst(struct sw_gso *s, struct rte_mbuf **pkts, uint16_t nb_pkts);
+
+/*
+ * Whether m is larger than a frame and must go through sw_gso_segment()
+ */
+static inline bool sw_gso_needed(const struct sw_gso *s, const struct rte_mbuf *m)
+{
+    return m->pkt_len > s->gso.gso_size;
+}
+
+/*
+ * Cut a merged packet into segments of at most one frame. On success the
+ * caller's reference to m is released and the number of segments in out
+ * is returned. Returns 0 if m needs no segmenting and -errno if it could
+ * not be segmented; m is untouched in both cases.
+ */
+int sw_gso_segment(struct sw_gso *s, struct rte_mbuf *m, struct rte_mbuf **out,
+                   uint16_t nb_out);
+
+#endif /* SW_GSO_H */
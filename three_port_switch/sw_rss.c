@@ -0,0 +1,151 @@
+/*
+ * Software RSS for the veth Switches - Implementation
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+
+#include "sw_rss.h"
+#include "pkt_meta.h"
+
+int sw_rss_port_init(struct sw_rss_port *p, const char *name, uint16_t port_id,
+                     uint16_t nb_workers, int socket_id)
+{
+    char ring_name[RTE_RING_NAMESIZE];
+    
+    if (nb_workers == 0 || nb_workers > SW_RSS_MAX_WORKERS) {
+        return -EINVAL;
+    }
+    
+    memset(p, 0, sizeof(*p));
+    p->port_id = port_id;
+    p->nb_workers = nb_workers;
+    
+    for (uint16_t w = 0; w < nb_workers; w++) {
+        snprintf(ring_name, sizeof(ring_name), "%s_rx%u", name, w);
+        p->rx_ring[w] = rte_ring_create(ring_name, SW_RSS_RING_SIZE, socket_id,
+                                        RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (!p->rx_ring[w]) {
+            sw_rss_port_free(p);
+            return -ENOMEM;
+        }
+    }
+    
+    snprintf(ring_name, sizeof(ring_name), "%s_tx", name);
+    p->tx_ring = rte_ring_create(ring_name, SW_RSS_RING_SIZE, socket_id, RING_F_SC_DEQ);
+    if (!p->tx_ring) {
+        sw_rss_port_free(p);
+        return -ENOMEM;
+    }
+    
+    return 0;
+}
+
+static void ring_drain_free(struct rte_ring *r)
+{
+    struct rte_mbuf *pkts[SW_RSS_BURST];
+    unsigned int n;
+    
+    while ((n = rte_ring_dequeue_burst(r, (void **)pkts, SW_RSS_BURST, NULL)) > 0) {
+        rte_pktmbuf_free_bulk(pkts, n);
+    }
+}
+
+void sw_rss_port_free(struct sw_rss_port *p)
+{
+    for (uint16_t w = 0; w < SW_RSS_MAX_WORKERS; w++) {
+        if (p->rx_ring[w]) {
+            ring_drain_free(p->rx_ring[w]);
+            rte_ring_free(p->rx_ring[w]);
+            p->rx_ring[w] = NULL;
+        }
+    }
+    if (p->tx_ring) {
+        ring_drain_free(p->tx_ring);
+        rte_ring_free(p->tx_ring);
+        p->tx_ring = NULL;
+    }
+}
+
+uint32_t sw_rss_hash(struct rte_mbuf *m)
+{
+    const struct rte_ether_hdr *eth;
+    const uint16_t *src, *dst;
+    const struct rte_ipv4_hdr *ip;
+    struct pkt_meta md;
+    uint64_t h;
+    
+    /* Parsing first pulls a chained packet's headers into its first segment */
+    pkt_meta_parse(m, &md);
+    eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+    src = (const uint16_t *)&eth->src_addr;
+    dst = (const uint16_t *)&eth->dst_addr;
+    
+    /* XOR of each source/destination pair keeps the hash symmetric */
+    h = (uint64_t)(src[0] ^ dst[0]) << 32 | (uint32_t)(src[1] ^ dst[1]) << 16 | (src[2] ^ dst[2]);
+    
+    ip = pkt_meta_ipv4(m, &md);
+    if (ip) {
+        h ^= (uint64_t)(ip->src_addr ^ ip->dst_addr) << 16;
+        
+        /* Fragments carry no ports after the first, so hash on addresses only */
+        if (pkt_meta_has_ports(&md)) {
+            const uint16_t *ports = pkt_meta_l4(m, &md);
+            
+            h ^= (uint64_t)(ports[0] ^ ports[1]) << 48 | ip->next_proto_id;
+        }
+    }
+    
+    return (uint32_t)((h * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+void sw_rss_distribute(struct sw_rss_port *p, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+    struct rte_mbuf *per_worker[SW_RSS_MAX_WORKERS][SW_RSS_BURST];
+    uint16_t count[SW_RSS_MAX_WORKERS] = {0};
+    
+    for (uint16_t i = 0; i < nb_pkts; i++) {
+        /* Multiply-shift maps the hash onto the workers without a divide */
+        uint16_t w = ((uint64_t)sw_rss_hash(pkts[i]) * p->nb_workers) >> 32;
+        
+        per_worker[w][count[w]++] = pkts[i];
+        if (count[w] == SW_RSS_BURST) {
+            unsigned int n = rte_ring_sp_enqueue_burst(p->rx_ring[w], (void **)per_worker[w],
+                                                       SW_RSS_BURST, NULL);
+            
+            rte_pktmbuf_free_bulk(&per_worker[w][n], SW_RSS_BURST - n);
+            p->rx_dropped += SW_RSS_BURST - n;
+            count[w] = 0;
+        }
+    }
+    
+    for (uint16_t w = 0; w < p->nb_workers; w++) {
+        if (count[w] > 0) {
+            unsigned int n = rte_ring_sp_enqueue_burst(p->rx_ring[w], (void **)per_worker[w],
+                                                       count[w], NULL);
+            
+            rte_pktmbuf_free_bulk(&per_worker[w][n], count[w] - n);
+            p->rx_dropped += count[w] - n;
+        }
+    }
+}
+
+uint16_t sw_rss_tx_drain(struct sw_rss_port *p)
+{
+    struct rte_mbuf *pkts[SW_RSS_BURST];
+    unsigned int n = rte_ring_sc_dequeue_burst(p->tx_ring, (void **)pkts, SW_RSS_BURST, NULL);
+    uint16_t sent;
+    
+    if (n == 0) {
+        return 0;
+    }
+    sent = rte_eth_tx_burst(p->port_id, 0, pkts, n);
+    rte_pktmbuf_free_bulk(&pkts[sent], n - sent);
+    p->tx_dropped += n - sent;
+    
+    return sent;
+}
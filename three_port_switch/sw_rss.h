@@ -0,0 +1,81 @@
+/*
+ * Software RSS for the veth Switches
+ *
+ * Spreads one port's traffic over several forwarding lcores when its PMD
+ * cannot give every lcore its own RX/TX queue pair. The lcore that owns
+ * queue 0 receives for everybody and hands each packet to a worker ring
+ * chosen by a symmetric flow hash, so both directions of a flow land on
+ * the same lcore and packet order within a flow is kept. Workers send
+ * through a shared ring that the owner drains into queue 0.
+ */
+
+#ifndef SW_RSS_H
+#define SW_RSS_H
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+
+#define SW_RSS_MAX_WORKERS 16
+#define SW_RSS_RING_SIZE 1024
+#define SW_RSS_BURST 32
+
+struct sw_rss_port {
+    uint16_t port_id;
+    uint16_t nb_workers;
+    struct rte_ring *rx_ring[SW_RSS_MAX_WORKERS];   /* Owner to worker, SP/SC */
+    struct rte_ring *tx_ring;                       /* Workers to owner, MP/SC */
+    uint64_t rx_dropped;                            /* Worker ring full; owner only */
+    uint64_t tx_dropped;                            /* PMD refused; owner only */
+};
+
+/*
+ * Create the rings for port_id shared by nb_workers lcores
+ */
+int sw_rss_port_init(struct sw_rss_port *p, const char *name, uint16_t port_id,
+                     uint16_t nb_workers, int socket_id);
+
+/*
+ * Free the rings and any packets still queued on them
+ */
+void sw_rss_port_free(struct sw_rss_port *p);
+
+/*
+ * Flow hash over the MAC pair and, for IPv4, the address and TCP/UDP port
+ * pairs; symmetric in source and destination. Leaves the parsed ptype in
+ * m->packet_type for the worker.
+ */
+uint32_t sw_rss_hash(struct rte_mbuf *m);
+
+/*
+ * Owner: hand a received burst to the workers; packets that do not fit
+ * are freed and counted in rx_dropped
+ */
+void sw_rss_distribute(struct sw_rss_port *p, struct rte_mbuf **pkts, uint16_t nb_pkts);
+
+/*
+ * Owner: send what the workers queued for transmission; returns the
+ * number of packets sent
+ */
+uint16_t sw_rss_tx_drain(struct sw_rss_port *p);
+
+/*
+ * Worker: packets distributed to worker
+ */
+static inline uint16_t sw_rss_rx(struct sw_rss_port *p, uint16_t worker,
+                                 struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+    return rte_ring_sc_dequeue_burst(p->rx_ring[worker], (void **)pkts, nb_pkts, NULL);
+}
+
+/*
+ * Worker: queue packets for the owner to send; returns how many were
+ * taken, the caller frees the rest
+ */
+static inline uint16_t sw_rss_tx(struct sw_rss_port *p, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+    return rte_ring_mp_enqueue_burst(p->tx_ring, (void **)pkts, nb_pkts, NULL);
+}
+
+#endif /* SW_RSS_H */
@@ -0,0 +1,146 @@
+/*
+ * Shared-Memory Switch Statistics - Implementation
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "switch_stats.h"
+
+void switch_stats_name(char *buf, size_t len, const char *app, uint32_t switch_id)
+{
+    snprintf(buf, len, "/" SWITCH_STATS_PREFIX "%s_%u", app, switch_id);
+}
+
+int switch_stats_create(struct switch_stats *st, const char *app, uint32_t switch_id)
+{
+    struct switch_stats_shm *shm;
+    int fd, err;
+    
+    memset(st, 0, sizeof(*st));
+    switch_stats_name(st->name, sizeof(st->name), app, switch_id);
+    
+    /* A segment left behind by a crashed switch is reused */
+    fd = shm_open(st->name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (ftruncate(fd, sizeof(*shm)) < 0) {
+        err = -errno;
+        close(fd);
+        return err;
+    }
+    shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    err = -errno;
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return err;
+    }
+    
+    memset(shm, 0, sizeof(*shm));
+    shm->version = SWITCH_STATS_VERSION;
+    shm->size = sizeof(*shm);
+    shm->pid = getpid();
+    shm->switch_id = switch_id;
+    snprintf(shm->app, sizeof(shm->app), "%s", app);
+    __atomic_store_n(&shm->magic, SWITCH_STATS_MAGIC, __ATOMIC_RELEASE);
+    
+    st->shm = shm;
+    st->writer = true;
+    return 0;
+}
+
+int switch_stats_attach(struct switch_stats *st, const char *name)
+{
+    struct switch_stats_shm *shm;
+    struct stat sb;
+    int fd, err;
+    
+    memset(st, 0, sizeof(*st));
+    snprintf(st->name, sizeof(st->name), "%s%s", name[0] == '/' ? "" : "/", name);
+    
+    fd = shm_open(st->name, O_RDONLY, 0);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (fstat(fd, &sb) < 0) {
+        err = -errno;
+        close(fd);
+        return err;
+    }
+    if ((size_t)sb.st_size != sizeof(*shm)) {
+        close(fd);
+        return -EPROTO;
+    }
+    shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+    err = -errno;
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return err;
+    }
+    
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != SWITCH_STATS_MAGIC ||
+        shm->version != SWITCH_STATS_VERSION || shm->size != sizeof(*shm)) {
+        munmap(shm, sizeof(*shm));
+        return -EPROTO;
+    }
+    
+    st->shm = shm;
+    return 0;
+}
+
+void switch_stats_close(struct switch_stats *st)
+{
+    if (!st->shm) {
+        return;
+    }
+    munmap(st->shm, sizeof(*st->shm));
+    if (st->writer) {
+        shm_unlink(st->name);
+    }
+    st->shm = NULL;
+}
+
+void switch_stats_publish(struct switch_stats *st, struct switch_stats_counters *c)
+{
+    struct switch_stats_shm *shm = st->shm;
+    uint64_t seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    
+    /* Odd sequence: readers that overlap this copy discard theirs */
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&shm->c, c, sizeof(*c));
+    shm->published++;
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int switch_stats_read(const struct switch_stats *st, struct switch_stats_counters *c)
+{
+    const struct switch_stats_shm *shm = st->shm;
+    
+    for (int i = 0; i < SWITCH_STATS_READ_RETRIES; i++) {
+        uint64_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(c, &shm->c, sizeof(*c));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq) {
+            return seq == 0 ? -ENODATA : 0;
+        }
+    }
+    return -EAGAIN;
+}
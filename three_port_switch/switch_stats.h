@@ -0,0 +1,133 @@
+/*
+ * Shared-Memory Switch Statistics
+ *
+ * A switch publishes its counters into a POSIX shared-memory segment
+ * (/dev/shm/switch_stats_<app>_<id>) that monitoring tools map read-only,
+ * so reading them costs the datapath nothing and needs no log parsing.
+ * One thread of the switch copies a snapshot in periodically; the copy is
+ * guarded by a sequence lock, so readers retry instead of blocking the
+ * writer and never see a half-written snapshot.
+ *
+ * The segment starts with a magic number and a layout version. A reader
+ * refuses a segment whose version differs from its own; any change to the
+ * structures below must bump SWITCH_STATS_VERSION.
+ */
+
+#ifndef SWITCH_STATS_H
+#define SWITCH_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SWITCH_STATS_MAGIC 0x54535753       /* "SWST" */
+#define SWITCH_STATS_VERSION 1
+#define SWITCH_STATS_PREFIX "switch_stats_"
+#define SWITCH_STATS_NAME_LEN 64
+#define SWITCH_STATS_MAX_PORTS 4
+#define SWITCH_STATS_NB_CLASSES 8
+#define SWITCH_STATS_MAX_LCORES 16
+#define SWITCH_STATS_READ_RETRIES 1000
+
+/* One QoS class of an output port */
+struct switch_stats_class {
+    uint64_t enqueued;
+    uint64_t dequeued;
+    uint64_t tail_dropped;                  /* Queue full */
+    uint64_t aqm_dropped;
+    uint64_t ecn_marked;
+    uint64_t backlog;                       /* Packets queued at snapshot time */
+    uint64_t sojourn_sum_ns;                /* Over dequeued packets */
+    uint64_t sojourn_max_ns;
+};
+
+struct switch_stats_port {
+    char name[16];
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    uint64_t rx_dropped;                    /* Dropped before classification */
+    uint64_t tx_dropped;                    /* TX ring full */
+    uint64_t shaped;                        /* Dequeues held back by the shaper */
+    struct switch_stats_class classes[SWITCH_STATS_NB_CLASSES];
+};
+
+/* Idle policy of one forwarding lcore */
+struct switch_stats_lcore {
+    uint64_t busy_polls;
+    uint64_t idle_polls;
+    uint64_t sleeps;
+    uint64_t intr_waits;
+    uint64_t asleep_ns;
+};
+
+/* One snapshot; counters never decrease while the writer runs */
+struct switch_stats_counters {
+    uint64_t time_ns;                       /* CLOCK_MONOTONIC when published */
+    uint64_t forwarded;
+    uint64_t dropped;
+    uint64_t qos_classified;
+    uint64_t ttl_expired;
+    uint64_t rss_distributed;
+    uint64_t hairpinned;
+    uint32_t fdb_entries;
+    uint32_t fdb_capacity;
+    uint32_t nb_ports;
+    uint32_t nb_lcores;
+    struct switch_stats_port ports[SWITCH_STATS_MAX_PORTS];
+    struct switch_stats_lcore lcores[SWITCH_STATS_MAX_LCORES];
+};
+
+/* Segment layout */
+struct switch_stats_shm {
+    uint32_t magic;                         /* Written last by the creator */
+    uint32_t version;
+    uint32_t size;                          /* sizeof(struct switch_stats_shm) */
+    int32_t pid;                            /* Writer process */
+    uint32_t switch_id;
+    char app[28];
+    uint64_t seq __attribute__((aligned(64)));  /* Odd while a snapshot is written */
+    uint64_t published;                     /* Snapshots written */
+    struct switch_stats_counters c;
+};
+
+/* Handle on a mapped segment */
+struct switch_stats {
+    struct switch_stats_shm *shm;
+    char name[SWITCH_STATS_NAME_LEN];
+    bool writer;
+};
+
+/*
+ * Segment name of switch switch_id of application app, e.g. "qos"
+ */
+void switch_stats_name(char *buf, size_t len, const char *app, uint32_t switch_id);
+
+/*
+ * Create (or take over a stale) segment and map it for writing
+ */
+int switch_stats_create(struct switch_stats *st, const char *app, uint32_t switch_id);
+
+/*
+ * Map an existing segment read-only. Returns -ENOENT if it does not exist
+ * and -EPROTO if its magic, version or size do not match.
+ */
+int switch_stats_attach(struct switch_stats *st, const char *name);
+
+/*
+ * Unmap the segment; the writer also removes it
+ */
+void switch_stats_close(struct switch_stats *st);
+
+/*
+ * Copy c into the segment, stamping c->time_ns. Single writer only.
+ */
+void switch_stats_publish(struct switch_stats *st, struct switch_stats_counters *c);
+
+/*
+ * Copy a consistent snapshot out of the segment. Returns -EAGAIN if the
+ * writer kept it busy for SWITCH_STATS_READ_RETRIES attempts and -ENODATA
+ * if nothing has been published yet.
+ */
+int switch_stats_read(const struct switch_stats *st, struct switch_stats_counters *c);
+
+#endif /* SWITCH_STATS_H */
@@ -0,0 +1,273 @@
+/*
+ * Switch Statistics Reader
+ *
+ * Prints the counters a switch publishes in shared memory (see
+ * switch_stats.h), once or every -i milliseconds with per-second rates.
+ * -k prints one "key value" line per counter for scripts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "switch_stats.h"
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("Read switch counters from shared memory\n\n");
+    printf("Options:\n");
+    printf("  -a APP      Switch application: qos, doca (default: qos)\n");
+    printf("  -s ID       Switch ID (default: 1)\n");
+    printf("  -n NAME     Segment name, overrides -a/-s (e.g. switch_stats_qos_1)\n");
+    printf("  -i MSEC     Refresh every MSEC milliseconds (default: print once)\n");
+    printf("  -c COUNT    Stop after COUNT refreshes (default: 0 = until Ctrl+C)\n");
+    printf("  -k          Print \"key value\" lines instead of tables\n");
+    printf("  -l          List the segments in /dev/shm\n");
+    printf("  -h          Show this help\n");
+}
+
+static int list_segments(void)
+{
+    DIR *dir = opendir("/dev/shm");
+    struct dirent *de;
+    
+    if (!dir) {
+        perror("/dev/shm");
+        return 1;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        struct switch_stats st;
+        
+        if (strncmp(de->d_name, SWITCH_STATS_PREFIX, strlen(SWITCH_STATS_PREFIX)) != 0) {
+            continue;
+        }
+        if (switch_stats_attach(&st, de->d_name) < 0) {
+            printf("%-32s (unreadable or other version)\n", de->d_name);
+            continue;
+        }
+        printf("%-32s switch %u, %s, pid %d%s\n", de->d_name, st.shm->switch_id,
+               st.shm->app, st.shm->pid,
+               kill(st.shm->pid, 0) < 0 && errno == ESRCH ? " (exited)" : "");
+        switch_stats_close(&st);
+    }
+    closedir(dir);
+    return 0;
+}
+
+static double rate(uint64_t cur, uint64_t prev, double secs)
+{
+    return secs > 0 ? (cur - prev) / secs : 0.0;
+}
+
+static void print_keys(const struct switch_stats_counters *c)
+{
+    printf("time_ns %lu\n", c->time_ns);
+    printf("forwarded %lu\n", c->forwarded);
+    printf("dropped %lu\n", c->dropped);
+    printf("qos_classified %lu\n", c->qos_classified);
+    printf("ttl_expired %lu\n", c->ttl_expired);
+    printf("rss_distributed %lu\n", c->rss_distributed);
+    printf("hairpinned %lu\n", c->hairpinned);
+    printf("fdb_entries %u\n", c->fdb_entries);
+    printf("fdb_capacity %u\n", c->fdb_capacity);
+    
+    for (uint32_t i = 0; i < c->nb_ports && i < SWITCH_STATS_MAX_PORTS; i++) {
+        const struct switch_stats_port *p = &c->ports[i];
+        
+        printf("port.%u.rx_packets %lu\n", i, p->rx_packets);
+        printf("port.%u.tx_packets %lu\n", i, p->tx_packets);
+        printf("port.%u.rx_dropped %lu\n", i, p->rx_dropped);
+        printf("port.%u.tx_dropped %lu\n", i, p->tx_dropped);
+        printf("port.%u.shaped %lu\n", i, p->shaped);
+        for (int q = 0; q < SWITCH_STATS_NB_CLASSES; q++) {
+            const struct switch_stats_class *cl = &p->classes[q];
+            
+            printf("port.%u.class.%d.enqueued %lu\n", i, q, cl->enqueued);
+            printf("port.%u.class.%d.dequeued %lu\n", i, q, cl->dequeued);
+            printf("port.%u.class.%d.tail_dropped %lu\n", i, q, cl->tail_dropped);
+            printf("port.%u.class.%d.aqm_dropped %lu\n", i, q, cl->aqm_dropped);
+            printf("port.%u.class.%d.ecn_marked %lu\n", i, q, cl->ecn_marked);
+            printf("port.%u.class.%d.backlog %lu\n", i, q, cl->backlog);
+            printf("port.%u.class.%d.sojourn_sum_ns %lu\n", i, q, cl->sojourn_sum_ns);
+            printf("port.%u.class.%d.sojourn_max_ns %lu\n", i, q, cl->sojourn_max_ns);
+        }
+    }
+    
+    for (uint32_t w = 0; w < c->nb_lcores && w < SWITCH_STATS_MAX_LCORES; w++) {
+        const struct switch_stats_lcore *l = &c->lcores[w];
+        
+        printf("lcore.%u.busy_polls %lu\n", w, l->busy_polls);
+        printf("lcore.%u.idle_polls %lu\n", w, l->idle_polls);
+        printf("lcore.%u.sleeps %lu\n", w, l->sleeps);
+        printf("lcore.%u.intr_waits %lu\n", w, l->intr_waits);
+        printf("lcore.%u.asleep_ns %lu\n", w, l->asleep_ns);
+    }
+    printf("\n");
+}
+
+/* Tables; rates are against prev when there is one */
+static void print_tables(const struct switch_stats *st, const struct switch_stats_counters *c,
+                         const struct switch_stats_counters *prev)
+{
+    double secs = prev ? (c->time_ns - prev->time_ns) / 1e9 : 0.0;
+    struct timespec ts;
+    uint64_t now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    
+    printf("[Switch %u] %s, pid %d, snapshot %.0f ms old%s\n",
+           st->shm->switch_id, st->shm->app, st->shm->pid,
+           now > c->time_ns ? (now - c->time_ns) / 1e6 : 0.0,
+           kill(st->shm->pid, 0) < 0 && errno == ESRCH ? " (writer exited)" : "");
+    printf("  Forwarded=%lu Dropped=%lu QoS=%lu TTL=%lu RSS=%lu Hairpin=%lu MACs=%u/%u\n",
+           c->forwarded, c->dropped, c->qos_classified, c->ttl_expired,
+           c->rss_distributed, c->hairpinned, c->fdb_entries, c->fdb_capacity);
+    
+    printf("  %-4s %-10s %12s %12s %10s %10s %10s %10s\n",
+           "Port", "Name", "RX", "TX", "RXDrop", "TXDrop", "RX pps", "TX pps");
+    for (uint32_t i = 0; i < c->nb_ports && i < SWITCH_STATS_MAX_PORTS; i++) {
+        const struct switch_stats_port *p = &c->ports[i];
+        
+        printf("  %-4u %-10s %12lu %12lu %10lu %10lu %10.0f %10.0f\n",
+               i, p->name, p->rx_packets, p->tx_packets, p->rx_dropped, p->tx_dropped,
+               prev ? rate(p->rx_packets, prev->ports[i].rx_packets, secs) : 0.0,
+               prev ? rate(p->tx_packets, prev->ports[i].tx_packets, secs) : 0.0);
+    }
+    
+    printf("  %-4s %-5s %12s %8s %10s %10s %10s %10s %10s\n",
+           "Port", "Class", "Dequeued", "Backlog", "TailDrop", "AQMDrop", "ECN",
+           "AvgUs", "MaxUs");
+    for (uint32_t i = 0; i < c->nb_ports && i < SWITCH_STATS_MAX_PORTS; i++) {
+        for (int q = 0; q < SWITCH_STATS_NB_CLASSES; q++) {
+            const struct switch_stats_class *cl = &c->ports[i].classes[q];
+            uint64_t sent = cl->dequeued - cl->aqm_dropped;
+            
+            if (cl->enqueued == 0 && cl->tail_dropped == 0) {
+                continue;
+            }
+            printf("  %-4u %-5d %12lu %8lu %10lu %10lu %10lu %10.1f %10.1f\n",
+                   i, q, cl->dequeued, cl->backlog, cl->tail_dropped, cl->aqm_dropped,
+                   cl->ecn_marked, sent ? cl->sojourn_sum_ns / 1e3 / sent : 0.0,
+                   cl->sojourn_max_ns / 1e3);
+        }
+    }
+    
+    for (uint32_t w = 0; w < c->nb_lcores && w < SWITCH_STATS_MAX_LCORES; w++) {
+        const struct switch_stats_lcore *l = &c->lcores[w];
+        uint64_t polls = l->busy_polls + l->idle_polls;
+        
+        printf("  Worker %u: idle polls %.1f%%", w, polls ? 100.0 * l->idle_polls / polls : 0.0);
+        if (prev && secs > 0) {
+            printf(", asleep %.1f%%",
+                   100.0 * (l->asleep_ns - prev->lcores[w].asleep_ns) / 1e9 / secs);
+        }
+        printf("\n");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    const char *app = "qos";
+    const char *name = NULL;
+    char default_name[SWITCH_STATS_NAME_LEN];
+    uint32_t switch_id = 1;
+    unsigned int interval_ms = 0;
+    unsigned long count = 0;
+    bool keys = false;
+    struct switch_stats st;
+    struct switch_stats_counters cur, prev;
+    bool have_prev = false;
+    int opt, ret;
+    
+    while ((opt = getopt(argc, argv, "a:s:n:i:c:klh")) != -1) {
+        switch (opt) {
+            case 'a':
+                app = optarg;
+                break;
+            case 's':
+                switch_id = atoi(optarg);
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                break;
+            case 'c':
+                count = strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                keys = true;
+                break;
+            case 'l':
+                return list_segments();
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (!name) {
+        switch_stats_name(default_name, sizeof(default_name), app, switch_id);
+        name = default_name;
+    }
+    
+    ret = switch_stats_attach(&st, name);
+    if (ret == -EPROTO) {
+        fprintf(stderr, "%s: not a version %d switch stats segment\n", name,
+                SWITCH_STATS_VERSION);
+        return 1;
+    } else if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", name, strerror(-ret));
+        return 1;
+    }
+    
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    
+    for (unsigned long n = 0; keep_running; n++) {
+        ret = switch_stats_read(&st, &cur);
+        if (ret == 0) {
+            if (keys) {
+                print_keys(&cur);
+            } else {
+                print_tables(&st, &cur, have_prev ? &prev : NULL);
+            }
+            prev = cur;
+            have_prev = true;
+        } else if (ret != -ENODATA) {
+            fprintf(stderr, "%s: %s\n", name, strerror(-ret));
+        }
+        
+        if (interval_ms == 0 || (count && n + 1 >= count)) {
+            break;
+        }
+        usleep(interval_ms * 1000);
+    }
+    
+    switch_stats_close(&st);
+    return 0;
+}
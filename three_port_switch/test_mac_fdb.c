@@ -0,0 +1,331 @@
+/*
+ * Test Suite for the MAC Forwarding Database
+ *
+ * Checks insert/lookup/delete at full 64K capacity, lookups at 80% load,
+ * keys that collided in the old direct-mapped table, VLAN separation,
+ * bulk lookup and aging, then times single and bulk lookups.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#include "mac_fdb.h"
+
+/* Test framework macros */
+#define TEST_PASSED 0
+#define TEST_FAILED 1
+#define ASSERT_EQ(a, b, msg) do { \
+    if ((a) != (b)) { \
+        fprintf(stderr, "FAIL: %s (expected %d, got %d)\n", msg, (int)(b), (int)(a)); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define RUN_TEST(test) do { \
+    printf("Running %s...\n", #test); \
+    if (test() == TEST_PASSED) { \
+        printf("  ✓ PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAILED\n"); \
+        tests_failed++; \
+    } \
+    tests_total++; \
+} while(0)
+
+/* Test statistics */
+static int tests_total = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+/* Locally administered unicast MAC derived from an index */
+static void make_mac(uint8_t *mac, uint32_t i)
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (i >> 24) & 0xFF;
+    mac[3] = (i >> 16) & 0xFF;
+    mac[4] = (i >> 8) & 0xFF;
+    mac[5] = i & 0xFF;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill to the requested capacity, find everything, delete everything */
+static int test_full_capacity(void)
+{
+    struct mac_fdb fdb;
+    uint8_t mac[6];
+    uint16_t port;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, MAC_FDB_DEFAULT_ENTRIES), 0, "create");
+    
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i++) {
+        make_mac(mac, i);
+        ASSERT_EQ(mac_fdb_add(&fdb, mac, 0, i % 3, 100), 0, "insert up to capacity");
+    }
+    ASSERT_EQ(fdb.count, MAC_FDB_DEFAULT_ENTRIES, "entry count");
+    printf("  %u entries in %u buckets (%.1f%% load), %lu displaced\n",
+           fdb.count, fdb.nb_buckets,
+           100.0 * fdb.count / (fdb.nb_buckets * MAC_FDB_BUCKET_ENTRIES),
+           fdb.stats.displaced);
+    
+    make_mac(mac, MAC_FDB_DEFAULT_ENTRIES);
+    ASSERT_EQ(mac_fdb_add(&fdb, mac, 0, 0, 100), -ENOSPC, "insert beyond capacity");
+    
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i++) {
+        make_mac(mac, i);
+        ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), 0, "lookup after displacement");
+        ASSERT_EQ(port, i % 3, "port after displacement");
+    }
+    
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i += 2) {
+        make_mac(mac, i);
+        ASSERT_EQ(mac_fdb_del(&fdb, mac, 0), 0, "delete");
+    }
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i++) {
+        make_mac(mac, i);
+        ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), (i & 1) ? 0 : -ENOENT,
+                  "lookup after delete");
+    }
+    ASSERT_EQ(mac_fdb_del(&fdb, mac, 0xFFF), -ENOENT, "delete absent key");
+    ASSERT_EQ(fdb.count, MAC_FDB_DEFAULT_ENTRIES / 2, "count after delete");
+    
+    /* Freed indexes are reused */
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i += 2) {
+        make_mac(mac, i + 0x1000000);
+        ASSERT_EQ(mac_fdb_add(&fdb, mac, 0, 1, 100), 0, "re-insert");
+    }
+    ASSERT_EQ(fdb.count, MAC_FDB_DEFAULT_ENTRIES, "count after re-insert");
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* Capacity that fills the buckets to 80%, the most create() sizes for */
+static int test_high_load(void)
+{
+    const uint32_t nb_entries = 8192 * MAC_FDB_BUCKET_ENTRIES * 4 / 5;
+    struct mac_fdb fdb;
+    uint8_t mac[6];
+    uint16_t port;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, nb_entries), 0, "create");
+    ASSERT_EQ(fdb.nb_buckets, 8192, "bucket count");
+    
+    for (uint32_t i = 0; i < nb_entries; i++) {
+        make_mac(mac, i * 2654435761u);
+        ASSERT_EQ(mac_fdb_add(&fdb, mac, (uint16_t)(i & 0xFFF), i % 5, 100), 0,
+                  "insert up to 80% load");
+    }
+    printf("  %u entries in %u buckets (%.1f%% load), %lu displaced\n",
+           fdb.count, fdb.nb_buckets,
+           100.0 * fdb.count / (fdb.nb_buckets * MAC_FDB_BUCKET_ENTRIES),
+           fdb.stats.displaced);
+    
+    for (uint32_t i = 0; i < nb_entries; i++) {
+        make_mac(mac, i * 2654435761u);
+        ASSERT_EQ(mac_fdb_lookup(&fdb, mac, (uint16_t)(i & 0xFFF), &port), 0,
+                  "lookup at 80% load");
+        ASSERT_EQ(port, i % 5, "port at 80% load");
+    }
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* MACs sharing the last byte overwrote each other in the old table */
+static int test_last_byte_collisions(void)
+{
+    struct mac_fdb fdb;
+    uint8_t mac[6];
+    uint16_t port;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, 1024), 0, "create");
+    
+    for (uint32_t i = 0; i < 256; i++) {
+        make_mac(mac, i << 8 | 0x42);
+        ASSERT_EQ(mac_fdb_add(&fdb, mac, 0, i % 3, 1), 0, "insert");
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        make_mac(mac, i << 8 | 0x42);
+        ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), 0, "lookup");
+        ASSERT_EQ(port, i % 3, "port");
+    }
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* Same MAC in two VLANs is two entries; re-learning moves the port */
+static int test_vlan_and_move(void)
+{
+    struct mac_fdb fdb;
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    uint16_t port;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, 64), 0, "create");
+    ASSERT_EQ(mac_fdb_add(&fdb, mac, 10, 1, 1), 0, "add vlan 10");
+    ASSERT_EQ(mac_fdb_add(&fdb, mac, 20, 2, 1), 0, "add vlan 20");
+    ASSERT_EQ(fdb.count, 2, "two entries");
+    
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 10, &port), 0, "lookup vlan 10");
+    ASSERT_EQ(port, 1, "vlan 10 port");
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 30, &port), -ENOENT, "lookup vlan 30");
+    
+    ASSERT_EQ(mac_fdb_add(&fdb, mac, 10, 0, 2), 0, "station move");
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 10, &port), 0, "lookup after move");
+    ASSERT_EQ(port, 0, "moved port");
+    ASSERT_EQ(fdb.count, 2, "move does not insert");
+    ASSERT_EQ(fdb.stats.moves, 1, "move counted");
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* Bulk lookup agrees with single lookups, including misses */
+static int test_bulk_lookup(void)
+{
+    struct mac_fdb fdb;
+    uint8_t macs[MAC_FDB_MAX_BURST][6];
+    const uint8_t *keys[MAC_FDB_MAX_BURST];
+    uint16_t ports[MAC_FDB_MAX_BURST];
+    uint64_t hit_mask;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, 4096), 0, "create");
+    
+    for (uint32_t i = 0; i < MAC_FDB_MAX_BURST; i++) {
+        make_mac(macs[i], i * 7);
+        keys[i] = macs[i];
+        if (i % 4 != 3)
+            ASSERT_EQ(mac_fdb_add(&fdb, macs[i], 0, i % 3, 1), 0, "insert");
+    }
+    
+    ASSERT_EQ(mac_fdb_lookup_bulk(&fdb, keys, NULL, MAC_FDB_MAX_BURST, ports, &hit_mask),
+              MAC_FDB_MAX_BURST / 4 * 3, "bulk hits");
+    for (uint32_t i = 0; i < MAC_FDB_MAX_BURST; i++) {
+        ASSERT_EQ((hit_mask >> i) & 1, i % 4 != 3, "hit bit");
+        if (i % 4 != 3)
+            ASSERT_EQ(ports[i], i % 3, "bulk port");
+    }
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* Only entries idle longer than the aging time are removed */
+static int test_aging(void)
+{
+    struct mac_fdb fdb;
+    uint8_t mac[6];
+    uint16_t port;
+    
+    ASSERT_EQ(mac_fdb_create(&fdb, 256), 0, "create");
+    
+    for (uint32_t i = 0; i < 100; i++) {
+        make_mac(mac, i);
+        ASSERT_EQ(mac_fdb_add(&fdb, mac, 0, 1, i < 50 ? 1000 : 1200), 0, "insert");
+    }
+    
+    ASSERT_EQ(mac_fdb_age(&fdb, 1250, 300), 0, "nothing expired yet");
+    ASSERT_EQ(mac_fdb_age(&fdb, 1400, 300), 50, "older half expired");
+    ASSERT_EQ(fdb.count, 50, "count after aging");
+    
+    make_mac(mac, 10);
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), -ENOENT, "aged entry gone");
+    make_mac(mac, 60);
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), 0, "fresh entry kept");
+    
+    mac_fdb_flush(&fdb);
+    ASSERT_EQ(fdb.count, 0, "flush");
+    ASSERT_EQ(mac_fdb_lookup(&fdb, mac, 0, &port), -ENOENT, "lookup after flush");
+    
+    mac_fdb_destroy(&fdb);
+    return TEST_PASSED;
+}
+
+/* Lookup throughput at full table, single vs. bulk */
+static void benchmark(void)
+{
+    enum { ROUNDS = 64 };
+    struct mac_fdb fdb;
+    uint8_t (*macs)[6] = malloc(MAC_FDB_DEFAULT_ENTRIES * sizeof(*macs));
+    const uint8_t *keys[MAC_FDB_MAX_BURST];
+    uint16_t ports[MAC_FDB_MAX_BURST];
+    uint64_t found = 0;
+    double t0, single, bulk;
+    
+    if (!macs || mac_fdb_create(&fdb, MAC_FDB_DEFAULT_ENTRIES) != 0)
+        return;
+    
+    for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i++) {
+        make_mac(macs[i], i * 2654435761u);
+        mac_fdb_add(&fdb, macs[i], 0, i % 3, 1);
+    }
+    
+    t0 = now_sec();
+    for (int r = 0; r < ROUNDS; r++)
+        for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i++)
+            found += mac_fdb_lookup(&fdb, macs[(i * 40503u) & (MAC_FDB_DEFAULT_ENTRIES - 1)],
+                                    0, &ports[0]) == 0;
+    single = now_sec() - t0;
+    
+    t0 = now_sec();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (uint32_t i = 0; i < MAC_FDB_DEFAULT_ENTRIES; i += MAC_FDB_MAX_BURST) {
+            for (uint32_t j = 0; j < MAC_FDB_MAX_BURST; j++)
+                keys[j] = macs[((i + j) * 40503u) & (MAC_FDB_DEFAULT_ENTRIES - 1)];
+            found += mac_fdb_lookup_bulk(&fdb, keys, NULL, MAC_FDB_MAX_BURST, ports, NULL);
+        }
+    }
+    bulk = now_sec() - t0;
+    
+    printf("  %u entries: single %.1f ns/lookup, bulk(%d) %.1f ns/lookup (%lu hits)\n",
+           fdb.count, single * 1e9 / (ROUNDS * MAC_FDB_DEFAULT_ENTRIES),
+           MAC_FDB_MAX_BURST, bulk * 1e9 / (ROUNDS * MAC_FDB_DEFAULT_ENTRIES), found);
+    
+    mac_fdb_destroy(&fdb);
+    free(macs);
+}
+
+int main(int argc, char **argv)
+{
+    printf("\n");
+    printf("==============================================\n");
+    printf("MAC Forwarding Database Test Suite\n");
+    printf("==============================================\n\n");
+    
+    RUN_TEST(test_full_capacity);
+    RUN_TEST(test_high_load);
+    RUN_TEST(test_last_byte_collisions);
+    RUN_TEST(test_vlan_and_move);
+    RUN_TEST(test_bulk_lookup);
+    RUN_TEST(test_aging);
+    
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        printf("\nBenchmark:\n");
+        benchmark();
+    }
+    
+    printf("\n==============================================\n");
+    printf("Tests: %d total, %d passed, %d failed\n", tests_total, tests_passed, tests_failed);
+    printf("==============================================\n");
+    
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/*
+ * Test Suite for the Shared-Memory Switch Statistics
+ *
+ * Checks that a published snapshot reads back through a separate mapping,
+ * that readers refuse segments of another layout version, and that a
+ * reader racing a writer thread only ever sees whole snapshots.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "switch_stats.h"
+
+/* Test framework macros */
+#define TEST_PASSED 0
+#define TEST_FAILED 1
+#define ASSERT_EQ(a, b, msg) do { \
+    if ((a) != (b)) { \
+        fprintf(stderr, "FAIL: %s (expected %ld, got %ld)\n", msg, (long)(b), (long)(a)); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define RUN_TEST(test) do { \
+    printf("Running %s...\n", #test); \
+    if (test() == TEST_PASSED) { \
+        printf("  ✓ PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAILED\n"); \
+        tests_failed++; \
+    } \
+    tests_total++; \
+} while(0)
+
+#define TEST_APP "test"
+#define TEST_SWITCH_ID 4242
+#define RACE_SNAPSHOTS 200000
+
+/* Test statistics */
+static int tests_total = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+/* Set every counter of the snapshot to v */
+static void fill_counters(struct switch_stats_counters *c, uint64_t v)
+{
+    c->forwarded = c->dropped = c->qos_classified = v;
+    c->ttl_expired = c->rss_distributed = c->hairpinned = v;
+    c->nb_ports = SWITCH_STATS_MAX_PORTS;
+    c->nb_lcores = SWITCH_STATS_MAX_LCORES;
+    for (int i = 0; i < SWITCH_STATS_MAX_PORTS; i++) {
+        c->ports[i].rx_packets = c->ports[i].tx_packets = v;
+        for (int q = 0; q < SWITCH_STATS_NB_CLASSES; q++) {
+            c->ports[i].classes[q].enqueued = v;
+            c->ports[i].classes[q].sojourn_max_ns = v;
+        }
+    }
+    for (int w = 0; w < SWITCH_STATS_MAX_LCORES; w++) {
+        c->lcores[w].busy_polls = v;
+    }
+}
+
+/* Whether every counter fill_counters() sets holds the same value */
+static bool counters_consistent(const struct switch_stats_counters *c)
+{
+    uint64_t v = c->forwarded;
+    
+    if (c->dropped != v || c->hairpinned != v) {
+        return false;
+    }
+    for (int i = 0; i < SWITCH_STATS_MAX_PORTS; i++) {
+        if (c->ports[i].rx_packets != v || c->ports[i].tx_packets != v) {
+            return false;
+        }
+        for (int q = 0; q < SWITCH_STATS_NB_CLASSES; q++) {
+            if (c->ports[i].classes[q].enqueued != v ||
+                c->ports[i].classes[q].sojourn_max_ns != v) {
+                return false;
+            }
+        }
+    }
+    for (int w = 0; w < SWITCH_STATS_MAX_LCORES; w++) {
+        if (c->lcores[w].busy_polls != v) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int test_publish_read(void)
+{
+    struct switch_stats writer, reader;
+    struct switch_stats_counters c, out;
+    char name[SWITCH_STATS_NAME_LEN];
+    
+    ASSERT_EQ(switch_stats_create(&writer, TEST_APP, TEST_SWITCH_ID), 0, "create");
+    switch_stats_name(name, sizeof(name), TEST_APP, TEST_SWITCH_ID);
+    ASSERT_EQ(switch_stats_attach(&reader, name + 1), 0, "attach without leading slash");
+    ASSERT_EQ(reader.shm->switch_id, TEST_SWITCH_ID, "switch id");
+    ASSERT_TRUE(strcmp(reader.shm->app, TEST_APP) == 0, "app name");
+    
+    ASSERT_EQ(switch_stats_read(&reader, &out), -ENODATA, "nothing published yet");
+    
+    memset(&c, 0, sizeof(c));
+    fill_counters(&c, 7);
+    c.fdb_entries = 3;
+    snprintf(c.ports[1].name, sizeof(c.ports[1].name), "veth1");
+    switch_stats_publish(&writer, &c);
+    ASSERT_TRUE(c.time_ns != 0, "publish stamps the snapshot");
+    
+    ASSERT_EQ(switch_stats_read(&reader, &out), 0, "read");
+    ASSERT_TRUE(memcmp(&c, &out, sizeof(c)) == 0, "snapshot reads back unchanged");
+    ASSERT_EQ(reader.shm->published, 1, "published count");
+    
+    switch_stats_close(&reader);
+    switch_stats_close(&writer);
+    ASSERT_EQ(switch_stats_attach(&reader, name), -ENOENT, "writer removes the segment");
+    return TEST_PASSED;
+}
+
+static int test_version_mismatch(void)
+{
+    struct switch_stats writer, reader;
+    
+    ASSERT_EQ(switch_stats_create(&writer, TEST_APP, TEST_SWITCH_ID), 0, "create");
+    writer.shm->version = SWITCH_STATS_VERSION + 1;
+    ASSERT_EQ(switch_stats_attach(&reader, writer.name), -EPROTO, "newer layout refused");
+    writer.shm->version = SWITCH_STATS_VERSION;
+    writer.shm->magic = 0;
+    ASSERT_EQ(switch_stats_attach(&reader, writer.name), -EPROTO, "bad magic refused");
+    switch_stats_close(&writer);
+    return TEST_PASSED;
+}
+
+static void *race_writer(void *arg)
+{
+    struct switch_stats *writer = arg;
+    static struct switch_stats_counters c;
+    
+    for (uint64_t v = 1; v <= RACE_SNAPSHOTS; v++) {
+        fill_counters(&c, v);
+        switch_stats_publish(writer, &c);
+    }
+    return NULL;
+}
+
+static int test_concurrent_reader(void)
+{
+    struct switch_stats writer, reader;
+    struct switch_stats_counters out;
+    pthread_t tid;
+    uint64_t last = 0, reads = 0, busy = 0;
+    
+    ASSERT_EQ(switch_stats_create(&writer, TEST_APP, TEST_SWITCH_ID), 0, "create");
+    ASSERT_EQ(switch_stats_attach(&reader, writer.name), 0, "attach");
+    ASSERT_EQ(pthread_create(&tid, NULL, race_writer, &writer), 0, "writer thread");
+    
+    while (last < RACE_SNAPSHOTS) {
+        int ret = switch_stats_read(&reader, &out);
+        
+        if (ret == -ENODATA || ret == -EAGAIN) {
+            busy += ret == -EAGAIN;
+            continue;
+        }
+        ASSERT_EQ(ret, 0, "read");
+        ASSERT_TRUE(counters_consistent(&out), "torn snapshot");
+        ASSERT_TRUE(out.forwarded >= last, "snapshots go backwards");
+        last = out.forwarded;
+        reads++;
+    }
+    pthread_join(tid, NULL);
+    printf("  %lu consistent reads, %lu gave up on a busy writer\n", reads, busy);
+    
+    switch_stats_close(&reader);
+    switch_stats_close(&writer);
+    return TEST_PASSED;
+}
+
+int main(void)
+{
+    printf("\n");
+    printf("==============================================\n");
+    printf("Switch Statistics Test Suite\n");
+    printf("==============================================\n\n");
+    
+    RUN_TEST(test_publish_read);
+    RUN_TEST(test_version_mismatch);
+    RUN_TEST(test_concurrent_reader);
+    
+    printf("\n==============================================\n");
+    printf("Tests: %d total, %d passed, %d failed\n", tests_total, tests_passed, tests_failed);
+    printf("==============================================\n");
+    
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+/*
+ * Test Suite for the veth Switch MAC Learning Table
+ *
+ * Runs the reader and the updater on one thread under a memory-only EAL.
+ * Checks that learning stops one entry short of the slot count, that a
+ * full table that ages out is rebuilt empty and learns again,
+ * and that churning a full table never uses up its last empty slot. The
+ * coarse clock is advanced by moving the updater's next tick back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <rte_eal.h>
+#include <rte_cycles.h>
+
+#include "veth_fdb.h"
+
+/* Test framework macros */
+#define TEST_PASSED 0
+#define TEST_FAILED 1
+#define ASSERT_EQ(a, b, msg) do { \
+    if ((a) != (b)) { \
+        fprintf(stderr, "FAIL: %s (expected %d, got %d)\n", msg, (int)(b), (int)(a)); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        return TEST_FAILED; \
+    } \
+} while(0)
+
+#define RUN_TEST(test) do { \
+    printf("Running %s...\n", #test); \
+    if (test() == TEST_PASSED) { \
+        printf("  ✓ PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAILED\n"); \
+        tests_failed++; \
+    } \
+    tests_total++; \
+} while(0)
+
+/* Test statistics */
+static int tests_total = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+/* Locally administered unicast MAC derived from an index */
+static void make_mac(struct rte_ether_addr *mac, uint32_t i)
+{
+    mac->addr_bytes[0] = 0x02;
+    mac->addr_bytes[1] = 0x00;
+    mac->addr_bytes[2] = (i >> 24) & 0xFF;
+    mac->addr_bytes[3] = (i >> 16) & 0xFF;
+    mac->addr_bytes[4] = (i >> 8) & 0xFF;
+    mac->addr_bytes[5] = i & 0xFF;
+}
+
+/* Learn MACs first..last-1 on port i % 3, draining the ring as it fills */
+static void learn_range(struct veth_fdb *fdb, uint32_t first, uint32_t last)
+{
+    struct rte_ether_addr mac;
+    
+    for (uint32_t i = first; i < last; i++) {
+        make_mac(&mac, i);
+        veth_fdb_learn(fdb, 0, &mac, i % 3);
+        if ((i + 1) % VETH_FDB_LEARN_BURST == 0) {
+            veth_fdb_update(fdb);
+        }
+    }
+    veth_fdb_update(fdb);
+}
+
+/* Move the coarse clock forward by at least sec seconds */
+static void advance_clock(struct veth_fdb *fdb, uint32_t sec)
+{
+    fdb->next_tick_tsc = rte_rdtsc() - (uint64_t)sec * fdb->tsc_hz;
+    veth_fdb_update(fdb);
+}
+
+static uint32_t slots_in_state(const struct veth_fdb *fdb, uint8_t state)
+{
+    uint32_t n = 0;
+    
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        n += fdb->table[i].state == state;
+    }
+    return n;
+}
+
+/* Fill the table, let every entry age out, reclaim and learn again */
+static int test_fill_age_reclaim(void)
+{
+    struct veth_fdb fdb;
+    struct rte_ether_addr mac;
+    
+    ASSERT_EQ(veth_fdb_init(&fdb, "test_fdb", 1, SOCKET_ID_ANY), 0, "init");
+    ASSERT_EQ(veth_fdb_reader_online(&fdb, 0), 0, "reader online");
+    
+    learn_range(&fdb, 0, VETH_FDB_SIZE + 16);
+    ASSERT_EQ(fdb.count, VETH_FDB_SIZE - 1, "count stops one short of the slots");
+    ASSERT_EQ(fdb.table_full, 17, "refused inserts");
+    ASSERT_EQ(slots_in_state(&fdb, VETH_FDB_EMPTY), 1, "one empty slot left");
+    for (uint32_t i = 0; i < VETH_FDB_SIZE + 16; i++) {
+        make_mac(&mac, i);
+        ASSERT_EQ(veth_fdb_lookup(&fdb, &mac), i < VETH_FDB_SIZE - 1 ? (int)(i % 3) : -1,
+                  "lookup in a full table");
+    }
+    
+    /* Jump the clock past the aging time; the dead table is rebuilt empty */
+    advance_clock(&fdb, VETH_FDB_AGING_TIME + 2);
+    ASSERT_EQ(fdb.aged, VETH_FDB_SIZE - 1, "aged entries");
+    ASSERT_EQ(fdb.count, 0, "count after aging");
+    ASSERT_EQ(fdb.compactions, 1, "compacted after aging");
+    ASSERT_EQ(fdb.used, 0, "no dead slots left");
+    ASSERT_EQ(slots_in_state(&fdb, VETH_FDB_EMPTY), VETH_FDB_SIZE, "empty after compaction");
+    
+    /* The old table is freed once the reader has been quiescent */
+    ASSERT_TRUE(fdb.retired != NULL, "old table kept for readers");
+    veth_fdb_quiescent(&fdb, 0);
+    veth_fdb_update(&fdb);
+    ASSERT_TRUE(fdb.retired == NULL, "old table freed after a grace period");
+    
+    learn_range(&fdb, 0x100000, 0x100000 + 1000);
+    ASSERT_EQ(fdb.count, 1000, "count after relearning");
+    for (uint32_t i = 0x100000; i < 0x100000 + 1000; i++) {
+        make_mac(&mac, i);
+        ASSERT_EQ(veth_fdb_lookup(&fdb, &mac), (int)(i % 3), "lookup after relearning");
+    }
+    
+    veth_fdb_reader_offline(&fdb, 0);
+    veth_fdb_free(&fdb);
+    return TEST_PASSED;
+}
+
+/*
+ * Keep a full table full: each round half the entries age out and as many
+ * new ones take their place. Dead slots must never take the last empty
+ * one, and learning must never be refused for lack of room.
+ */
+static int test_churn_full_table(void)
+{
+    const uint32_t half = VETH_FDB_SIZE / 2;
+    const uint32_t step = VETH_FDB_AGING_TIME / 2 + 10;
+    struct veth_fdb fdb;
+    struct rte_ether_addr mac;
+    uint32_t next = 0;
+    
+    ASSERT_EQ(veth_fdb_init(&fdb, "test_fdb", 1, SOCKET_ID_ANY), 0, "init");
+    ASSERT_EQ(veth_fdb_reader_online(&fdb, 0), 0, "reader online");
+    
+    learn_range(&fdb, next, next + half);
+    next += half;
+    advance_clock(&fdb, step);
+    
+    for (int round = 0; round < 16; round++) {
+        /* The older half is now past the aging time, the newer one is not */
+        uint32_t batch = round % 2 ? half : half - 1;
+        
+        learn_range(&fdb, next, next + batch);
+        next += batch;
+        ASSERT_EQ(fdb.table_full, 0, "no refused inserts");
+        ASSERT_EQ(fdb.count, VETH_FDB_SIZE - 1, "table full again");
+        ASSERT_TRUE(slots_in_state(&fdb, VETH_FDB_EMPTY) >= 1, "an empty slot survives");
+        
+        for (uint32_t i = next - batch; i < next; i++) {
+            make_mac(&mac, i);
+            ASSERT_EQ(veth_fdb_lookup(&fdb, &mac), (int)(i % 3), "lookup during churn");
+        }
+        make_mac(&mac, 0xFFFFFF);
+        ASSERT_EQ(veth_fdb_lookup(&fdb, &mac), -1, "miss during churn");
+        
+        advance_clock(&fdb, step);
+        veth_fdb_quiescent(&fdb, 0);
+        veth_fdb_update(&fdb);
+        ASSERT_TRUE(slots_in_state(&fdb, VETH_FDB_EMPTY) >= 1, "an empty slot survives aging");
+    }
+    ASSERT_TRUE(fdb.compactions > 0, "dead slots were compacted away");
+    
+    veth_fdb_reader_offline(&fdb, 0);
+    veth_fdb_free(&fdb);
+    return TEST_PASSED;
+}
+
+int main(int argc, char **argv)
+{
+    char *eal_args[] = {argv[0], "-l", "0", "--no-huge", "--no-pci", "--log-level", "error"};
+    
+    (void)argc;
+    if (rte_eal_init(sizeof(eal_args) / sizeof(eal_args[0]), eal_args) < 0) {
+        fprintf(stderr, "Cannot initialize EAL\n");
+        return EXIT_FAILURE;
+    }
+    
+    printf("==============================================\n");
+    printf("veth MAC Learning Table Test Suite\n");
+    printf("==============================================\n\n");
+    
+    RUN_TEST(test_fill_age_reclaim);
+    RUN_TEST(test_churn_full_table);
+    
+    printf("\n==============================================\n");
+    printf("Tests: %d total, %d passed, %d failed\n", tests_total, tests_passed, tests_failed);
+    printf("==============================================\n");
+    
+    rte_eal_cleanup();
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -9,9 +9,11 @@
  * - Port 1: Ethernet port 0
  * - Port 2: Ethernet port 1
  *
- * Packets are forwarded between ports using a simple MAC learning table.
+ * Packets are forwarded between ports using a MAC learning table (a
+ * bucketized cuckoo hash, see mac_fdb.h) keyed on MAC address and VLAN.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -30,6 +32,9 @@
 #include <doca_dpdk.h>
 #include <doca_argp.h>
 
+#include "mac_fdb.h"
+#include "switch_stats.h"
+
 DOCA_LOG_REGISTER(THREE_PORT_SWITCH);
 
 #define NB_PORTS 3
@@ -37,11 +42,14 @@ DOCA_LOG_REGISTER(THREE_PORT_SWITCH);
 #define ETH_PORT_1 1
 #define ETH_PORT_2 2
 #define MAX_PORT_STR_LEN 128
-#define MAC_TABLE_SIZE 256
+#define MAC_TABLE_SIZE MAC_FDB_DEFAULT_ENTRIES
+#define MAC_AGING_TIME 300  /* Seconds, 802.1D default */
 #define NB_QOS_QUEUES 8  /* 8 priority queues per port */
 #define MAX_QUEUE_DEPTH 1024
 #define NB_RSS_QUEUES 4  /* Number of RSS queues for load distribution */
 #define NB_HAIRPIN_QUEUES 2  /* Hairpin queues for hw-to-hw forwarding */
+#define STATS_PUBLISH_MS 100  /* Shared-memory counter refresh */
+#define STATS_DISPLAY_SEC 5
 
 /* RSS configuration */
 struct rss_config {
@@ -82,19 +90,11 @@ struct qos_queue_entry {
 	uint64_t dropped;
 };
 
-/* MAC learning table entry */
-struct mac_entry {
-	uint8_t mac[6];
-	uint16_t port_id;
-	time_t timestamp;
-	uint8_t valid;
-};
-
 /* Switch state */
 struct switch_state {
 	struct doca_flow_port *ports[NB_PORTS];
 	struct port_config port_configs[NB_PORTS];
-	struct mac_entry mac_table[MAC_TABLE_SIZE];
+	struct mac_fdb mac_table;
 	struct qos_queue_entry qos_queues[NB_PORTS][NB_QOS_QUEUES];
 	volatile sig_atomic_t keep_running;
 	uint64_t packets_forwarded;
@@ -103,6 +103,7 @@ struct switch_state {
 	uint64_t packets_rss_distributed;
 	uint64_t packets_hairpinned;
 	uint64_t packets_ttl_expired;  /* IPv4 TTL or IPv6 hop limit expired */
+	struct switch_stats stats;  /* Shared-memory counters for monitoring tools */
 };
 
 static struct switch_state sw_state = {
@@ -129,10 +130,17 @@ static void signal_handler(int signum)
 /*
  * Initialize MAC learning table
  */
-static void init_mac_table(void)
+static int init_mac_table(void)
 {
-	memset(sw_state.mac_table, 0, sizeof(sw_state.mac_table));
-	DOCA_LOG_INFO("MAC learning table initialized (%d entries)", MAC_TABLE_SIZE);
+	int ret = mac_fdb_create(&sw_state.mac_table, MAC_TABLE_SIZE);
+
+	if (ret < 0) {
+		DOCA_LOG_ERR("Failed to create MAC learning table: %d", ret);
+		return ret;
+	}
+	DOCA_LOG_INFO("MAC learning table initialized (%u entries, %u buckets)",
+		      sw_state.mac_table.capacity, sw_state.mac_table.nb_buckets);
+	return 0;
 }
 
 /*
@@ -357,31 +365,25 @@ static inline int process_packet_ttl(struct rte_mbuf *mbuf)
 /*
  * Learn MAC address on a port
  */
-static void learn_mac(const uint8_t *mac, uint16_t port_id)
+static void learn_mac(const uint8_t *mac, uint16_t vlan_id, uint16_t port_id)
 {
-	int idx = mac[5] % MAC_TABLE_SIZE; /* Simple hash */
-	
-	memcpy(sw_state.mac_table[idx].mac, mac, 6);
-	sw_state.mac_table[idx].port_id = port_id;
-	sw_state.mac_table[idx].timestamp = time(NULL);
-	sw_state.mac_table[idx].valid = 1;
+	if (mac_fdb_add(&sw_state.mac_table, mac, vlan_id, port_id, (uint32_t)time(NULL)) < 0) {
+		DOCA_LOG_WARN("MAC table full, not learning %02x:%02x:%02x:%02x:%02x:%02x",
+			      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+		return;
+	}
 	
-	DOCA_LOG_DBG("Learned MAC %02x:%02x:%02x:%02x:%02x:%02x on port %d",
-		     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], port_id);
+	DOCA_LOG_DBG("Learned MAC %02x:%02x:%02x:%02x:%02x:%02x vlan %u on port %d",
+		     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], vlan_id, port_id);
 }
 
 /*
  * Lookup MAC address in learning table
  */
-static int lookup_mac(const uint8_t *mac, uint16_t *port_id)
+static int lookup_mac(const uint8_t *mac, uint16_t vlan_id, uint16_t *port_id)
 {
-	int idx = mac[5] % MAC_TABLE_SIZE;
-	
-	if (sw_state.mac_table[idx].valid &&
-	    memcmp(sw_state.mac_table[idx].mac, mac, 6) == 0) {
-		*port_id = sw_state.mac_table[idx].port_id;
+	if (mac_fdb_lookup(&sw_state.mac_table, mac, vlan_id, port_id) == 0)
 		return 1; /* Found */
-	}
 	
 	return 0; /* Not found */
 }
@@ -666,6 +668,42 @@ static doca_error_t create_switch_flows(void)
 	return DOCA_SUCCESS;
 }
 
+/*
+ * Copy the switch counters into the shared-memory statistics segment
+ */
+static void publish_stats(void)
+{
+	static struct switch_stats_counters c;
+	int i, j;
+
+	if (sw_state.stats.shm == NULL)
+		return;
+
+	memset(&c, 0, sizeof(c));
+	c.forwarded = sw_state.packets_forwarded;
+	c.dropped = sw_state.packets_dropped;
+	c.qos_classified = sw_state.packets_qos_classified;
+	c.ttl_expired = sw_state.packets_ttl_expired;
+	c.rss_distributed = sw_state.packets_rss_distributed;
+	c.hairpinned = sw_state.packets_hairpinned;
+	c.fdb_entries = sw_state.mac_table.count;
+	c.fdb_capacity = sw_state.mac_table.capacity;
+	c.nb_ports = NB_PORTS;
+
+	for (i = 0; i < NB_PORTS; i++) {
+		struct switch_stats_port *sp = &c.ports[i];
+
+		snprintf(sp->name, sizeof(sp->name), "%s", sw_state.port_configs[i].port_name);
+		for (j = 0; j < NB_QOS_QUEUES; j++) {
+			sp->classes[j].enqueued = sw_state.qos_queues[i][j].enqueued;
+			sp->classes[j].dequeued = sw_state.qos_queues[i][j].dequeued;
+			sp->classes[j].tail_dropped = sw_state.qos_queues[i][j].dropped;
+		}
+	}
+
+	switch_stats_publish(&sw_state.stats, &c);
+}
+
 /*
  * Display switch statistics
  */
@@ -682,6 +720,9 @@ static void display_stats(void)
 	DOCA_LOG_INFO("Packets RSS distributed:%lu", sw_state.packets_rss_distributed);
 	DOCA_LOG_INFO("Packets hairpinned:     %lu", sw_state.packets_hairpinned);
 	DOCA_LOG_INFO("Packets TTL expired:    %lu", sw_state.packets_ttl_expired);
+	DOCA_LOG_INFO("MAC table:              %u/%u entries, %lu displaced, %lu aged",
+		      sw_state.mac_table.count, sw_state.mac_table.capacity,
+		      sw_state.mac_table.stats.displaced, sw_state.mac_table.stats.aged);
 	
 	/* Display RSS statistics */
 	for (i = 0; i < NB_PORTS; i++) {
@@ -759,6 +800,7 @@ int main(int argc, char **argv)
 {
 	doca_error_t result;
 	struct doca_log_backend *logger;
+	unsigned int ticks = 0;
 	int ret;
 
 	/* Setup signal handlers */
@@ -798,7 +840,8 @@ int main(int argc, char **argv)
 	DOCA_LOG_INFO("===========================================");
 
 	/* Initialize MAC learning table */
-	init_mac_table();
+	if (init_mac_table() < 0)
+		return EXIT_FAILURE;
 	
 	/* Initialize QoS queues */
 	init_qos_queues();
@@ -829,14 +872,25 @@ int main(int argc, char **argv)
 
 	DOCA_LOG_INFO("Switch is running - Press Ctrl+C to stop");
 
+	/* Counters are exported for ./switch_stats -a doca -s 0 */
+	ret = switch_stats_create(&sw_state.stats, "doca", 0);
+	if (ret < 0)
+		DOCA_LOG_WARN("Shared-memory statistics unavailable: %s", strerror(-ret));
+
 	/* Main loop - in a real implementation, this would process packets */
 	while (sw_state.keep_running) {
-		sleep(5);
+		usleep(STATS_PUBLISH_MS * 1000);
+		publish_stats();
+		if (++ticks < STATS_DISPLAY_SEC * 1000 / STATS_PUBLISH_MS)
+			continue;
+		ticks = 0;
+		mac_fdb_age(&sw_state.mac_table, (uint32_t)time(NULL), MAC_AGING_TIME);
 		display_stats();
 	}
 
 	DOCA_LOG_INFO("Shutting down switch...");
 	display_stats();
+	switch_stats_close(&sw_state.stats);
 
 cleanup_ports:
 	/* Stop ports */
@@ -847,6 +901,7 @@ cleanup_ports:
 
 cleanup_flow:
 	doca_flow_destroy();
+	mac_fdb_destroy(&sw_state.mac_table);
 
 	DOCA_LOG_INFO("Switch stopped");
 	return result == DOCA_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
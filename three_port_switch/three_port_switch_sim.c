@@ -4,7 +4,7 @@
  * This is a host-side simulation for testing and debugging
  * the three-port switch logic without hardware.
  * 
- * Compile: gcc -g -O0 -o switch_sim three_port_switch_sim.c
+ * Compile: gcc -g -O0 -pthread -o switch_sim three_port_switch_sim.c l2_fwd.c
  * Debug:   gdb ./switch_sim
  */
 
@@ -14,6 +14,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
+#include "l2_fwd.h"
 
 /* Simulate packet structure */
 typedef struct {
@@ -52,26 +54,9 @@ port_config_t port_config[3] = {
     {2, true, "eth_port_2", 1500}
 };
 
-/*
- * Three-Port Switch Forwarding Logic
- * 
- * Port 0 (PCI) <-> Port 1 (Ethernet)
- * Port 1 (Ethernet) <-> Port 2 (Ethernet)  
- * Port 2 (Ethernet) <-> Port 0 (PCI)
- */
-uint8_t get_forward_port(uint8_t input_port)
-{
-    switch (input_port) {
-        case 0:
-            return 1;  // PCI -> Eth1
-        case 1:
-            return 2;  // Eth1 -> Eth2
-        case 2:
-            return 0;  // Eth2 -> PCI
-        default:
-            return 0;  // Invalid, drop
-    }
-}
+/* MAC learning forwarding plane and its clock (advanced explicitly) */
+l2_fwd_t fwd;
+uint64_t sim_time_ms = 0;
 
 /*
  * Process a packet through the switch
@@ -107,6 +92,14 @@ void process_packet(packet_t *pkt)
     port_stats[pkt->port_id].rx_packets++;
     port_stats[pkt->port_id].rx_bytes += pkt->size;
     
+    // Learn the source MAC and look up the destination
+    uint32_t out_ports = l2_fwd_forward(&fwd, pkt->port_id, pkt->data,
+                                        pkt->size, sim_time_ms);
+    if (out_ports == L2_FWD_DROP) {
+        printf("  FILTERED: Destination is behind the ingress port\n");
+        return;
+    }
+    
     // Check and decrement TTL/hop limit for IP packets (loop prevention)
     if (pkt->is_ipv4 || pkt->ttl > 0) {  /* IP packet (IPv4 or IPv6) */
         if (pkt->ttl <= 1) {
@@ -118,22 +111,28 @@ void process_packet(packet_t *pkt)
         printf("  TTL decremented to %d\n", pkt->ttl);
     }
     
-    // Determine output port
-    uint8_t out_port = get_forward_port(pkt->port_id);
-    
-    printf("  Forwarding: port %d -> port %d\n", pkt->port_id, out_port);
-    
-    // Check output port
-    if (!port_config[out_port].enabled) {
-        printf("  ERROR: Output port %d is disabled\n", out_port);
-        port_stats[out_port].tx_errors++;
-        return;
+    // Send to each egress port: one on a hit, all others on a miss
+    for (uint8_t out_port = 0; out_port < 3; out_port++) {
+        if (!(out_ports & (1u << out_port))) {
+            continue;
+        }
+        
+        printf("  %s: port %d -> port %d\n",
+               (out_ports & (out_ports - 1)) ? "Flooding" : "Forwarding",
+               pkt->port_id, out_port);
+        
+        // Check output port
+        if (!port_config[out_port].enabled) {
+            printf("  ERROR: Output port %d is disabled\n", out_port);
+            port_stats[out_port].tx_errors++;
+            continue;
+        }
+        
+        // Update TX stats
+        port_stats[out_port].tx_packets++;
+        port_stats[out_port].tx_bytes += pkt->size;
     }
     
-    // Update TX stats
-    port_stats[out_port].tx_packets++;
-    port_stats[out_port].tx_bytes += pkt->size;
-    
     printf("  SUCCESS: Packet forwarded\n");
 }
 
@@ -174,6 +173,15 @@ void reset_stats(void)
     printf("Statistics reset\n");
 }
 
+/*
+ * Forget all learned MAC addresses
+ */
+void reset_fdb(void)
+{
+    l2_fwd_flush(&fwd);
+    printf("FDB flushed\n");
+}
+
 /*
  * Create test packet
  */
@@ -207,6 +215,25 @@ packet_t create_ip_packet(uint8_t port, uint16_t size, uint8_t ttl, bool is_ipv4
     return pkt;
 }
 
+/*
+ * Create test packet between stations 02:00:00:00:00:<n>
+ * (dst_station 0xFF = broadcast)
+ */
+packet_t create_station_packet(uint8_t port, uint16_t size,
+                               uint8_t src_station, uint8_t dst_station)
+{
+    packet_t pkt = create_packet(port, size);
+    uint8_t src[6] = {0x02, 0x00, 0x00, 0x00, 0x00, src_station};
+    uint8_t dst[6] = {0x02, 0x00, 0x00, 0x00, 0x00, dst_station};
+    
+    if (dst_station == 0xFF) {
+        memset(dst, 0xFF, sizeof(dst));
+    }
+    memcpy(pkt.data, dst, 6);
+    memcpy(pkt.data + 6, src, 6);
+    return pkt;
+}
+
 /*
  * Run test scenarios
  */
@@ -216,23 +243,29 @@ void run_tests(void)
     printf("Running Three-Port Switch Tests\n");
     printf("========================================\n\n");
     
-    /* Test 1: Basic forwarding */
-    printf("Test 1: Basic Forwarding\n");
-    printf("------------------------\n");
-    packet_t pkt1 = create_packet(0, 64);
-    packet_t pkt2 = create_packet(1, 128);
-    packet_t pkt3 = create_packet(2, 256);
+    /* Test 1: Learning and flooding */
+    printf("Test 1: MAC Learning and Flooding\n");
+    printf("---------------------------------\n");
+    reset_fdb();
+    packet_t pkt1 = create_station_packet(0, 64, 1, 2);   // A@0 -> B, unknown
+    packet_t pkt2 = create_station_packet(2, 128, 2, 1);  // B@2 -> A, learned
+    packet_t pkt3 = create_station_packet(0, 256, 1, 2);  // A@0 -> B, learned
     
     process_packet(&pkt1);
+    assert(port_stats[1].tx_packets == 1);  // Flooded to port 1
+    assert(port_stats[2].tx_packets == 1);  // and port 2
+    assert(port_stats[0].tx_packets == 0);  // Never back out the ingress port
+    
     process_packet(&pkt2);
+    assert(port_stats[0].tx_packets == 1);  // Port 2 -> Port 0 only
+    assert(port_stats[1].tx_packets == 1);
+    
     process_packet(&pkt3);
+    assert(port_stats[2].tx_packets == 2);  // Port 0 -> Port 2 only
+    assert(port_stats[1].tx_packets == 1);
     
-    assert(port_stats[0].rx_packets == 1);
-    assert(port_stats[1].rx_packets == 1);
-    assert(port_stats[2].rx_packets == 1);
-    assert(port_stats[1].tx_packets == 1);  // Port 0 -> Port 1
-    assert(port_stats[2].tx_packets == 1);  // Port 1 -> Port 2
-    assert(port_stats[0].tx_packets == 1);  // Port 2 -> Port 0
+    uint8_t mac_a[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 1};
+    assert(l2_fwd_lookup(&fwd, mac_a, sim_time_ms) == 0);
     printf("✓ Test 1 passed\n\n");
     
     /* Test 2: Invalid port */
@@ -268,12 +301,13 @@ void run_tests(void)
     printf("Test 5: Byte Counting\n");
     printf("---------------------\n");
     reset_stats();
-    packet_t pkt_100 = create_packet(0, 100);
-    packet_t pkt_200 = create_packet(0, 200);
+    packet_t pkt_100 = create_station_packet(0, 100, 1, 2);  // B learned on port 2
+    packet_t pkt_200 = create_station_packet(0, 200, 1, 2);
     process_packet(&pkt_100);
     process_packet(&pkt_200);
     assert(port_stats[0].rx_bytes == 300);
-    assert(port_stats[1].tx_bytes == 300);
+    assert(port_stats[2].tx_bytes == 300);
+    assert(port_stats[1].tx_bytes == 0);
     printf("✓ Test 5 passed\n\n");
     
     /* Test 6: TTL expiration (IPv4) */
@@ -293,14 +327,18 @@ void run_tests(void)
     printf("Test 7: TTL Decrement - IPv4\n");
     printf("----------------------------\n");
     reset_stats();
-    packet_t pkt_ttl64 = create_ip_packet(0, 64, 64, true);  // TTL=64
-    packet_t pkt_ttl2 = create_ip_packet(1, 64, 2, true);    // TTL=2
+    packet_t pkt_ttl64 = create_station_packet(0, 64, 1, 2);  // A@0 -> B@2
+    packet_t pkt_ttl2 = create_station_packet(2, 64, 2, 1);   // B@2 -> A@0
+    pkt_ttl64.ttl = 64;
+    pkt_ttl64.is_ipv4 = 1;
+    pkt_ttl2.ttl = 2;
+    pkt_ttl2.is_ipv4 = 1;
     process_packet(&pkt_ttl64);  // Should forward with TTL=63
     process_packet(&pkt_ttl2);   // Should forward with TTL=1
     assert(pkt_ttl64.ttl == 63);
     assert(pkt_ttl2.ttl == 1);
-    assert(port_stats[1].tx_packets == 1);  // Port 0 -> Port 1
-    assert(port_stats[2].tx_packets == 1);  // Port 1 -> Port 2
+    assert(port_stats[2].tx_packets == 1);  // Port 0 -> Port 2
+    assert(port_stats[0].tx_packets == 1);  // Port 2 -> Port 0
     printf("✓ Test 7 passed\n\n");
     
     /* Test 8: Hop limit expiration (IPv6) */
@@ -345,6 +383,59 @@ void run_tests(void)
     printf("  ✓ Packet dropped after 3 hops, preventing infinite loop\n");
     printf("✓ Test 9 passed\n\n");
     
+    /* Test 10: Filtering */
+    printf("Test 10: Filtering - Destination on Ingress Port\n");
+    printf("------------------------------------------------\n");
+    reset_fdb();
+    reset_stats();
+    uint64_t filtered_before = fwd.stats.filtered;
+    packet_t pkt_c = create_station_packet(1, 64, 3, 0xFF);  // C@1 announces itself
+    packet_t pkt_d = create_station_packet(1, 64, 4, 3);     // D@1 -> C@1
+    process_packet(&pkt_c);
+    process_packet(&pkt_d);
+    assert(port_stats[0].tx_packets == 1);  // Only the broadcast
+    assert(port_stats[2].tx_packets == 1);
+    assert(fwd.stats.filtered == filtered_before + 1);
+    printf("✓ Test 10 passed\n\n");
+    
+    /* Test 11: Broadcast */
+    printf("Test 11: Broadcast Flooding\n");
+    printf("---------------------------\n");
+    reset_stats();
+    packet_t pkt_bcast = create_station_packet(2, 64, 5, 0xFF);
+    process_packet(&pkt_bcast);
+    assert(port_stats[0].tx_packets == 1);
+    assert(port_stats[1].tx_packets == 1);
+    assert(port_stats[2].tx_packets == 0);
+    printf("✓ Test 11 passed\n\n");
+    
+    /* Test 12: Station move */
+    printf("Test 12: Station Move\n");
+    printf("---------------------\n");
+    reset_stats();
+    uint8_t mac_c[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 3};
+    uint64_t moved_before = fwd.stats.moved;
+    packet_t pkt_move = create_station_packet(0, 64, 3, 5);  // C now on port 0
+    process_packet(&pkt_move);
+    assert(l2_fwd_lookup(&fwd, mac_c, sim_time_ms) == 0);
+    assert(port_stats[2].tx_packets == 1);  // E learned on port 2
+    assert(fwd.stats.moved == moved_before + 1);
+    printf("✓ Test 12 passed\n\n");
+    
+    /* Test 13: Aging */
+    printf("Test 13: Aging\n");
+    printf("--------------\n");
+    reset_stats();
+    sim_time_ms += fwd.age_ms + 1;
+    assert(l2_fwd_lookup(&fwd, mac_c, sim_time_ms) == -ENOENT);
+    packet_t pkt_aged = create_station_packet(2, 64, 5, 3);  // C aged: flood
+    process_packet(&pkt_aged);
+    assert(port_stats[0].tx_packets == 1);
+    assert(port_stats[1].tx_packets == 1);
+    assert(l2_fwd_age(&fwd, sim_time_ms) == 1);  // D
+    assert(fwd.count == 1);                      // Only E, just refreshed
+    printf("✓ Test 13 passed\n\n");
+    
     printf("========================================\n");
     printf("All Tests Passed! ✓\n");
     printf("========================================\n");
@@ -365,7 +456,10 @@ void interactive_mode(void)
     printf("  send <port> <size>         - Send non-IP packet\n");
     printf("  sendip <port> <size> <ttl> - Send IPv4 packet with TTL\n");
     printf("  sendip6 <port> <size> <hop>- Send IPv6 packet with hop limit\n");
+    printf("  sendmac <port> <src> <dst> - Send frame between stations (dst 255 = broadcast)\n");
+    printf("  tick <ms>                  - Advance the aging clock\n");
     printf("  stats                      - Show statistics\n");
+    printf("  fdb                        - Show forwarding database statistics\n");
     printf("  reset                      - Reset statistics\n");
     printf("  enable <port>              - Enable port\n");
     printf("  disable <port>             - Disable port\n");
@@ -385,6 +479,9 @@ void interactive_mode(void)
             if (strcmp(action, "stats") == 0) {
                 print_port_stats();
             }
+            else if (strcmp(action, "fdb") == 0) {
+                l2_fwd_print_stats(&fwd, "Switch");
+            }
             else if (strcmp(action, "reset") == 0) {
                 reset_stats();
             }
@@ -399,6 +496,16 @@ void interactive_mode(void)
                 packet_t pkt = create_ip_packet(port, size, ttl, true);
                 process_packet(&pkt);
             }
+            else if (sscanf(cmd, "sendmac %d %d %d", &port, &size, &ttl) == 3) {
+                /* size/ttl hold the source and destination stations */
+                packet_t pkt = create_station_packet(port, 64, size, ttl);
+                process_packet(&pkt);
+            }
+            else if (sscanf(cmd, "tick %d", &size) == 1) {
+                sim_time_ms += size;
+                printf("Clock: %lu ms, %u entries aged\n", sim_time_ms,
+                       l2_fwd_age(&fwd, sim_time_ms));
+            }
             else if (sscanf(cmd, "send %d %d", &port, &size) == 2) {
                 packet_t pkt = create_packet(port, size);
                 process_packet(&pkt);
@@ -406,12 +513,14 @@ void interactive_mode(void)
             else if (sscanf(cmd, "enable %d", &port) == 1) {
                 if (port >= 0 && port < 3) {
                     port_config[port].enabled = true;
+                    l2_fwd_set_port_state(&fwd, port, L2_PORT_FORWARDING);
                     printf("Port %d enabled\n", port);
                 }
             }
             else if (sscanf(cmd, "disable %d", &port) == 1) {
                 if (port >= 0 && port < 3) {
                     port_config[port].enabled = false;
+                    l2_fwd_set_port_state(&fwd, port, L2_PORT_BLOCKING);
                     printf("Port %d disabled\n", port);
                 }
             }
@@ -431,6 +540,11 @@ int main(int argc, char *argv[])
     printf("Three-Port Switch Simulator\n");
     printf("========================================\n");
     
+    if (l2_fwd_init(&fwd, 3, 0, 0) != 0) {
+        fprintf(stderr, "Failed to initialize forwarding engine\n");
+        return 1;
+    }
+    
     if (argc > 1 && strcmp(argv[1], "test") == 0) {
         // Run automated tests
         run_tests();
@@ -447,6 +561,7 @@ int main(int argc, char *argv[])
         interactive_mode();
     }
     
+    l2_fwd_cleanup(&fwd);
     return 0;
 }
 
@@ -454,7 +569,7 @@ int main(int argc, char *argv[])
  * GDB Debugging Tips:
  * 
  * Compile with debug symbols:
- *   gcc -g -O0 -o switch_sim three_port_switch_sim.c
+ *   gcc -g -O0 -pthread -o switch_sim three_port_switch_sim.c l2_fwd.c
  * 
  * Start debugging:
  *   gdb ./switch_sim
@@ -10,24 +10,50 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <time.h>
 
 #include <rte_eal.h>
+#include <rte_dev.h>
+#include <rte_cycles.h>
 #include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
 #include <rte_mbuf.h>
 #include <rte_ether.h>
 #include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
 #include <rte_udp.h>
 #include <rte_tcp.h>
+#include <rte_telemetry.h>
+#include <rte_thread.h>
+
+#include "veth_fdb.h"
+#include "sw_rss.h"
+#include "lcore_idle.h"
+#include "pkt_trace.h"
+#include "mbuf_pool.h"
+#include "pkt_meta.h"
+#include "sw_gso.h"
+#include "port_failover.h"
 
 #define MAX_PKT_BURST 32
-#define MBUF_CACHE_SIZE 250
 #define RX_RING_SIZE 1024
 #define TX_RING_SIZE 1024
-#define NUM_MBUFS 8192
+#define BURST_TX_DRAIN_US 100   /* Max time a packet waits in a TX buffer */
+
+#define XDP_BUSY_BUDGET 64      /* Packets per busy-poll syscall; 0 disables */
 
-#define MAC_TABLE_SIZE 1024
-#define MAC_AGING_TIME 300
+#define MAX_MTU 9600
+#define AF_PACKET_FRAME_HDR 128 /* TPACKET header and sockaddr before the frame */
+
+#define MAX_LCORES VETH_FDB_MAX_READERS
+#define UPDATER_LCORE 0         /* Worker that also runs the FDB updater */
+#define LINK_POLL_US 200        /* Link state poll interval; 0 relies on LSC interrupts */
 
 static volatile bool force_quit = false;
 
@@ -36,23 +62,39 @@ enum port_type {
     PORT_TYPE_SWITCH_LINK = 1,
 };
 
+/* PMD the veths are attached with */
+enum veth_backend {
+    BACKEND_AF_PACKET = 0,
+    BACKEND_AF_XDP,
+};
+
 struct port_config {
     char veth_name[32];
     uint16_t port_id;
     enum port_type type;
     char peer_switch[16];
     bool configured;
-};
-
-struct mac_entry {
-    struct rte_ether_addr mac;
-    uint16_t port_id;
-    time_t timestamp;
-    bool valid;
+    bool af_xdp;                /* Attached through AF_XDP */
+    bool scatter;               /* Receives jumbo frames into chained mbufs */
 };
 
 #define MAX_PORTS 11
 
+/* Per-forwarding-lcore state; worker w uses RX/TX queue w on every port */
+struct lcore_conf {
+    uint16_t worker_id;         /* Also its FDB reader id */
+    struct rte_eth_dev_tx_buffer *tx_buffer[MAX_PORTS];  /* By DPDK port id */
+    
+    uint64_t rx_packets[MAX_PORTS];
+    uint64_t tx_packets[MAX_PORTS];
+    uint64_t dropped_packets;
+    uint64_t flooded_packets;
+    
+    struct lcore_idle idle;
+    struct pkt_trace_ring *trace;
+    struct sw_gso gso;          /* With --gro */
+} __rte_cache_aligned;
+
 struct switch_ctx {
     int switch_id;
     int num_switches;
@@ -61,14 +103,35 @@ struct switch_ctx {
     struct port_config ports[MAX_PORTS];
     int num_ports;
     
-    struct mac_entry mac_table[MAC_TABLE_SIZE];
+    struct veth_fdb fdb;
     
-    struct rte_mempool *mbuf_pool;
+    struct mbuf_pools pools;                /* One per socket with ports */
     
-    uint64_t rx_packets[MAX_PORTS];
-    uint64_t tx_packets[MAX_PORTS];
-    uint64_t dropped_packets;
-    uint64_t mac_learned;
+    int nb_lcores;
+    bool force_sw_rss;
+    bool rx_intr;               /* Wait for RX interrupts when idle */
+    enum veth_backend backend;
+    int xdp_busy_budget;
+    uint16_t mtu;
+    bool tx_linearize;          /* A port cannot send chained mbufs */
+    bool gro;                   /* Merge host TCP segments, cut them again on TX */
+    struct lcore_conf lcores[MAX_LCORES];
+    
+    /* TX and flood ports for every link state of the switch links */
+    struct port_failover failover;
+    pthread_mutex_t link_lock;              /* Serializes link_check() */
+    uint32_t link_poll_us;
+    rte_thread_t link_thread;
+    bool link_thread_running;
+    
+    /* Ports whose PMD has fewer queue pairs than lcores; by DPDK port id */
+    bool sw_rss_enabled[MAX_PORTS];
+    struct sw_rss_port sw_rss[MAX_PORTS];
+    bool rx_intr_enabled[MAX_PORTS];        /* By DPDK port id */
+    
+    /* Packet-path trace rings by worker, dumped to trace_file */
+    struct pkt_trace_ring trace[MAX_LCORES];
+    char trace_file[256];
 };
 
 static struct switch_ctx ctx = {0};
@@ -81,297 +144,413 @@ static void signal_handler(int signum)
     }
 }
 
-static uint32_t mac_hash(const struct rte_ether_addr *mac)
+/*
+ * Load the static MAC table, then reload it on every SIGHUP. The file is
+ * parsed into a shadow table off the datapath and swapped in by the
+ * forwarding loop, so a reload never pauses forwarding.
+ */
+static int load_mac_table_from_file(const char *filename)
+{
+    uint16_t port_ids[MAX_PORTS];
+    int loaded;
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        port_ids[i] = ctx.ports[i].port_id;
+    }
+    
+    loaded = veth_fdb_reload(&ctx.fdb, filename, port_ids, ctx.num_ports);
+    if (loaded < 0) {
+        printf("Warning: Cannot load MAC table file %s\n", filename);
+    } else {
+        printf("Loaded %d static MAC entries from %s\n", loaded, filename);
+    }
+    
+    if (veth_fdb_reload_thread_start(&ctx.fdb, filename, port_ids, ctx.num_ports) == 0) {
+        printf("Send SIGHUP (kill -HUP %d) to reload %s\n", getpid(), filename);
+    }
+    fflush(stdout);
+    
+    return loaded;
+}
+
+/* TX buffer error callback: the PMD did not take these packets */
+static void tx_drop_unsent(struct rte_mbuf **unsent, uint16_t count, void *userdata)
+{
+    struct lcore_conf *lc = userdata;
+    
+    rte_pktmbuf_free_bulk(unsent, count);
+    lc->dropped_packets += count;
+    PKT_TRACE(lc->trace, PKT_TRACE_TX_DROP, count, 0, 0);
+}
+
+/* Software RSS ports: the buffer only stages packets for the owner's ring */
+static uint16_t tx_sw_rss_flush(struct lcore_conf *lc, uint16_t dst_port)
 {
-    uint32_t hash = 0;
-    for (int i = 0; i < 6; i++) {
-        hash = hash * 31 + mac->addr_bytes[i];
+    struct rte_eth_dev_tx_buffer *buf = lc->tx_buffer[dst_port];
+    uint16_t sent = sw_rss_tx(&ctx.sw_rss[dst_port], buf->pkts, buf->length);
+    
+    if (sent < buf->length) {
+        tx_drop_unsent(&buf->pkts[sent], buf->length - sent, lc);
     }
-    return hash % MAC_TABLE_SIZE;
+    buf->length = 0;
+    return sent;
 }
 
-static int mac_lookup(const struct rte_ether_addr *mac)
+/* Queue one frame for dst_port; the buffer sends a full burst by itself */
+static inline void tx_buffer_frame(struct lcore_conf *lc, uint16_t dst_port, struct rte_mbuf *m)
 {
-    uint32_t hash = mac_hash(mac);
-    uint32_t idx = hash;
-    time_t now = time(NULL);
+    struct rte_eth_dev_tx_buffer *buf = lc->tx_buffer[dst_port];
     
-    for (int i = 0; i < MAC_TABLE_SIZE; i++) {
-        idx = (hash + i) % MAC_TABLE_SIZE;
-        
-        if (!ctx.mac_table[idx].valid) {
-            return -1;
-        }
-        
-        if (rte_is_same_ether_addr(&ctx.mac_table[idx].mac, mac)) {
-            if (now - ctx.mac_table[idx].timestamp > MAC_AGING_TIME) {
-                ctx.mac_table[idx].valid = false;
-                return -1;
-            }
-            return ctx.mac_table[idx].port_id;
+    if (ctx.sw_rss_enabled[dst_port]) {
+        buf->pkts[buf->length++] = m;
+        if (buf->length == buf->size) {
+            lc->tx_packets[dst_port] += tx_sw_rss_flush(lc, dst_port);
         }
+        return;
     }
+    lc->tx_packets[dst_port] += rte_eth_tx_buffer(dst_port, lc->worker_id, buf, m);
+}
+
+/* Cut a packet merged by GRO back into frames and queue them */
+static void tx_enqueue_segments(struct lcore_conf *lc, uint16_t dst_port, struct rte_mbuf *m)
+{
+    struct rte_mbuf *segs[SW_GSO_MAX_SEGS];
+    int nb_segs = sw_gso_segment(&lc->gso, m, segs, SW_GSO_MAX_SEGS);
     
-    return -1;
+    if (nb_segs < 0) {
+        rte_pktmbuf_free(m);
+        lc->dropped_packets++;
+        return;
+    }
+    if (nb_segs == 0) {
+        tx_buffer_frame(lc, dst_port, m);
+        return;
+    }
+    for (int i = 0; i < nb_segs; i++) {
+        tx_buffer_frame(lc, dst_port, segs[i]);
+    }
 }
 
-static int load_mac_table_from_file(const char *filename)
+/* Queue one packet for dst_port */
+static inline void tx_enqueue(struct lcore_conf *lc, uint16_t dst_port, struct rte_mbuf *m)
 {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        printf("Warning: Cannot open MAC table file %s\n", filename);
-        return -1;
+    if (unlikely(ctx.gro && sw_gso_needed(&lc->gso, m))) {
+        tx_enqueue_segments(lc, dst_port, m);
+        return;
     }
-    
-    printf("Loading static MAC table from %s...\n", filename);
-    fflush(stdout);
-    
-    char line[256];
-    int entries_loaded = 0;
-    int line_num = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        line_num++;
+    tx_buffer_frame(lc, dst_port, m);
+}
+
+static void tx_flush_all(struct lcore_conf *lc)
+{
+    for (int i = 0; i < ctx.num_ports; i++) {
+        uint16_t pid = ctx.ports[i].port_id;
         
-        // Skip comments and empty lines
-        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+        if (!ctx.ports[i].configured) {
             continue;
         }
-        
-        uint8_t mac[6];
-        int port_index;
-        char desc[64];
-        
-        int parsed = sscanf(line, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx %d %63s",
-                   &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5],
-                   &port_index, desc);
-        
-        if (parsed == 8) {
-            // Validate port_index
-            if (port_index < 0 || port_index >= ctx.num_ports) {
-                printf("  Warning: Invalid port index %d on line %d (have %d ports)\n", 
-                       port_index, line_num, ctx.num_ports);
-                continue;
-            }
-            
-            // Get the actual DPDK port_id from the port_index
-            uint16_t dpdk_port_id = ctx.ports[port_index].port_id;
-            
-            // Add to MAC table using direct hash
-            struct rte_ether_addr addr;
-            memcpy(addr.addr_bytes, mac, 6);
-            
-            uint32_t hash = mac_hash(&addr);
-            uint32_t idx = hash;
-            bool added = false;
-            
-            for (int i = 0; i < MAC_TABLE_SIZE; i++) {
-                idx = (hash + i) % MAC_TABLE_SIZE;
-                
-                if (!ctx.mac_table[idx].valid) {
-                    rte_ether_addr_copy(&addr, &ctx.mac_table[idx].mac);
-                    ctx.mac_table[idx].port_id = dpdk_port_id;
-                    ctx.mac_table[idx].timestamp = time(NULL);
-                    ctx.mac_table[idx].valid = true;
-                    
-                    printf("  [Line %d] Added: %02x:%02x:%02x:%02x:%02x:%02x -> port_idx=%d (port_id=%u, %s) [%s]\n",
-                           line_num,
-                           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
-                           port_index, dpdk_port_id, ctx.ports[port_index].veth_name, desc);
-                    printf("           Hash slot: %u\n", idx);
-                    fflush(stdout);
-                    
-                    entries_loaded++;
-                    ctx.mac_learned++;
-                    added = true;
-                    break;
-                }
-            }
-            
-            if (!added) {
-                printf("  ERROR: Could not add MAC entry on line %d (hash table full?)\n", line_num);
-            }
+        if (ctx.sw_rss_enabled[pid]) {
+            lc->tx_packets[pid] += tx_sw_rss_flush(lc, pid);
         } else {
-            if (line[0] != '#' && line[0] != '\n') {
-                printf("  Warning: Could not parse line %d: %s", line_num, line);
-            }
+            lc->tx_packets[pid] += rte_eth_tx_buffer_flush(pid, lc->worker_id, lc->tx_buffer[pid]);
         }
     }
+}
+
+/*
+ * Precompute forwarding for every link state of the configured switch
+ * links. In a ring each link backs up the other: traffic for a failed
+ * segment goes the other way around.
+ */
+static int build_failover(void)
+{
+    struct port_failover *pf = &ctx.failover;
+    int links[2], nb_links = 0;
+    int ret;
     
-    fclose(fp);
-    printf("Loaded %d static MAC entries from %s\n", entries_loaded, filename);
-    fflush(stdout);
-    
-    // Verify by doing test lookups
-    printf("\nVerifying MAC table entries:\n");
-    for (int i = 0; i < MAC_TABLE_SIZE; i++) {
-        if (ctx.mac_table[i].valid) {
-            int lookup_result = mac_lookup(&ctx.mac_table[i].mac);
-            printf("  Slot %d: %02x:%02x:%02x:%02x:%02x:%02x -> port_id=%u (lookup returns: %d)\n",
-                   i,
-                   ctx.mac_table[i].mac.addr_bytes[0],
-                   ctx.mac_table[i].mac.addr_bytes[1],
-                   ctx.mac_table[i].mac.addr_bytes[2],
-                   ctx.mac_table[i].mac.addr_bytes[3],
-                   ctx.mac_table[i].mac.addr_bytes[4],
-                   ctx.mac_table[i].mac.addr_bytes[5],
-                   ctx.mac_table[i].port_id,
-                   lookup_result);
+    port_failover_init(pf);
+    for (int i = 0; i < ctx.num_ports; i++) {
+        bool link = ctx.ports[i].type == PORT_TYPE_SWITCH_LINK;
+        
+        if (!ctx.ports[i].configured) {
+            continue;
+        }
+        ret = port_failover_add_port(pf, ctx.ports[i].port_id, link);
+        if (ret < 0) {
+            return ret;
+        }
+        if (link && nb_links < 2) {
+            links[nb_links++] = ctx.ports[i].port_id;
         }
     }
-    fflush(stdout);
-    
-    return entries_loaded;
+    if (strcmp(ctx.topology, "ring") == 0 && nb_links == 2) {
+        port_failover_set_backup(pf, links[0], links[1]);
+        port_failover_set_backup(pf, links[1], links[0]);
+    }
+    port_failover_build(pf);
+    return 0;
 }
 
-static void forward_packet(struct rte_mbuf *m, uint16_t rx_port_id)
+/*
+ * Unknown destination or broadcast - flood to all ports except rx_port
+ * that have link. Flooded packets are never modified, so every output
+ * port shares the one mbuf: the refcount of each of its segments is
+ * raised once and each TX completion drops it.
+ */
+static void flood_packet(struct lcore_conf *lc, const struct port_failover_state *st,
+                         struct rte_mbuf *m, uint16_t rx_port_id)
 {
-    struct rte_ether_hdr *eth_hdr;
-    int dst_port_id;
-    static uint64_t pkt_num = 0;
+    uint16_t nb_ports = st->nb_flood[rx_port_id];
     
-    eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    if (nb_ports == 0) {
+        rte_pktmbuf_free(m);
+        lc->dropped_packets++;
+        return;
+    }
     
-    pkt_num++;
-    if (pkt_num <= 50) {
-        printf("PKT#%lu: RX on port_id=%u, dst_mac=%02x:%02x:%02x:%02x:%02x:%02x\n",
-               pkt_num, rx_port_id,
-               eth_hdr->dst_addr.addr_bytes[0],
-               eth_hdr->dst_addr.addr_bytes[1],
-               eth_hdr->dst_addr.addr_bytes[2],
-               eth_hdr->dst_addr.addr_bytes[3],
-               eth_hdr->dst_addr.addr_bytes[4],
-               eth_hdr->dst_addr.addr_bytes[5]);
-        fflush(stdout);
+    PKT_TRACE(lc->trace, PKT_TRACE_FLOOD, rx_port_id, nb_ports, 0);
+    if (nb_ports > 1) {
+        rte_pktmbuf_refcnt_update(m, nb_ports - 1);
+    }
+    for (uint16_t i = 0; i < nb_ports; i++) {
+        tx_enqueue(lc, st->flood[rx_port_id][i], m);
     }
+    lc->flooded_packets++;
+}
+
+/* Destination MAC as the low 48 bits of a trace argument */
+static inline uint64_t mac_to_u64(const struct rte_ether_addr *mac)
+{
+    const uint8_t *b = mac->addr_bytes;
     
-    // Don't learn MACs - use static table only
+    return (uint64_t)b[0] << 40 | (uint64_t)b[1] << 32 | (uint64_t)b[2] << 24 |
+           (uint64_t)b[3] << 16 | (uint64_t)b[4] << 8 | b[5];
+}
+
+/*
+ * Drop what cannot be forwarded: chained packets whose Ethernet header
+ * is split, or that some port cannot send and do not fit one mbuf.
+ * Returns the packets kept, compacted at the front of pkts.
+ */
+static uint16_t prepare_burst(struct lcore_conf *lc, struct rte_mbuf **pkts, uint16_t nb_rx)
+{
+    uint16_t n = 0;
     
-    // Lookup destination in static MAC table
-    dst_port_id = mac_lookup(&eth_hdr->dst_addr);
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        struct rte_mbuf *m = pkts[i];
+        
+        if (m->nb_segs > 1 &&
+            (pkt_meta_pullup(m, RTE_ETHER_HDR_LEN) < 0 ||
+             (ctx.tx_linearize && rte_pktmbuf_linearize(m) < 0))) {
+            rte_pktmbuf_free(m);
+            lc->dropped_packets++;
+            continue;
+        }
+        pkts[n++] = m;
+    }
+    return n;
+}
+
+/*
+ * Forward one RX burst in stages: prefetch every header, post source
+ * learning and look up all destinations in one bulk call, then queue each
+ * packet on its destination's TX buffer, or the backup while that port
+ * is down. Buffers go out when full or when the main loop drains them.
+ */
+static void forward_burst(struct lcore_conf *lc, struct rte_mbuf **pkts, uint16_t nb_rx,
+                          uint16_t rx_port_id)
+{
+    const struct port_failover_state *st = port_failover_state(&ctx.failover);
+    const struct rte_ether_addr *dst_macs[MAX_PKT_BURST];
+    int dst_ports[MAX_PKT_BURST];
     
-    if (pkt_num <= 50) {
-        printf("  dst_port lookup=%d (rx_port=%u)\n", dst_port_id, rx_port_id);
-        fflush(stdout);
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
     }
     
-    if (dst_port_id >= 0 && dst_port_id != rx_port_id) {
-        // Known destination - forward directly
-        if (pkt_num <= 50) {
-            printf("  → Unicast forwarding to port_id %d\n", dst_port_id);
-            fflush(stdout);
-        }
-        uint16_t sent = rte_eth_tx_burst(dst_port_id, 0, &m, 1);
-        if (sent > 0) {
-            ctx.tx_packets[dst_port_id]++;
-        } else {
-            rte_pktmbuf_free(m);
-            ctx.dropped_packets++;
-        }
-    } else {
-        // Unknown destination or broadcast - flood to all ports except rx_port
-        if (pkt_num <= 50) {
-            printf("  → Flooding (dst_port=%d). Will flood to: ", dst_port_id);
-            fflush(stdout);
-        }
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        struct rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(pkts[i], struct rte_ether_hdr *);
         
-        int flood_count = 0;
-        int num_flood_ports = 0;
+        // Post the source to the learning ring; the table is updated off the fast path
+        veth_fdb_learn(&ctx.fdb, lc->worker_id, &eth_hdr->src_addr, rx_port_id);
+        dst_macs[i] = &eth_hdr->dst_addr;
+    }
+    
+    veth_fdb_lookup_bulk(&ctx.fdb, dst_macs, nb_rx, dst_ports);
+    
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        int dst_port_id = port_failover_egress(st, rx_port_id, dst_ports[i]);
         
-        for (int i = 0; i < ctx.num_ports; i++) {
-            if (ctx.ports[i].configured && ctx.ports[i].port_id != rx_port_id) {
-                num_flood_ports++;
-                if (pkt_num <= 50) {
-                    printf("port_id=%u ", ctx.ports[i].port_id);
-                    fflush(stdout);
-                }
-            }
+        PKT_TRACE(lc->trace, PKT_TRACE_FWD, rx_port_id, mac_to_u64(dst_macs[i]),
+                  (uint64_t)(int64_t)dst_port_id);
+        if (dst_port_id != PORT_FAILOVER_FLOOD) {
+            tx_enqueue(lc, dst_port_id, pkts[i]);
+        } else {
+            flood_packet(lc, st, pkts[i], rx_port_id);
         }
+    }
+}
+
+/*
+ * Use RX interrupts for idle waits only if every queue this lcore polls
+ * can raise one; software RSS rings cannot
+ */
+static void setup_rx_intr(struct lcore_conf *lc)
+{
+    if (!ctx.rx_intr) {
+        return;
+    }
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        uint16_t pid = ctx.ports[i].port_id;
         
-        if (pkt_num <= 50) {
-            printf("(total: %d ports)\n", num_flood_ports);
-            fflush(stdout);
+        if (!ctx.ports[i].configured) {
+            continue;
         }
-        
-        if (num_flood_ports == 0) {
-            rte_pktmbuf_free(m);
-            ctx.dropped_packets++;
+        if (!ctx.rx_intr_enabled[pid] ||
+            lcore_idle_add_rx_intr(&lc->idle, pid, lc->worker_id) < 0) {
+            printf("Worker %u: no RX interrupt on port %u, sleeping when idle instead\n",
+                   lc->worker_id, pid);
+            lc->idle.nb_intr_queues = 0;
             return;
         }
+    }
+}
+
+/* Receive a burst from this lcore's share of a port */
+static uint16_t rx_port(struct lcore_conf *lc, uint16_t pid, struct rte_mbuf **bufs)
+{
+    struct sw_rss_port *rss = &ctx.sw_rss[pid];
+    
+    if (!ctx.sw_rss_enabled[pid]) {
+        return rte_eth_rx_burst(pid, lc->worker_id, bufs, MAX_PKT_BURST);
+    }
+    
+    /* The updater lcore owns queue 0 of software RSS ports */
+    if (lc->worker_id == UPDATER_LCORE) {
+        uint16_t nb_rx = rte_eth_rx_burst(pid, 0, bufs, MAX_PKT_BURST);
         
-        for (int i = 0; i < ctx.num_ports; i++) {
-            if (ctx.ports[i].configured && ctx.ports[i].port_id != rx_port_id) {
-                struct rte_mbuf *m_to_send;
-                
-                if (flood_count == num_flood_ports - 1) {
-                    m_to_send = m;
-                } else {
-                    m_to_send = rte_pktmbuf_clone(m, ctx.mbuf_pool);
-                    if (!m_to_send) {
-                        continue;
-                    }
-                }
-                
-                uint16_t sent = rte_eth_tx_burst(ctx.ports[i].port_id, 0, &m_to_send, 1);
-                if (sent > 0) {
-                    ctx.tx_packets[ctx.ports[i].port_id]++;
-                    if (pkt_num <= 50) {
-                        printf("    → Sent to port_id %u (%s)\n", 
-                               ctx.ports[i].port_id, ctx.ports[i].veth_name);
-                        fflush(stdout);
-                    }
-                } else {
-                    rte_pktmbuf_free(m_to_send);
-                    ctx.dropped_packets++;
-                }
-                flood_count++;
-            }
+        uint16_t nb_tx;
+        
+        if (nb_rx > 0) {
+            sw_rss_distribute(rss, bufs, nb_rx);
         }
+        nb_tx = sw_rss_tx_drain(rss);
+        lc->tx_packets[pid] += nb_tx;
+        lcore_idle_work(&lc->idle, nb_rx + nb_tx);
+    }
+    return sw_rss_rx(rss, lc->worker_id, bufs, MAX_PKT_BURST);
+}
+
+/* Status line: share of empty polls and of time asleep on every worker */
+static void print_idle_status(void)
+{
+    printf("[Switch %d]", ctx.switch_id);
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        double idle_pct, asleep_pct;
+        
+        lcore_idle_ratio(&ctx.lcores[w].idle, &idle_pct, &asleep_pct);
+        printf("%s worker %d: idle polls %.1f%%, asleep %.1f%%", w ? ";" : "", w, idle_pct,
+               asleep_pct);
     }
+    printf("\n");
 }
 
-static int main_loop(void)
+/* End a poll and record the time it spent asleep, if any */
+static void trace_idle_end_poll(struct lcore_conf *lc)
 {
+    uint64_t asleep = lc->idle.sleep_tsc;
+    uint64_t intr_waits = lc->idle.intr_waits;
+    
+    lcore_idle_end_poll(&lc->idle);
+    if (lc->idle.sleep_tsc != asleep) {
+        pkt_trace_emit(lc->trace, PKT_TRACE_IDLE, lc->idle.intr_waits != intr_waits,
+                       lc->idle.sleep_tsc - asleep, 0);
+    }
+}
+
+static int main_loop(void *arg)
+{
+    struct lcore_conf *lc = arg;
     struct rte_mbuf *bufs[MAX_PKT_BURST];
     uint16_t nb_rx;
     static uint64_t loop_count = 0;
-    static time_t last_debug = 0;
+    const uint64_t drain_tsc = (rte_get_tsc_hz() + US_PER_S - 1) / US_PER_S * BURST_TX_DRAIN_US;
+    uint64_t prev_tsc = rte_rdtsc();
+    bool updater = lc->worker_id == UPDATER_LCORE;
     
-    printf("\nSwitch %d forwarding packets on core %u. [Ctrl+C to quit]\n",
-           ctx.switch_id, rte_lcore_id());
+    printf("\nSwitch %d worker %u forwarding packets on core %u. [Ctrl+C to quit]\n",
+           ctx.switch_id, lc->worker_id, rte_lcore_id());
     fflush(stdout);
     
+    veth_fdb_reader_online(&ctx.fdb, lc->worker_id);
+    lcore_idle_init(&lc->idle);
+    setup_rx_intr(lc);
+    
     while (!force_quit) {
-        loop_count++;
+        if (updater) {
+            loop_count++;
+            
+            // One lcore applies learn requests from all of them
+            uint32_t last_sec = veth_fdb_now(&ctx.fdb);
+            uint32_t applied = veth_fdb_update(&ctx.fdb);
+            
+            lcore_idle_work(&lc->idle, applied);
+            if (applied > 0) {
+                PKT_TRACE(lc->trace, PKT_TRACE_FDB_UPDATE, applied, ctx.fdb.count, 0);
+            }
+            uint32_t now_sec = veth_fdb_now(&ctx.fdb);
+            if (now_sec != last_sec && now_sec % 10 == 0) {
+                printf("DEBUG: Loop count: %lu, checking %d ports\n", loop_count, ctx.num_ports);
+                print_idle_status();
+                fflush(stdout);
+            }
+        }
         
-        time_t now = time(NULL);
-        if (now != last_debug && now % 10 == 0) {
-            printf("DEBUG: Loop count: %lu, checking %d ports\n", loop_count, ctx.num_ports);
-            fflush(stdout);
-            last_debug = now;
+        uint64_t cur_tsc = rte_rdtsc();
+        if (cur_tsc - prev_tsc > drain_tsc) {
+            tx_flush_all(lc);
+            prev_tsc = cur_tsc;
         }
         
         for (int i = 0; i < ctx.num_ports; i++) {
+            uint16_t pid = ctx.ports[i].port_id;
+            
             if (!ctx.ports[i].configured) {
                 continue;
             }
             
-            nb_rx = rte_eth_rx_burst(ctx.ports[i].port_id, 0, bufs, MAX_PKT_BURST);
-            
-            if (nb_rx > 0) {
-                printf("DEBUG: Port %d (%s) received %u packets!\n", 
-                       i, ctx.ports[i].veth_name, nb_rx);
-                fflush(stdout);
+            nb_rx = rx_port(lc, pid, bufs);
+            if (nb_rx == 0) {
+                continue;
             }
             
-            ctx.rx_packets[ctx.ports[i].port_id] += nb_rx;
-            
-            for (uint16_t j = 0; j < nb_rx; j++) {
-                forward_packet(bufs[j], ctx.ports[i].port_id);
+            PKT_TRACE(lc->trace, PKT_TRACE_RX_BURST, pid, nb_rx, 0);
+            lc->rx_packets[pid] += nb_rx;
+            lcore_idle_work(&lc->idle, nb_rx);
+            nb_rx = prepare_burst(lc, bufs, nb_rx);
+            if (ctx.gro && ctx.ports[i].type == PORT_TYPE_HOST) {
+                nb_rx = sw_gro_burst(&lc->gso, bufs, nb_rx);
             }
+            forward_burst(lc, bufs, nb_rx, pid);
+        }
+        
+        veth_fdb_quiescent(&ctx.fdb, lc->worker_id);
+        
+        // Back off while idle; nothing may wait in a TX buffer during a sleep
+        if (lcore_idle_will_sleep(&lc->idle)) {
+            tx_flush_all(lc);
+        }
+        if (pkt_trace_on(PKT_TRACE_IDLE)) {
+            trace_idle_end_poll(lc);
+        } else {
+            lcore_idle_end_poll(&lc->idle);
         }
     }
     
+    tx_flush_all(lc);
+    veth_fdb_reader_offline(&ctx.fdb, lc->worker_id);
+    
     return 0;
 }
 
@@ -485,6 +664,79 @@ static int configure_ports(void)
     return 0;
 }
 
+/* RX queues the kernel gave a veth (numrxqueues at creation) */
+static int veth_rx_queues(const char *ifname)
+{
+    char path[128];
+    struct dirent *de;
+    DIR *dir;
+    int n = 0;
+    
+    snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifname);
+    dir = opendir(path);
+    if (dir == NULL) {
+        return 1;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "rx-", 3) == 0) {
+            n++;
+        }
+    }
+    closedir(dir);
+    return n > 0 ? n : 1;
+}
+
+/* AF_PACKET ring geometry: one whole packet per frame, blocks of at least a page */
+static const char *af_packet_ring_args(void)
+{
+    static char args[48];
+    uint32_t framesz = 2048;
+    
+    while (framesz < mbuf_pool_frame_len(ctx.mtu) + AF_PACKET_FRAME_HDR) {
+        framesz <<= 1;
+    }
+    snprintf(args, sizeof(args), "blocksz=%u,framesz=%u",
+             framesz > 4096 ? framesz : 4096, framesz);
+    return args;
+}
+
+/*
+ * Attach every veth through AF_XDP, one XSK per lcore up to the veth's
+ * queue count. The kernel binds zero-copy when the driver supports it and
+ * copy mode otherwise. A port whose XSK cannot be created (no AF_XDP in
+ * the kernel or in this DPDK build) falls back to AF_PACKET.
+ */
+static void attach_af_xdp_ports(void)
+{
+    char devargs[256];
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        const char *ifname = ctx.ports[i].veth_name;
+        int nb_queues = veth_rx_queues(ifname);
+        
+        if (nb_queues > ctx.nb_lcores) {
+            nb_queues = ctx.nb_lcores;
+        }
+        
+        snprintf(devargs, sizeof(devargs),
+                 "net_af_xdp%d,iface=%s,start_queue=0,queue_count=%d,busy_budget=%d",
+                 i, ifname, nb_queues, ctx.xdp_busy_budget);
+        printf("Attaching: %s\n", devargs);
+        if (rte_dev_probe(devargs) == 0) {
+            ctx.ports[i].af_xdp = true;
+            continue;
+        }
+        
+        printf("WARNING: AF_XDP unavailable on %s, falling back to AF_PACKET\n", ifname);
+        snprintf(devargs, sizeof(devargs), "net_af_packet%d,iface=%s,qpairs=%d,%s",
+                 i, ifname, ctx.nb_lcores, af_packet_ring_args());
+        if (rte_dev_probe(devargs) != 0) {
+            printf("ERROR: Cannot attach %s\n", ifname);
+        }
+    }
+    fflush(stdout);
+}
+
 static int init_eal_with_veth(int argc, char **argv)
 {
     char *eal_argv[64];
@@ -493,8 +745,11 @@ static int init_eal_with_veth(int argc, char **argv)
     eal_argv[eal_argc++] = argv[0];
     eal_argv[eal_argc++] = "-l";
     
+    // Each switch gets its own block of nb_lcores cores
     static char lcore_mask[32];
-    snprintf(lcore_mask, sizeof(lcore_mask), "%d", ctx.switch_id - 1);
+    int first_core = (ctx.switch_id - 1) * ctx.nb_lcores;
+    int last_core = first_core + ctx.nb_lcores - 1;
+    snprintf(lcore_mask, sizeof(lcore_mask), "%d-%d", first_core, last_core);
     eal_argv[eal_argc++] = lcore_mask;
     
     eal_argv[eal_argc++] = "--proc-type";
@@ -505,18 +760,19 @@ static int init_eal_with_veth(int argc, char **argv)
     eal_argv[eal_argc++] = file_prefix;
     eal_argv[eal_argc++] = "--no-huge";
     
+    // AF_XDP ports are attached after EAL init so each can fall back on its own
     static char vdev_args[MAX_PORTS][128];
-    for (int i = 0; i < ctx.num_ports; i++) {
+    for (int i = 0; i < ctx.num_ports && ctx.backend == BACKEND_AF_PACKET; i++) {
         snprintf(vdev_args[i], sizeof(vdev_args[i]),
-                 "--vdev=net_af_packet%d,iface=%s",
-                 i, ctx.ports[i].veth_name);
+                 "--vdev=net_af_packet%d,iface=%s,qpairs=%d,%s",
+                 i, ctx.ports[i].veth_name, ctx.nb_lcores, af_packet_ring_args());
         eal_argv[eal_argc++] = vdev_args[i];
         
         printf("Adding vdev: %s\n", vdev_args[i]);
         fflush(stdout);
     }
     
-    printf("Switch %d will run on CPU core %d\n", ctx.switch_id, ctx.switch_id - 1);
+    printf("Switch %d will run on CPU cores %d-%d\n", ctx.switch_id, first_core, last_core);
     printf("Initializing EAL with %d arguments...\n", eal_argc);
     fflush(stdout);
     
@@ -530,6 +786,10 @@ static int init_eal_with_veth(int argc, char **argv)
     printf("EAL initialized successfully (returned %d)\n", ret);
     fflush(stdout);
     
+    if (ctx.backend == BACKEND_AF_XDP) {
+        attach_af_xdp_ports();
+    }
+    
     // Immediately check how many ports DPDK found
     uint16_t found_ports = rte_eth_dev_count_avail();
     printf("DPDK found %u ethdev ports immediately after EAL init\n", found_ports);
@@ -551,8 +811,281 @@ static int init_eal_with_veth(int argc, char **argv)
     return ret;
 }
 
+/* Telemetry /switch_veth/trace,<events|all|off>: set the traced events */
+static int telemetry_trace(const char *cmd __rte_unused, const char *params,
+                           struct rte_tel_data *d)
+{
+    uint32_t mask = __atomic_load_n(&pkt_trace_mask, __ATOMIC_RELAXED);
+    
+    if (params != NULL && params[0] != '\0') {
+        if (pkt_trace_parse_mask(params, &mask) < 0) {
+            return -EINVAL;
+        }
+        pkt_trace_set_mask(mask);
+    }
+    
+    rte_tel_data_start_dict(d);
+    for (int ev = 0; ev < PKT_TRACE_NB_EVENTS; ev++) {
+        rte_tel_data_add_dict_uint(d, pkt_trace_events[ev].name, (mask >> ev) & 1);
+    }
+    return 0;
+}
+
+/* Telemetry /switch_veth/trace_dump[,<path>]: write the rings to a file */
+static int telemetry_trace_dump(const char *cmd __rte_unused, const char *params,
+                                struct rte_tel_data *d)
+{
+    const char *path = params != NULL && params[0] != '\0' ? params : ctx.trace_file;
+    int n = pkt_trace_dump(path, ctx.trace, ctx.nb_lcores, ctx.switch_id);
+    
+    if (n < 0) {
+        return n;
+    }
+    rte_tel_data_start_dict(d);
+    rte_tel_data_add_dict_string(d, "file", path);
+    rte_tel_data_add_dict_uint(d, "records", n);
+    return 0;
+}
+
+static void register_trace_commands(void)
+{
+    rte_telemetry_register_cmd("/switch_veth/trace", telemetry_trace,
+        "Set traced events. Parameters: comma-separated events, all or off");
+    rte_telemetry_register_cmd("/switch_veth/trace_dump", telemetry_trace_dump,
+        "Write the trace rings to a file. Parameters: optional path");
+}
+
+/* Telemetry /switch_veth/mempool: occupancy and RX allocation failures per pool */
+static int telemetry_mempool(const char *cmd __rte_unused, const char *params __rte_unused,
+                             struct rte_tel_data *d)
+{
+    return mbuf_pools_telemetry(&ctx.pools, d);
+}
+
+/* veth a DPDK port is attached to */
+static const char *port_name(uint16_t pid)
+{
+    for (int i = 0; i < ctx.num_ports; i++) {
+        if (ctx.ports[i].port_id == pid) {
+            return ctx.ports[i].veth_name;
+        }
+    }
+    return "?";
+}
+
+/*
+ * Whether a veth has carrier. The kernel drops it when either end of the
+ * pair goes down, and refuses the read while this end is down.
+ */
+static bool veth_carrier(const char *ifname)
+{
+    char path[128];
+    char c = '0';
+    int fd;
+    
+    snprintf(path, sizeof(path), "/sys/class/net/%s/carrier", ifname);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (read(fd, &c, 1) != 1) {
+        c = '0';
+    }
+    close(fd);
+    return c == '1';
+}
+
+/*
+ * Read the carrier of every switch link and flip forwarding to the
+ * matching precomputed state. Runs on the link poller and on LSC
+ * interrupts. The kernel is asked rather than the PMD: AF_PACKET and
+ * AF_XDP report their link as always up.
+ */
+static void link_check(void)
+{
+    struct port_failover *pf = &ctx.failover;
+    uint32_t mask = 0, changed;
+    
+    pthread_mutex_lock(&ctx.link_lock);
+    for (uint16_t l = 0; l < pf->nb_links; l++) {
+        if (veth_carrier(port_name(pf->link_ports[l]))) {
+            mask |= 1u << l;
+        }
+    }
+    changed = port_failover_set_links(pf, mask);
+    pthread_mutex_unlock(&ctx.link_lock);
+    
+    for (uint16_t l = 0; l < pf->nb_links; l++) {
+        uint16_t pid = pf->link_ports[l];
+        
+        if (!(changed & (1u << l))) {
+            continue;
+        }
+        if (mask & (1u << l)) {
+            printf("Link %s (port %u) up\n", port_name(pid), pid);
+        } else if (pf->backup[pid] >= 0) {
+            printf("Link %s (port %u) down, its traffic goes through port %d\n",
+                   port_name(pid), pid, pf->backup[pid]);
+        } else {
+            printf("Link %s (port %u) down\n", port_name(pid), pid);
+        }
+        fflush(stdout);
+    }
+}
+
+/* LSC interrupt: re-read every link, not just the one that changed */
+static int link_event(uint16_t port_id __rte_unused, enum rte_eth_event_type type __rte_unused,
+                      void *arg __rte_unused, void *ret_param __rte_unused)
+{
+    link_check();
+    return 0;
+}
+
+/* Poll carrier for PMDs without LSC interrupts, e.g. AF_PACKET and AF_XDP */
+static uint32_t link_monitor_main(void *arg __rte_unused)
+{
+    const struct timespec interval = {
+        .tv_sec = ctx.link_poll_us / US_PER_S,
+        .tv_nsec = (long)(ctx.link_poll_us % US_PER_S) * 1000,
+    };
+    
+    while (!force_quit) {
+        link_check();
+        nanosleep(&interval, NULL);
+    }
+    return 0;
+}
+
+/* Telemetry /switch_veth/links: link state of the switch links and flips so far */
+static int telemetry_links(const char *cmd __rte_unused, const char *params __rte_unused,
+                           struct rte_tel_data *d)
+{
+    const struct port_failover *pf = &ctx.failover;
+    uint32_t mask = __atomic_load_n(&pf->link_mask, __ATOMIC_RELAXED);
+    
+    rte_tel_data_start_dict(d);
+    for (uint16_t l = 0; l < pf->nb_links; l++) {
+        rte_tel_data_add_dict_uint(d, port_name(pf->link_ports[l]), (mask >> l) & 1);
+    }
+    rte_tel_data_add_dict_uint(d, "flips", pf->flips);
+    return 0;
+}
+
+/*
+ * Start following link state: one check now, then LSC interrupts where
+ * the PMD raises them and a poller for the others
+ */
+static int start_link_monitor(void)
+{
+    int ret;
+    
+    pthread_mutex_init(&ctx.link_lock, NULL);
+    link_check();
+    rte_telemetry_register_cmd("/switch_veth/links", telemetry_links,
+        "Link state of the switch links. No parameters");
+    if (ctx.failover.nb_links == 0 || ctx.link_poll_us == 0) {
+        return 0;
+    }
+    
+    ret = rte_thread_create_control(&ctx.link_thread, "veth-link-mon", link_monitor_main, NULL);
+    if (ret != 0) {
+        return -ret;
+    }
+    ctx.link_thread_running = true;
+    printf("Polling link state every %u us\n", ctx.link_poll_us);
+    return 0;
+}
+
+/* Whether the PMD lacks a queue pair per lcore, so RX is spread in software */
+static bool port_needs_sw_rss(const struct rte_eth_dev_info *dev_info)
+{
+    return ctx.force_sw_rss ||
+           dev_info->max_rx_queues < ctx.nb_lcores || dev_info->max_tx_queues < ctx.nb_lcores;
+}
+
+/* Whether frames of the MTU span several mbufs and the PMD can chain them */
+static bool port_can_scatter(const struct rte_eth_dev_info *dev_info)
+{
+    return mbuf_pool_needs_scatter(mbuf_pool_frame_len(ctx.mtu)) &&
+           (dev_info->rx_offload_capa & RTE_ETH_RX_OFFLOAD_SCATTER);
+}
+
+/*
+ * Size one pool per socket for everything that can hold mbufs at once:
+ * the descriptor rings of its ports, software RSS rings, and per lcore an
+ * RX burst plus a TX buffer per port. Flooding takes references instead
+ * of copies and needs no extra mbufs. Under AF_XDP the pool backs the
+ * UMEM, whose RX rings are filled up front, which the same count covers.
+ *
+ * Ports that can scatter receive jumbo frames into chained mbufs; for any
+ * other, the pool's buffers are sized for a whole frame. If one port
+ * scatters and another cannot send chained mbufs, received chains are
+ * linearized.
+ *
+ * With GRO, an lcore also holds the segments of one packet while GSO cuts
+ * it, and a TX descriptor may pin a segment header as well as the merged
+ * packet it references. GRO is turned off again if a port cannot send the
+ * chains it builds.
+ */
+static int create_mbuf_pools(void)
+{
+    char pool_name[16];
+    bool any_scatter = false, all_multi_seg = true;
+    uint32_t per_lcore = MAX_PKT_BURST * (ctx.num_ports + 1);
+    uint16_t nb_tx_desc = TX_RING_SIZE;
+    int ret;
+    
+    if (ctx.gro) {
+        per_lcore += SW_GSO_MAX_SEGS;
+        nb_tx_desc *= 2;
+    }
+    mbuf_pools_init(&ctx.pools, ctx.nb_lcores, per_lcore, mbuf_pool_frame_len(ctx.mtu));
+    for (int i = 0; i < ctx.num_ports; i++) {
+        uint16_t pid = ctx.ports[i].port_id;
+        struct rte_eth_dev_info dev_info;
+        uint16_t nb_queues = ctx.nb_lcores;
+        uint32_t ring_slots = 0;
+        
+        if (rte_eth_dev_info_get(pid, &dev_info) != 0) {
+            continue;
+        }
+        if (port_needs_sw_rss(&dev_info)) {
+            nb_queues = 1;
+            ring_slots = (ctx.nb_lcores + 1) * SW_RSS_RING_SIZE;
+        }
+        ctx.ports[i].scatter = port_can_scatter(&dev_info);
+        any_scatter |= ctx.ports[i].scatter;
+        all_multi_seg &= (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS) != 0;
+        ret = mbuf_pools_add_port(&ctx.pools, pid, nb_queues, RX_RING_SIZE, nb_tx_desc,
+                                  ring_slots, ctx.ports[i].scatter);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    ctx.tx_linearize = any_scatter && !all_multi_seg;
+    if (ctx.gro && !all_multi_seg) {
+        printf("Warning: a port cannot send chained mbufs, GRO disabled\n");
+        ctx.gro = false;
+    }
+    
+    snprintf(pool_name, sizeof(pool_name), "MBUF_%d", ctx.switch_id);
+    ret = mbuf_pools_create(&ctx.pools, pool_name);
+    if (ret == 0 && ctx.gro) {
+        ret = mbuf_pools_create_indirect(&ctx.pools, pool_name);
+    }
+    if (ret < 0) {
+        return ret;
+    }
+    rte_telemetry_register_cmd("/switch_veth/mempool", telemetry_mempool,
+        "Mbuf pool occupancy and RX allocation failures. No parameters");
+    return 0;
+}
+
 static int parse_args(int argc, char **argv)
 {
+    ctx.xdp_busy_budget = XDP_BUSY_BUDGET;
+    ctx.link_poll_us = LINK_POLL_US;
+    
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--switch-id") == 0 && i + 1 < argc) {
             ctx.switch_id = atoi(argv[i + 1]);
@@ -563,12 +1096,51 @@ static int parse_args(int argc, char **argv)
         } else if (strcmp(argv[i], "--num-switches") == 0 && i + 1 < argc) {
             ctx.num_switches = atoi(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "--lcores") == 0 && i + 1 < argc) {
+            ctx.nb_lcores = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--sw-rss") == 0) {
+            ctx.force_sw_rss = true;
+        } else if (strcmp(argv[i], "--rx-intr") == 0) {
+            ctx.rx_intr = true;
+        } else if (strcmp(argv[i], "--gro") == 0) {
+            ctx.gro = true;
+        } else if (strcmp(argv[i], "--link-poll-us") == 0 && i + 1 < argc) {
+            ctx.link_poll_us = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            ctx.backend = strcmp(argv[i + 1], "af_xdp") == 0 ? BACKEND_AF_XDP : BACKEND_AF_PACKET;
+            i++;
+        } else if (strcmp(argv[i], "--xdp-busy-budget") == 0 && i + 1 < argc) {
+            ctx.xdp_busy_budget = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            uint32_t mask;
+            
+            if (pkt_trace_parse_mask(argv[i + 1], &mask) < 0) {
+                printf("Warning: unknown trace event in '%s', tracing stays off\n", argv[i + 1]);
+            } else {
+                pkt_trace_set_mask(mask);
+            }
+            i++;
+        } else if (strcmp(argv[i], "--mtu") == 0 && i + 1 < argc) {
+            ctx.mtu = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+            strncpy(ctx.trace_file, argv[i + 1], sizeof(ctx.trace_file) - 1);
+            i++;
         }
     }
     
     if (ctx.switch_id == 0) ctx.switch_id = 1;
     if (ctx.topology[0] == '\0') strcpy(ctx.topology, "ring");
     if (ctx.num_switches == 0) ctx.num_switches = 3;
+    if (ctx.nb_lcores <= 0) ctx.nb_lcores = 1;
+    if (ctx.nb_lcores > MAX_LCORES) ctx.nb_lcores = MAX_LCORES;
+    if (ctx.mtu < RTE_ETHER_MIN_MTU || ctx.mtu > MAX_MTU) ctx.mtu = RTE_ETHER_MTU;
+    if (ctx.trace_file[0] == '\0') {
+        snprintf(ctx.trace_file, sizeof(ctx.trace_file), "trace_sw%d.bin", ctx.switch_id);
+    }
     
     return 0;
 }
@@ -579,6 +1151,9 @@ int main(int argc, char **argv)
     
     printf("DOCA Three Port Switch with veth Integration v2\n");
     
+    /* Before rte_eal_init so EAL threads inherit the mask */
+    veth_fdb_block_reload_signal();
+    
     parse_args(argc, argv);
     configure_ports();
     
@@ -592,17 +1167,11 @@ int main(int argc, char **argv)
     
     ret = init_eal_with_veth(argc, argv);
     
-    char pool_name[32];
-    snprintf(pool_name, sizeof(pool_name), "MBUF_POOL_%d", ctx.switch_id);
-    printf("DEBUG: Creating mbuf pool...\n"); 
-    fflush(stdout);
-    ctx.mbuf_pool = rte_pktmbuf_pool_create(pool_name, NUM_MBUFS,
-        MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
-    
-    if (ctx.mbuf_pool == NULL) {
-        rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
+    if ((unsigned int)ctx.nb_lcores > rte_lcore_count()) {
+        printf("Warning: only %u lcores available\n", rte_lcore_count());
+        ctx.nb_lcores = rte_lcore_count();
     }
-
+    
     uint16_t nb_ports = rte_eth_dev_count_avail();
     printf("DEBUG: Port count check\n"); 
     fflush(stdout);
@@ -670,6 +1239,12 @@ int main(int argc, char **argv)
         }
     }
     
+    char fdb_name[32];
+    snprintf(fdb_name, sizeof(fdb_name), "FDB_%d", ctx.switch_id);
+    if (veth_fdb_init(&ctx.fdb, fdb_name, ctx.nb_lcores, rte_socket_id()) < 0) {
+        rte_exit(EXIT_FAILURE, "Cannot create MAC table\n");
+    }
+    
     // NOW load the MAC table (after port_ids are assigned)
     char mac_table_file[256];
     snprintf(mac_table_file, sizeof(mac_table_file), 
@@ -677,39 +1252,153 @@ int main(int argc, char **argv)
     
     int loaded = load_mac_table_from_file(mac_table_file);
     if (loaded < 0) {
-        printf("Warning: No static MAC table loaded, will use MAC learning\n");
+        printf("Warning: No static MAC table loaded, will use MAC learning only\n");
     } else {
-        printf("Static MAC forwarding enabled - no broadcasting needed!\n");
+        printf("Static MAC entries loaded; unknown stations are learned dynamically\n");
     }
     fflush(stdout);
     
-    struct rte_eth_conf port_conf = {0};
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        ctx.lcores[w].worker_id = w;
+        if (pkt_trace_ring_init(&ctx.trace[w], w) < 0) {
+            rte_exit(EXIT_FAILURE, "Cannot allocate trace ring\n");
+        }
+        ctx.lcores[w].trace = &ctx.trace[w];
+    }
+    register_trace_commands();
+    
+    if (create_mbuf_pools() < 0) {
+        rte_exit(EXIT_FAILURE, "Cannot create mbuf pools\n");
+    }
+    
+    // Segments go to any port; take their mbufs from the host port's socket
+    for (int w = 0; w < ctx.nb_lcores && ctx.gro; w++) {
+        int socket = rte_eth_dev_socket_id(ctx.ports[0].port_id);
+        
+        if (sw_gso_init(&ctx.lcores[w].gso, mbuf_pools_get(&ctx.pools, socket),
+                        mbuf_pools_get_indirect(&ctx.pools, socket), ctx.mtu, MAX_PKT_BURST) < 0) {
+            rte_exit(EXIT_FAILURE, "Cannot set up GRO/GSO\n");
+        }
+    }
+    if (ctx.gro) {
+        printf("GRO on host ports, GSO to %u-byte frames\n", ctx.lcores[0].gso.gso.gso_size);
+    }
+    
     for (int i = 0; i < ctx.num_ports; i++) {
         uint16_t pid = ctx.ports[i].port_id;
+        struct rte_eth_conf port_conf = {0};
+        struct rte_eth_dev_info dev_info;
+        uint16_t nb_queues = ctx.nb_lcores;
         
-        printf("Configuring port %u (veth: %s)...\n", pid, ctx.ports[i].veth_name);
+        printf("Configuring port %u (veth: %s, %s)...\n", pid, ctx.ports[i].veth_name,
+               ctx.ports[i].af_xdp ? "AF_XDP" : "AF_PACKET");
         fflush(stdout);
         
-        ret = rte_eth_dev_configure(pid, 1, 1, &port_conf);
+        ret = rte_eth_dev_info_get(pid, &dev_info);
+        if (ret != 0) {
+            printf("ERROR: Cannot get device info: err=%d, port=%u\n", ret, pid);
+            continue;
+        }
+        
+        // One queue pair per lcore if the PMD has them, otherwise spread in software
+        if (port_needs_sw_rss(&dev_info)) {
+            char rss_name[32];
+            
+            snprintf(rss_name, sizeof(rss_name), "RSS_%d_%u", ctx.switch_id, pid);
+            ret = sw_rss_port_init(&ctx.sw_rss[pid], rss_name, pid, ctx.nb_lcores,
+                                   rte_eth_dev_socket_id(pid));
+            if (ret < 0) {
+                printf("ERROR: Cannot create software RSS rings: err=%d, port=%u\n", ret, pid);
+                continue;
+            }
+            ctx.sw_rss_enabled[pid] = true;
+            nb_queues = 1;
+        } else if (nb_queues > 1 && dev_info.flow_type_rss_offloads != 0) {
+            port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+            port_conf.rx_adv_conf.rss_conf.rss_hf =
+                (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+        }
+        printf("  %u queue pair(s)%s\n", nb_queues,
+               ctx.sw_rss_enabled[pid] ? ", software RSS" : "");
+        
+        if (ctx.mtu > dev_info.max_mtu) {
+            printf("ERROR: MTU %u above the port's maximum %u, port=%u\n",
+                   ctx.mtu, dev_info.max_mtu, pid);
+            continue;
+        }
+        port_conf.rxmode.mtu = ctx.mtu;
+        if (ctx.ports[i].scatter) {
+            port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_SCATTER;
+        }
+        if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS) {
+            port_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+        }
+        if (ctx.ports[i].type == PORT_TYPE_SWITCH_LINK && (*dev_info.dev_flags & RTE_ETH_DEV_INTR_LSC)) {
+            port_conf.intr_conf.lsc = 1;
+        }
+        
+        if (ctx.rx_intr && !ctx.sw_rss_enabled[pid]) {
+            port_conf.intr_conf.rxq = 1;
+            ret = rte_eth_dev_configure(pid, nb_queues, nb_queues, &port_conf);
+            if (ret < 0) {
+                printf("  RX interrupts not supported (err=%d), polling only\n", ret);
+                port_conf.intr_conf.rxq = 0;
+            }
+            ctx.rx_intr_enabled[pid] = ret >= 0;
+        }
+        if (!ctx.rx_intr_enabled[pid]) {
+            ret = rte_eth_dev_configure(pid, nb_queues, nb_queues, &port_conf);
+        }
         if (ret < 0) {
             printf("ERROR: Cannot configure device: err=%d, port=%u\n", ret, pid);
             continue;
         }
         
-        ret = rte_eth_rx_queue_setup(pid, 0, RX_RING_SIZE,
-                rte_eth_dev_socket_id(pid), NULL, ctx.mbuf_pool);
+        // The kernel side of the veth drops frames above its own MTU
+        if (ctx.mtu != RTE_ETHER_MTU) {
+            ret = rte_eth_dev_set_mtu(pid, ctx.mtu);
+            if (ret < 0) {
+                printf("Warning: Cannot set interface MTU %u: err=%d, port=%u\n",
+                       ctx.mtu, ret, pid);
+            }
+        }
+        
+        for (uint16_t q = 0; q < nb_queues && ret >= 0; q++) {
+            ret = rte_eth_rx_queue_setup(pid, q, RX_RING_SIZE,
+                    rte_eth_dev_socket_id(pid), NULL,
+                    mbuf_pools_get(&ctx.pools, rte_eth_dev_socket_id(pid)));
+        }
         if (ret < 0) {
             printf("ERROR: rte_eth_rx_queue_setup: err=%d, port=%u\n", ret, pid);
             continue;
         }
         
-        ret = rte_eth_tx_queue_setup(pid, 0, TX_RING_SIZE,
-                rte_eth_dev_socket_id(pid), NULL);
+        for (uint16_t q = 0; q < nb_queues && ret >= 0; q++) {
+            ret = rte_eth_tx_queue_setup(pid, q, TX_RING_SIZE,
+                    rte_eth_dev_socket_id(pid), NULL);
+        }
         if (ret < 0) {
             printf("ERROR: rte_eth_tx_queue_setup: err=%d, port=%u\n", ret, pid);
             continue;
         }
         
+        for (int w = 0; w < ctx.nb_lcores && ret >= 0; w++) {
+            struct lcore_conf *lc = &ctx.lcores[w];
+            
+            lc->tx_buffer[pid] = rte_zmalloc_socket("tx_buffer", RTE_ETH_TX_BUFFER_SIZE(MAX_PKT_BURST),
+                                                    0, rte_eth_dev_socket_id(pid));
+            if (lc->tx_buffer[pid] == NULL) {
+                ret = -ENOMEM;
+                break;
+            }
+            rte_eth_tx_buffer_init(lc->tx_buffer[pid], MAX_PKT_BURST);
+            rte_eth_tx_buffer_set_err_callback(lc->tx_buffer[pid], tx_drop_unsent, lc);
+        }
+        if (ret < 0) {
+            printf("ERROR: Cannot allocate TX buffer, port=%u\n", pid);
+            continue;
+        }
+        
         ret = rte_eth_dev_start(pid);
         if (ret < 0) {
             printf("ERROR: rte_eth_dev_start: err=%d, port=%u\n", ret, pid);
@@ -721,11 +1410,22 @@ int main(int argc, char **argv)
             printf("Warning: Cannot enable promiscuous mode: err=%d, port=%u\n", ret, pid);
         }
         
+        if (port_conf.intr_conf.lsc) {
+            rte_eth_dev_callback_register(pid, RTE_ETH_EVENT_INTR_LSC, link_event, NULL);
+        }
+        
         ctx.ports[i].configured = true;
         printf("Port %u started successfully\n", pid);
         fflush(stdout);
     }
     
+    if (build_failover() < 0) {
+        rte_exit(EXIT_FAILURE, "Cannot set up link failover\n");
+    }
+    if (start_link_monitor() < 0) {
+        printf("Warning: Cannot start link monitor, failover follows LSC interrupts only\n");
+    }
+    
     printf("DEBUG: Setting up signal handlers...\n"); 
     fflush(stdout);
     signal(SIGINT, signal_handler);
@@ -736,7 +1436,22 @@ int main(int argc, char **argv)
     
     printf("DEBUG: Entering main loop...\n"); 
     fflush(stdout);
-    main_loop();
+    
+    // Worker 0 runs on the main lcore, the others on the remaining EAL lcores
+    unsigned int lcore_id;
+    int w = 1;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        if (w >= ctx.nb_lcores) {
+            break;
+        }
+        rte_eal_remote_launch(main_loop, &ctx.lcores[w], lcore_id);
+        w++;
+    }
+    main_loop(&ctx.lcores[UPDATER_LCORE]);
+    rte_eal_mp_wait_lcore();
+    if (ctx.link_thread_running) {
+        rte_thread_join(ctx.link_thread, NULL);
+    }
     
     printf("\nStopping switch %d...\n", ctx.switch_id);
     for (int i = 0; i < ctx.num_ports; i++) {
@@ -752,14 +1467,91 @@ int main(int argc, char **argv)
     }
     
     printf("\nSwitch %d statistics:\n", ctx.switch_id);
+    uint64_t dropped = 0, flooded = 0, learn_posted = 0, learn_dropped = 0;
     for (int i = 0; i < ctx.num_ports; i++) {
+        uint16_t pid = ctx.ports[i].port_id;
+        uint64_t rx = 0, tx = 0;
+        
         if (!ctx.ports[i].configured) continue;
-        printf("  Port %u (%s):\n", ctx.ports[i].port_id, ctx.ports[i].veth_name);
-        printf("    RX: %lu packets\n", ctx.rx_packets[ctx.ports[i].port_id]);
-        printf("    TX: %lu packets\n", ctx.tx_packets[ctx.ports[i].port_id]);
+        for (int w = 0; w < ctx.nb_lcores; w++) {
+            rx += ctx.lcores[w].rx_packets[pid];
+            tx += ctx.lcores[w].tx_packets[pid];
+        }
+        printf("  Port %u (%s):\n", pid, ctx.ports[i].veth_name);
+        printf("    RX: %lu packets\n", rx);
+        printf("    TX: %lu packets\n", tx);
+        if (ctx.sw_rss_enabled[pid]) {
+            dropped += ctx.sw_rss[pid].rx_dropped + ctx.sw_rss[pid].tx_dropped;
+        }
+    }
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        dropped += ctx.lcores[w].dropped_packets;
+        flooded += ctx.lcores[w].flooded_packets;
+        learn_posted += ctx.fdb.readers[w].learn_posted;
+        learn_dropped += ctx.fdb.readers[w].learn_dropped;
+    }
+    printf("  Dropped: %lu packets\n", dropped);
+    printf("  Flooded: %lu packets\n", flooded);
+    printf("  MAC entries learned: %lu, moved: %lu, aged: %lu (table full: %lu)\n",
+           ctx.fdb.learned, ctx.fdb.moved, ctx.fdb.aged, ctx.fdb.table_full);
+    printf("  Learn requests posted: %lu, dropped: %lu\n", learn_posted, learn_dropped);
+    printf("  Link state changes: %lu\n", ctx.failover.flips);
+    if (ctx.gro) {
+        uint64_t gro_in = 0, gro_out = 0, gso_in = 0, gso_out = 0, gso_failed = 0;
+        
+        for (int w = 0; w < ctx.nb_lcores; w++) {
+            const struct sw_gso *g = &ctx.lcores[w].gso;
+            
+            gro_in += g->gro_in;
+            gro_out += g->gro_out;
+            gso_in += g->gso_in;
+            gso_out += g->gso_out;
+            gso_failed += g->gso_failed;
+        }
+        printf("  GRO: %lu TCP packets merged into %lu\n", gro_in, gro_out);
+        printf("  GSO: %lu packets cut into %lu segments (%lu failed)\n",
+               gso_in, gso_out, gso_failed);
+    }
+    mbuf_pools_print(&ctx.pools);
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        const struct lcore_idle *idle = &ctx.lcores[w].idle;
+        double idle_pct, asleep_pct;
+        
+        lcore_idle_ratio(idle, &idle_pct, &asleep_pct);
+        printf("  Worker %d: idle polls %.1f%%, asleep %.1f%% (%lu sleeps, %lu interrupt waits)\n",
+               w, idle_pct, asleep_pct, idle->sleeps, idle->intr_waits);
+    }
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        uint16_t pid = ctx.ports[i].port_id;
+        
+        if (ctx.sw_rss_enabled[pid]) {
+            sw_rss_port_free(&ctx.sw_rss[pid]);
+        }
+        for (int w = 0; w < ctx.nb_lcores; w++) {
+            rte_free(ctx.lcores[w].tx_buffer[pid]);
+        }
+    }
+    
+    // Keep whatever was traced for pkt_trace_decode
+    uint64_t traced = 0;
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        traced += ctx.trace[w].head;
     }
-    printf("  Dropped: %lu packets\n", ctx.dropped_packets);
-    printf("  MAC entries learned: %lu\n", ctx.mac_learned);
+    if (traced > 0) {
+        ret = pkt_trace_dump(ctx.trace_file, ctx.trace, ctx.nb_lcores, ctx.switch_id);
+        if (ret < 0) {
+            printf("Warning: cannot write trace %s: %s\n", ctx.trace_file, strerror(-ret));
+        } else {
+            printf("Wrote %d trace records to %s\n", ret, ctx.trace_file);
+        }
+    }
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        pkt_trace_ring_free(&ctx.trace[w]);
+    }
+    
+    veth_fdb_reload_thread_stop(&ctx.fdb);
+    veth_fdb_free(&ctx.fdb);
     
     rte_eal_cleanup();
     
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <unistd.h>
@@ -15,44 +16,59 @@
 
 #include <rte_eal.h>
 #include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
 #include <rte_mbuf.h>
 #include <rte_ether.h>
 #include <rte_ip.h>
 #include <rte_cycles.h>
+#include <rte_prefetch.h>
+#include <rte_telemetry.h>
+
+#include "net_checksum.h"
+#include "veth_fdb.h"
+#include "sw_rss.h"
+#include "qos_sched.h"
+#include "pkt_meta.h"
+#include "lcore_idle.h"
+#include "switch_stats.h"
+#include "mbuf_pool.h"
 
 #define MAX_PORTS 3
-#define MAC_TABLE_SIZE 1024
+#define MAX_LCORES VETH_FDB_MAX_READERS
+#define UPDATER_LCORE 0  /* Worker that also runs the FDB updater */
 #define MAX_PKT_BURST 32
-#define MEMPOOL_CACHE_SIZE 256
-#define NUM_MBUFS 8191
-#define NB_QOS_QUEUES 8
-#define QOS_QUEUE_SIZE 512
-
-struct qos_queue {
-    struct rte_mbuf *packets[QOS_QUEUE_SIZE];
-    uint16_t head;
-    uint16_t tail;
-    uint16_t count;
-    uint8_t priority;
-    uint64_t enqueued;
-    uint64_t dequeued;
-    uint64_t dropped;
-};
+#define RX_RING_SIZE 256
+#define TX_RING_SIZE 256
+#define MAX_MTU 9600
+#define AF_PACKET_FRAME_HDR 128     /* TPACKET header and sockaddr before the frame */
+#define NB_QOS_QUEUES QOS_SCHED_NB_CLASSES
+#define STATS_PUBLISH_MS 100        /* Shared-memory counter refresh */
+#define STATS_DISPLAY_SEC 10
 
 struct port_config {
     uint16_t port_id;
     char veth_name[64];
     bool configured;
     enum { PORT_TYPE_HOST, PORT_TYPE_SWITCH_LINK } type;
-    struct qos_queue qos_queues[NB_QOS_QUEUES];
-    uint64_t qos_classified;
+    bool sw_rss_enabled;    /* PMD has fewer queue pairs than lcores */
+    struct sw_rss_port sw_rss;
+    bool rx_intr;           /* Configured with RX interrupts */
+    bool scatter;           /* Receives jumbo frames into chained mbufs */
 };
 
-struct mac_entry {
-    struct rte_ether_addr mac;
-    uint16_t port_id;
-    bool valid;
-};
+/* Per-forwarding-lcore state: worker w uses queue pair w of every port */
+struct lcore_conf {
+    uint16_t worker_id;     /* Also its FDB reader id */
+    struct qos_sched_port sched[MAX_PORTS];     /* By output port */
+    uint64_t rx_packets[MAX_PORTS];
+    uint64_t tx_packets[MAX_PORTS];
+    uint64_t tx_dropped[MAX_PORTS];
+    uint64_t dropped_packets;
+    uint64_t qos_total_classified;
+    uint64_t ttl_expired;
+    struct lcore_idle idle;
+} __rte_cache_aligned;
 
 struct switch_context {
     uint8_t switch_id;
@@ -60,18 +76,34 @@ struct switch_context {
     int num_switches;
     int num_ports;
     struct port_config ports[MAX_PORTS];
-    struct rte_mempool *mbuf_pool;
-    struct mac_entry mac_table[MAC_TABLE_SIZE];
-    uint64_t rx_packets[MAX_PORTS];
-    uint64_t tx_packets[MAX_PORTS];
-    uint64_t dropped_packets;
-    uint64_t qos_total_classified;
-    uint64_t ttl_expired;
+    int8_t port_idx[RTE_MAX_ETHPORTS];      /* DPDK port id to ports[] index, -1 if none */
+    struct mbuf_pools pools;    /* One per socket with ports */
+    struct veth_fdb fdb;
+    int nb_lcores;
+    bool force_sw_rss;
+    uint64_t port_rate_bps;     /* Egress shaping rate, 0 = line rate */
+    bool codel;                 /* CoDel AQM on the DRR classes */
+    bool rx_intr;               /* Wait for RX interrupts when idle */
+    uint16_t mtu;
+    bool tx_linearize;          /* A port cannot send chained mbufs */
+    struct lcore_conf lcores[MAX_LCORES];
+    struct switch_stats stats;  /* Shared-memory counters, NULL shm if unavailable */
     volatile bool force_quit;
 } ctx = {0};
 
+/* DSCP to class: EF and above 7, AF4x 6, AF3x 5, AF2x 4, AF1x 3, else 0 */
+static const uint8_t dscp_to_class[64] = {
+    [0 ... 7] = 0,
+    [8 ... 15] = 3,
+    [16 ... 23] = 4,
+    [24 ... 31] = 5,
+    [32 ... 45] = 6,
+    [46 ... 63] = 7,
+};
+
+/* DRR weights; class 7 (EF) is strict priority and has none */
 static const uint8_t queue_weights[NB_QOS_QUEUES] = {
-    1, 2, 4, 8, 16, 32, 64, 128
+    1, 2, 4, 8, 16, 32, 64, 0
 };
 
 static void signal_handler(int signum)
@@ -87,7 +119,9 @@ static int parse_args(int argc, char **argv)
 {
     int opt;
     
-    while ((opt = getopt(argc, argv, "s:t:n:")) != -1) {
+    ctx.nb_lcores = 1;
+    ctx.mtu = RTE_ETHER_MTU;
+    while ((opt = getopt(argc, argv, "s:t:n:c:rR:aim:")) != -1) {
         switch (opt) {
         case 's':
             ctx.switch_id = atoi(optarg);
@@ -98,11 +132,34 @@ static int parse_args(int argc, char **argv)
         case 'n':
             ctx.num_switches = atoi(optarg);
             break;
+        case 'c':
+            ctx.nb_lcores = atoi(optarg);
+            break;
+        case 'r':
+            ctx.force_sw_rss = true;
+            break;
+        case 'R':     /* Egress rate per port in Mbit/s */
+            ctx.port_rate_bps = strtoull(optarg, NULL, 10) * 1000000ULL;
+            break;
+        case 'a':
+            ctx.codel = true;
+            break;
+        case 'i':
+            ctx.rx_intr = true;
+            break;
+        case 'm':
+            ctx.mtu = atoi(optarg);
+            break;
         default:
             return -1;
         }
     }
     
+    if (ctx.nb_lcores < 1 || ctx.nb_lcores > MAX_LCORES)
+        return -1;
+    if (ctx.mtu < RTE_ETHER_MIN_MTU || ctx.mtu > MAX_MTU)
+        return -1;
+    
     return (ctx.switch_id > 0 && ctx.num_switches > 0 && strlen(ctx.topology) > 0) ? 0 : -1;
 }
 
@@ -156,6 +213,16 @@ static void configure_ports(void)
     }
 }
 
+/* AF_PACKET ring frames hold a whole packet; blocks a frame and a page */
+static uint32_t af_packet_framesz(void)
+{
+    uint32_t framesz = 2048;
+    
+    while (framesz < mbuf_pool_frame_len(ctx.mtu) + AF_PACKET_FRAME_HDR)
+        framesz <<= 1;
+    return framesz;
+}
+
 static int init_eal_with_veth(int argc, char **argv)
 {
     char *eal_argv[64];
@@ -165,7 +232,8 @@ static int init_eal_with_veth(int argc, char **argv)
     
     eal_argv[eal_argc++] = argv[0];
     eal_argv[eal_argc++] = "-l";
-    snprintf(lcore, sizeof(lcore), "%d", ctx.switch_id % 8);
+    snprintf(lcore, sizeof(lcore), "%d-%d", (ctx.switch_id % 8) * ctx.nb_lcores,
+             (ctx.switch_id % 8) * ctx.nb_lcores + ctx.nb_lcores - 1);
     eal_argv[eal_argc++] = lcore;
     eal_argv[eal_argc++] = "--proc-type";
     eal_argv[eal_argc++] = "auto";
@@ -176,33 +244,155 @@ static int init_eal_with_veth(int argc, char **argv)
     eal_argv[eal_argc++] = "--no-pci";
     
     /* Create vdevs in the SAME ORDER as port configuration */
+    uint32_t framesz = af_packet_framesz();
+    
     for (int i = 0; i < ctx.num_ports; i++) {
         snprintf(vdev_args[i], sizeof(vdev_args[i]),
-                 "--vdev=net_af_packet%d,iface=%s,blocksz=4096,framesz=2048,framecnt=512,qdisc_bypass=0",
-                 i, ctx.ports[i].veth_name);
+                 "--vdev=net_af_packet%d,iface=%s,qpairs=%d,blocksz=%u,framesz=%u,framecnt=512,qdisc_bypass=0",
+                 i, ctx.ports[i].veth_name, ctx.nb_lcores,
+                 framesz > 4096 ? framesz : 4096, framesz);
         eal_argv[eal_argc++] = vdev_args[i];
     }
     
     return rte_eal_init(eal_argc, eal_argv);
 }
 
+/* Whether the PMD lacks a queue pair per lcore, so RX is spread in software */
+static bool port_needs_sw_rss(const struct rte_eth_dev_info *dev_info)
+{
+    return ctx.force_sw_rss ||
+           dev_info->max_rx_queues < ctx.nb_lcores || dev_info->max_tx_queues < ctx.nb_lcores;
+}
+
+/* Whether frames of the MTU span several mbufs and the PMD can chain them */
+static bool port_can_scatter(const struct rte_eth_dev_info *dev_info)
+{
+    return mbuf_pool_needs_scatter(mbuf_pool_frame_len(ctx.mtu)) &&
+           (dev_info->rx_offload_capa & RTE_ETH_RX_OFFLOAD_SCATTER);
+}
+
+/* Telemetry /switch_qos/mempool: occupancy and RX allocation failures per pool */
+static int telemetry_mempool(const char *cmd __rte_unused, const char *params __rte_unused,
+                             struct rte_tel_data *d)
+{
+    return mbuf_pools_telemetry(&ctx.pools, d);
+}
+
+/*
+ * Size one pool per socket for everything that can hold mbufs at once:
+ * the descriptor rings of its ports, software RSS rings, and per lcore an
+ * RX burst plus a full set of class queues on every output port.
+ * Jumbo frames are chained on ports that can scatter and fill one large
+ * buffer on the others; chains are linearized if a port cannot send them.
+ */
+static int create_mbuf_pools(void)
+{
+    char pool_name[16];
+    bool any_scatter = false, all_multi_seg = true;
+    int ret;
+    
+    mbuf_pools_init(&ctx.pools, ctx.nb_lcores,
+                    MAX_PKT_BURST + ctx.num_ports * NB_QOS_QUEUES * QOS_SCHED_QUEUE_SIZE,
+                    mbuf_pool_frame_len(ctx.mtu));
+    for (int i = 0; i < ctx.num_ports; i++) {
+        struct rte_eth_dev_info dev_info;
+        uint16_t nb_queues = ctx.nb_lcores;
+        uint32_t ring_slots = 0;
+        
+        if (rte_eth_dev_info_get(ctx.ports[i].port_id, &dev_info) != 0)
+            return -ENODEV;
+        if (port_needs_sw_rss(&dev_info)) {
+            nb_queues = 1;
+            ring_slots = (ctx.nb_lcores + 1) * SW_RSS_RING_SIZE;
+        }
+        ctx.ports[i].scatter = port_can_scatter(&dev_info);
+        any_scatter |= ctx.ports[i].scatter;
+        all_multi_seg &= (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS) != 0;
+        ret = mbuf_pools_add_port(&ctx.pools, ctx.ports[i].port_id, nb_queues,
+                                  RX_RING_SIZE, TX_RING_SIZE, ring_slots, ctx.ports[i].scatter);
+        if (ret < 0)
+            return ret;
+    }
+    ctx.tx_linearize = any_scatter && !all_multi_seg;
+    
+    snprintf(pool_name, sizeof(pool_name), "MBUF_SW%d", ctx.switch_id);
+    ret = mbuf_pools_create(&ctx.pools, pool_name);
+    if (ret < 0)
+        return ret;
+    rte_telemetry_register_cmd("/switch_qos/mempool", telemetry_mempool,
+                               "Mbuf pool occupancy and RX allocation failures. No parameters");
+    return 0;
+}
+
 static int init_port(uint16_t port_id)
 {
+    struct port_config *port = &ctx.ports[port_id];
     struct rte_eth_conf port_conf = {0};
+    struct rte_eth_dev_info dev_info;
+    uint16_t nb_queues = ctx.nb_lcores;
     int ret;
     
-    ret = rte_eth_dev_configure(port_id, 1, 1, &port_conf);
-    if (ret < 0) return ret;
+    ret = rte_eth_dev_info_get(port_id, &dev_info);
+    if (ret != 0) return ret;
     
-    ret = rte_eth_rx_queue_setup(port_id, 0, 256,
-                                  rte_eth_dev_socket_id(port_id),
-                                  NULL, ctx.mbuf_pool);
-    if (ret < 0) return ret;
+    /* One queue pair per lcore if the PMD has them, otherwise spread in software */
+    if (port_needs_sw_rss(&dev_info)) {
+        char name[32];
+        
+        snprintf(name, sizeof(name), "RSS_SW%d_%u", ctx.switch_id, port_id);
+        ret = sw_rss_port_init(&port->sw_rss, name, port_id, ctx.nb_lcores,
+                               rte_eth_dev_socket_id(port_id));
+        if (ret < 0) return ret;
+        port->sw_rss_enabled = true;
+        nb_queues = 1;
+    } else if (nb_queues > 1 && dev_info.flow_type_rss_offloads != 0) {
+        port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+        port_conf.rx_adv_conf.rss_conf.rss_hf =
+            (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+    }
     
-    ret = rte_eth_tx_queue_setup(port_id, 0, 256,
-                                  rte_eth_dev_socket_id(port_id),
-                                  NULL);
-    if (ret < 0) return ret;
+    if (ctx.mtu > dev_info.max_mtu) {
+        printf("[Switch %d] Port %u: MTU %u above its maximum %u\n",
+               ctx.switch_id, port_id, ctx.mtu, dev_info.max_mtu);
+        return -EINVAL;
+    }
+    port_conf.rxmode.mtu = ctx.mtu;
+    if (port->scatter)
+        port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_SCATTER;
+    if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS)
+        port_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+    
+    if (ctx.rx_intr && !port->sw_rss_enabled) {
+        port_conf.intr_conf.rxq = 1;
+        ret = rte_eth_dev_configure(port_id, nb_queues, nb_queues, &port_conf);
+        port->rx_intr = ret >= 0;
+        if (ret < 0) {
+            printf("[Switch %d] Port %u: no RX interrupts (err=%d), polling only\n",
+                   ctx.switch_id, port_id, ret);
+            port_conf.intr_conf.rxq = 0;
+        }
+    }
+    if (!port->rx_intr) {
+        ret = rte_eth_dev_configure(port_id, nb_queues, nb_queues, &port_conf);
+        if (ret < 0) return ret;
+    }
+    
+    /* The kernel side of the veth drops frames above its own MTU */
+    if (ctx.mtu != RTE_ETHER_MTU && rte_eth_dev_set_mtu(port_id, ctx.mtu) < 0)
+        printf("[Switch %d] Port %u: cannot set interface MTU %u\n",
+               ctx.switch_id, port_id, ctx.mtu);
+    
+    for (uint16_t q = 0; q < nb_queues; q++) {
+        ret = rte_eth_rx_queue_setup(port_id, q, RX_RING_SIZE,
+                                      rte_eth_dev_socket_id(port_id), NULL,
+                                      mbuf_pools_get(&ctx.pools, rte_eth_dev_socket_id(port_id)));
+        if (ret < 0) return ret;
+        
+        ret = rte_eth_tx_queue_setup(port_id, q, TX_RING_SIZE,
+                                      rte_eth_dev_socket_id(port_id),
+                                      NULL);
+        if (ret < 0) return ret;
+    }
     
     ret = rte_eth_dev_start(port_id);
     if (ret < 0) return ret;
@@ -211,244 +401,428 @@ static int init_port(uint16_t port_id)
     return 0;
 }
 
-static void init_qos_queues(struct port_config *port)
+/*
+ * Per-class DRR quantum: weight full-size frames per round. Every lcore
+ * schedules its own share of a port, so the port rate is split among them.
+ */
+static void init_qos_queues(struct qos_sched_port *sched)
 {
-    for (int i = 0; i < NB_QOS_QUEUES; i++) {
-        port->qos_queues[i].head = 0;
-        port->qos_queues[i].tail = 0;
-        port->qos_queues[i].count = 0;
-        port->qos_queues[i].priority = i;
-        port->qos_queues[i].enqueued = 0;
-        port->qos_queues[i].dequeued = 0;
-        port->qos_queues[i].dropped = 0;
-    }
+    uint32_t max_frame = RTE_MAX(mbuf_pool_frame_len(ctx.mtu), (uint32_t)QOS_SCHED_MTU);
+    uint32_t quanta[NB_QOS_QUEUES];
+    
+    for (int i = 0; i < NB_QOS_QUEUES; i++)
+        quanta[i] = queue_weights[i] * max_frame;
+    qos_sched_port_init(sched, quanta, ctx.port_rate_bps / ctx.nb_lcores,
+                        rte_get_tsc_hz(), max_frame);
+    
+    /* EF traffic is policed by its sources, not by drops */
+    if (ctx.codel)
+        qos_sched_set_codel(sched, ~(1u << QOS_SCHED_EF_CLASS) & 0xFF,
+                            QOS_SCHED_CODEL_TARGET_US, QOS_SCHED_CODEL_INTERVAL_US);
 }
 
+/* Load the static MAC table; SIGHUP reloads it without stopping traffic */
 static int load_mac_table_from_file(const char *filename)
 {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) return -1;
+    uint16_t port_ids[MAX_PORTS];
+    int count;
     
-    char line[256];
-    int count = 0;
+    for (int i = 0; i < ctx.num_ports; i++)
+        port_ids[i] = ctx.ports[i].port_id;
     
-    while (fgets(line, sizeof(line), fp)) {
-        if (line[0] == '#') continue;
-            
-        unsigned int mac[6];
-        int port_idx;
-        
-        if (sscanf(line, "%x:%x:%x:%x:%x:%x %d",
-                   &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5],
-                   &port_idx) == 7) {
-            
-            if (port_idx >= ctx.num_ports) continue;
-            
-            uint32_t hash = (mac[5] + (mac[4] << 8)) % MAC_TABLE_SIZE;
-            
-            for (int i = 0; i < 6; i++)
-                ctx.mac_table[hash].mac.addr_bytes[i] = (uint8_t)mac[i];
-            
-            if (ctx.ports[port_idx].configured) {
-                ctx.mac_table[hash].port_id = ctx.ports[port_idx].port_id;
-                ctx.mac_table[hash].valid = true;
-                count++;
-            }
-        }
-    }
+    count = veth_fdb_reload(&ctx.fdb, filename, port_ids, ctx.num_ports);
+    if (count >= 0)
+        printf("[Switch %d] Loaded %d MAC entries\n", ctx.switch_id, count);
     
-    fclose(fp);
-    printf("[Switch %d] Loaded %d MAC entries\n", ctx.switch_id, count);
-    return 0;
+    veth_fdb_reload_thread_start(&ctx.fdb, filename, port_ids, ctx.num_ports);
+    return count < 0 ? -1 : 0;
 }
 
-static uint8_t extract_qos_priority(struct rte_mbuf *m)
+/* Receive a burst from this lcore's share of a port */
+static uint16_t rx_port(struct lcore_conf *lc, uint16_t port_idx, struct rte_mbuf **pkts)
 {
-    struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-    uint16_t eth_type = rte_be_to_cpu_16(eth->ether_type);
-    
-    if (eth_type == RTE_ETHER_TYPE_IPV4) {
-        struct rte_ipv4_hdr *ip = (struct rte_ipv4_hdr *)(eth + 1);
-        uint8_t dscp = (ip->type_of_service >> 2) & 0x3F;
-        return (dscp >= 46) ? 7 : (dscp >= 32) ? 6 : (dscp >= 24) ? 5 :
-               (dscp >= 16) ? 4 : (dscp >= 8) ? 3 : 0;
-    }
-    return 0;
-}
-
-static int qos_enqueue(struct qos_queue *q, struct rte_mbuf *m)
-{
-    if (q->count >= QOS_QUEUE_SIZE) {
-        q->dropped++;
-        rte_pktmbuf_free(m);
-        return -1;
+    struct port_config *port = &ctx.ports[port_idx];
+    
+    if (!port->sw_rss_enabled)
+        return rte_eth_rx_burst(port->port_id, lc->worker_id, pkts, MAX_PKT_BURST);
+    
+    /* The updater lcore owns queue 0 of software RSS ports */
+    if (lc->worker_id == UPDATER_LCORE) {
+        uint16_t nb_rx = rte_eth_rx_burst(port->port_id, 0, pkts, MAX_PKT_BURST);
+        
+        uint16_t nb_tx;
+        
+        if (nb_rx > 0)
+            sw_rss_distribute(&port->sw_rss, pkts, nb_rx);
+        nb_tx = sw_rss_tx_drain(&port->sw_rss);
+        lc->tx_packets[port_idx] += nb_tx;
+        lcore_idle_work(&lc->idle, nb_rx + nb_tx);
     }
-    q->packets[q->tail] = m;
-    q->tail = (q->tail + 1) % QOS_QUEUE_SIZE;
-    q->count++;
-    q->enqueued++;
-    return 0;
+    return sw_rss_rx(&port->sw_rss, lc->worker_id, pkts, MAX_PKT_BURST);
 }
 
-static struct rte_mbuf *qos_dequeue(struct qos_queue *q)
-{
-    if (q->count == 0) return NULL;
-    struct rte_mbuf *m = q->packets[q->head];
-    q->head = (q->head + 1) % QOS_QUEUE_SIZE;
-    q->count--;
-    q->dequeued++;
-    return m;
-}
-
-static uint16_t qos_schedule(struct port_config *port, struct rte_mbuf **pkts, uint16_t max_pkts)
+/*
+ * Classify a burst: learn sources, check and decrement IPv4 TTLs, map DSCP
+ * to a class and look up all destinations at once. Headers are prefetched
+ * for the whole burst and parsed once. Packets whose TTL expired or whose
+ * IPv4 checksum the PMD found bad get class -1.
+ */
+static void classify_burst(struct lcore_conf *lc, uint16_t port_idx,
+                           struct rte_mbuf **pkts, uint16_t nb,
+                           int8_t *cls, int *dst_ports)
 {
-    uint16_t nb_tx = 0;
-    uint8_t credits[NB_QOS_QUEUES];
-    memcpy(credits, queue_weights, sizeof(credits));
-    
-    bool done = false;
-    while (!done && nb_tx < max_pkts) {
-        done = true;
-        for (int i = NB_QOS_QUEUES - 1; i >= 0 && nb_tx < max_pkts; i--) {
-            if (credits[i] > 0 && port->qos_queues[i].count > 0) {
-                pkts[nb_tx] = qos_dequeue(&port->qos_queues[i]);
-                if (pkts[nb_tx]) {
-                    nb_tx++;
-                    credits[i]--;
-                    done = false;
-                }
-            }
+    const struct rte_ether_addr *dst_macs[MAX_PKT_BURST];
+    struct pkt_meta md[MAX_PKT_BURST];
+    uint16_t rx_port_id = ctx.ports[port_idx].port_id;
+    
+    for (uint16_t i = 0; i < nb; i++)
+        rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
+    
+    pkt_meta_parse_burst(pkts, nb, md);
+    
+    for (uint16_t i = 0; i < nb; i++) {
+        struct rte_ether_hdr *eth = rte_pktmbuf_mtod(pkts[i], struct rte_ether_hdr *);
+        struct rte_ipv4_hdr *ip = pkt_meta_ipv4(pkts[i], &md[i]);
+        
+        veth_fdb_learn(&ctx.fdb, lc->worker_id, &eth->src_addr, rx_port_id);
+        dst_macs[i] = &eth->dst_addr;
+        cls[i] = 0;
+        
+        if (!ip)
+            continue;
+        if (md[i].flags & PKT_META_L3_CKSUM_BAD) {
+            cls[i] = -1;
+            continue;
         }
+        if (ip->time_to_live <= 1) {
+            lc->ttl_expired++;
+            cls[i] = -1;
+            continue;
+        }
+        net_ipv4_dec_ttl((uint8_t *)ip);
+        cls[i] = dscp_to_class[ip->type_of_service >> 2];
     }
-    return nb_tx;
+    
+    veth_fdb_lookup_bulk(&ctx.fdb, dst_macs, nb, dst_ports);
 }
 
-static int process_packet_ttl(struct rte_mbuf *m)
+static void forward_packets_with_qos(struct lcore_conf *lc, uint16_t port_idx)
 {
-    struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-    uint16_t eth_type = rte_be_to_cpu_16(eth->ether_type);
+    struct rte_mbuf *pkts[MAX_PKT_BURST];
+    int8_t cls[MAX_PKT_BURST];
+    int dst_ports[MAX_PKT_BURST];
+    uint16_t nb_rx = rx_port(lc, port_idx, pkts);
+    uint64_t now;
     
-    if (eth_type == RTE_ETHER_TYPE_IPV4) {
-        struct rte_ipv4_hdr *ip = (struct rte_ipv4_hdr *)(eth + 1);
-        if (ip->time_to_live <= 1) {
-            ctx.ttl_expired++;
-            return 0;
+    if (nb_rx == 0) return;
+    
+    lc->rx_packets[port_idx] += nb_rx;
+    lcore_idle_work(&lc->idle, nb_rx);
+    now = rte_rdtsc();
+    
+    classify_burst(lc, port_idx, pkts, nb_rx, cls, dst_ports);
+    
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        int out_idx = dst_ports[i] >= 0 ? ctx.port_idx[dst_ports[i]] : -1;
+        
+        if (cls[i] < 0 || out_idx < 0 ||
+            (ctx.tx_linearize && pkts[i]->nb_segs > 1 && rte_pktmbuf_linearize(pkts[i]) < 0)) {
+            rte_pktmbuf_free(pkts[i]);
+            lc->dropped_packets++;
+            continue;
         }
-        ip->time_to_live--;
-        uint16_t cksum = ip->hdr_checksum + rte_cpu_to_be_16(0x0100);
-        if (cksum < ip->hdr_checksum) cksum++;
-        ip->hdr_checksum = cksum;
+        
+        lc->qos_total_classified++;
+        if (qos_sched_enqueue(&lc->sched[out_idx], cls[i], pkts[i], now) < 0)
+            lc->dropped_packets++;
     }
-    return 1;
 }
 
-static int lookup_mac(struct rte_ether_addr *mac, uint16_t *out_port_id)
+static void transmit_from_qos_queues(struct lcore_conf *lc, uint16_t port_idx)
 {
-    uint32_t hash = (mac->addr_bytes[5] + (mac->addr_bytes[4] << 8)) % MAC_TABLE_SIZE;
+    struct port_config *port = &ctx.ports[port_idx];
+    struct rte_mbuf *pkts[MAX_PKT_BURST];
+    uint16_t nb = qos_sched_dequeue_burst(&lc->sched[port_idx], pkts, MAX_PKT_BURST,
+                                          rte_rdtsc());
+    uint16_t nb_tx;
     
-    if (ctx.mac_table[hash].valid &&
-        rte_is_same_ether_addr(&ctx.mac_table[hash].mac, mac)) {
-        *out_port_id = ctx.mac_table[hash].port_id;
-        return 0;
+    /* Packets held back by the shaper keep the lcore from sleeping */
+    lcore_idle_work(&lc->idle, nb + (lc->sched[port_idx].active != 0));
+    if (nb == 0) return;
+    
+    if (port->sw_rss_enabled)
+        nb_tx = sw_rss_tx(&port->sw_rss, pkts, nb);
+    else
+        nb_tx = rte_eth_tx_burst(port->port_id, lc->worker_id, pkts, nb);
+    lc->tx_packets[port_idx] += nb_tx;
+    
+    for (uint16_t i = nb_tx; i < nb; i++) {
+        rte_pktmbuf_free(pkts[i]);
+        lc->tx_dropped[port_idx]++;
+        lc->dropped_packets++;
     }
-    return -1;
 }
 
-static int get_port_idx_by_dpdk_id(uint16_t dpdk_port_id)
+/*
+ * Use RX interrupts for idle waits only if every queue this lcore polls
+ * can raise one; software RSS rings cannot
+ */
+static void setup_rx_intr(struct lcore_conf *lc)
 {
+    if (!ctx.rx_intr)
+        return;
+    
     for (int i = 0; i < ctx.num_ports; i++) {
-        if (ctx.ports[i].configured && ctx.ports[i].port_id == dpdk_port_id)
-            return i;
+        struct port_config *port = &ctx.ports[i];
+        
+        if (!port->configured) continue;
+        if (!port->rx_intr ||
+            lcore_idle_add_rx_intr(&lc->idle, port->port_id, lc->worker_id) < 0) {
+            printf("[Switch %d] Worker %u: no RX interrupt on port %u, sleeping when idle instead\n",
+                   ctx.switch_id, lc->worker_id, port->port_id);
+            lc->idle.nb_intr_queues = 0;
+            return;
+        }
     }
-    return -1;
 }
 
-static void forward_packets_with_qos(uint16_t port_idx)
+/*
+ * Sum every lcore's counters into one snapshot. Other lcores' counters are
+ * read unlocked, so totals may lag slightly.
+ */
+static void collect_stats(struct switch_stats_counters *c)
 {
-    struct rte_mbuf *pkts[MAX_PKT_BURST];
-    uint16_t nb_rx = rte_eth_rx_burst(ctx.ports[port_idx].port_id, 0, pkts, MAX_PKT_BURST);
-    
-    if (nb_rx == 0) return;
+    double ns_per_cycle = 1e9 / rte_get_tsc_hz();
     
-    ctx.rx_packets[port_idx] += nb_rx;
+    memset(c, 0, sizeof(*c));
+    c->fdb_entries = ctx.fdb.count;
+    c->fdb_capacity = VETH_FDB_SIZE;
+    c->nb_ports = ctx.num_ports;
+    c->nb_lcores = ctx.nb_lcores;
     
-    for (uint16_t i = 0; i < nb_rx; i++) {
-        struct rte_ether_hdr *eth = rte_pktmbuf_mtod(pkts[i], struct rte_ether_hdr *);
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        const struct lcore_conf *lc = &ctx.lcores[w];
+        struct switch_stats_lcore *sl = &c->lcores[w];
         
-        if (!process_packet_ttl(pkts[i])) {
-            rte_pktmbuf_free(pkts[i]);
-            ctx.dropped_packets++;
-            continue;
+        for (int i = 0; i < ctx.num_ports; i++) {
+            const struct qos_sched_port *sched = &lc->sched[i];
+            struct switch_stats_port *sp = &c->ports[i];
+            
+            sp->rx_packets += lc->rx_packets[i];
+            sp->tx_packets += lc->tx_packets[i];
+            sp->tx_dropped += lc->tx_dropped[i];
+            sp->shaped += sched->shaped;
+            for (int q = 0; q < NB_QOS_QUEUES; q++) {
+                const struct qos_class_queue *cq = &sched->queues[q];
+                struct switch_stats_class *sc = &sp->classes[q];
+                uint64_t max_ns = cq->sojourn_max * ns_per_cycle;
+                
+                sc->enqueued += cq->enqueued;
+                sc->dequeued += cq->dequeued;
+                sc->tail_dropped += cq->dropped;
+                sc->aqm_dropped += cq->aqm_dropped;
+                sc->ecn_marked += cq->ecn_marked;
+                sc->backlog += cq->count;
+                sc->sojourn_sum_ns += cq->sojourn_sum * ns_per_cycle;
+                if (max_ns > sc->sojourn_max_ns)
+                    sc->sojourn_max_ns = max_ns;
+            }
+            c->forwarded += lc->tx_packets[i];
         }
+        c->qos_classified += lc->qos_total_classified;
+        c->dropped += lc->dropped_packets;
+        c->ttl_expired += lc->ttl_expired;
         
-        uint8_t qos = extract_qos_priority(pkts[i]);
-        ctx.qos_total_classified++;
+        sl->busy_polls = lc->idle.busy_polls;
+        sl->idle_polls = lc->idle.idle_polls;
+        sl->sleeps = lc->idle.sleeps;
+        sl->intr_waits = lc->idle.intr_waits;
+        sl->asleep_ns = lc->idle.sleep_tsc * ns_per_cycle;
+    }
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        const struct port_config *port = &ctx.ports[i];
+        struct switch_stats_port *sp = &c->ports[i];
         
-        uint16_t out_port_id;
-        if (lookup_mac(&eth->dst_addr, &out_port_id) != 0) {
-            rte_pktmbuf_free(pkts[i]);
-            ctx.dropped_packets++;
-            continue;
+        snprintf(sp->name, sizeof(sp->name), "%s", port->veth_name);
+        if (port->sw_rss_enabled) {
+            sp->rx_dropped = port->sw_rss.rx_dropped;
+            sp->tx_dropped += port->sw_rss.tx_dropped;
+            c->dropped += port->sw_rss.rx_dropped + port->sw_rss.tx_dropped;
         }
+    }
+}
+
+/* Queueing delay and AQM activity per class, over all ports */
+static void display_class_stats(const struct switch_stats_counters *c)
+{
+    for (int q = 0; q < NB_QOS_QUEUES; q++) {
+        uint64_t sent = 0, sum = 0, max = 0, full = 0, aqm = 0, ecn = 0;
         
-        int out_idx = get_port_idx_by_dpdk_id(out_port_id);
-        if (out_idx < 0 || qos_enqueue(&ctx.ports[out_idx].qos_queues[qos], pkts[i]) < 0) {
-            ctx.dropped_packets++;
+        for (uint32_t i = 0; i < c->nb_ports; i++) {
+            const struct switch_stats_class *sc = &c->ports[i].classes[q];
+            
+            sent += sc->dequeued - sc->aqm_dropped;
+            sum += sc->sojourn_sum_ns;
+            if (sc->sojourn_max_ns > max)
+                max = sc->sojourn_max_ns;
+            full += sc->tail_dropped;
+            aqm += sc->aqm_dropped;
+            ecn += sc->ecn_marked;
         }
+        if (sent == 0 && full == 0)
+            continue;
+        
+        printf("  Class %d: sojourn avg=%.1fus max=%.1fus TailDrop=%lu AQMDrop=%lu ECN=%lu\n",
+               q, sent ? sum / 1e3 / sent : 0.0, max / 1e3, full, aqm, ecn);
     }
 }
 
-static void transmit_from_qos_queues(uint16_t port_idx)
+static void display_stats(const struct switch_stats_counters *c)
 {
-    struct rte_mbuf *pkts[MAX_PKT_BURST];
-    uint16_t nb = qos_schedule(&ctx.ports[port_idx], pkts, MAX_PKT_BURST);
+    uint64_t rx = 0;
     
-    if (nb == 0) return;
+    for (uint32_t i = 0; i < c->nb_ports; i++)
+        rx += c->ports[i].rx_packets;
     
-    uint16_t nb_tx = rte_eth_tx_burst(ctx.ports[port_idx].port_id, 0, pkts, nb);
-    ctx.tx_packets[port_idx] += nb_tx;
-    
-    for (uint16_t i = nb_tx; i < nb; i++) {
-        rte_pktmbuf_free(pkts[i]);
-        ctx.dropped_packets++;
+    printf("\n[Switch %d] RX=%lu TX=%lu QoS=%lu Drop=%lu TTL=%lu MACs=%u\n",
+           ctx.switch_id, rx, c->forwarded, c->qos_classified, c->dropped,
+           c->ttl_expired, c->fdb_entries);
+    display_class_stats(c);
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        double idle_pct, asleep_pct;
+        
+        lcore_idle_ratio(&ctx.lcores[w].idle, &idle_pct, &asleep_pct);
+        printf("  Worker %d: idle polls %.1f%%, asleep %.1f%%\n", w, idle_pct, asleep_pct);
     }
+    mbuf_pools_print(&ctx.pools);
+    fflush(stdout);
 }
 
-static void display_stats(void)
+/*
+ * Publish a snapshot to shared memory every STATS_PUBLISH_MS and log it
+ * every STATS_DISPLAY_SEC; runs on the updater lcore only
+ */
+static void update_stats(void)
 {
-    static uint64_t last = 0;
+    static struct switch_stats_counters c;
+    static uint64_t last_publish = 0, last_display = 0;
     uint64_t now = rte_get_timer_cycles();
+    uint64_t hz = rte_get_timer_hz();
     
-    if ((now - last) < rte_get_timer_hz() * 10) return;
-    last = now;
+    if ((now - last_publish) < hz * STATS_PUBLISH_MS / 1000) return;
+    last_publish = now;
     
-    printf("\n[Switch %d] RX=%lu TX=%lu QoS=%lu Drop=%lu TTL=%lu\n",
-           ctx.switch_id,
-           ctx.rx_packets[0] + ctx.rx_packets[1] + ctx.rx_packets[2],
-           ctx.tx_packets[0] + ctx.tx_packets[1] + ctx.tx_packets[2],
-           ctx.qos_total_classified, ctx.dropped_packets, ctx.ttl_expired);
-    fflush(stdout);
+    collect_stats(&c);
+    if (ctx.stats.shm)
+        switch_stats_publish(&ctx.stats, &c);
+    
+    if ((now - last_display) < hz * STATS_DISPLAY_SEC) return;
+    last_display = now;
+    display_stats(&c);
 }
 
-static int lcore_main(__rte_unused void *arg)
+/* Telemetry /switch_qos/stats: the last published snapshot */
+static int telemetry_stats(const char *cmd __rte_unused, const char *params __rte_unused,
+                           struct rte_tel_data *d)
 {
-    printf("[Switch %d] Packet processing started\n", ctx.switch_id);
+    struct switch_stats_counters c;
+    char name[16];
+    
+    if (switch_stats_read(&ctx.stats, &c) < 0)
+        return -1;
+    
+    rte_tel_data_start_dict(d);
+    rte_tel_data_add_dict_uint(d, "switch_id", ctx.switch_id);
+    rte_tel_data_add_dict_uint(d, "forwarded", c.forwarded);
+    rte_tel_data_add_dict_uint(d, "dropped", c.dropped);
+    rte_tel_data_add_dict_uint(d, "qos_classified", c.qos_classified);
+    rte_tel_data_add_dict_uint(d, "ttl_expired", c.ttl_expired);
+    rte_tel_data_add_dict_uint(d, "fdb_entries", c.fdb_entries);
+    
+    for (uint32_t i = 0; i < c.nb_ports; i++) {
+        const struct switch_stats_port *sp = &c.ports[i];
+        struct rte_tel_data *pd = rte_tel_data_alloc();
+        
+        if (!pd)
+            return -ENOMEM;
+        rte_tel_data_start_dict(pd);
+        rte_tel_data_add_dict_uint(pd, "rx_packets", sp->rx_packets);
+        rte_tel_data_add_dict_uint(pd, "tx_packets", sp->tx_packets);
+        rte_tel_data_add_dict_uint(pd, "rx_dropped", sp->rx_dropped);
+        rte_tel_data_add_dict_uint(pd, "tx_dropped", sp->tx_dropped);
+        rte_tel_data_add_dict_uint(pd, "shaped", sp->shaped);
+        for (int q = 0; q < NB_QOS_QUEUES; q++) {
+            const struct switch_stats_class *sc = &sp->classes[q];
+            
+            snprintf(name, sizeof(name), "class%d_tx", q);
+            rte_tel_data_add_dict_uint(pd, name, sc->dequeued - sc->aqm_dropped);
+            snprintf(name, sizeof(name), "class%d_drop", q);
+            rte_tel_data_add_dict_uint(pd, name, sc->tail_dropped + sc->aqm_dropped);
+        }
+        snprintf(name, sizeof(name), "port%u", i);
+        rte_tel_data_add_dict_container(d, name, pd, 0);
+    }
+    return 0;
+}
+
+/*
+ * Export counters through shared memory and telemetry. Monitoring is
+ * optional: without it the switch still logs its counters.
+ */
+static void init_stats_export(void)
+{
+    int ret = switch_stats_create(&ctx.stats, "qos", ctx.switch_id);
+    
+    if (ret < 0) {
+        printf("[Switch %d] Warning: no shared-memory stats: %s\n",
+               ctx.switch_id, strerror(-ret));
+        return;
+    }
+    printf("[Switch %d] ✓ Stats in /dev/shm%s (read with ./switch_stats -s %d)\n",
+           ctx.switch_id, ctx.stats.name, ctx.switch_id);
+    
+    rte_telemetry_register_cmd("/switch_qos/stats", telemetry_stats,
+                               "Switch counters per port and class. No parameters");
+}
+
+static int lcore_main(void *arg)
+{
+    struct lcore_conf *lc = arg;
+    bool updater = lc->worker_id == UPDATER_LCORE;
+    
+    printf("[Switch %d] Packet processing started on lcore %u (worker %u)\n",
+           ctx.switch_id, rte_lcore_id(), lc->worker_id);
+    
+    veth_fdb_reader_online(&ctx.fdb, lc->worker_id);
+    lcore_idle_init(&lc->idle);
+    setup_rx_intr(lc);
     
     while (!ctx.force_quit) {
+        /* One lcore applies learn requests from all of them */
+        if (updater)
+            lcore_idle_work(&lc->idle, veth_fdb_update(&ctx.fdb));
+        
         for (int i = 0; i < ctx.num_ports; i++) {
             if (!ctx.ports[i].configured) continue;
-            forward_packets_with_qos(i);
-            transmit_from_qos_queues(i);
+            forward_packets_with_qos(lc, i);
+            transmit_from_qos_queues(lc, i);
         }
-        display_stats();
+        veth_fdb_quiescent(&ctx.fdb, lc->worker_id);
+        if (updater)
+            update_stats();
+        lcore_idle_end_poll(&lc->idle);
     }
     
-    printf("[Switch %d] Stopped\n", ctx.switch_id);
+    veth_fdb_reader_offline(&ctx.fdb, lc->worker_id);
+    
+    printf("[Switch %d] Worker %u stopped\n", ctx.switch_id, lc->worker_id);
     return 0;
 }
 
 int main(int argc, char **argv)
 {
+    veth_fdb_block_reload_signal();
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
@@ -460,15 +834,13 @@ int main(int argc, char **argv)
     if (init_eal_with_veth(argc, argv) < 0)
         return EXIT_FAILURE;
     
-    char pool_name[64];
-    snprintf(pool_name, sizeof(pool_name), "MBUF_SW%d", ctx.switch_id);
-    
-    ctx.mbuf_pool = rte_pktmbuf_pool_create(pool_name,
-        NUM_MBUFS, MEMPOOL_CACHE_SIZE, 0,
-        RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
-    
-    if (!ctx.mbuf_pool)
-        return EXIT_FAILURE;
+    if ((unsigned int)ctx.nb_lcores > rte_lcore_count())
+        ctx.nb_lcores = rte_lcore_count();
+    for (int w = 0; w < ctx.nb_lcores; w++) {
+        ctx.lcores[w].worker_id = w;
+        for (int i = 0; i < MAX_PORTS; i++)
+            init_qos_queues(&ctx.lcores[w].sched[i]);
+    }
     
     /* CRITICAL FIX: Map DPDK ports by ORDER, not by name matching!
      * AF_PACKET PMD creates ports as net_af_packet0, net_af_packet1, etc.
@@ -477,6 +849,7 @@ int main(int argc, char **argv)
     uint16_t port_id;
     int nb_ports = 0;
     
+    memset(ctx.port_idx, -1, sizeof(ctx.port_idx));
     RTE_ETH_FOREACH_DEV(port_id) {
         if (port_id >= ctx.num_ports) {
             printf("[Switch %d] Warning: Extra port %u found, ignoring\n",
@@ -487,37 +860,70 @@ int main(int argc, char **argv)
         /* Direct mapping: DPDK port ID = our port index */
         ctx.ports[port_id].port_id = port_id;
         ctx.ports[port_id].configured = true;
-        
+        ctx.port_idx[port_id] = port_id;
+        nb_ports++;
+    }
+    
+    if (nb_ports != ctx.num_ports) {
+        fprintf(stderr, "[Switch %d] ERROR: Expected %d ports but found %d\n",
+                ctx.switch_id, ctx.num_ports, nb_ports);
+        return EXIT_FAILURE;
+    }
+    
+    /* Pools are sized from the queues every port will get */
+    if (create_mbuf_pools() < 0) {
+        fprintf(stderr, "[Switch %d] Cannot create mbuf pools\n", ctx.switch_id);
+        return EXIT_FAILURE;
+    }
+    
+    for (port_id = 0; port_id < ctx.num_ports; port_id++) {
         if (init_port(port_id) < 0) {
             fprintf(stderr, "[Switch %d] Port %u init failed\n", 
                     ctx.switch_id, port_id);
             return EXIT_FAILURE;
         }
         
-        init_qos_queues(&ctx.ports[port_id]);
-        
         printf("[Switch %d] ✓ Port %u: %s\n", 
                ctx.switch_id, port_id, ctx.ports[port_id].veth_name);
-        
-        nb_ports++;
     }
     
-    if (nb_ports != ctx.num_ports) {
-        fprintf(stderr, "[Switch %d] ERROR: Expected %d ports but found %d\n",
-                ctx.switch_id, ctx.num_ports, nb_ports);
+    char fdb_name[32];
+    snprintf(fdb_name, sizeof(fdb_name), "FDB_SW%d", ctx.switch_id);
+    if (veth_fdb_init(&ctx.fdb, fdb_name, ctx.nb_lcores, rte_socket_id()) < 0)
         return EXIT_FAILURE;
-    }
     
     char mac_file[256];
     snprintf(mac_file, sizeof(mac_file),
              "mac_tables/switch_%d_%s.txt", ctx.switch_id, ctx.topology);
     load_mac_table_from_file(mac_file);
     
-    printf("[Switch %d] ✓ Ready: %d ports, %d QoS queues/port\n",
-           ctx.switch_id, ctx.num_ports, NB_QOS_QUEUES);
+    init_stats_export();
     
-    lcore_main(NULL);
+    printf("[Switch %d] ✓ Ready: %d ports, %d QoS queues/port, %d lcores\n",
+           ctx.switch_id, ctx.num_ports, NB_QOS_QUEUES, ctx.nb_lcores);
+    
+    /* Worker 0 runs on the main lcore, the others on the remaining EAL lcores */
+    unsigned int lcore_id;
+    int w = 1;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        if (w >= ctx.nb_lcores)
+            break;
+        rte_eal_remote_launch(lcore_main, &ctx.lcores[w], lcore_id);
+        w++;
+    }
+    lcore_main(&ctx.lcores[UPDATER_LCORE]);
+    rte_eal_mp_wait_lcore();
+    
+    for (int i = 0; i < ctx.num_ports; i++) {
+        for (int w = 0; w < ctx.nb_lcores; w++)
+            qos_sched_port_flush(&ctx.lcores[w].sched[i]);
+        if (ctx.ports[i].sw_rss_enabled)
+            sw_rss_port_free(&ctx.ports[i].sw_rss);
+    }
     
+    switch_stats_close(&ctx.stats);
+    veth_fdb_reload_thread_stop(&ctx.fdb);
+    veth_fdb_free(&ctx.fdb);
     rte_eal_cleanup();
     return 0;
 }
@@ -1,5 +1,8 @@
 #!/bin/bash
 
+# Refresh interval in seconds; shared-memory stats update every 100 ms
+INTERVAL=${1:-5}
+
 echo "Real-time QoS Monitor (Ctrl+C to stop)"
 echo "Press Enter to refresh stats..."
 echo ""
@@ -12,13 +15,16 @@ while true; do
     echo ""
     
     for sw in 1 2 3; do
-        if [ -f logs/sw${sw}.log ]; then
+        # Counters from shared memory when the reader is built, else the log
+        if [ -x ./switch_stats ] && [ -e /dev/shm/switch_stats_qos_${sw} ]; then
+            ./switch_stats -s $sw
+        elif [ -f logs/sw${sw}.log ]; then
             echo "┌─── Switch $sw ───┐"
             tail -20 logs/sw${sw}.log | grep -A 12 "QoS Statistics" | tail -13
             echo ""
         fi
     done
     
-    echo "Press Ctrl+C to exit, or wait 5 seconds for auto-refresh..."
-    sleep 5
+    echo "Press Ctrl+C to exit, or wait ${INTERVAL} seconds for auto-refresh..."
+    sleep $INTERVAL
 done
\ No newline at end of file
@@ -0,0 +1,680 @@
+/*
+ * MAC Learning Table for the veth Switches - Implementation
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
+
+#include "veth_fdb.h"
+
+#define FDB_MASK (VETH_FDB_SIZE - 1)
+#define FDB_TABLE_BYTES (VETH_FDB_SIZE * sizeof(struct veth_fdb_entry))
+#define FDB_MAX_USED (VETH_FDB_SIZE - 1)       /* One slot stays empty to end probes */
+#define FDB_COMPACT_DEAD (VETH_FDB_SIZE / 8)  /* Dead slots that trigger a rebuild */
+#define RELOAD_RETRY_US 10000
+#define RELOAD_RETRIES 100
+
+/* Multiplicative hash: sequential MACs spread out instead of clustering */
+static uint32_t mac_hash(const struct rte_ether_addr *mac)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 6; i++) {
+        v = (v << 8) | mac->addr_bytes[i];
+    }
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/* Learn requests travel through the ring as the pointer value itself */
+static inline void *learn_req_pack(const struct rte_ether_addr *mac, uint16_t port_id)
+{
+    uint64_t v = port_id;
+    for (int i = 0; i < 6; i++) {
+        v = (v << 8) | mac->addr_bytes[i];
+    }
+    return (void *)(uintptr_t)v;
+}
+
+static inline void learn_req_unpack(void *req, struct rte_ether_addr *mac, uint16_t *port_id)
+{
+    uint64_t v = (uintptr_t)req;
+    for (int i = 5; i >= 0; i--) {
+        mac->addr_bytes[i] = v & 0xFF;
+        v >>= 8;
+    }
+    *port_id = (uint16_t)v;
+}
+
+static inline uint8_t slot_state(const struct veth_fdb_entry *e)
+{
+    return __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+}
+
+/* Readers: the table pointer changes on reload, so load it once per call */
+static inline struct veth_fdb_entry *fdb_table(struct veth_fdb *fdb)
+{
+    return __atomic_load_n(&fdb->table, __ATOMIC_ACQUIRE);
+}
+
+/* Slot of a valid entry for mac, or -1 */
+static int table_find_hash(const struct veth_fdb_entry *table, const struct rte_ether_addr *mac,
+                           uint32_t hash)
+{
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        uint32_t idx = (hash + i) & FDB_MASK;
+        const struct veth_fdb_entry *e = &table[idx];
+        uint8_t state = slot_state(e);
+        
+        if (state == VETH_FDB_EMPTY) {
+            return -1;
+        }
+        if (state == VETH_FDB_VALID && rte_is_same_ether_addr(&e->mac, mac)) {
+            return idx;
+        }
+    }
+    
+    return -1;
+}
+
+static inline int table_find(const struct veth_fdb_entry *table, const struct rte_ether_addr *mac)
+{
+    return table_find_hash(table, mac, mac_hash(mac));
+}
+
+/*
+ * Updater: slot of a valid entry for mac, or -1 with free_idx set to the
+ * first reusable slot on the probe sequence (-1 if the table is full)
+ */
+static int table_probe(const struct veth_fdb_entry *table, const struct rte_ether_addr *mac,
+                       int *free_idx)
+{
+    uint32_t hash = mac_hash(mac);
+    
+    *free_idx = -1;
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        uint32_t idx = (hash + i) & FDB_MASK;
+        const struct veth_fdb_entry *e = &table[idx];
+        
+        if (e->state == VETH_FDB_TOMBSTONE) {
+            if (*free_idx < 0) {
+                *free_idx = idx;
+            }
+            continue;
+        }
+        if (e->state == VETH_FDB_EMPTY) {
+            if (*free_idx < 0) {
+                *free_idx = idx;
+            }
+            break;
+        }
+        if (e->state == VETH_FDB_VALID && rte_is_same_ether_addr(&e->mac, mac)) {
+            return idx;
+        }
+    }
+    
+    return -1;
+}
+
+int veth_fdb_init(struct veth_fdb *fdb, const char *name, uint32_t nb_readers,
+                  int socket_id)
+{
+    char ring_name[RTE_RING_NAMESIZE];
+    size_t qsbr_size;
+    
+    if (nb_readers == 0 || nb_readers > VETH_FDB_MAX_READERS) {
+        return -EINVAL;
+    }
+    
+    memset(fdb, 0, sizeof(*fdb));
+    fdb->nb_readers = nb_readers;
+    
+    fdb->table = rte_zmalloc_socket(name, FDB_TABLE_BYTES, RTE_CACHE_LINE_SIZE, socket_id);
+    qsbr_size = rte_rcu_qsbr_get_memsize(nb_readers);
+    fdb->qsbr = rte_zmalloc_socket(name, qsbr_size, RTE_CACHE_LINE_SIZE, socket_id);
+    if (!fdb->table || !fdb->qsbr) {
+        veth_fdb_free(fdb);
+        return -ENOMEM;
+    }
+    rte_rcu_qsbr_init(fdb->qsbr, nb_readers);
+    
+    for (uint32_t r = 0; r < nb_readers; r++) {
+        snprintf(ring_name, sizeof(ring_name), "%s_learn%u", name, r);
+        fdb->readers[r].learn_ring = rte_ring_create(ring_name, VETH_FDB_LEARN_RING_SIZE,
+                                                     socket_id, RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (!fdb->readers[r].learn_ring) {
+            veth_fdb_free(fdb);
+            return -ENOMEM;
+        }
+    }
+    
+    for (int i = 0; i < VETH_FDB_WHEEL_SLOTS; i++) {
+        fdb->wheel[i] = -1;
+    }
+    fdb->tsc_hz = rte_get_tsc_hz();
+    fdb->next_tick_tsc = rte_rdtsc() + fdb->tsc_hz;
+    
+    return 0;
+}
+
+void veth_fdb_free(struct veth_fdb *fdb)
+{
+    for (uint32_t r = 0; r < VETH_FDB_MAX_READERS; r++) {
+        rte_ring_free(fdb->readers[r].learn_ring);
+        fdb->readers[r].learn_ring = NULL;
+    }
+    rte_free(fdb->qsbr);
+    rte_free(fdb->table);
+    rte_free(fdb->staged);
+    rte_free(fdb->retired);
+    fdb->qsbr = NULL;
+    fdb->table = NULL;
+    fdb->staged = NULL;
+    fdb->retired = NULL;
+}
+
+int veth_fdb_reader_online(struct veth_fdb *fdb, uint32_t reader_id)
+{
+    int ret = rte_rcu_qsbr_thread_register(fdb->qsbr, reader_id);
+    
+    if (ret == 0) {
+        rte_rcu_qsbr_thread_online(fdb->qsbr, reader_id);
+    }
+    return ret;
+}
+
+void veth_fdb_reader_offline(struct veth_fdb *fdb, uint32_t reader_id)
+{
+    rte_rcu_qsbr_thread_offline(fdb->qsbr, reader_id);
+    rte_rcu_qsbr_thread_unregister(fdb->qsbr, reader_id);
+}
+
+int veth_fdb_lookup(struct veth_fdb *fdb, const struct rte_ether_addr *mac)
+{
+    struct veth_fdb_entry *table = fdb_table(fdb);
+    int idx = table_find(table, mac);
+    
+    if (idx < 0) {
+        return -1;
+    }
+    return __atomic_load_n(&table[idx].port_id, __ATOMIC_RELAXED);
+}
+
+void veth_fdb_lookup_bulk(struct veth_fdb *fdb, const struct rte_ether_addr *const *macs,
+                          uint16_t nb_keys, int *ports)
+{
+    struct veth_fdb_entry *table = fdb_table(fdb);
+    uint32_t hashes[VETH_FDB_MAX_BURST];
+    
+    for (uint16_t i = 0; i < nb_keys; i++) {
+        hashes[i] = mac_hash(macs[i]);
+        rte_prefetch0(&table[hashes[i] & FDB_MASK]);
+    }
+    
+    for (uint16_t i = 0; i < nb_keys; i++) {
+        int idx = table_find_hash(table, macs[i], hashes[i]);
+        
+        ports[i] = idx < 0 ? -1 : __atomic_load_n(&table[idx].port_id, __ATOMIC_RELAXED);
+    }
+}
+
+void veth_fdb_learn(struct veth_fdb *fdb, uint32_t reader_id,
+                    const struct rte_ether_addr *mac, uint16_t port_id)
+{
+    struct veth_fdb_reader *r = &fdb->readers[reader_id];
+    struct veth_fdb_entry *table;
+    int idx;
+    
+    /* Group addresses are never a source */
+    if (!rte_is_unicast_ether_addr(mac)) {
+        return;
+    }
+    
+    table = fdb_table(fdb);
+    idx = table_find(table, mac);
+    if (idx >= 0) {
+        struct veth_fdb_entry *e = &table[idx];
+        
+        if (__atomic_load_n(&e->port_id, __ATOMIC_RELAXED) == port_id &&
+            (__atomic_load_n(&e->is_static, __ATOMIC_RELAXED) ||
+             veth_fdb_now(fdb) - __atomic_load_n(&e->last_seen, __ATOMIC_RELAXED) <
+             VETH_FDB_REFRESH_SEC)) {
+            return;
+        }
+    }
+    
+    if (rte_ring_enqueue(r->learn_ring, learn_req_pack(mac, port_id)) == 0) {
+        r->learn_posted++;
+    } else {
+        r->learn_dropped++;
+    }
+}
+
+/* Updater: put a dynamic entry on the wheel slot where it may expire */
+static void wheel_schedule(struct veth_fdb *fdb, uint32_t idx)
+{
+    struct veth_fdb_entry *e = &fdb->table[idx];
+    uint32_t slot = (e->last_seen + VETH_FDB_AGING_TIME + 1) & (VETH_FDB_WHEEL_SLOTS - 1);
+    
+    e->wheel_next = fdb->wheel[slot];
+    fdb->wheel[slot] = idx;
+}
+
+/*
+ * Updater: insert or update. New entries are filled in before the state
+ * store publishes them; moves and refreshes are single atomic stores.
+ */
+static int fdb_insert(struct veth_fdb *fdb, const struct rte_ether_addr *mac,
+                      uint16_t port_id, bool is_static)
+{
+    int free_idx;
+    int idx = table_probe(fdb->table, mac, &free_idx);
+    
+    if (idx >= 0) {
+        struct veth_fdb_entry *e = &fdb->table[idx];
+        
+        if (e->port_id != port_id) {
+            __atomic_store_n(&e->port_id, port_id, __ATOMIC_RELAXED);
+            fdb->moved++;
+            /* A station that moved is no longer where the file says */
+            if (e->is_static && !is_static) {
+                __atomic_store_n(&e->is_static, 0, __ATOMIC_RELAXED);
+                e->last_seen = fdb->now_sec;
+                wheel_schedule(fdb, idx);
+            }
+        }
+        __atomic_store_n(&e->last_seen, fdb->now_sec, __ATOMIC_RELAXED);
+        return idx;
+    }
+    
+    /* Reusing a tombstone is free; taking an empty slot must leave one */
+    if (free_idx < 0 ||
+        (fdb->table[free_idx].state == VETH_FDB_EMPTY && fdb->used >= FDB_MAX_USED)) {
+        fdb->table_full++;
+        return -ENOSPC;
+    }
+    if (fdb->table[free_idx].state == VETH_FDB_EMPTY) {
+        fdb->used++;
+    }
+    
+    struct veth_fdb_entry *e = &fdb->table[free_idx];
+    rte_ether_addr_copy(mac, &e->mac);
+    e->port_id = port_id;
+    e->is_static = is_static;
+    e->last_seen = fdb->now_sec;
+    __atomic_store_n(&e->state, VETH_FDB_VALID, __ATOMIC_RELEASE);
+    if (!is_static) {
+        wheel_schedule(fdb, free_idx);
+    }
+    fdb->count++;
+    fdb->learned++;
+    
+    return free_idx;
+}
+
+/* Updater: unpublish an entry; its slot is reused after a grace period */
+static void fdb_delete(struct veth_fdb *fdb, uint32_t idx)
+{
+    __atomic_store_n(&fdb->table[idx].state, VETH_FDB_DELETED, __ATOMIC_RELEASE);
+    fdb->reclaim_idx[fdb->reclaim_tail & FDB_MASK] = idx;
+    fdb->reclaim_token[fdb->reclaim_tail & FDB_MASK] = rte_rcu_qsbr_start(fdb->qsbr);
+    fdb->reclaim_tail++;
+    fdb->count--;
+}
+
+/*
+ * Updater: turn deleted slots whose grace period has ended into
+ * tombstones; a run of tombstones ending at an empty slot ends no probe
+ * sequence and becomes empty. So does a table of nothing but tombstones.
+ */
+static void fdb_reclaim(struct veth_fdb *fdb)
+{
+    while (fdb->reclaim_head != fdb->reclaim_tail) {
+        uint32_t pos = fdb->reclaim_head & FDB_MASK;
+        uint32_t idx = fdb->reclaim_idx[pos];
+        uint32_t n;
+        
+        if (rte_rcu_qsbr_check(fdb->qsbr, fdb->reclaim_token[pos], false) != 1) {
+            break;
+        }
+        fdb->reclaim_head++;
+        
+        fdb->table[idx].state = VETH_FDB_TOMBSTONE;
+        for (n = 1; n < VETH_FDB_SIZE; n++) {
+            if (fdb->table[(idx + 1) & FDB_MASK].state != VETH_FDB_TOMBSTONE) {
+                break;
+            }
+            idx = (idx + 1) & FDB_MASK;
+        }
+        if (n < VETH_FDB_SIZE && fdb->table[(idx + 1) & FDB_MASK].state != VETH_FDB_EMPTY) {
+            continue;
+        }
+        for (n = 0; n < VETH_FDB_SIZE && fdb->table[idx].state == VETH_FDB_TOMBSTONE; n++) {
+            __atomic_store_n(&fdb->table[idx].state, VETH_FDB_EMPTY, __ATOMIC_RELEASE);
+            idx = (idx - 1) & FDB_MASK;
+            fdb->used--;
+        }
+    }
+}
+
+/* Updater: expire the entries due in one wheel slot */
+static void wheel_expire(struct veth_fdb *fdb, uint32_t slot)
+{
+    int32_t idx = fdb->wheel[slot];
+    
+    fdb->wheel[slot] = -1;
+    while (idx >= 0) {
+        struct veth_fdb_entry *e = &fdb->table[idx];
+        int32_t next = e->wheel_next;
+        
+        if (fdb->now_sec - e->last_seen > VETH_FDB_AGING_TIME) {
+            fdb_delete(fdb, idx);
+            fdb->aged++;
+        } else {
+            wheel_schedule(fdb, idx);   /* Refreshed since it was queued */
+        }
+        idx = next;
+    }
+}
+
+struct veth_fdb_entry *veth_fdb_parse_file(const char *path, const uint16_t *port_ids,
+                                           int nb_ports, int *nb_loaded)
+{
+    struct veth_fdb_entry *table;
+    char line[256];
+    int line_num = 0;
+    FILE *fp;
+    
+    *nb_loaded = 0;
+    fp = fopen(path, "r");
+    if (!fp) {
+        return NULL;
+    }
+    table = rte_zmalloc("veth_fdb_shadow", FDB_TABLE_BYTES, RTE_CACHE_LINE_SIZE);
+    if (!table) {
+        fclose(fp);
+        errno = ENOMEM;
+        return NULL;
+    }
+    
+    while (fgets(line, sizeof(line), fp)) {
+        struct rte_ether_addr mac;
+        int port_index;
+        int idx, free_idx;
+        
+        line_num++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        if (sscanf(line, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx %d",
+                   &mac.addr_bytes[0], &mac.addr_bytes[1], &mac.addr_bytes[2],
+                   &mac.addr_bytes[3], &mac.addr_bytes[4], &mac.addr_bytes[5],
+                   &port_index) != 7) {
+            printf("  Warning: %s:%d: cannot parse line\n", path, line_num);
+            continue;
+        }
+        if (port_index < 0 || port_index >= nb_ports) {
+            printf("  Warning: %s:%d: invalid port index %d (have %d ports)\n",
+                   path, line_num, port_index, nb_ports);
+            continue;
+        }
+        
+        /* Nothing reads the shadow table yet, so plain stores suffice */
+        idx = table_probe(table, &mac, &free_idx);
+        if (idx < 0) {
+            if (free_idx < 0 || *nb_loaded >= FDB_MAX_USED) {
+                printf("  Warning: %s:%d: MAC table full\n", path, line_num);
+                continue;
+            }
+            idx = free_idx;
+            rte_ether_addr_copy(&mac, &table[idx].mac);
+            table[idx].state = VETH_FDB_VALID;
+            table[idx].is_static = 1;
+            (*nb_loaded)++;
+        }
+        table[idx].port_id = port_ids[port_index];
+    }
+    
+    fclose(fp);
+    return table;
+}
+
+int veth_fdb_stage(struct veth_fdb *fdb, struct veth_fdb_entry *shadow)
+{
+    struct veth_fdb_entry *expected = NULL;
+    
+    if (!__atomic_compare_exchange_n(&fdb->staged, &expected, shadow, false,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return -EBUSY;
+    }
+    return 0;
+}
+
+int veth_fdb_reload(struct veth_fdb *fdb, const char *path, const uint16_t *port_ids,
+                    int nb_ports)
+{
+    struct veth_fdb_entry *shadow;
+    int nb_loaded;
+    
+    shadow = veth_fdb_parse_file(path, port_ids, nb_ports, &nb_loaded);
+    if (!shadow) {
+        return -errno;
+    }
+    
+    for (int i = 0; i < RELOAD_RETRIES; i++) {
+        if (veth_fdb_stage(fdb, shadow) == 0) {
+            return nb_loaded;
+        }
+        usleep(RELOAD_RETRY_US);
+    }
+    
+    rte_free(shadow);
+    return -EBUSY;
+}
+
+void veth_fdb_block_reload_signal(void)
+{
+    sigset_t set;
+    
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+static void *reload_thread_main(void *arg)
+{
+    struct veth_fdb *fdb = arg;
+    sigset_t set;
+    int sig;
+    
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    
+    while (!fdb->reload_quit) {
+        if (sigwait(&set, &sig) != 0 || fdb->reload_quit) {
+            continue;
+        }
+        
+        int ret = veth_fdb_reload(fdb, fdb->reload_path, fdb->reload_port_ids,
+                                  fdb->reload_nb_ports);
+        if (ret < 0) {
+            printf("MAC table reload from %s failed: %s\n", fdb->reload_path, strerror(-ret));
+        } else {
+            printf("MAC table reloaded from %s: %d static entries\n", fdb->reload_path, ret);
+        }
+        fflush(stdout);
+    }
+    
+    return NULL;
+}
+
+int veth_fdb_reload_thread_start(struct veth_fdb *fdb, const char *path,
+                                 const uint16_t *port_ids, int nb_ports)
+{
+    int ret;
+    
+    if (nb_ports > VETH_FDB_MAX_PORTS) {
+        return -EINVAL;
+    }
+    
+    snprintf(fdb->reload_path, sizeof(fdb->reload_path), "%s", path);
+    memcpy(fdb->reload_port_ids, port_ids, nb_ports * sizeof(port_ids[0]));
+    fdb->reload_nb_ports = nb_ports;
+    fdb->reload_quit = false;
+    
+    ret = pthread_create(&fdb->reload_thread, NULL, reload_thread_main, fdb);
+    if (ret != 0) {
+        return -ret;
+    }
+    fdb->reload_thread_running = true;
+    return 0;
+}
+
+void veth_fdb_reload_thread_stop(struct veth_fdb *fdb)
+{
+    if (!fdb->reload_thread_running) {
+        return;
+    }
+    fdb->reload_quit = true;
+    pthread_kill(fdb->reload_thread, SIGHUP);
+    pthread_join(fdb->reload_thread, NULL);
+    fdb->reload_thread_running = false;
+}
+
+/*
+ * Updater: swap in a staged table. Learned entries the file does not name
+ * are carried over, so a reload only changes what the file changed. The
+ * old table stays readable until every reader has passed a quiescent
+ * state; slots still waiting for reclaim simply go away with it, and the
+ * new table has no dead slots at all.
+ */
+static void fdb_swap_staged(struct veth_fdb *fdb, struct veth_fdb_entry *table)
+{
+    struct veth_fdb_entry *old = fdb->table;
+    uint32_t count = 0;
+    
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        count += table[i].state == VETH_FDB_VALID;
+    }
+    for (uint32_t i = 0; i < VETH_FDB_SIZE && count < FDB_MAX_USED; i++) {
+        const struct veth_fdb_entry *e = &old[i];
+        int free_idx;
+        
+        if (e->state != VETH_FDB_VALID || e->is_static) {
+            continue;
+        }
+        if (table_probe(table, &e->mac, &free_idx) < 0 && free_idx >= 0) {
+            table[free_idx] = *e;
+            count++;
+        }
+    }
+    
+    __atomic_store_n(&fdb->table, table, __ATOMIC_RELEASE);
+    
+    for (int i = 0; i < VETH_FDB_WHEEL_SLOTS; i++) {
+        fdb->wheel[i] = -1;
+    }
+    fdb->reclaim_head = fdb->reclaim_tail = 0;
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        if (table[i].state == VETH_FDB_VALID && !table[i].is_static) {
+            wheel_schedule(fdb, i);
+        }
+    }
+    fdb->count = count;
+    fdb->used = count;
+    
+    fdb->retired = old;
+    fdb->retired_token = rte_rcu_qsbr_start(fdb->qsbr);
+}
+
+/*
+ * Updater: rebuild the table without its deleted slots and tombstones once
+ * there are many of them, or once they hold the slots new entries need.
+ * Static entries are staged as a reload would; the swap carries the rest.
+ */
+static void fdb_compact(struct veth_fdb *fdb)
+{
+    uint32_t dead = fdb->used - fdb->count;
+    struct veth_fdb_entry *table;
+    
+    if (fdb->retired || dead == 0 || (dead < FDB_COMPACT_DEAD && fdb->used < FDB_MAX_USED)) {
+        return;
+    }
+    table = rte_zmalloc("veth_fdb_compact", FDB_TABLE_BYTES, RTE_CACHE_LINE_SIZE);
+    if (!table) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < VETH_FDB_SIZE; i++) {
+        const struct veth_fdb_entry *e = &fdb->table[i];
+        int free_idx;
+        
+        if (e->state == VETH_FDB_VALID && e->is_static &&
+            table_probe(table, &e->mac, &free_idx) < 0 && free_idx >= 0) {
+            table[free_idx] = *e;
+        }
+    }
+    fdb_swap_staged(fdb, table);
+    fdb->compactions++;
+}
+
+uint32_t veth_fdb_update(struct veth_fdb *fdb)
+{
+    void *reqs[VETH_FDB_LEARN_BURST];
+    uint64_t tsc = rte_rdtsc();
+    uint32_t applied = 0;
+    
+    while (tsc >= fdb->next_tick_tsc) {
+        __atomic_store_n(&fdb->now_sec, fdb->now_sec + 1, __ATOMIC_RELAXED);
+        fdb->next_tick_tsc += fdb->tsc_hz;
+    }
+    
+    /* One reload in flight: the next waits until the last table is freed */
+    if (fdb->retired &&
+        rte_rcu_qsbr_check(fdb->qsbr, fdb->retired_token, false) == 1) {
+        rte_free(fdb->retired);
+        fdb->retired = NULL;
+    }
+    if (!fdb->retired && __atomic_load_n(&fdb->staged, __ATOMIC_RELAXED)) {
+        struct veth_fdb_entry *table = __atomic_exchange_n(&fdb->staged, NULL,
+                                                           __ATOMIC_ACQUIRE);
+        fdb_swap_staged(fdb, table);
+        fdb->reloads++;
+    }
+    
+    /* Drain at most one ring's worth per reader so a storm cannot stall us */
+    for (uint32_t r = 0; r < fdb->nb_readers; r++) {
+        unsigned int budget = VETH_FDB_LEARN_RING_SIZE;
+        unsigned int n;
+        
+        do {
+            n = rte_ring_dequeue_burst(fdb->readers[r].learn_ring, reqs,
+                                       VETH_FDB_LEARN_BURST, NULL);
+            for (unsigned int i = 0; i < n; i++) {
+                struct rte_ether_addr mac;
+                uint16_t port_id;
+                
+                learn_req_unpack(reqs[i], &mac, &port_id);
+                fdb_insert(fdb, &mac, port_id, false);
+            }
+            applied += n;
+            budget -= n;
+        } while (n == VETH_FDB_LEARN_BURST && budget >= VETH_FDB_LEARN_BURST);
+    }
+    
+    fdb_reclaim(fdb);
+    
+    while (fdb->wheel_sec != fdb->now_sec) {
+        fdb->wheel_sec++;
+        wheel_expire(fdb, fdb->wheel_sec & (VETH_FDB_WHEEL_SLOTS - 1));
+    }
+    
+    fdb_compact(fdb);
+    
+    return applied;
+}
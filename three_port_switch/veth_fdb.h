@@ -0,0 +1,211 @@
+/*
+ * MAC Learning Table for the veth Switches
+ *
+ * Forwarding database shared by three_port_switch_veth and
+ * three_port_switch_veth_qos. Lookups are lock-free and may run on any
+ * number of forwarding lcores (readers). Readers never write the table:
+ * they post learn requests to their own single-producer ring, and one
+ * updater drains all rings, applies inserts/moves/refreshes and ages
+ * entries on a timer wheel.
+ *
+ * Deleted slots are reclaimed with QSBR (rte_rcu_qsbr): a slot is only
+ * reused once every reader has reported a quiescent state since the
+ * delete, so a reader can never see an entry change identity under it.
+ * Readers must call veth_fdb_quiescent() once per poll-loop iteration.
+ * At least one slot always stays empty so that every probe ends; when
+ * deleted slots and tombstones pile up, the updater rebuilds the table
+ * without them and swaps it in like a reload.
+ *
+ * The static MAC file is reloaded without pausing forwarding: it is parsed
+ * into a shadow table off the datapath, the updater carries learned
+ * entries over and swaps the table pointer, and the old table is freed
+ * after a grace period.
+ */
+
+#ifndef VETH_FDB_H
+#define VETH_FDB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <rte_ether.h>
+#include <rte_ring.h>
+#include <rte_rcu_qsbr.h>
+
+#define VETH_FDB_SIZE 4096              /* Slots; power of 2 */
+#define VETH_FDB_AGING_TIME 300         /* Seconds, 802.1D default */
+#define VETH_FDB_WHEEL_SLOTS 64         /* 1 s per slot; power of 2 */
+#define VETH_FDB_MAX_READERS 16
+#define VETH_FDB_LEARN_RING_SIZE 1024
+#define VETH_FDB_LEARN_BURST 32
+#define VETH_FDB_REFRESH_SEC 1          /* Min interval between refreshes */
+#define VETH_FDB_MAX_PORTS 16           /* Port indexes in the MAC file */
+#define VETH_FDB_MAX_BURST 64           /* Keys per veth_fdb_lookup_bulk call */
+
+enum veth_fdb_slot_state {
+    VETH_FDB_EMPTY = 0,                 /* Ends a probe sequence */
+    VETH_FDB_VALID,
+    VETH_FDB_DELETED,                   /* Waiting for a grace period */
+    VETH_FDB_TOMBSTONE,                 /* Reusable; probing continues past it */
+};
+
+struct veth_fdb_entry {
+    struct rte_ether_addr mac;
+    uint16_t port_id;
+    uint8_t state;
+    uint8_t is_static;                  /* From the MAC file; never aged */
+    uint32_t last_seen;                 /* Coarse clock seconds */
+    int32_t wheel_next;                 /* Next entry in the same wheel slot */
+};
+
+/* Per-reader learning channel */
+struct veth_fdb_reader {
+    struct rte_ring *learn_ring;
+    uint64_t learn_posted;
+    uint64_t learn_dropped;             /* Ring full */
+} __rte_cache_aligned;
+
+struct veth_fdb {
+    struct veth_fdb_entry *table;       /* Swapped atomically on reload and compaction */
+    struct rte_rcu_qsbr *qsbr;
+    uint32_t nb_readers;
+    struct veth_fdb_reader readers[VETH_FDB_MAX_READERS];
+    
+    /* Coarse clock: advanced by the updater, read by everyone */
+    uint32_t now_sec;
+    uint64_t tsc_hz;
+    uint64_t next_tick_tsc;
+    
+    /* Updater-only state */
+    int32_t wheel[VETH_FDB_WHEEL_SLOTS];
+    uint32_t wheel_sec;
+    uint32_t reclaim_idx[VETH_FDB_SIZE];
+    uint64_t reclaim_token[VETH_FDB_SIZE];
+    uint32_t reclaim_head;
+    uint32_t reclaim_tail;
+    uint32_t count;
+    uint32_t used;                      /* Slots not empty: valid, deleted, tombstones */
+    uint64_t learned;
+    uint64_t moved;
+    uint64_t aged;
+    uint64_t table_full;
+    uint64_t compactions;               /* Rebuilds that dropped dead slots */
+    
+    /* Hot reload */
+    struct veth_fdb_entry *staged;      /* Parsed shadow table for the updater */
+    struct veth_fdb_entry *retired;     /* Freed once its grace period ends */
+    uint64_t retired_token;
+    uint64_t reloads;
+    pthread_t reload_thread;
+    bool reload_thread_running;
+    volatile bool reload_quit;
+    char reload_path[256];
+    uint16_t reload_port_ids[VETH_FDB_MAX_PORTS];
+    int reload_nb_ports;
+};
+
+/*
+ * Allocate rings and QSBR state for nb_readers forwarding lcores
+ */
+int veth_fdb_init(struct veth_fdb *fdb, const char *name, uint32_t nb_readers,
+                  int socket_id);
+
+/*
+ * Free everything allocated by veth_fdb_init
+ */
+void veth_fdb_free(struct veth_fdb *fdb);
+
+/*
+ * Register the calling lcore as reader_id and mark it online
+ */
+int veth_fdb_reader_online(struct veth_fdb *fdb, uint32_t reader_id);
+
+/*
+ * Mark a reader offline (e.g. before it exits or sleeps)
+ */
+void veth_fdb_reader_offline(struct veth_fdb *fdb, uint32_t reader_id);
+
+/*
+ * Report that reader_id holds no references into the table
+ */
+static inline void veth_fdb_quiescent(struct veth_fdb *fdb, uint32_t reader_id)
+{
+    rte_rcu_qsbr_quiescent(fdb->qsbr, reader_id);
+}
+
+/*
+ * Look up a MAC; returns its DPDK port id or -1. Lock-free.
+ */
+int veth_fdb_lookup(struct veth_fdb *fdb, const struct rte_ether_addr *mac);
+
+/*
+ * Look up up to VETH_FDB_MAX_BURST MACs, prefetching every first probe
+ * slot before comparing any; ports[i] receives the port id or -1
+ */
+void veth_fdb_lookup_bulk(struct veth_fdb *fdb, const struct rte_ether_addr *const *macs,
+                          uint16_t nb_keys, int *ports);
+
+/*
+ * Post a learn request for a source MAC seen on port_id. Never blocks:
+ * known, fresh entries cost one lookup and requests are dropped when the
+ * reader's ring is full.
+ */
+void veth_fdb_learn(struct veth_fdb *fdb, uint32_t reader_id,
+                    const struct rte_ether_addr *mac, uint16_t port_id);
+
+/*
+ * Parse a static MAC file ("aa:bb:cc:dd:ee:ff <port index> [description]")
+ * into a new table, mapping port indexes through port_ids. Returns NULL if
+ * the file cannot be read; nb_loaded receives the entry count.
+ */
+struct veth_fdb_entry *veth_fdb_parse_file(const char *path, const uint16_t *port_ids,
+                                           int nb_ports, int *nb_loaded);
+
+/*
+ * Hand a parsed table to the updater; returns -EBUSY while another one is
+ * still staged
+ */
+int veth_fdb_stage(struct veth_fdb *fdb, struct veth_fdb_entry *shadow);
+
+/*
+ * Parse path and stage it, retrying briefly while busy. Returns the number
+ * of static entries or a negative errno.
+ */
+int veth_fdb_reload(struct veth_fdb *fdb, const char *path, const uint16_t *port_ids,
+                    int nb_ports);
+
+/*
+ * Block SIGHUP in the calling thread and the threads it creates later;
+ * call before rte_eal_init() so that only the reload thread receives it
+ */
+void veth_fdb_block_reload_signal(void);
+
+/*
+ * Start a thread that reloads path on every SIGHUP
+ */
+int veth_fdb_reload_thread_start(struct veth_fdb *fdb, const char *path,
+                                 const uint16_t *port_ids, int nb_ports);
+
+/*
+ * Stop the reload thread
+ */
+void veth_fdb_reload_thread_stop(struct veth_fdb *fdb);
+
+/*
+ * Updater step, once per loop iteration: advance the clock, swap in a
+ * staged table, apply posted learn requests, reclaim slots past their
+ * grace period and age entries. Returns the number of learn requests
+ * applied.
+ */
+uint32_t veth_fdb_update(struct veth_fdb *fdb);
+
+/*
+ * Coarse clock in seconds since veth_fdb_init
+ */
+static inline uint32_t veth_fdb_now(const struct veth_fdb *fdb)
+{
+    return __atomic_load_n(&fdb->now_sec, __ATOMIC_RELAXED);
+}
+
+#endif /* VETH_FDB_H */
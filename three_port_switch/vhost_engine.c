@@ -0,0 +1,548 @@
+/*
+ * Virtual Host Engine Implementation
+ */
+
+#include "vhost_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+/* Helper: Get current time in microseconds */
+static uint64_t engine_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Timer wheel
+ *
+ * Each slot is a circular list; a timer further away than one revolution
+ * stays in its slot and is skipped until its absolute tick is reached.
+ */
+
+static void wheel_init(vhost_engine_worker_t *w)
+{
+    for (uint32_t i = 0; i < VHOST_WHEEL_SLOTS; i++) {
+        w->slots[i].next = &w->slots[i];
+        w->slots[i].prev = &w->slots[i];
+    }
+    w->tick = engine_now_us() / VHOST_WHEEL_TICK_US;
+}
+
+static inline void timer_unlink(vhost_timer_t *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+    t->armed = false;
+}
+
+/* Arm (or re-arm) a timer to fire at deadline_us */
+static void wheel_arm(vhost_engine_worker_t *w, vhost_timer_t *t, uint64_t deadline_us)
+{
+    pthread_mutex_lock(&w->lock);
+    
+    if (t->armed) {
+        timer_unlink(t);
+    }
+    
+    /* Never behind the worker: a past deadline fires on the next tick */
+    uint64_t expires = deadline_us / VHOST_WHEEL_TICK_US;
+    if (expires < w->tick) {
+        expires = w->tick;
+    }
+    
+    vhost_timer_t *head = &w->slots[expires & (VHOST_WHEEL_SLOTS - 1)];
+    t->expires = expires;
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+    t->armed = true;
+    
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void wheel_cancel(vhost_engine_worker_t *w, vhost_timer_t *t)
+{
+    pthread_mutex_lock(&w->lock);
+    if (t->armed) {
+        timer_unlink(t);
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Expire every tick up to now; callbacks run without the wheel lock */
+static uint32_t wheel_advance(vhost_engine_worker_t *w, uint64_t now_us)
+{
+    uint64_t now_tick = now_us / VHOST_WHEEL_TICK_US;
+    uint32_t fired = 0;
+    
+    while (w->tick <= now_tick) {
+        vhost_timer_t *expired = NULL;
+        
+        pthread_mutex_lock(&w->lock);
+        vhost_timer_t *head = &w->slots[w->tick & (VHOST_WHEEL_SLOTS - 1)];
+        vhost_timer_t *t = head->next;
+        while (t != head) {
+            vhost_timer_t *next = t->next;
+            if (t->expires <= w->tick) {
+                timer_unlink(t);
+                t->next = expired;
+                expired = t;
+            }
+            t = next;
+        }
+        /* Timers armed from now on land on the following tick at the earliest */
+        w->tick++;
+        pthread_mutex_unlock(&w->lock);
+        
+        while (expired) {
+            vhost_timer_t *next = expired->next;
+            expired->next = NULL;
+            expired->fn(expired);
+            expired = next;
+            fired++;
+        }
+    }
+    
+    return fired;
+}
+
+/*
+ * MAC demux table (open addressing, built while the engine is stopped)
+ */
+
+static inline uint32_t mac_hash(const uint8_t *mac)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < VHOST_MAC_LEN; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h & (VHOST_ENGINE_MAC_TABLE_SIZE - 1);
+}
+
+static vhost_engine_mac_entry_t *mac_slot(vhost_engine_t *engine, const uint8_t *mac,
+                                          bool create)
+{
+    uint32_t idx = mac_hash(mac);
+    
+    for (uint32_t n = 0; n < VHOST_ENGINE_MAC_TABLE_SIZE; n++) {
+        vhost_engine_mac_entry_t *e = &engine->mac_table[idx];
+        if (!e->used) {
+            return create ? e : NULL;
+        }
+        if (memcmp(e->mac, mac, VHOST_MAC_LEN) == 0) {
+            return e;
+        }
+        idx = (idx + 1) & (VHOST_ENGINE_MAC_TABLE_SIZE - 1);
+    }
+    
+    return NULL;
+}
+
+/* Hand one received frame to its host(s) */
+static void uplink_deliver(vhost_engine_t *engine, vhost_engine_uplink_t *up,
+                           const uint8_t *data, uint16_t size)
+{
+    up->rx_frames++;
+    
+    if (size < 14) {
+        return;
+    }
+    
+    /* Broadcast/multicast: every host on the segment sees it */
+    if (data[0] & 0x01) {
+        up->flooded++;
+        for (uint32_t i = 0; i < up->num_hosts; i++) {
+            vhost_receive_frame(engine->host_mgr, up->host_ids[i], data, size);
+        }
+        return;
+    }
+    
+    vhost_engine_mac_entry_t *e = mac_slot(engine, data, false);
+    if (!e || engine->hosts[e->host_id].uplink != (uint32_t)(up - engine->uplinks)) {
+        up->unknown_dst++;
+        return;
+    }
+    
+    up->delivered++;
+    vhost_receive_frame(engine->host_mgr, e->host_id, data, size);
+}
+
+/* Pktgen pacing: send what is due, then re-arm for the next packet */
+static void pktgen_timer_fn(vhost_timer_t *timer)
+{
+    vhost_engine_host_t *eh = (vhost_engine_host_t *)
+        ((uint8_t *)timer - offsetof(vhost_engine_host_t, pktgen_timer));
+    vhost_engine_t *engine = eh->engine;
+    vhost_instance_t *host = &engine->host_mgr->hosts[eh->host_id];
+    static const uint8_t unresolved_mac[VHOST_MAC_LEN] = {0};
+    uint8_t packet[128];
+    uint64_t now = engine_now_us();
+    
+    if (!engine->running || !host->running || !host->pktgen.enabled) {
+        return;
+    }
+    
+    for (uint32_t burst = 0; eh->next_us <= now && burst < VHOST_ENGINE_PKTGEN_BURST; burst++) {
+        uint16_t pkt_size = vhost_build_udp_packet(
+            packet, sizeof(packet),
+            unresolved_mac, host->config.mac_addr,
+            host->pktgen.dst_ip, host->config.ip_addr,
+            host->pktgen.dst_port, 12345,
+            (uint8_t *)"Test packet", 11
+        );
+        
+        /* Unresolved next hops queue behind ARP instead of blocking the worker */
+        if (vhost_send_ip_packet(engine->host_mgr, eh->host_id, host->pktgen.dst_ip,
+                                 packet, pkt_size) == 0) {
+            eh->sent++;
+        }
+        eh->next_us += eh->interval_us;
+        
+        if (host->pktgen.count > 0 && eh->sent >= host->pktgen.count) {
+            host->pktgen.enabled = false;
+            return;
+        }
+    }
+    
+    /* Too far behind (overloaded worker): drop the backlog, keep the rate */
+    if (eh->next_us + eh->interval_us * VHOST_ENGINE_PKTGEN_BURST < now) {
+        eh->next_us = now;
+    }
+    
+    wheel_arm(&engine->workers[eh->worker], timer, eh->next_us);
+}
+
+/* Worker loop: poll owned uplinks, expire timers, nap when idle */
+static void *engine_worker_func(void *arg)
+{
+    vhost_engine_worker_t *w = (vhost_engine_worker_t *)arg;
+    vhost_engine_t *engine = w->engine;
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint16_t size;
+    
+    while (engine->running) {
+        uint32_t work = 0;
+        
+        for (uint32_t u = 0; u < engine->num_uplinks; u++) {
+            vhost_engine_uplink_t *up = &engine->uplinks[u];
+            if (up->worker != w->id) {
+                continue;
+            }
+            for (uint32_t n = 0; n < VHOST_ENGINE_RX_BURST; n++) {
+                if (vlink_poll(engine->link_mgr, up->link_id, frame, &size, sizeof(frame)) != 0) {
+                    break;
+                }
+                uplink_deliver(engine, up, frame, size);
+                w->rx_frames++;
+                work++;
+            }
+        }
+        
+        uint32_t fired = wheel_advance(w, engine_now_us());
+        w->timers_fired += fired;
+        work += fired;
+        
+        if (work) {
+            w->busy_loops++;
+        } else {
+            w->idle_loops++;
+            struct timespec nap = { .tv_sec = 0, .tv_nsec = VHOST_WHEEL_TICK_US * 500 };
+            nanosleep(&nap, NULL);
+        }
+    }
+    
+    return NULL;
+}
+
+/* Initialize engine */
+int vhost_engine_init(vhost_engine_t *engine, vhost_manager_t *host_mgr,
+                      uint32_t num_workers)
+{
+    if (!engine || !host_mgr || num_workers == 0 || num_workers > VHOST_ENGINE_MAX_WORKERS) {
+        return -1;
+    }
+    
+    memset(engine, 0, sizeof(*engine));
+    engine->host_mgr = host_mgr;
+    engine->link_mgr = host_mgr->link_mgr;
+    engine->num_workers = num_workers;
+    
+    engine->hosts = calloc(MAX_VHOSTS, sizeof(*engine->hosts));
+    engine->mac_table = calloc(VHOST_ENGINE_MAC_TABLE_SIZE, sizeof(*engine->mac_table));
+    if (!engine->hosts || !engine->mac_table) {
+        free(engine->hosts);
+        free(engine->mac_table);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < num_workers; i++) {
+        vhost_engine_worker_t *w = &engine->workers[i];
+        w->id = i;
+        w->engine = engine;
+        pthread_mutex_init(&w->lock, NULL);
+        wheel_init(w);
+    }
+    
+    return 0;
+}
+
+/* Cleanup engine */
+void vhost_engine_cleanup(vhost_engine_t *engine)
+{
+    if (!engine) {
+        return;
+    }
+    
+    vhost_engine_stop(engine);
+    
+    for (uint32_t i = 0; i < engine->num_workers; i++) {
+        pthread_mutex_destroy(&engine->workers[i].lock);
+    }
+    for (uint32_t i = 0; i < engine->num_uplinks; i++) {
+        free(engine->uplinks[i].host_ids);
+    }
+    
+    free(engine->hosts);
+    free(engine->mac_table);
+    engine->hosts = NULL;
+    engine->mac_table = NULL;
+}
+
+/* Create an uplink connected to a switch PCI link */
+int vhost_engine_add_uplink(vhost_engine_t *engine, uint32_t switch_pci_link_id,
+                            uint32_t *uplink_id)
+{
+    if (!engine || !uplink_id || engine->running ||
+        engine->num_uplinks >= VHOST_ENGINE_MAX_UPLINKS) {
+        return -1;
+    }
+    
+    uint32_t id = engine->num_uplinks;
+    vhost_engine_uplink_t *up = &engine->uplinks[id];
+    char link_name[64];
+    
+    memset(up, 0, sizeof(*up));
+    snprintf(link_name, sizeof(link_name), "engine_uplink%u", id);
+    
+    /* No simulated latency here: vlink_send would sleep in the worker */
+    if (vlink_create(engine->link_mgr, link_name, 100000, 0, 0.0, &up->link_id) != 0) {
+        return -1;
+    }
+    
+    if (vlink_connect(engine->link_mgr, up->link_id, switch_pci_link_id) != 0) {
+        return -1;
+    }
+    
+    up->worker = id % engine->num_workers;
+    engine->num_uplinks++;
+    *uplink_id = id;
+    
+    return 0;
+}
+
+/* Attach a created host to an uplink */
+int vhost_engine_attach_host(vhost_engine_t *engine, uint32_t host_id,
+                             uint32_t uplink_id)
+{
+    if (!engine || engine->running || uplink_id >= engine->num_uplinks ||
+        host_id >= engine->host_mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &engine->host_mgr->hosts[host_id];
+    vhost_engine_uplink_t *up = &engine->uplinks[uplink_id];
+    vhost_engine_host_t *eh = &engine->hosts[host_id];
+    
+    if (eh->attached) {
+        return -1;
+    }
+    
+    vhost_engine_mac_entry_t *e = mac_slot(engine, host->config.mac_addr, true);
+    if (!e || e->used) {
+        return -1;  /* Table full or duplicate MAC */
+    }
+    
+    if (up->num_hosts == up->cap_hosts) {
+        uint32_t cap = up->cap_hosts ? up->cap_hosts * 2 : 64;
+        uint32_t *ids = realloc(up->host_ids, cap * sizeof(*ids));
+        if (!ids) {
+            return -1;
+        }
+        up->host_ids = ids;
+        up->cap_hosts = cap;
+    }
+    up->host_ids[up->num_hosts++] = host_id;
+    
+    memcpy(e->mac, host->config.mac_addr, VHOST_MAC_LEN);
+    e->host_id = host_id;
+    e->used = true;
+    
+    eh->engine = engine;
+    eh->host_id = host_id;
+    eh->uplink = uplink_id;
+    eh->worker = up->worker;  /* Host state stays on its uplink's thread */
+    eh->pktgen_timer.fn = pktgen_timer_fn;
+    eh->attached = true;
+    
+    host->pci_link_id = up->link_id;
+    host->engine = engine;
+    
+    return 0;
+}
+
+/* Start uplinks and worker threads */
+int vhost_engine_start(vhost_engine_t *engine)
+{
+    if (!engine || engine->running) {
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < engine->num_uplinks; i++) {
+        vlink_start(engine->link_mgr, engine->uplinks[i].link_id);
+    }
+    
+    engine->running = true;
+    
+    for (uint32_t i = 0; i < engine->num_workers; i++) {
+        vhost_engine_worker_t *w = &engine->workers[i];
+        w->tick = engine_now_us() / VHOST_WHEEL_TICK_US;
+        if (pthread_create(&w->thread, NULL, engine_worker_func, w) != 0) {
+            engine->running = false;
+            for (uint32_t j = 0; j < i; j++) {
+                pthread_join(engine->workers[j].thread, NULL);
+            }
+            return -1;
+        }
+    }
+    
+    printf("Host engine started: %u workers, %u uplinks\n",
+           engine->num_workers, engine->num_uplinks);
+    
+    return 0;
+}
+
+/* Stop worker threads and uplinks */
+void vhost_engine_stop(vhost_engine_t *engine)
+{
+    if (!engine || !engine->running) {
+        return;
+    }
+    
+    engine->running = false;
+    
+    for (uint32_t i = 0; i < engine->num_workers; i++) {
+        pthread_join(engine->workers[i].thread, NULL);
+    }
+    
+    for (uint32_t h = 0; h < engine->host_mgr->num_hosts; h++) {
+        vhost_engine_host_t *eh = &engine->hosts[h];
+        if (eh->attached) {
+            wheel_cancel(&engine->workers[eh->worker], &eh->pktgen_timer);
+        }
+    }
+    
+    for (uint32_t i = 0; i < engine->num_uplinks; i++) {
+        vlink_stop(engine->link_mgr, engine->uplinks[i].link_id);
+    }
+}
+
+/* Start packet generator of an attached host */
+int vhost_engine_start_pktgen(vhost_engine_t *engine, uint32_t host_id)
+{
+    if (!engine || host_id >= engine->host_mgr->num_hosts ||
+        !engine->hosts[host_id].attached) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &engine->host_mgr->hosts[host_id];
+    vhost_engine_host_t *eh = &engine->hosts[host_id];
+    
+    if (host->pktgen.pps == 0 || host->pktgen.enabled) {
+        return host->pktgen.enabled ? 0 : -1;
+    }
+    
+    /* A configured destination MAC is a static neighbor; otherwise use ARP */
+    if (host->pktgen.dst_mac[0] | host->pktgen.dst_mac[1] | host->pktgen.dst_mac[2] |
+        host->pktgen.dst_mac[3] | host->pktgen.dst_mac[4] | host->pktgen.dst_mac[5]) {
+        vhost_add_neighbor(engine->host_mgr, host_id, host->pktgen.dst_ip,
+                           host->pktgen.dst_mac);
+    }
+    
+    eh->sent = 0;
+    eh->interval_us = 1000000ULL / host->pktgen.pps;
+    if (eh->interval_us == 0) {
+        eh->interval_us = 1;
+    }
+    
+    /* Spread first packets over one interval so hosts do not fire in lockstep */
+    eh->next_us = engine_now_us() + (host_id * 2654435761u) % eh->interval_us;
+    host->pktgen.enabled = true;
+    wheel_arm(&engine->workers[eh->worker], &eh->pktgen_timer, eh->next_us);
+    
+    return 0;
+}
+
+/* Print engine statistics */
+void vhost_engine_print_stats(vhost_engine_t *engine)
+{
+    if (!engine) {
+        return;
+    }
+    
+    vhost_stats_t total = {0};
+    uint32_t attached = 0;
+    
+    for (uint32_t h = 0; h < engine->host_mgr->num_hosts; h++) {
+        if (!engine->hosts[h].attached) {
+            continue;
+        }
+        vhost_stats_t st;
+        vhost_get_stats(engine->host_mgr, h, &st);
+        total.tx_packets += st.tx_packets;
+        total.tx_bytes += st.tx_bytes;
+        total.rx_packets += st.rx_packets;
+        total.rx_bytes += st.rx_bytes;
+        total.tx_errors += st.tx_errors;
+        total.arp_requests_tx += st.arp_requests_tx;
+        total.arp_replies_tx += st.arp_replies_tx;
+        total.arp_rx += st.arp_rx;
+        total.neigh_drops += st.neigh_drops;
+        attached++;
+    }
+    
+    printf("\n========================================\n");
+    printf("Host Engine Statistics\n");
+    printf("========================================\n");
+    printf("Hosts: %u on %u uplinks, %u workers\n",
+           attached, engine->num_uplinks, engine->num_workers);
+    
+    for (uint32_t i = 0; i < engine->num_workers; i++) {
+        vhost_engine_worker_t *w = &engine->workers[i];
+        uint64_t loops = w->busy_loops + w->idle_loops;
+        printf("  Worker %u: RX %lu frames, %lu timers fired, busy %.1f%%\n",
+               i, w->rx_frames, w->timers_fired,
+               loops ? 100.0 * w->busy_loops / loops : 0.0);
+    }
+    
+    for (uint32_t i = 0; i < engine->num_uplinks; i++) {
+        vhost_engine_uplink_t *up = &engine->uplinks[i];
+        printf("  Uplink %u (worker %u, %u hosts): RX %lu, delivered %lu, flooded %lu, unknown dst %lu\n",
+               i, up->worker, up->num_hosts, up->rx_frames, up->delivered,
+               up->flooded, up->unknown_dst);
+    }
+    
+    printf("Host totals:\n");
+    printf("  TX: %lu pkts / %lu bytes (errors: %lu)\n",
+           total.tx_packets, total.tx_bytes, total.tx_errors);
+    printf("  RX: %lu pkts / %lu bytes\n", total.rx_packets, total.rx_bytes);
+    printf("  ARP: %lu requests / %lu replies sent, %lu received (neighbor drops: %lu)\n",
+           total.arp_requests_tx, total.arp_replies_tx, total.arp_rx, total.neigh_drops);
+}
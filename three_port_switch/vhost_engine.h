@@ -0,0 +1,155 @@
+/*
+ * Virtual Host Engine
+ *
+ * Multiplexes many virtual hosts onto a small pool of worker threads.
+ * Hosts attach to a shared uplink per switch PCI port instead of owning
+ * a virtual link; each worker polls its uplinks, demultiplexes frames to
+ * hosts by destination MAC and runs the hosts' pktgen pacing from a
+ * timer wheel. Two threads per host become a fixed number of workers,
+ * so rack-scale host counts (thousands) fit in one process.
+ */
+
+#ifndef VHOST_ENGINE_H
+#define VHOST_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "virtual_link.h"
+#include "virtual_host.h"
+
+#define VHOST_ENGINE_MAX_WORKERS 64
+#define VHOST_ENGINE_MAX_UPLINKS 64
+#define VHOST_ENGINE_MAC_TABLE_SIZE 8192   /* Power of 2, >= 2 * MAX_VHOSTS */
+#define VHOST_ENGINE_RX_BURST 32           /* Frames per uplink per loop */
+#define VHOST_ENGINE_PKTGEN_BURST 8        /* Catch-up packets per timer */
+
+/* Timer wheel: 1024 slots of 100 us cover ~100 ms per revolution */
+#define VHOST_WHEEL_SLOTS 1024             /* Power of 2 */
+#define VHOST_WHEEL_TICK_US 100
+
+/* Timer wheel entry (intrusive, embedded in its owner) */
+typedef struct vhost_timer {
+    struct vhost_timer *next;
+    struct vhost_timer *prev;
+    uint64_t expires;         /* Absolute tick */
+    bool armed;
+    void (*fn)(struct vhost_timer *timer);
+} vhost_timer_t;
+
+/* Per-host engine state */
+typedef struct {
+    struct vhost_engine *engine;
+    uint32_t host_id;
+    uint32_t uplink;
+    uint32_t worker;
+    bool attached;
+    
+    /* Pktgen pacing */
+    vhost_timer_t pktgen_timer;
+    uint64_t next_us;
+    uint64_t interval_us;
+    uint32_t sent;
+} vhost_engine_host_t;
+
+/* Shared link between one switch PCI port and the hosts behind it */
+typedef struct {
+    uint32_t link_id;
+    uint32_t worker;
+    uint32_t *host_ids;       /* Broadcast fan-out list */
+    uint32_t num_hosts;
+    uint32_t cap_hosts;
+    
+    /* Statistics (owned by the polling worker) */
+    uint64_t rx_frames;
+    uint64_t delivered;
+    uint64_t flooded;         /* Broadcast/multicast frames */
+    uint64_t unknown_dst;     /* Unicast to a MAC not on this uplink */
+} vhost_engine_uplink_t;
+
+/* MAC -> host demux entry */
+typedef struct {
+    uint8_t mac[VHOST_MAC_LEN];
+    bool used;
+    uint32_t host_id;
+} vhost_engine_mac_entry_t;
+
+/* Worker thread: polls uplinks and runs a timer wheel */
+typedef struct {
+    uint32_t id;
+    struct vhost_engine *engine;
+    pthread_t thread;
+    
+    /* Timer wheel; arming from other threads takes the lock */
+    pthread_mutex_t lock;
+    vhost_timer_t slots[VHOST_WHEEL_SLOTS];  /* List heads */
+    uint64_t tick;            /* Next tick to expire */
+    
+    /* Statistics */
+    uint64_t timers_fired;
+    uint64_t rx_frames;
+    uint64_t busy_loops;
+    uint64_t idle_loops;
+} vhost_engine_worker_t;
+
+/* Host engine */
+typedef struct vhost_engine {
+    vhost_manager_t *host_mgr;
+    vlink_manager_t *link_mgr;
+    
+    vhost_engine_worker_t workers[VHOST_ENGINE_MAX_WORKERS];
+    uint32_t num_workers;
+    
+    vhost_engine_uplink_t uplinks[VHOST_ENGINE_MAX_UPLINKS];
+    uint32_t num_uplinks;
+    
+    vhost_engine_host_t *hosts;              /* Indexed by host_id */
+    vhost_engine_mac_entry_t *mac_table;     /* Read-only while running */
+    
+    volatile bool running;
+} vhost_engine_t;
+
+/*
+ * Initialize engine with num_workers worker threads
+ */
+int vhost_engine_init(vhost_engine_t *engine, vhost_manager_t *host_mgr,
+                      uint32_t num_workers);
+
+/*
+ * Cleanup engine (stops it first)
+ */
+void vhost_engine_cleanup(vhost_engine_t *engine);
+
+/*
+ * Create an uplink connected to a switch PCI link
+ */
+int vhost_engine_add_uplink(vhost_engine_t *engine, uint32_t switch_pci_link_id,
+                            uint32_t *uplink_id);
+
+/*
+ * Attach a created host to an uplink; replaces vhost_connect_to_switch
+ */
+int vhost_engine_attach_host(vhost_engine_t *engine, uint32_t host_id,
+                             uint32_t uplink_id);
+
+/*
+ * Start uplinks and worker threads
+ */
+int vhost_engine_start(vhost_engine_t *engine);
+
+/*
+ * Stop worker threads and uplinks
+ */
+void vhost_engine_stop(vhost_engine_t *engine);
+
+/*
+ * Start packet generator of an attached host (uses vhost_configure_pktgen config)
+ */
+int vhost_engine_start_pktgen(vhost_engine_t *engine, uint32_t host_id);
+
+/*
+ * Print per-worker and per-uplink statistics plus host totals
+ */
+void vhost_engine_print_stats(vhost_engine_t *engine);
+
+#endif /* VHOST_ENGINE_H */
@@ -15,6 +15,9 @@
 #include <getopt.h>
 #include "virtual_link.h"
 #include "virtual_host.h"
+#include "vhost_engine.h"
+#include "net_checksum.h"
+#include "l2_fwd.h"
 
 /* Switch instance */
 typedef struct {
@@ -26,6 +29,9 @@ typedef struct {
     uint32_t eth0_link_id;     /* Port 1 - Ethernet 0 */
     uint32_t eth1_link_id;     /* Port 2 - Ethernet 1 */
     
+    /* MAC learning forwarding plane */
+    l2_fwd_t fwd;
+    
     /* Port statistics */
     struct {
         uint64_t rx_packets;
@@ -45,6 +51,8 @@ static switch_instance_t switches[MAX_SWITCHES];
 static uint32_t num_switches = 0;
 static vlink_manager_t global_link_mgr;
 static vhost_manager_t global_host_mgr;
+static vhost_engine_t global_engine;
+static uint32_t hosts_per_switch = 0;   /* > 0: hosts run on the shared engine */
 static volatile bool keep_running = true;
 
 /* Signal handler */
@@ -75,123 +83,74 @@ static bool check_and_decrement_ttl(uint8_t *packet, uint16_t size)
         return false;  /* Drop packet, TTL expired */
     }
     
-    (*ttl_ptr)--;
-    
-    /* Recalculate IP checksum */
-    uint8_t *ip_hdr = &packet[14];
-    ip_hdr[10] = 0;
-    ip_hdr[11] = 0;
-    
-    uint32_t sum = 0;
-    for (int i = 0; i < 20; i += 2) {
-        sum += (ip_hdr[i] << 8) | ip_hdr[i + 1];
-    }
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    uint16_t checksum = ~sum;
-    ip_hdr[10] = (checksum >> 8) & 0xFF;
-    ip_hdr[11] = checksum & 0xFF;
+    /* RFC 1624 update of the TTL/protocol word; no header re-sum */
+    net_ipv4_dec_ttl(&packet[14]);
     
     return *ttl_ptr > 0;
 }
 
-/* Forward packet based on three-port switch logic */
-static uint8_t get_forward_port(uint8_t input_port)
+/* Link attached to a switch port */
+static uint32_t port_link(const switch_instance_t *sw, uint8_t port)
 {
-    switch (input_port) {
-        case 0: return 1;  /* PCI -> Eth0 */
-        case 1: return 2;  /* Eth0 -> Eth1 */
-        case 2: return 0;  /* Eth1 -> PCI */
-        default: return 0;
+    switch (port) {
+        case 0: return sw->pci_link_id;
+        case 1: return sw->eth0_link_id;
+        default: return sw->eth1_link_id;
     }
 }
 
-/* RX callback for PCI port */
-static void pci_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+/* Learn, look up and send a frame received on in_port to its egress ports */
+static void switch_port_rx(switch_instance_t *sw, uint8_t in_port,
+                           const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
     uint8_t packet[9000];
     
     memcpy(packet, data, size);
     
-    sw->port_stats[0].rx_packets++;
-    sw->port_stats[0].rx_bytes += size;
+    sw->port_stats[in_port].rx_packets++;
+    sw->port_stats[in_port].rx_bytes += size;
+    
+    uint32_t out_ports = l2_fwd_forward(&sw->fwd, in_port, packet, size,
+                                        l2_fwd_now_ms());
+    if (out_ports == L2_FWD_DROP) {
+        return;
+    }
     
     /* Check TTL */
     if (!check_and_decrement_ttl(packet, size)) {
-        sw->port_stats[0].drops++;
+        sw->port_stats[in_port].drops++;
         return;
     }
     
-    /* Forward to Eth0 (port 1) */
-    uint8_t out_port = get_forward_port(0);
-    uint32_t out_link = (out_port == 1) ? sw->eth0_link_id : sw->eth1_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, packet, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
+    for (uint8_t out_port = 0; out_port < 3; out_port++) {
+        if (!(out_ports & (1u << out_port))) {
+            continue;
+        }
+        if (vlink_send(sw->link_mgr, port_link(sw, out_port), packet, size) == 0) {
+            sw->port_stats[out_port].tx_packets++;
+            sw->port_stats[out_port].tx_bytes += size;
+        } else {
+            sw->port_stats[out_port].drops++;
+        }
     }
 }
 
+/* RX callback for PCI port */
+static void pci_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+{
+    switch_port_rx((switch_instance_t *)ctx, 0, data, size);
+}
+
 /* RX callback for Eth0 port */
 static void eth0_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
-    uint8_t packet[9000];
-    
-    memcpy(packet, data, size);
-    
-    sw->port_stats[1].rx_packets++;
-    sw->port_stats[1].rx_bytes += size;
-    
-    /* Check TTL */
-    if (!check_and_decrement_ttl(packet, size)) {
-        sw->port_stats[1].drops++;
-        return;
-    }
-    
-    /* Forward to Eth1 (port 2) */
-    uint8_t out_port = get_forward_port(1);
-    uint32_t out_link = (out_port == 2) ? sw->eth1_link_id : sw->pci_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, packet, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
-    }
+    switch_port_rx((switch_instance_t *)ctx, 1, data, size);
 }
 
 /* RX callback for Eth1 port */
 static void eth1_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
-    uint8_t packet[9000];
-    
-    memcpy(packet, data, size);
-    
-    sw->port_stats[2].rx_packets++;
-    sw->port_stats[2].rx_bytes += size;
-    
-    /* Check TTL */
-    if (!check_and_decrement_ttl(packet, size)) {
-        sw->port_stats[2].drops++;
-        return;
-    }
-    
-    /* Forward to PCI (port 0) */
-    uint8_t out_port = get_forward_port(2);
-    uint32_t out_link = (out_port == 0) ? sw->pci_link_id : sw->eth0_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, packet, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
-    }
+    switch_port_rx((switch_instance_t *)ctx, 2, data, size);
 }
 
 /* Create a switch instance */
@@ -210,6 +169,11 @@ static int create_switch(uint32_t switch_id, const char *name)
     sw->running = true;
     sw->ttl = 64;
     
+    if (l2_fwd_init(&sw->fwd, 3, 2 * MAX_VHOSTS, 0) != 0) {
+        num_switches--;
+        return -1;
+    }
+    
     /* Create virtual links for each port */
     char link_name[64];
     
@@ -248,8 +212,13 @@ static void connect_ring_topology(void)
                      switches[i].eth1_link_id,
                      switches[next].eth0_link_id);
         
-        printf("  Switch %u (eth1) <-> Switch %u (eth0)\n", i, next);
+        printf("  Switch %u (eth1) <-> Switch %u (eth0)%s\n", i, next,
+               next == 0 ? " [blocked]" : "");
     }
+    
+    /* Block the link closing the ring, as spanning tree would, so floods end */
+    l2_fwd_set_port_state(&switches[num_switches - 1].fwd, 2, L2_PORT_BLOCKING);
+    l2_fwd_set_port_state(&switches[0].fwd, 1, L2_PORT_BLOCKING);
 }
 
 /* Host packet handler - prints received packets */
@@ -271,7 +240,7 @@ static void host_packet_handler(void *ctx, const uint8_t *data, uint16_t size)
 }
 
 /* Create virtual hosts */
-static void create_hosts(uint32_t count)
+static void create_hosts(uint32_t count, bool print_packets)
 {
     printf("\nCreating %u virtual hosts...\n", count);
     
@@ -297,7 +266,9 @@ static void create_hosts(uint32_t count)
         /* Set packet handler */
         static uint32_t host_ids[MAX_SWITCHES];
         host_ids[i] = i;
-        vhost_set_packet_handler(&global_host_mgr, host_id, host_packet_handler, &host_ids[i]);
+        if (print_packets) {
+            vhost_set_packet_handler(&global_host_mgr, host_id, host_packet_handler, &host_ids[i]);
+        }
         
         /* Start host */
         vhost_start(&global_host_mgr, host_id);
@@ -306,6 +277,87 @@ static void create_hosts(uint32_t count)
     }
 }
 
+/*
+ * Create hosts_per_switch hosts behind every switch, multiplexed on the
+ * shared host engine. Host h of switch s is 02:00:00:<s>:<h> / 10.<s>.<h>.
+ */
+static int create_engine_hosts(uint32_t count, uint32_t per_switch, uint32_t workers)
+{
+    printf("\nCreating %u virtual hosts on %u engine workers (%u per switch)...\n",
+           count * per_switch, workers, per_switch);
+    
+    if (vhost_engine_init(&global_engine, &global_host_mgr, workers) != 0) {
+        fprintf(stderr, "Failed to initialize host engine\n");
+        return -1;
+    }
+    
+    for (uint32_t s = 0; s < count; s++) {
+        uint32_t uplink;
+        if (vhost_engine_add_uplink(&global_engine, switches[s].pci_link_id, &uplink) != 0) {
+            fprintf(stderr, "Failed to create uplink for switch %u\n", s);
+            return -1;
+        }
+        
+        for (uint32_t h = 0; h < per_switch; h++) {
+            char name[64];
+            uint8_t mac[6] = {0x02, 0x00, 0x00, (uint8_t)s, (uint8_t)(h >> 8), (uint8_t)h};
+            uint8_t ip[4] = {10, (uint8_t)s, (uint8_t)(h >> 8), (uint8_t)h};
+            uint32_t host_id;
+            
+            snprintf(name, sizeof(name), "Host-%u.%u", s, h);
+            
+            if (vhost_create(&global_host_mgr, name, mac, ip, &host_id) != 0 ||
+                vhost_engine_attach_host(&global_engine, host_id, uplink) != 0) {
+                fprintf(stderr, "Failed to create host %u on switch %u\n", h, s);
+                return -1;
+            }
+        }
+    }
+    
+    if (vhost_engine_start(&global_engine) != 0) {
+        fprintf(stderr, "Failed to start host engine\n");
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < global_host_mgr.num_hosts; i++) {
+        vhost_start(&global_host_mgr, i);
+    }
+    
+    return 0;
+}
+
+/*
+ * Engine pktgen: host h of switch s sends to host h of switch s-1
+ */
+static void start_engine_pktgen(uint32_t pps, uint32_t count)
+{
+    printf("\nStarting %u engine packet generators (%u pps, %u packets each)...\n",
+           global_host_mgr.num_hosts, pps, count);
+    
+    for (uint32_t s = 0; s < num_switches; s++) {
+        uint32_t dst_sw = (s + num_switches - 1) % num_switches;
+        for (uint32_t h = 0; h < hosts_per_switch; h++) {
+            uint32_t host_id = s * hosts_per_switch + h;
+            vhost_pktgen_config_t config = {0};
+            config.pkt_size = 128;
+            config.pps = pps;
+            config.count = count;
+            config.dst_mac[0] = 0x02;
+            config.dst_mac[3] = dst_sw;
+            config.dst_mac[4] = h >> 8;
+            config.dst_mac[5] = h;
+            config.dst_ip[0] = 10;
+            config.dst_ip[1] = dst_sw;
+            config.dst_ip[2] = h >> 8;
+            config.dst_ip[3] = h;
+            config.dst_port = 5000;
+            
+            vhost_configure_pktgen(&global_host_mgr, host_id, &config);
+            vhost_engine_start_pktgen(&global_engine, host_id);
+        }
+    }
+}
+
 /* Configure packet generators on hosts */
 static void configure_pktgen(bool enabled, uint32_t pps, uint32_t count)
 {
@@ -348,6 +400,59 @@ static void start_all_pktgen(void)
     }
 }
 
+/*
+ * Closed-loop RPC: host 0 keeps `outstanding` requests in flight to the
+ * last host, which echoes them from its RX path.
+ */
+static int start_rpc(uint32_t outstanding, uint32_t size, uint32_t count)
+{
+    uint32_t server = global_host_mgr.num_hosts - 1;
+    vhost_rpc_config_t config = {0};
+    vhost_config_t server_cfg;
+    
+    vhost_get_config(&global_host_mgr, server, &server_cfg);
+    memcpy(config.dst_ip, server_cfg.ip_addr, sizeof(config.dst_ip));
+    config.dst_port = 7000;
+    config.outstanding = outstanding;
+    config.req_size = size;
+    config.resp_size = size;
+    config.count = count;
+    
+    printf("\nStarting closed-loop RPC: Host 0 -> Host %u (K=%u, %u B, %u transactions)\n",
+           server, outstanding, size, count);
+    
+    vhost_start_rpc_server(&global_host_mgr, server, config.dst_port);
+    if (vhost_configure_rpc(&global_host_mgr, 0, &config) != 0 ||
+        vhost_start_rpc_client(&global_host_mgr, 0) != 0) {
+        fprintf(stderr, "Failed to start RPC client\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Latency probes from host 0 to the last host, alongside any bulk traffic */
+static int start_ping(uint32_t interval_us)
+{
+    uint32_t target = global_host_mgr.num_hosts - 1;
+    vhost_ping_config_t config = {0};
+    vhost_config_t target_cfg;
+    
+    vhost_get_config(&global_host_mgr, target, &target_cfg);
+    memcpy(config.dst_ip, target_cfg.ip_addr, sizeof(config.dst_ip));
+    config.interval_us = interval_us;
+    config.payload_size = 56;
+    
+    printf("\nStarting ping: Host 0 -> Host %u every %u us\n", target, interval_us);
+    
+    if (vhost_start_ping(&global_host_mgr, 0, &config) != 0) {
+        fprintf(stderr, "Failed to start ping\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
 /* Print all statistics */
 static void print_all_stats(void)
 {
@@ -371,9 +476,17 @@ static void print_all_stats(void)
                sw->port_stats[2].rx_packets, sw->port_stats[2].rx_bytes,
                sw->port_stats[2].tx_packets, sw->port_stats[2].tx_bytes,
                sw->port_stats[2].drops);
+        l2_fwd_print_stats(&sw->fwd, sw->name);
     }
     
-    vhost_print_stats(&global_host_mgr);
+    if (hosts_per_switch > 0) {
+        vhost_engine_print_stats(&global_engine);
+        vhost_print_rpc_stats(&global_host_mgr, 0);
+        vhost_print_rpc_stats(&global_host_mgr, global_host_mgr.num_hosts - 1);
+        vhost_print_ping_stats(&global_host_mgr, 0);
+    } else {
+        vhost_print_stats(&global_host_mgr);
+    }
 }
 
 /* Usage */
@@ -387,6 +500,13 @@ static void print_usage(const char *prog)
     printf("  -r RATE     Packet generation rate in pps (default: 100)\n");
     printf("  -c COUNT    Number of packets to send (default: 100, 0=infinite)\n");
     printf("  -d DURATION Run duration in seconds (default: 10)\n");
+    printf("  -R K        Closed-loop RPC from host 0 to the last host, K requests in flight\n");
+    printf("              (-c sets the transaction count, 0=until the duration ends)\n");
+    printf("  -s SIZE     RPC request/response payload bytes (default: 64)\n");
+    printf("  -P USEC     Ping host 0 -> last host every USEC microseconds during the run\n");
+    printf("  -H NUM      Hosts per switch on the shared host engine (default: 0 = one\n");
+    printf("              threaded host per switch, max: %d total)\n", MAX_VHOSTS);
+    printf("  -w NUM      Host engine worker threads (default: 4)\n");
     printf("  -h          Show this help\n");
 }
 
@@ -398,9 +518,13 @@ int main(int argc, char *argv[])
     uint32_t pps = 100;
     uint32_t pkt_count = 100;
     uint32_t duration = 10;
+    uint32_t rpc_outstanding = 0;
+    uint32_t rpc_size = 64;
+    uint32_t engine_workers = 4;
+    uint32_t ping_interval = 0;
     
     /* Parse arguments */
-    while ((opt = getopt(argc, argv, "n:pr:c:d:h")) != -1) {
+    while ((opt = getopt(argc, argv, "n:pr:c:d:R:s:P:H:w:h")) != -1) {
         switch (opt) {
             case 'n':
                 num = atoi(optarg);
@@ -421,6 +545,30 @@ int main(int argc, char *argv[])
             case 'd':
                 duration = atoi(optarg);
                 break;
+            case 'R':
+                rpc_outstanding = atoi(optarg);
+                if (rpc_outstanding < 1 || rpc_outstanding > VHOST_RPC_MAX_OUTSTANDING) {
+                    fprintf(stderr, "Invalid outstanding requests (1-%d)\n",
+                            VHOST_RPC_MAX_OUTSTANDING);
+                    return 1;
+                }
+                break;
+            case 's':
+                rpc_size = atoi(optarg);
+                break;
+            case 'P':
+                ping_interval = atoi(optarg);
+                break;
+            case 'H':
+                hosts_per_switch = atoi(optarg);
+                break;
+            case 'w':
+                engine_workers = atoi(optarg);
+                if (engine_workers < 1 || engine_workers > VHOST_ENGINE_MAX_WORKERS) {
+                    fprintf(stderr, "Invalid worker count (1-%d)\n", VHOST_ENGINE_MAX_WORKERS);
+                    return 1;
+                }
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -430,6 +578,11 @@ int main(int argc, char *argv[])
         }
     }
     
+    if (hosts_per_switch > 0 && hosts_per_switch * num > MAX_VHOSTS) {
+        fprintf(stderr, "Too many hosts (%u x %u > %d)\n", hosts_per_switch, num, MAX_VHOSTS);
+        return 1;
+    }
+    
     /* Setup signal handler */
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -444,6 +597,14 @@ int main(int argc, char *argv[])
         printf("  Rate: %u pps\n", pps);
         printf("  Count: %u packets\n", pkt_count);
     }
+    if (rpc_outstanding > 0) {
+        printf("RPC: %u outstanding, %u B, %u transactions\n",
+               rpc_outstanding, rpc_size, pkt_count);
+    }
+    if (hosts_per_switch > 0) {
+        printf("Host Engine: %u hosts per switch on %u workers\n",
+               hosts_per_switch, engine_workers);
+    }
     printf("Duration: %u seconds\n", duration);
     printf("\n");
     
@@ -474,31 +635,70 @@ int main(int argc, char *argv[])
     connect_ring_topology();
     
     /* Create and connect hosts */
-    create_hosts(num);
+    if (hosts_per_switch > 0) {
+        if (create_engine_hosts(num, hosts_per_switch, engine_workers) != 0) {
+            return 1;
+        }
+    } else {
+        create_hosts(num, rpc_outstanding == 0);
+    }
     
     /* Configure packet generation */
-    if (enable_pktgen) {
+    if (enable_pktgen && hosts_per_switch > 0) {
+        start_engine_pktgen(pps, pkt_count);
+    } else if (enable_pktgen) {
         configure_pktgen(true, pps, pkt_count);
         start_all_pktgen();
     }
     
+    if (rpc_outstanding > 0 && start_rpc(rpc_outstanding, rpc_size, pkt_count) != 0) {
+        rpc_outstanding = 0;
+    }
+    
+    if (ping_interval > 0 && start_ping(ping_interval) != 0) {
+        ping_interval = 0;
+    }
+    
     printf("\n✓ All components running!\n");
     printf("Press Ctrl+C to stop and show statistics\n\n");
     
     /* Run for specified duration or until interrupted */
     for (uint32_t i = 0; i < duration && keep_running; i++) {
-        sleep(1);
-        if (enable_pktgen && (i % 5 == 0)) {
+        if (rpc_outstanding > 0) {
+            /* Finish early once the RPC client has completed its count */
+            if (vhost_wait_rpc_client(&global_host_mgr, 0, 1000) == 0) {
+                break;
+            }
+        } else {
+            sleep(1);
+        }
+        for (uint32_t s = 0; s < num_switches; s++) {
+            l2_fwd_age(&switches[s].fwd, l2_fwd_now_ms());
+        }
+        if ((enable_pktgen || rpc_outstanding > 0) && (i % 5 == 0)) {
             printf("Running... (%u/%u seconds)\n", i, duration);
         }
     }
     
+    if (rpc_outstanding > 0) {
+        vhost_stop_rpc_client(&global_host_mgr, 0);
+    }
+    if (ping_interval > 0) {
+        vhost_stop_ping(&global_host_mgr, 0);
+    }
+    
     /* Print final statistics */
     print_all_stats();
     
     /* Cleanup */
     printf("\nCleaning up...\n");
+    if (hosts_per_switch > 0) {
+        vhost_engine_stop(&global_engine);
+    }
     vhost_manager_cleanup(&global_host_mgr);
+    if (hosts_per_switch > 0) {
+        vhost_engine_cleanup(&global_engine);
+    }
     
     for (uint32_t i = 0; i < num_switches; i++) {
         vlink_stop(&global_link_mgr, switches[i].pci_link_id);
@@ -507,6 +707,9 @@ int main(int argc, char *argv[])
     }
     
     vlink_manager_cleanup(&global_link_mgr);
+    for (uint32_t i = 0; i < num_switches; i++) {
+        l2_fwd_cleanup(&switches[i].fwd);
+    }
     
     printf("Done.\n");
     
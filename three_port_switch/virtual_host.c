@@ -3,386 +3,1810 @@
  */
 
 #include "virtual_host.h"
+#include "net_checksum.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
 #include <arpa/inet.h>
 
-/* RX callback from virtual link */
-static void vhost_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+/* Helper: Get current time in microseconds */
+static uint64_t vhost_now_us(void)
 {
-    vhost_instance_t *host = (vhost_instance_t *)ctx;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t vhost_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool mac_is_zero(const uint8_t *mac)
+{
+    static const uint8_t zero[VHOST_MAC_LEN] = {0};
+    return memcmp(mac, zero, VHOST_MAC_LEN) == 0;
+}
+
+/* Transmit a frame on the host's PCI link and account for it */
+static int vhost_xmit(vhost_instance_t *host, const uint8_t *data, uint16_t size)
+{
+    if (vlink_send(host->link_mgr, host->pci_link_id, data, size) != 0) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.tx_errors++;
+        pthread_mutex_unlock(&host->lock);
+        return -1;
+    }
     
     pthread_mutex_lock(&host->lock);
-    host->stats.rx_packets++;
-    host->stats.rx_bytes += size;
+    host->stats.tx_packets++;
+    host->stats.tx_bytes += size;
     pthread_mutex_unlock(&host->lock);
     
-    /* Call custom handler if set */
-    if (host->pkt_handler) {
-        host->pkt_handler(host->pkt_handler_ctx, data, size);
+    return 0;
+}
+
+/* Send a broadcast ARP request for target_ip */
+static void vhost_send_arp_request(vhost_instance_t *host, const uint8_t *target_ip)
+{
+    uint8_t packet[64];
+    uint16_t size = vhost_build_arp_request(packet, sizeof(packet),
+                                            host->config.mac_addr,
+                                            host->config.ip_addr, target_ip);
+    
+    if (size > 0 && vhost_xmit(host, packet, size) == 0) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.arp_requests_tx++;
+        pthread_mutex_unlock(&host->lock);
     }
 }
 
-/* Packet generator thread */
-static void *pktgen_thread_func(void *arg)
+/*
+ * Neighbor table
+ *
+ * Open addressing with linear probing. Entries are never removed
+ * individually (only by a full flush), so probe chains stay intact
+ * without tombstones. Caller holds neigh.lock.
+ */
+static inline uint32_t neigh_hash(uint32_t ip)
 {
-    vhost_instance_t *host = (vhost_instance_t *)arg;
-    uint8_t packet[9000];
-    uint32_t sent = 0;
-    uint64_t interval_ns = 1000000000ULL / host->pktgen.pps;
-    struct timespec next_time, now;
-    bool arp_sent = false;
+    return (ip * 2654435761U) & (VHOST_NEIGH_TABLE_SIZE - 1);
+}
+
+static vhost_neigh_entry_t *neigh_find(vhost_neigh_table_t *tbl, uint32_t ip, bool create)
+{
+    uint32_t idx = neigh_hash(ip);
     
-    printf("[PKTGEN] Thread started for host %u (running=%d, enabled=%d, pps=%u)\n",
-           host->host_id, host->running, host->pktgen.enabled, host->pktgen.pps);
+    for (uint32_t i = 0; i < VHOST_NEIGH_TABLE_SIZE; i++) {
+        vhost_neigh_entry_t *e = &tbl->entries[(idx + i) & (VHOST_NEIGH_TABLE_SIZE - 1)];
+        
+        if (e->state == VHOST_NEIGH_FREE) {
+            if (!create) {
+                return NULL;
+            }
+            memset(e, 0, sizeof(*e));
+            e->ip = ip;
+            e->state = VHOST_NEIGH_INCOMPLETE;
+            tbl->count++;
+            return e;
+        }
+        
+        if (e->ip == ip) {
+            return e;
+        }
+    }
     
-    clock_gettime(CLOCK_MONOTONIC, &next_time);
+    return NULL;  /* Table full */
+}
+
+static inline bool neigh_usable(const vhost_neigh_entry_t *e)
+{
+    return e->state == VHOST_NEIGH_REACHABLE || e->state == VHOST_NEIGH_STATIC;
+}
+
+/* Detach the pending list of an entry */
+static vhost_pending_pkt_t *neigh_take_pending(vhost_neigh_entry_t *e)
+{
+    vhost_pending_pkt_t *list = e->pending_head;
     
-    /* Send ARP request first to establish MAC-IP mapping */
-    if (!arp_sent) {
-        uint16_t arp_size = vhost_build_arp_request(
-            packet, sizeof(packet),
-            host->config.mac_addr,
-            host->config.ip_addr,
-            host->pktgen.dst_ip
-        );
+    e->pending_head = NULL;
+    e->pending_tail = NULL;
+    e->pending_count = 0;
+    
+    return list;
+}
+
+/* Free a pending list, counting the packets as neighbor drops */
+static void neigh_drop_pending(vhost_instance_t *host, vhost_pending_pkt_t *list)
+{
+    uint64_t dropped = 0;
+    
+    while (list) {
+        vhost_pending_pkt_t *next = list->next;
+        free(list);
+        list = next;
+        dropped++;
+    }
+    
+    if (dropped) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.neigh_drops += dropped;
+        pthread_mutex_unlock(&host->lock);
+    }
+}
+
+/* Transmit a pending list now that the destination MAC is known */
+static void neigh_flush_pending(vhost_instance_t *host, vhost_pending_pkt_t *list,
+                                const uint8_t *mac)
+{
+    while (list) {
+        vhost_pending_pkt_t *next = list->next;
+        memcpy(list->data, mac, VHOST_MAC_LEN);
+        vhost_xmit(host, list->data, list->size);
+        free(list);
+        list = next;
+    }
+}
+
+/*
+ * Record ip -> mac. Existing dynamic entries are always refreshed; new
+ * entries are only created when create is set (ARP traffic addressed to us).
+ */
+static void neigh_update(vhost_instance_t *host, const uint8_t *ip, const uint8_t *mac,
+                         bool create)
+{
+    vhost_neigh_table_t *tbl = &host->neigh;
+    vhost_pending_pkt_t *pending = NULL;
+    uint32_t key;
+    
+    memcpy(&key, ip, sizeof(key));
+    
+    pthread_mutex_lock(&tbl->lock);
+    
+    vhost_neigh_entry_t *e = neigh_find(tbl, key, create);
+    if (e && e->state != VHOST_NEIGH_STATIC) {
+        memcpy(e->mac, mac, VHOST_MAC_LEN);
+        e->state = VHOST_NEIGH_REACHABLE;
+        e->updated_us = vhost_now_us();
+        e->probes = 0;
+        pending = neigh_take_pending(e);
+        pthread_cond_broadcast(&tbl->resolved);
+    }
+    
+    pthread_mutex_unlock(&tbl->lock);
+    
+    neigh_flush_pending(host, pending, mac);
+}
+
+/* Process a received ARP packet */
+static void vhost_arp_input(vhost_instance_t *host, const uint8_t *data, uint16_t size)
+{
+    if (size < 14 + 28) {
+        return;
+    }
+    
+    const uint8_t *arp = data + 14;
+    
+    /* Ethernet/IPv4 ARP only */
+    if (arp[0] != 0x00 || arp[1] != 0x01 || arp[2] != 0x08 || arp[3] != 0x00 ||
+        arp[4] != 6 || arp[5] != 4) {
+        return;
+    }
+    
+    uint16_t op = (arp[6] << 8) | arp[7];
+    const uint8_t *sha = arp + 8;
+    const uint8_t *spa = arp + 14;
+    const uint8_t *tpa = arp + 24;
+    static const uint8_t any_ip[VHOST_IP_LEN] = {0};
+    
+    pthread_mutex_lock(&host->lock);
+    host->stats.arp_rx++;
+    pthread_mutex_unlock(&host->lock);
+    
+    /* Ignore probes (sender 0.0.0.0) and our own announcements */
+    if (memcmp(spa, any_ip, VHOST_IP_LEN) == 0 ||
+        memcmp(spa, host->config.ip_addr, VHOST_IP_LEN) == 0) {
+        return;
+    }
+    
+    bool for_us = memcmp(tpa, host->config.ip_addr, VHOST_IP_LEN) == 0;
+    
+    /* Gratuitous and overheard ARP only refresh existing entries */
+    neigh_update(host, spa, sha, for_us);
+    
+    if (op == 1 && for_us) {
+        uint8_t reply[64];
+        uint16_t reply_size = vhost_build_arp_reply(reply, sizeof(reply),
+                                                    host->config.mac_addr,
+                                                    host->config.ip_addr,
+                                                    sha, spa);
+        if (reply_size > 0 && vhost_xmit(host, reply, reply_size) == 0) {
+            pthread_mutex_lock(&host->lock);
+            host->stats.arp_replies_tx++;
+            pthread_mutex_unlock(&host->lock);
+        }
+    }
+}
+
+/*
+ * Send an IPv4 frame through the neighbor cache. The frame is copied
+ * into the pending queue when the next hop is not resolved yet.
+ */
+static int host_send_ip(vhost_instance_t *host, const uint8_t *dst_ip,
+                        uint8_t *frame, uint16_t size)
+{
+    vhost_neigh_table_t *tbl = &host->neigh;
+    vhost_pending_pkt_t *failed = NULL;
+    uint64_t now = vhost_now_us();
+    bool send_arp = false;
+    uint32_t key;
+    
+    memcpy(&key, dst_ip, sizeof(key));
+    
+    pthread_mutex_lock(&tbl->lock);
+    
+    vhost_neigh_entry_t *e = neigh_find(tbl, key, true);
+    if (!e) {
+        pthread_mutex_unlock(&tbl->lock);
+        pthread_mutex_lock(&host->lock);
+        host->stats.neigh_drops++;
+        pthread_mutex_unlock(&host->lock);
+        return -1;
+    }
+    
+    if (neigh_usable(e)) {
+        memcpy(frame, e->mac, VHOST_MAC_LEN);
+        
+        /* Refresh aged entries in the background, keep using the old MAC */
+        if (e->state == VHOST_NEIGH_REACHABLE &&
+            now - e->updated_us > VHOST_NEIGH_REACHABLE_MS * 1000ULL &&
+            now - e->probe_us > VHOST_ARP_RETRANS_MS * 1000ULL) {
+            e->probe_us = now;
+            send_arp = true;
+        }
         
-        if (arp_size > 0) {
-            int arp_result = vlink_send(host->link_mgr, host->pci_link_id, packet, arp_size);
-            if (arp_result == 0) {
-                printf("[PKTGEN] Host %u: Sent ARP request for %u.%u.%u.%u\n",
-                       host->host_id,
-                       host->pktgen.dst_ip[0], host->pktgen.dst_ip[1],
-                       host->pktgen.dst_ip[2], host->pktgen.dst_ip[3]);
-                arp_sent = true;
-                
-                /* Wait a bit for ARP reply */
-                usleep(100000);  /* 100ms */
+        pthread_mutex_unlock(&tbl->lock);
+        
+        if (send_arp) {
+            vhost_send_arp_request(host, dst_ip);
+        }
+        return vhost_xmit(host, frame, size);
+    }
+    
+    /* Unresolved: retransmit or give up on the previous attempt */
+    if (e->probes == 0 || now - e->probe_us >= VHOST_ARP_RETRANS_MS * 1000ULL) {
+        if (e->probes >= VHOST_ARP_MAX_PROBES) {
+            failed = neigh_take_pending(e);
+            e->probes = 0;
+        }
+        e->probes++;
+        e->probe_us = now;
+        send_arp = true;
+    }
+    
+    int ret = 0;
+    if (e->pending_count < VHOST_NEIGH_MAX_PENDING) {
+        vhost_pending_pkt_t *p = malloc(sizeof(*p) + size);
+        if (p) {
+            p->next = NULL;
+            p->size = size;
+            memcpy(p->data, frame, size);
+            if (e->pending_tail) {
+                e->pending_tail->next = p;
             } else {
-                printf("[PKTGEN] Host %u: Failed to send ARP request\n", host->host_id);
+                e->pending_head = p;
             }
+            e->pending_tail = p;
+            e->pending_count++;
+        } else {
+            ret = -1;
         }
+    } else {
+        ret = -1;
     }
     
-    while (host->running && host->pktgen.enabled) {
-        /* Build packet */
-        uint16_t pkt_size = vhost_build_udp_packet(
-            packet, sizeof(packet),
-            host->pktgen.dst_mac, host->config.mac_addr,
-            host->pktgen.dst_ip, host->config.ip_addr,
-            host->pktgen.dst_port, 12345,
-            (uint8_t *)"Test packet", 11
-        );
+    pthread_mutex_unlock(&tbl->lock);
+    
+    neigh_drop_pending(host, failed);
+    if (ret != 0) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.neigh_drops++;
+        pthread_mutex_unlock(&host->lock);
+    }
+    if (send_arp) {
+        vhost_send_arp_request(host, dst_ip);
+    }
+    
+    return ret;
+}
+
+/* Blocking resolve; returns as soon as the ARP reply is processed */
+static int host_resolve(vhost_instance_t *host, const uint8_t *ip, uint8_t *mac,
+                        uint32_t timeout_ms)
+{
+    vhost_neigh_table_t *tbl = &host->neigh;
+    uint64_t deadline = vhost_now_us() + timeout_ms * 1000ULL;
+    uint32_t key;
+    int ret = -1;
+    
+    memcpy(&key, ip, sizeof(key));
+    
+    pthread_mutex_lock(&tbl->lock);
+    
+    while (host->running) {
+        vhost_neigh_entry_t *e = neigh_find(tbl, key, true);
+        if (!e) {
+            break;
+        }
         
-        if (pkt_size == 0) {
-            printf("[PKTGEN] Host %u: build_udp_packet failed\n", host->host_id);
-            host->stats.tx_errors++;
+        if (neigh_usable(e)) {
+            memcpy(mac, e->mac, VHOST_MAC_LEN);
+            ret = 0;
             break;
         }
         
-        /* Send packet */
-        int send_result = vlink_send(host->link_mgr, host->pci_link_id, packet, pkt_size);
-        if (send_result == 0) {
-            pthread_mutex_lock(&host->lock);
-            host->stats.tx_packets++;
-            host->stats.tx_bytes += pkt_size;
-            pthread_mutex_unlock(&host->lock);
-            sent++;
-            
-            /* Check if we've sent enough */
-            if (host->pktgen.count > 0 && sent >= host->pktgen.count) {
-                printf("[PKTGEN] Host %u: reached count limit %u\n", host->host_id, sent);
-                break;
-            }
-        } else {
-            static int error_count[MAX_VHOSTS] = {0};
-            if (error_count[host->host_id] < 5) {  /* Only log first 5 errors per host */
-                printf("[PKTGEN] Host %u: vlink_send failed (result=%d, attempt %u)\n", 
-                       host->host_id, send_result, sent + error_count[host->host_id] + 1);
-                error_count[host->host_id]++;
-            }
-            pthread_mutex_lock(&host->lock);
-            host->stats.tx_errors++;
-            pthread_mutex_unlock(&host->lock);
+        uint64_t now = vhost_now_us();
+        if (now >= deadline) {
+            ret = -ETIMEDOUT;
+            break;
         }
         
-        /* Rate limiting */
-        next_time.tv_nsec += interval_ns;
-        if (next_time.tv_nsec >= 1000000000) {
-            next_time.tv_sec++;
-            next_time.tv_nsec -= 1000000000;
+        if (e->probes == 0 || now - e->probe_us >= VHOST_ARP_RETRANS_MS * 1000ULL) {
+            e->probes++;
+            e->probe_us = now;
+            pthread_mutex_unlock(&tbl->lock);
+            vhost_send_arp_request(host, ip);
+            pthread_mutex_lock(&tbl->lock);
+            continue;
         }
         
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        if (now.tv_sec < next_time.tv_sec ||
-            (now.tv_sec == next_time.tv_sec && now.tv_nsec < next_time.tv_nsec)) {
-            struct timespec sleep_time;
-            sleep_time.tv_sec = next_time.tv_sec - now.tv_sec;
-            sleep_time.tv_nsec = next_time.tv_nsec - now.tv_nsec;
-            if (sleep_time.tv_nsec < 0) {
-                sleep_time.tv_sec--;
-                sleep_time.tv_nsec += 1000000000;
-            }
-            nanosleep(&sleep_time, NULL);
+        /* Sleep until the reply, the next retransmit or the deadline */
+        uint64_t wake_us = e->probe_us + VHOST_ARP_RETRANS_MS * 1000ULL;
+        if (wake_us > deadline) {
+            wake_us = deadline;
         }
+        struct timespec ts = {
+            .tv_sec = wake_us / 1000000ULL,
+            .tv_nsec = (wake_us % 1000000ULL) * 1000
+        };
+        pthread_cond_timedwait(&tbl->resolved, &tbl->lock, &ts);
     }
     
-    if (!host->running) {
-        printf("[PKTGEN] Host %u: host->running became false\n", host->host_id);
+    pthread_mutex_unlock(&tbl->lock);
+    
+    return ret;
+}
+
+/* Drop every dynamic entry and its queued packets */
+static void neigh_flush(vhost_instance_t *host, bool keep_static)
+{
+    vhost_neigh_table_t *tbl = &host->neigh;
+    vhost_neigh_entry_t keep[VHOST_NEIGH_TABLE_SIZE];
+    vhost_pending_pkt_t *dropped = NULL;
+    uint32_t nkeep = 0;
+    
+    pthread_mutex_lock(&tbl->lock);
+    
+    for (uint32_t i = 0; i < VHOST_NEIGH_TABLE_SIZE; i++) {
+        vhost_neigh_entry_t *e = &tbl->entries[i];
+        if (e->state == VHOST_NEIGH_FREE) {
+            continue;
+        }
+        if (keep_static && e->state == VHOST_NEIGH_STATIC) {
+            keep[nkeep++] = *e;
+            continue;
+        }
+        vhost_pending_pkt_t *list = neigh_take_pending(e);
+        while (list) {
+            vhost_pending_pkt_t *next = list->next;
+            list->next = dropped;
+            dropped = list;
+            list = next;
+        }
     }
-    if (!host->pktgen.enabled) {
-        printf("[PKTGEN] Host %u: pktgen.enabled became false\n", host->host_id);
+    
+    /* Rebuild so probe chains of kept entries stay contiguous */
+    memset(tbl->entries, 0, sizeof(tbl->entries));
+    tbl->count = 0;
+    for (uint32_t i = 0; i < nkeep; i++) {
+        vhost_neigh_entry_t *e = neigh_find(tbl, keep[i].ip, true);
+        *e = keep[i];
     }
     
-    printf("[PKTGEN] Thread ending for host %u (sent %u UDP packets)\n", host->host_id, sent);
-    host->pktgen.enabled = false;
-    return NULL;
+    pthread_mutex_unlock(&tbl->lock);
+    
+    neigh_drop_pending(host, dropped);
 }
 
-/* Initialize virtual host manager */
-int vhost_manager_init(vhost_manager_t *mgr, vlink_manager_t *link_mgr)
+/*
+ * Closed-loop RPC
+ *
+ * Requests and responses are UDP datagrams whose payload starts with a
+ * vhost_rpc_hdr_t. The server answers from its RX path; the client issues
+ * the next request on a slot from its RX path as soon as the response for
+ * that slot arrives, so K slots keep exactly K requests in flight.
+ */
+
+/* Send one request on a slot; the caller has assigned slot seq/sent_ns */
+static int rpc_send_request(vhost_instance_t *host, uint16_t slot, uint32_t seq)
 {
-    if (!mgr || !link_mgr) {
-        return -1;
+    vhost_rpc_config_t *cfg = &host->rpc.config;
+    uint8_t payload[MAX_PACKET_SIZE];
+    uint8_t frame[MAX_PACKET_SIZE];
+    static const uint8_t unresolved_mac[VHOST_MAC_LEN] = {0};
+    
+    vhost_rpc_hdr_t hdr = {
+        .magic = htonl(VHOST_RPC_MAGIC),
+        .type = VHOST_RPC_REQUEST,
+        .slot = htons(slot),
+        .seq = htonl(seq),
+        .resp_size = htonl(cfg->resp_size)
+    };
+    memcpy(payload, &hdr, sizeof(hdr));
+    memset(payload + sizeof(hdr), 0, cfg->req_size - sizeof(hdr));
+    
+    uint16_t size = vhost_build_udp_packet(frame, sizeof(frame),
+                                           unresolved_mac, host->config.mac_addr,
+                                           cfg->dst_ip, host->config.ip_addr,
+                                           cfg->dst_port, VHOST_RPC_SRC_PORT,
+                                           payload, cfg->req_size);
+    int ret = size ? host_send_ip(host, cfg->dst_ip, frame, size) : -1;
+    
+    pthread_mutex_lock(&host->rpc.lock);
+    if (ret == 0) {
+        host->rpc.stats.requests_tx++;
+    } else {
+        host->rpc.stats.send_errors++;
     }
+    pthread_mutex_unlock(&host->rpc.lock);
     
-    memset(mgr, 0, sizeof(*mgr));
-    mgr->link_mgr = link_mgr;
-    pthread_mutex_init(&mgr->mgr_lock, NULL);
+    return ret;
+}
+
+/*
+ * Start a new transaction on slot if the configured count allows it.
+ * Called with rpc.lock held; returns the sequence to send or 0.
+ */
+static uint32_t rpc_claim_slot(vhost_rpc_t *rpc, uint16_t slot, uint64_t now_ns)
+{
+    if (!rpc->client_enabled ||
+        (rpc->config.count > 0 && rpc->issued >= rpc->config.count)) {
+        rpc->slots[slot].seq = 0;
+        return 0;
+    }
     
-    return 0;
+    if (++rpc->next_seq == 0) {
+        rpc->next_seq = 1;  /* 0 marks an idle slot */
+    }
+    rpc->issued++;
+    rpc->slots[slot].seq = rpc->next_seq;
+    rpc->slots[slot].sent_ns = now_ns;
+    
+    return rpc->next_seq;
+}
+
+/* Server side: echo a request back to its sender */
+static void rpc_serve(vhost_instance_t *host, const uint8_t *data,
+                      const vhost_rpc_hdr_t *req)
+{
+    uint8_t payload[MAX_PACKET_SIZE];
+    uint8_t frame[MAX_PACKET_SIZE];
+    const uint8_t *ip = data + 14;
+    const uint8_t *udp = ip + (ip[0] & 0x0F) * 4;
+    uint16_t src_port = ((uint16_t)udp[0] << 8) | udp[1];
+    uint32_t resp_size = ntohl(req->resp_size);
+    
+    if (resp_size < sizeof(*req)) {
+        resp_size = sizeof(*req);
+    }
+    if (resp_size > MAX_PACKET_SIZE - 42) {
+        resp_size = MAX_PACKET_SIZE - 42;
+    }
+    
+    vhost_rpc_hdr_t resp = *req;
+    resp.type = VHOST_RPC_RESPONSE;
+    memcpy(payload, &resp, sizeof(resp));
+    memset(payload + sizeof(resp), 0, resp_size - sizeof(resp));
+    
+    /* Reply straight to the sender's MAC, no ARP needed */
+    uint16_t size = vhost_build_udp_packet(frame, sizeof(frame),
+                                           data + 6, host->config.mac_addr,
+                                           ip + 12, host->config.ip_addr,
+                                           src_port, host->rpc.server_port,
+                                           payload, resp_size);
+    if (size > 0 && vhost_xmit(host, frame, size) == 0) {
+        pthread_mutex_lock(&host->rpc.lock);
+        host->rpc.stats.server_requests++;
+        pthread_mutex_unlock(&host->rpc.lock);
+    }
+}
+
+/* Client side: complete a transaction and start the next one on its slot */
+static void rpc_complete(vhost_instance_t *host, const vhost_rpc_hdr_t *resp)
+{
+    vhost_rpc_t *rpc = &host->rpc;
+    uint16_t slot = ntohs(resp->slot);
+    uint32_t seq = ntohl(resp->seq);
+    uint64_t now = vhost_now_ns();
+    uint32_t next_seq = 0;
+    
+    pthread_mutex_lock(&rpc->lock);
+    
+    if (slot >= rpc->config.outstanding || seq == 0 || rpc->slots[slot].seq != seq) {
+        rpc->stats.late_responses++;
+        pthread_mutex_unlock(&rpc->lock);
+        return;
+    }
+    
+    vhost_hist_record(&rpc->stats.rtt, now - rpc->slots[slot].sent_ns);
+    rpc->stats.responses_rx++;
+    rpc->completed++;
+    
+    next_seq = rpc_claim_slot(rpc, slot, now);
+    if (rpc->config.count > 0 && rpc->completed >= rpc->config.count) {
+        pthread_cond_broadcast(&rpc->done);
+    }
+    
+    pthread_mutex_unlock(&rpc->lock);
+    
+    if (next_seq) {
+        rpc_send_request(host, slot, next_seq);
+    }
+}
+
+/* RX hook: returns true if the frame was an RPC message for this host */
+static bool vhost_rpc_input(vhost_instance_t *host, const uint8_t *data, uint16_t size)
+{
+    const uint8_t *ip = data + 14;
+    
+    if (size < 14 + 20 + 8 + sizeof(vhost_rpc_hdr_t) ||
+        data[12] != 0x08 || data[13] != 0x00 ||
+        (ip[0] >> 4) != 4 || ip[9] != 17 ||
+        memcmp(ip + 16, host->config.ip_addr, VHOST_IP_LEN) != 0) {
+        return false;
+    }
+    
+    uint16_t ihl = (ip[0] & 0x0F) * 4;
+    if (ihl < 20 || size < 14 + ihl + 8 + sizeof(vhost_rpc_hdr_t)) {
+        return false;
+    }
+    
+    const uint8_t *udp = ip + ihl;
+    uint16_t dst_port = ((uint16_t)udp[2] << 8) | udp[3];
+    vhost_rpc_hdr_t hdr;
+    memcpy(&hdr, udp + 8, sizeof(hdr));
+    
+    if (ntohl(hdr.magic) != VHOST_RPC_MAGIC) {
+        return false;
+    }
+    
+    if (hdr.type == VHOST_RPC_REQUEST && host->rpc.server_port != 0 &&
+        dst_port == host->rpc.server_port) {
+        rpc_serve(host, data, &hdr);
+        return true;
+    }
+    
+    if (hdr.type == VHOST_RPC_RESPONSE && dst_port == VHOST_RPC_SRC_PORT) {
+        rpc_complete(host, &hdr);
+        return true;
+    }
+    
+    return false;
+}
+
+/* RPC client thread: resolves the server, primes K slots, retries timeouts */
+static void *rpc_client_thread_func(void *arg)
+{
+    vhost_instance_t *host = (vhost_instance_t *)arg;
+    vhost_rpc_t *rpc = &host->rpc;
+    uint32_t k = rpc->config.outstanding;
+    uint64_t timeout_ns = rpc->config.timeout_ms * 1000000ULL;
+    uint8_t dst_mac[VHOST_MAC_LEN];
+    
+    if (host_resolve(host, rpc->config.dst_ip, dst_mac,
+                     VHOST_ARP_RETRANS_MS * VHOST_ARP_MAX_PROBES) != 0) {
+        printf("[RPC] Host %u: ARP resolution of %u.%u.%u.%u failed\n",
+               host->host_id,
+               rpc->config.dst_ip[0], rpc->config.dst_ip[1],
+               rpc->config.dst_ip[2], rpc->config.dst_ip[3]);
+        pthread_mutex_lock(&rpc->lock);
+        rpc->client_enabled = false;
+        pthread_cond_broadcast(&rpc->done);
+        pthread_mutex_unlock(&rpc->lock);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&rpc->lock);
+    rpc->start_ns = vhost_now_ns();
+    pthread_mutex_unlock(&rpc->lock);
+    
+    /* Prime the window */
+    for (uint16_t slot = 0; slot < k; slot++) {
+        pthread_mutex_lock(&rpc->lock);
+        uint32_t seq = rpc_claim_slot(rpc, slot, vhost_now_ns());
+        pthread_mutex_unlock(&rpc->lock);
+        if (seq) {
+            rpc_send_request(host, slot, seq);
+        }
+    }
+    
+    /* Responses drive the loop; this thread only handles timeouts */
+    pthread_mutex_lock(&rpc->lock);
+    while (rpc->client_enabled && host->running &&
+           (rpc->config.count == 0 || rpc->completed < rpc->config.count)) {
+        uint64_t now = vhost_now_ns();
+        uint64_t wake = now + 1000000ULL;
+        
+        for (uint16_t slot = 0; slot < k; slot++) {
+            vhost_rpc_slot_t *s = &rpc->slots[slot];
+            if (s->seq == 0 || now - s->sent_ns < timeout_ns) {
+                continue;
+            }
+            
+            /* Lost request or response: retry with a new sequence */
+            rpc->stats.timeouts++;
+            rpc->issued--;
+            uint32_t seq = rpc_claim_slot(rpc, slot, now);
+            if (seq) {
+                pthread_mutex_unlock(&rpc->lock);
+                rpc_send_request(host, slot, seq);
+                pthread_mutex_lock(&rpc->lock);
+            }
+        }
+        
+        struct timespec ts = {
+            .tv_sec = wake / 1000000000ULL,
+            .tv_nsec = wake % 1000000000ULL
+        };
+        pthread_cond_timedwait(&rpc->done, &rpc->lock, &ts);
+    }
+    
+    rpc->stats.elapsed_ns = vhost_now_ns() - rpc->start_ns;
+    rpc->stats.tps = rpc->stats.elapsed_ns ?
+        rpc->completed * 1e9 / rpc->stats.elapsed_ns : 0.0;
+    rpc->client_enabled = false;
+    pthread_cond_broadcast(&rpc->done);
+    pthread_mutex_unlock(&rpc->lock);
+    
+    printf("[RPC] Host %u: client finished (%lu transactions, %.0f TPS)\n",
+           host->host_id, rpc->stats.responses_rx, rpc->stats.tps);
+    
+    return NULL;
+}
+
+/*
+ * ICMP
+ */
+
+/* Match an echo reply against the ping window */
+static void ping_reply_input(vhost_instance_t *host, uint16_t seq)
+{
+    vhost_ping_t *ping = &host->ping;
+    uint64_t now = vhost_now_ns();
+    
+    pthread_mutex_lock(&ping->lock);
+    vhost_ping_probe_t *probe = &ping->window[seq & (VHOST_PING_WINDOW - 1)];
+    if (probe->pending && probe->seq == seq) {
+        probe->pending = false;
+        ping->stats.received++;
+        vhost_hist_record(&ping->stats.rtt, now - probe->sent_ns);
+        if (ping->stats.received >= ping->stats.sent) {
+            pthread_cond_broadcast(&ping->done);
+        }
+    } else {
+        ping->stats.late++;
+    }
+    pthread_mutex_unlock(&ping->lock);
+}
+
+/*
+ * RX hook for ICMP addressed to this host. Echo replies are matched here;
+ * returns true for an echo request that should be answered.
+ */
+static bool vhost_icmp_input(vhost_instance_t *host, const uint8_t *data, uint16_t size)
+{
+    const uint8_t *ip = data + 14;
+    
+    if (size < 14 + 20 + 8 || (ip[0] >> 4) != 4 || ip[9] != 1 ||
+        memcmp(ip + 16, host->config.ip_addr, VHOST_IP_LEN) != 0) {
+        return false;
+    }
+    
+    uint16_t ihl = (ip[0] & 0x0F) * 4;
+    uint16_t total_len = ((uint16_t)ip[2] << 8) | ip[3];
+    bool fragment = (((ip[6] & 0x3F) << 8) | ip[7]) != 0;
+    if (ihl < 20 || total_len < ihl + 8 || 14 + total_len > size || fragment) {
+        return false;
+    }
+    
+    const uint8_t *icmp = ip + ihl;
+    
+    pthread_mutex_lock(&host->lock);
+    host->stats.icmp_rx++;
+    pthread_mutex_unlock(&host->lock);
+    
+    if (icmp[0] == 8 && icmp[1] == 0) {
+        return true;
+    }
+    
+    if (icmp[0] == 0 && icmp[1] == 0 &&
+        (((uint16_t)icmp[4] << 8) | icmp[5]) == host->ping.ident) {
+        ping_reply_input(host, ((uint16_t)icmp[6] << 8) | icmp[7]);
+    }
+    
+    return false;
+}
+
+/*
+ * Answer an echo request: copy it, swap MACs and IPs in the copy, reset
+ * TTL and patch both checksums incrementally. The request may be shared
+ * with other hosts, so it is never written.
+ */
+static void vhost_icmp_echo_reply(vhost_instance_t *host, const uint8_t *request)
+{
+    uint16_t total_len = ((uint16_t)request[14 + 2] << 8) | request[14 + 3];
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint8_t tmp[VHOST_IP_LEN];
+    
+    if (14 + total_len > (int)sizeof(frame)) {
+        return;
+    }
+    memcpy(frame, request, 14 + total_len);
+    
+    uint8_t *ip = frame + 14;
+    uint8_t *icmp = ip + (ip[0] & 0x0F) * 4;
+    
+    memcpy(frame, request + 6, VHOST_MAC_LEN);
+    memcpy(frame + 6, host->config.mac_addr, VHOST_MAC_LEN);
+    
+    /* Swapping addresses leaves the one's complement sum unchanged */
+    memcpy(tmp, ip + 12, VHOST_IP_LEN);
+    memcpy(ip + 12, ip + 16, VHOST_IP_LEN);
+    memcpy(ip + 16, tmp, VHOST_IP_LEN);
+    
+    uint16_t old_word = ((uint16_t)ip[8] << 8) | ip[9];
+    ip[8] = 64;
+    net_csum_replace16(ip + 10, old_word, ((uint16_t)ip[8] << 8) | ip[9]);
+    
+    icmp[0] = 0;  /* Echo reply */
+    net_csum_replace16(icmp + 2, 0x0800, 0x0000);
+    
+    if (vhost_xmit(host, frame, 14 + total_len) == 0) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.icmp_echo_replies_tx++;
+        pthread_mutex_unlock(&host->lock);
+    }
+}
+
+/* Ping thread: paced echo requests, then wait for stragglers */
+static void *ping_thread_func(void *arg)
+{
+    vhost_instance_t *host = (vhost_instance_t *)arg;
+    vhost_ping_t *ping = &host->ping;
+    vhost_ping_config_t *cfg = &ping->config;
+    uint8_t payload[MAX_PACKET_SIZE];
+    uint8_t frame[MAX_PACKET_SIZE];
+    static const uint8_t unresolved_mac[VHOST_MAC_LEN] = {0};
+    uint8_t dst_mac[VHOST_MAC_LEN];
+    uint16_t seq = 0;
+    uint64_t sent = 0;
+    
+    for (uint16_t i = 0; i < cfg->payload_size; i++) {
+        payload[i] = (uint8_t)i;
+    }
+    
+    if (host_resolve(host, cfg->dst_ip, dst_mac,
+                     VHOST_ARP_RETRANS_MS * VHOST_ARP_MAX_PROBES) != 0) {
+        printf("[PING] Host %u: ARP resolution of %u.%u.%u.%u failed\n",
+               host->host_id, cfg->dst_ip[0], cfg->dst_ip[1], cfg->dst_ip[2], cfg->dst_ip[3]);
+        cfg->count = 0;
+        goto out;
+    }
+    
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    
+    while (ping->enabled && host->running && (cfg->count == 0 || sent < cfg->count)) {
+        seq++;
+        vhost_ping_probe_t *probe = &ping->window[seq & (VHOST_PING_WINDOW - 1)];
+        
+        /* Arm the window slot first: the reply can beat vhost_xmit's return */
+        pthread_mutex_lock(&ping->lock);
+        probe->seq = seq;
+        probe->pending = true;
+        probe->sent_ns = vhost_now_ns();
+        ping->stats.sent++;
+        pthread_mutex_unlock(&ping->lock);
+        
+        uint16_t size = vhost_build_icmp_echo(frame, sizeof(frame),
+                                              unresolved_mac, host->config.mac_addr,
+                                              cfg->dst_ip, host->config.ip_addr,
+                                              ping->ident, seq,
+                                              payload, cfg->payload_size);
+        if (size == 0 || host_send_ip(host, cfg->dst_ip, frame, size) != 0) {
+            pthread_mutex_lock(&ping->lock);
+            probe->pending = false;
+            ping->stats.sent--;
+            ping->stats.send_errors++;
+            pthread_mutex_unlock(&ping->lock);
+        }
+        sent++;
+        
+        next.tv_nsec += (long)cfg->interval_us * 1000;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    
+    /* Give outstanding probes timeout_ms to come back */
+    uint64_t deadline = vhost_now_ns() + cfg->timeout_ms * 1000000ULL;
+    struct timespec ts = {
+        .tv_sec = deadline / 1000000000ULL,
+        .tv_nsec = deadline % 1000000000ULL
+    };
+    pthread_mutex_lock(&ping->lock);
+    while (ping->enabled && host->running && ping->stats.received < ping->stats.sent) {
+        if (pthread_cond_timedwait(&ping->done, &ping->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ping->lock);
+    
+out:
+    pthread_mutex_lock(&ping->lock);
+    ping->enabled = false;
+    pthread_cond_broadcast(&ping->done);
+    pthread_mutex_unlock(&ping->lock);
+    
+    return NULL;
+}
+
+/* RX callback from virtual link */
+static void vhost_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+{
+    vhost_instance_t *host = (vhost_instance_t *)ctx;
+    bool echo_request = false;
+    
+    pthread_mutex_lock(&host->lock);
+    host->stats.rx_packets++;
+    host->stats.rx_bytes += size;
+    pthread_mutex_unlock(&host->lock);
+    
+    /* ARP, ICMP and RPC are handled by the host stack */
+    if (size >= 14 && data[12] == 0x08 && data[13] == 0x06) {
+        vhost_arp_input(host, data, size);
+    } else if (size >= 14 + 20 && data[12] == 0x08 && data[13] == 0x00 && data[14 + 9] == 1) {
+        echo_request = vhost_icmp_input(host, data, size);
+    } else {
+        vhost_rpc_input(host, data, size);
+    }
+    
+    /* Call custom handler if set */
+    if (host->pkt_handler) {
+        host->pkt_handler(host->pkt_handler_ctx, data, size);
+    }
+    
+    if (echo_request) {
+        vhost_icmp_echo_reply(host, data);
+    }
+}
+
+/* Packet generator thread */
+static void *pktgen_thread_func(void *arg)
+{
+    vhost_instance_t *host = (vhost_instance_t *)arg;
+    uint8_t packet[9000];
+    uint32_t sent = 0;
+    uint64_t interval_ns = 1000000000ULL / host->pktgen.pps;
+    struct timespec next_time, now;
+    
+    printf("[PKTGEN] Thread started for host %u (running=%d, enabled=%d, pps=%u)\n",
+           host->host_id, host->running, host->pktgen.enabled, host->pktgen.pps);
+    
+    /* A configured destination MAC is a static neighbor; otherwise use ARP */
+    if (!mac_is_zero(host->pktgen.dst_mac)) {
+        uint32_t key;
+        memcpy(&key, host->pktgen.dst_ip, sizeof(key));
+        pthread_mutex_lock(&host->neigh.lock);
+        vhost_neigh_entry_t *e = neigh_find(&host->neigh, key, true);
+        if (e) {
+            memcpy(e->mac, host->pktgen.dst_mac, VHOST_MAC_LEN);
+            e->state = VHOST_NEIGH_STATIC;
+        }
+        pthread_mutex_unlock(&host->neigh.lock);
+    } else {
+        uint8_t dst_mac[VHOST_MAC_LEN];
+        uint64_t start_us = vhost_now_us();
+        
+        if (host_resolve(host, host->pktgen.dst_ip, dst_mac,
+                         VHOST_ARP_RETRANS_MS * VHOST_ARP_MAX_PROBES) != 0) {
+            printf("[PKTGEN] Host %u: ARP resolution of %u.%u.%u.%u failed\n",
+                   host->host_id,
+                   host->pktgen.dst_ip[0], host->pktgen.dst_ip[1],
+                   host->pktgen.dst_ip[2], host->pktgen.dst_ip[3]);
+            host->pktgen.enabled = false;
+            return NULL;
+        }
+        
+        printf("[PKTGEN] Host %u: Resolved %u.%u.%u.%u -> %02x:%02x:%02x:%02x:%02x:%02x in %lu us\n",
+               host->host_id,
+               host->pktgen.dst_ip[0], host->pktgen.dst_ip[1],
+               host->pktgen.dst_ip[2], host->pktgen.dst_ip[3],
+               dst_mac[0], dst_mac[1], dst_mac[2], dst_mac[3], dst_mac[4], dst_mac[5],
+               vhost_now_us() - start_us);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &next_time);
+    
+    while (host->running && host->pktgen.enabled) {
+        /* Build packet */
+        static const uint8_t unresolved_mac[VHOST_MAC_LEN] = {0};
+        uint16_t pkt_size = vhost_build_udp_packet(
+            packet, sizeof(packet),
+            unresolved_mac, host->config.mac_addr,
+            host->pktgen.dst_ip, host->config.ip_addr,
+            host->pktgen.dst_port, 12345,
+            (uint8_t *)"Test packet", 11
+        );
+        
+        if (pkt_size == 0) {
+            printf("[PKTGEN] Host %u: build_udp_packet failed\n", host->host_id);
+            host->stats.tx_errors++;
+            break;
+        }
+        
+        /* Send packet (destination MAC comes from the neighbor cache) */
+        int send_result = host_send_ip(host, host->pktgen.dst_ip, packet, pkt_size);
+        if (send_result == 0) {
+            sent++;
+            
+            /* Check if we've sent enough */
+            if (host->pktgen.count > 0 && sent >= host->pktgen.count) {
+                printf("[PKTGEN] Host %u: reached count limit %u\n", host->host_id, sent);
+                break;
+            }
+        } else {
+            static int error_count[MAX_VHOSTS] = {0};
+            if (error_count[host->host_id] < 5) {  /* Only log first 5 errors per host */
+                printf("[PKTGEN] Host %u: send failed (result=%d, attempt %u)\n", 
+                       host->host_id, send_result, sent + error_count[host->host_id] + 1);
+                error_count[host->host_id]++;
+            }
+        }
+        
+        /* Rate limiting */
+        next_time.tv_nsec += interval_ns;
+        if (next_time.tv_nsec >= 1000000000) {
+            next_time.tv_sec++;
+            next_time.tv_nsec -= 1000000000;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec < next_time.tv_sec ||
+            (now.tv_sec == next_time.tv_sec && now.tv_nsec < next_time.tv_nsec)) {
+            struct timespec sleep_time;
+            sleep_time.tv_sec = next_time.tv_sec - now.tv_sec;
+            sleep_time.tv_nsec = next_time.tv_nsec - now.tv_nsec;
+            if (sleep_time.tv_nsec < 0) {
+                sleep_time.tv_sec--;
+                sleep_time.tv_nsec += 1000000000;
+            }
+            nanosleep(&sleep_time, NULL);
+        }
+    }
+    
+    if (!host->running) {
+        printf("[PKTGEN] Host %u: host->running became false\n", host->host_id);
+    }
+    if (!host->pktgen.enabled) {
+        printf("[PKTGEN] Host %u: pktgen.enabled became false\n", host->host_id);
+    }
+    
+    printf("[PKTGEN] Thread ending for host %u (sent %u UDP packets)\n", host->host_id, sent);
+    host->pktgen.enabled = false;
+    return NULL;
+}
+
+/* Initialize virtual host manager */
+int vhost_manager_init(vhost_manager_t *mgr, vlink_manager_t *link_mgr)
+{
+    if (!mgr || !link_mgr) {
+        return -1;
+    }
+    
+    memset(mgr, 0, sizeof(*mgr));
+    
+    /* Thousands of hosts: only the entries actually created get touched */
+    mgr->hosts = calloc(MAX_VHOSTS, sizeof(*mgr->hosts));
+    if (!mgr->hosts) {
+        return -1;
+    }
+    
+    mgr->link_mgr = link_mgr;
+    pthread_mutex_init(&mgr->mgr_lock, NULL);
+    
+    return 0;
+}
+
+/* Cleanup virtual host manager */
+void vhost_manager_cleanup(vhost_manager_t *mgr)
+{
+    if (!mgr) {
+        return;
+    }
+    
+    /* Stop all hosts */
+    for (uint32_t i = 0; i < mgr->num_hosts; i++) {
+        vhost_stop(mgr, i);
+    }
+    
+    /* Release queued packets and neighbor tables */
+    for (uint32_t i = 0; i < mgr->num_hosts; i++) {
+        neigh_flush(&mgr->hosts[i], false);
+        pthread_cond_destroy(&mgr->hosts[i].neigh.resolved);
+        pthread_mutex_destroy(&mgr->hosts[i].neigh.lock);
+        pthread_cond_destroy(&mgr->hosts[i].rpc.done);
+        pthread_mutex_destroy(&mgr->hosts[i].rpc.lock);
+        pthread_cond_destroy(&mgr->hosts[i].ping.done);
+        pthread_mutex_destroy(&mgr->hosts[i].ping.lock);
+    }
+    
+    free(mgr->hosts);
+    mgr->hosts = NULL;
+    mgr->num_hosts = 0;
+    pthread_mutex_destroy(&mgr->mgr_lock);
+}
+
+/* Create a virtual host */
+int vhost_create(vhost_manager_t *mgr, const char *name,
+                 const uint8_t *mac_addr, const uint8_t *ip_addr,
+                 uint32_t *host_id)
+{
+    if (!mgr || !name || !mac_addr || !ip_addr || !host_id) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_lock);
+    
+    if (mgr->num_hosts >= MAX_VHOSTS) {
+        pthread_mutex_unlock(&mgr->mgr_lock);
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[mgr->num_hosts];
+    memset(host, 0, sizeof(*host));
+    
+    host->host_id = mgr->num_hosts;
+    snprintf(host->config.name, sizeof(host->config.name), "%s", name);
+    memcpy(host->config.mac_addr, mac_addr, VHOST_MAC_LEN);
+    memcpy(host->config.ip_addr, ip_addr, VHOST_IP_LEN);
+    host->config.mtu = 1500;
+    host->config.enabled = true;
+    host->link_mgr = mgr->link_mgr;
+    
+    pthread_mutex_init(&host->lock, NULL);
+    
+    /* Neighbor table waits use CLOCK_MONOTONIC deadlines */
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&host->neigh.lock, NULL);
+    pthread_cond_init(&host->neigh.resolved, &cond_attr);
+    pthread_mutex_init(&host->rpc.lock, NULL);
+    pthread_cond_init(&host->rpc.done, &cond_attr);
+    pthread_mutex_init(&host->ping.lock, NULL);
+    pthread_cond_init(&host->ping.done, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    vhost_hist_reset(&host->rpc.stats.rtt);
+    vhost_hist_reset(&host->ping.stats.rtt);
+    host->ping.ident = (uint16_t)(host->host_id + 1);
+    
+    *host_id = mgr->num_hosts;
+    mgr->num_hosts++;
+    
+    pthread_mutex_unlock(&mgr->mgr_lock);
+    
+    return 0;
+}
+
+/* Connect virtual host to a switch PCI link */
+int vhost_connect_to_switch(vhost_manager_t *mgr, uint32_t host_id,
+                            uint32_t switch_pci_link_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    /* Create our side of the PCI link */
+    char link_name[64];
+    snprintf(link_name, sizeof(link_name), "host%u_pci", host_id);
+    
+    if (vlink_create(mgr->link_mgr, link_name, 100000, 1, 0.0, &host->pci_link_id) != 0) {
+        return -1;
+    }
+    
+    /* Connect to switch PCI link (bidirectional) */
+    if (vlink_connect(mgr->link_mgr, host->pci_link_id, switch_pci_link_id) != 0) {
+        return -1;
+    }
+    
+    /* Set RX callback */
+    vlink_set_rx_callback(mgr->link_mgr, host->pci_link_id, vhost_rx_callback, host);
+    
+    return 0;
+}
+
+/* Start virtual host */
+int vhost_start(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (host->running) {
+        return 0;  /* Already running */
+    }
+    
+    host->running = true;
+    
+    /* Start virtual link (engine hosts share a link the engine starts) */
+    if (!host->engine) {
+        vlink_start(mgr->link_mgr, host->pci_link_id);
+    }
+    
+    /* Announce ourselves so peers with stale entries update them */
+    vhost_send_gratuitous_arp(mgr, host_id);
+    
+    return 0;
+}
+
+/* Stop virtual host */
+int vhost_stop(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (!host->running) {
+        return 0;  /* Already stopped */
+    }
+    
+    printf("[VHOST_STOP] Stopping host %u\n", host_id);
+    host->running = false;
+    
+    /* Wake any thread blocked in ARP resolution */
+    pthread_mutex_lock(&host->neigh.lock);
+    pthread_cond_broadcast(&host->neigh.resolved);
+    pthread_mutex_unlock(&host->neigh.lock);
+    
+    /* Stop packet generator if running */
+    if (host->pktgen.enabled) {
+        vhost_stop_pktgen(mgr, host_id);
+    }
+    
+    /* Stop RPC and ping clients; the server goes quiet with the link */
+    vhost_stop_rpc_client(mgr, host_id);
+    vhost_stop_ping(mgr, host_id);
+    
+    /* Stop virtual link */
+    if (!host->engine) {
+        vlink_stop(mgr->link_mgr, host->pci_link_id);
+    }
+    
+    return 0;
+}
+
+/* Send packet from virtual host */
+int vhost_send_packet(vhost_manager_t *mgr, uint32_t host_id,
+                      const uint8_t *data, uint16_t size)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !data || size == 0) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (!host->running) {
+        return -1;
+    }
+    
+    if (vlink_send(mgr->link_mgr, host->pci_link_id, data, size) != 0) {
+        pthread_mutex_lock(&host->lock);
+        host->stats.tx_errors++;
+        pthread_mutex_unlock(&host->lock);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&host->lock);
+    host->stats.tx_packets++;
+    host->stats.tx_bytes += size;
+    pthread_mutex_unlock(&host->lock);
+    
+    return 0;
+}
+
+/* Configure packet generator */
+int vhost_configure_pktgen(vhost_manager_t *mgr, uint32_t host_id,
+                           const vhost_pktgen_config_t *config)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !config) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    pthread_mutex_lock(&host->lock);
+    memcpy(&host->pktgen, config, sizeof(host->pktgen));
+    pthread_mutex_unlock(&host->lock);
+    
+    return 0;
+}
+
+/* Start packet generator */
+int vhost_start_pktgen(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        printf("[PKTGEN_START] Invalid mgr or host_id=%u >= %u\n", host_id, mgr ? mgr->num_hosts : 0);
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (host->pktgen.enabled) {
+        printf("[PKTGEN_START] Host %u already running\n", host_id);
+        return 0;  /* Already running */
+    }
+    
+    if (host->pktgen.pps == 0) {
+        printf("[PKTGEN_START] Host %u not configured (pps=0)\n", host_id);
+        return -1;  /* Not configured */
+    }
+    
+    if (host->engine) {
+        return -1;  /* Paced by the engine: vhost_engine_start_pktgen() */
+    }
+    
+    printf("[PKTGEN_START] Starting pktgen for host %u (running=%d, pps=%u)\n", 
+           host_id, host->running, host->pktgen.pps);
+    
+    host->pktgen.enabled = true;
+    
+    if (pthread_create(&host->pktgen_thread, NULL, pktgen_thread_func, host) != 0) {
+        printf("[PKTGEN_START] pthread_create failed for host %u\n", host_id);
+        host->pktgen.enabled = false;
+        return -1;
+    }
+    
+    printf("[PKTGEN_START] pthread created successfully for host %u\n", host_id);
+    return 0;
+}
+
+/* Stop packet generator */
+int vhost_stop_pktgen(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (!host->pktgen.enabled) {
+        return 0;  /* Already stopped */
+    }
+    
+    host->pktgen.enabled = false;
+    if (!host->engine) {
+        pthread_join(host->pktgen_thread, NULL);
+    }
+    
+    return 0;
+}
+
+/* Send IPv4 frame via the neighbor cache */
+int vhost_send_ip_packet(vhost_manager_t *mgr, uint32_t host_id,
+                         const uint8_t *dst_ip, uint8_t *frame, uint16_t size)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !dst_ip || !frame || size < 14) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (!host->running) {
+        return -1;
+    }
+    
+    return host_send_ip(host, dst_ip, frame, size);
+}
+
+/* Resolve IPv4 address to MAC */
+int vhost_resolve(vhost_manager_t *mgr, uint32_t host_id,
+                  const uint8_t *ip, uint8_t *mac, uint32_t timeout_ms)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !ip || !mac) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    if (!host->running) {
+        return -1;
+    }
+    
+    return host_resolve(host, ip, mac, timeout_ms);
+}
+
+/* Add static neighbor entry */
+int vhost_add_neighbor(vhost_manager_t *mgr, uint32_t host_id,
+                       const uint8_t *ip, const uint8_t *mac)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !ip || !mac) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_pending_pkt_t *pending = NULL;
+    uint32_t key;
+    
+    memcpy(&key, ip, sizeof(key));
+    
+    pthread_mutex_lock(&host->neigh.lock);
+    vhost_neigh_entry_t *e = neigh_find(&host->neigh, key, true);
+    if (e) {
+        memcpy(e->mac, mac, VHOST_MAC_LEN);
+        e->state = VHOST_NEIGH_STATIC;
+        e->updated_us = vhost_now_us();
+        pending = neigh_take_pending(e);
+        pthread_cond_broadcast(&host->neigh.resolved);
+    }
+    pthread_mutex_unlock(&host->neigh.lock);
+    
+    if (!e) {
+        return -1;
+    }
+    
+    neigh_flush_pending(host, pending, mac);
+    return 0;
+}
+
+/* Look up resolved neighbor */
+int vhost_lookup_neighbor(vhost_manager_t *mgr, uint32_t host_id,
+                          const uint8_t *ip, uint8_t *mac)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !ip || !mac) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    uint32_t key;
+    int ret = -1;
+    
+    memcpy(&key, ip, sizeof(key));
+    
+    pthread_mutex_lock(&host->neigh.lock);
+    vhost_neigh_entry_t *e = neigh_find(&host->neigh, key, false);
+    if (e && neigh_usable(e)) {
+        memcpy(mac, e->mac, VHOST_MAC_LEN);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&host->neigh.lock);
+    
+    return ret;
+}
+
+/* Flush dynamic neighbor entries */
+int vhost_flush_neighbors(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    neigh_flush(&mgr->hosts[host_id], true);
+    return 0;
+}
+
+/* Send gratuitous ARP */
+int vhost_send_gratuitous_arp(vhost_manager_t *mgr, uint32_t host_id)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return -1;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    uint8_t packet[64];
+    uint16_t size = vhost_build_gratuitous_arp(packet, sizeof(packet),
+                                               host->config.mac_addr,
+                                               host->config.ip_addr);
+    
+    if (size == 0 || vhost_xmit(host, packet, size) != 0) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&host->lock);
+    host->stats.arp_requests_tx++;
+    pthread_mutex_unlock(&host->lock);
+    
+    return 0;
+}
+
+/* Print neighbor table */
+void vhost_print_neighbors(vhost_manager_t *mgr, uint32_t host_id)
+{
+    static const char *state_names[] = {
+        "FREE", "INCOMPLETE", "REACHABLE", "STATIC"
+    };
+    
+    if (!mgr || host_id >= mgr->num_hosts) {
+        return;
+    }
+    
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    
+    pthread_mutex_lock(&host->neigh.lock);
+    printf("  Neighbors (%u):\n", host->neigh.count);
+    for (uint32_t i = 0; i < VHOST_NEIGH_TABLE_SIZE; i++) {
+        vhost_neigh_entry_t *e = &host->neigh.entries[i];
+        if (e->state == VHOST_NEIGH_FREE) {
+            continue;
+        }
+        const uint8_t *ip = (const uint8_t *)&e->ip;
+        printf("    %u.%u.%u.%u -> %02x:%02x:%02x:%02x:%02x:%02x %s (pending %u)\n",
+               ip[0], ip[1], ip[2], ip[3],
+               e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5],
+               state_names[e->state], e->pending_count);
+    }
+    pthread_mutex_unlock(&host->neigh.lock);
 }
 
-/* Cleanup virtual host manager */
-void vhost_manager_cleanup(vhost_manager_t *mgr)
+/* Configure closed-loop RPC client */
+int vhost_configure_rpc(vhost_manager_t *mgr, uint32_t host_id,
+                        const vhost_rpc_config_t *config)
 {
-    if (!mgr) {
-        return;
+    if (!mgr || host_id >= mgr->num_hosts || !config ||
+        config->outstanding == 0 || config->outstanding > VHOST_RPC_MAX_OUTSTANDING) {
+        return -1;
     }
     
-    /* Stop all hosts */
-    for (uint32_t i = 0; i < mgr->num_hosts; i++) {
-        vhost_stop(mgr, i);
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_rpc_t *rpc = &host->rpc;
+    
+    pthread_mutex_lock(&rpc->lock);
+    if (rpc->client_enabled) {
+        pthread_mutex_unlock(&rpc->lock);
+        return -1;  /* Reconfigure only while stopped */
     }
     
-    pthread_mutex_destroy(&mgr->mgr_lock);
+    rpc->config = *config;
+    if (rpc->config.timeout_ms == 0) {
+        rpc->config.timeout_ms = VHOST_RPC_DEFAULT_TIMEOUT_MS;
+    }
+    if (rpc->config.req_size < sizeof(vhost_rpc_hdr_t)) {
+        rpc->config.req_size = sizeof(vhost_rpc_hdr_t);
+    }
+    if (rpc->config.resp_size < sizeof(vhost_rpc_hdr_t)) {
+        rpc->config.resp_size = sizeof(vhost_rpc_hdr_t);
+    }
+    if (rpc->config.req_size > MAX_PACKET_SIZE - 42) {
+        rpc->config.req_size = MAX_PACKET_SIZE - 42;
+    }
+    pthread_mutex_unlock(&rpc->lock);
+    
+    return 0;
 }
 
-/* Create a virtual host */
-int vhost_create(vhost_manager_t *mgr, const char *name,
-                 const uint8_t *mac_addr, const uint8_t *ip_addr,
-                 uint32_t *host_id)
+/* Start RPC client */
+int vhost_start_rpc_client(vhost_manager_t *mgr, uint32_t host_id)
 {
-    if (!mgr || !name || !mac_addr || !ip_addr || !host_id) {
+    if (!mgr || host_id >= mgr->num_hosts) {
         return -1;
     }
     
-    pthread_mutex_lock(&mgr->mgr_lock);
+    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_rpc_t *rpc = &host->rpc;
     
-    if (mgr->num_hosts >= MAX_VHOSTS) {
-        pthread_mutex_unlock(&mgr->mgr_lock);
-        return -1;
+    if (!host->running || rpc->config.outstanding == 0) {
+        return -1;  /* Not running or not configured */
     }
     
-    vhost_instance_t *host = &mgr->hosts[mgr->num_hosts];
-    memset(host, 0, sizeof(*host));
-    
-    host->host_id = mgr->num_hosts;
-    snprintf(host->config.name, sizeof(host->config.name), "%s", name);
-    memcpy(host->config.mac_addr, mac_addr, VHOST_MAC_LEN);
-    memcpy(host->config.ip_addr, ip_addr, VHOST_IP_LEN);
-    host->config.mtu = 1500;
-    host->config.enabled = true;
-    host->link_mgr = mgr->link_mgr;
-    
-    pthread_mutex_init(&host->lock, NULL);
+    if (rpc->client_joinable && !rpc->client_enabled) {
+        pthread_join(rpc->client_thread, NULL);  /* Previous run finished */
+        rpc->client_joinable = false;
+    }
     
-    *host_id = mgr->num_hosts;
-    mgr->num_hosts++;
+    pthread_mutex_lock(&rpc->lock);
+    if (rpc->client_enabled) {
+        pthread_mutex_unlock(&rpc->lock);
+        return 0;  /* Already running */
+    }
     
-    pthread_mutex_unlock(&mgr->mgr_lock);
+    /* Fresh run: keep server counters, reset client state */
+    uint64_t served = rpc->stats.server_requests;
+    memset(&rpc->stats, 0, sizeof(rpc->stats));
+    vhost_hist_reset(&rpc->stats.rtt);
+    rpc->stats.server_requests = served;
+    memset(rpc->slots, 0, sizeof(rpc->slots));
+    rpc->issued = 0;
+    rpc->completed = 0;
+    rpc->client_enabled = true;
+    rpc->start_ns = 0;
+    pthread_mutex_unlock(&rpc->lock);
+    
+    if (pthread_create(&rpc->client_thread, NULL, rpc_client_thread_func, host) != 0) {
+        rpc->client_enabled = false;
+        return -1;
+    }
+    rpc->client_joinable = true;
     
     return 0;
 }
 
-/* Connect virtual host to a switch PCI link */
-int vhost_connect_to_switch(vhost_manager_t *mgr, uint32_t host_id,
-                            uint32_t switch_pci_link_id)
+/* Stop RPC client */
+int vhost_stop_rpc_client(vhost_manager_t *mgr, uint32_t host_id)
 {
     if (!mgr || host_id >= mgr->num_hosts) {
         return -1;
     }
     
-    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_rpc_t *rpc = &mgr->hosts[host_id].rpc;
     
-    /* Create our side of the PCI link */
-    char link_name[64];
-    snprintf(link_name, sizeof(link_name), "host%u_pci", host_id);
+    pthread_mutex_lock(&rpc->lock);
+    rpc->client_enabled = false;
+    pthread_cond_broadcast(&rpc->done);
+    pthread_mutex_unlock(&rpc->lock);
     
-    if (vlink_create(mgr->link_mgr, link_name, 100000, 1, 0.0, &host->pci_link_id) != 0) {
-        return -1;
+    if (rpc->client_joinable) {
+        pthread_join(rpc->client_thread, NULL);
+        rpc->client_joinable = false;
     }
     
-    /* Connect to switch PCI link (bidirectional) */
-    if (vlink_connect(mgr->link_mgr, host->pci_link_id, switch_pci_link_id) != 0) {
+    return 0;
+}
+
+/* Wait for the RPC client to complete its configured count */
+int vhost_wait_rpc_client(vhost_manager_t *mgr, uint32_t host_id, uint32_t timeout_ms)
+{
+    if (!mgr || host_id >= mgr->num_hosts) {
         return -1;
     }
     
-    /* Set RX callback */
-    vlink_set_rx_callback(mgr->link_mgr, host->pci_link_id, vhost_rx_callback, host);
+    vhost_rpc_t *rpc = &mgr->hosts[host_id].rpc;
+    uint64_t deadline = vhost_now_ns() + timeout_ms * 1000000ULL;
+    struct timespec ts = {
+        .tv_sec = deadline / 1000000000ULL,
+        .tv_nsec = deadline % 1000000000ULL
+    };
+    int ret = 0;
+    
+    pthread_mutex_lock(&rpc->lock);
+    while (rpc->client_enabled && ret != ETIMEDOUT) {
+        ret = pthread_cond_timedwait(&rpc->done, &rpc->lock, &ts);
+    }
+    ret = rpc->client_enabled ? -ETIMEDOUT : 0;
+    pthread_mutex_unlock(&rpc->lock);
     
-    return 0;
+    return ret;
 }
 
-/* Start virtual host */
-int vhost_start(vhost_manager_t *mgr, uint32_t host_id)
+/* Answer RPC requests on a UDP port */
+int vhost_start_rpc_server(vhost_manager_t *mgr, uint32_t host_id, uint16_t port)
 {
     if (!mgr || host_id >= mgr->num_hosts) {
         return -1;
     }
     
-    vhost_instance_t *host = &mgr->hosts[host_id];
+    mgr->hosts[host_id].rpc.server_port = port;
     
-    if (host->running) {
-        return 0;  /* Already running */
+    return 0;
+}
+
+/* Get RPC statistics */
+int vhost_get_rpc_stats(vhost_manager_t *mgr, uint32_t host_id, vhost_rpc_stats_t *stats)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !stats) {
+        return -1;
     }
     
-    host->running = true;
+    vhost_rpc_t *rpc = &mgr->hosts[host_id].rpc;
     
-    /* Start virtual link */
-    vlink_start(mgr->link_mgr, host->pci_link_id);
+    pthread_mutex_lock(&rpc->lock);
+    memcpy(stats, &rpc->stats, sizeof(*stats));
+    if (rpc->client_enabled && rpc->start_ns != 0) {
+        stats->elapsed_ns = vhost_now_ns() - rpc->start_ns;
+        stats->tps = stats->elapsed_ns ? rpc->completed * 1e9 / stats->elapsed_ns : 0.0;
+    }
+    pthread_mutex_unlock(&rpc->lock);
     
     return 0;
 }
 
-/* Stop virtual host */
-int vhost_stop(vhost_manager_t *mgr, uint32_t host_id)
+/* Print RPC statistics */
+void vhost_print_rpc_stats(vhost_manager_t *mgr, uint32_t host_id)
 {
-    if (!mgr || host_id >= mgr->num_hosts) {
-        return -1;
+    vhost_rpc_stats_t stats;
+    
+    if (vhost_get_rpc_stats(mgr, host_id, &stats) != 0) {
+        return;
     }
     
     vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_rpc_config_t *cfg = &host->rpc.config;
     
-    if (!host->running) {
-        return 0;  /* Already stopped */
+    if (host->rpc.server_port != 0) {
+        printf("Host %u: RPC server on port %u answered %lu requests\n",
+               host_id, host->rpc.server_port, stats.server_requests);
     }
     
-    printf("[VHOST_STOP] Stopping host %u\n", host_id);
-    host->running = false;
-    
-    /* Stop packet generator if running */
-    if (host->pktgen.enabled) {
-        vhost_stop_pktgen(mgr, host_id);
+    if (stats.requests_tx == 0) {
+        return;
     }
     
-    /* Stop virtual link */
-    vlink_stop(mgr->link_mgr, host->pci_link_id);
-    
-    return 0;
+    printf("Host %u: RPC client -> %u.%u.%u.%u:%u (K=%u, %u B request / %u B response)\n",
+           host_id, cfg->dst_ip[0], cfg->dst_ip[1], cfg->dst_ip[2], cfg->dst_ip[3],
+           cfg->dst_port, cfg->outstanding, cfg->req_size, cfg->resp_size);
+    printf("  Transactions: %lu in %.3f s = %.0f TPS\n",
+           stats.responses_rx, stats.elapsed_ns / 1e9, stats.tps);
+    printf("  Requests: %lu sent, %lu timeouts, %lu late responses, %lu send errors\n",
+           stats.requests_tx, stats.timeouts, stats.late_responses, stats.send_errors);
+    vhost_hist_print(&stats.rtt, "RTT");
 }
 
-/* Send packet from virtual host */
-int vhost_send_packet(vhost_manager_t *mgr, uint32_t host_id,
-                      const uint8_t *data, uint16_t size)
+/* Start ping client */
+int vhost_start_ping(vhost_manager_t *mgr, uint32_t host_id,
+                     const vhost_ping_config_t *config)
 {
-    if (!mgr || host_id >= mgr->num_hosts || !data || size == 0) {
+    if (!mgr || host_id >= mgr->num_hosts || !config || config->interval_us == 0) {
         return -1;
     }
     
     vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_ping_t *ping = &host->ping;
     
     if (!host->running) {
         return -1;
     }
     
-    if (vlink_send(mgr->link_mgr, host->pci_link_id, data, size) != 0) {
-        pthread_mutex_lock(&host->lock);
-        host->stats.tx_errors++;
-        pthread_mutex_unlock(&host->lock);
-        return -1;
+    if (ping->joinable && !ping->enabled) {
+        pthread_join(ping->thread, NULL);  /* Previous run finished */
+        ping->joinable = false;
     }
     
-    pthread_mutex_lock(&host->lock);
-    host->stats.tx_packets++;
-    host->stats.tx_bytes += size;
-    pthread_mutex_unlock(&host->lock);
+    pthread_mutex_lock(&ping->lock);
+    if (ping->enabled) {
+        pthread_mutex_unlock(&ping->lock);
+        return -1;  /* Already running */
+    }
+    
+    ping->config = *config;
+    if (ping->config.payload_size < 8) {
+        ping->config.payload_size = 8;
+    }
+    if (ping->config.payload_size > MAX_PACKET_SIZE - 42) {
+        ping->config.payload_size = MAX_PACKET_SIZE - 42;
+    }
+    if (ping->config.timeout_ms == 0) {
+        ping->config.timeout_ms = VHOST_PING_DEFAULT_TIMEOUT_MS;
+    }
+    memset(&ping->stats, 0, sizeof(ping->stats));
+    vhost_hist_reset(&ping->stats.rtt);
+    memset(ping->window, 0, sizeof(ping->window));
+    ping->enabled = true;
+    pthread_mutex_unlock(&ping->lock);
+    
+    if (pthread_create(&ping->thread, NULL, ping_thread_func, host) != 0) {
+        ping->enabled = false;
+        return -1;
+    }
+    ping->joinable = true;
     
     return 0;
 }
 
-/* Configure packet generator */
-int vhost_configure_pktgen(vhost_manager_t *mgr, uint32_t host_id,
-                           const vhost_pktgen_config_t *config)
+/* Stop ping client */
+int vhost_stop_ping(vhost_manager_t *mgr, uint32_t host_id)
 {
-    if (!mgr || host_id >= mgr->num_hosts || !config) {
+    if (!mgr || host_id >= mgr->num_hosts) {
         return -1;
     }
     
-    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_ping_t *ping = &mgr->hosts[host_id].ping;
     
-    pthread_mutex_lock(&host->lock);
-    memcpy(&host->pktgen, config, sizeof(host->pktgen));
-    pthread_mutex_unlock(&host->lock);
+    pthread_mutex_lock(&ping->lock);
+    ping->enabled = false;
+    pthread_cond_broadcast(&ping->done);
+    pthread_mutex_unlock(&ping->lock);
+    
+    if (ping->joinable) {
+        pthread_join(ping->thread, NULL);
+        ping->joinable = false;
+    }
     
     return 0;
 }
 
-/* Start packet generator */
-int vhost_start_pktgen(vhost_manager_t *mgr, uint32_t host_id)
+/* Wait for the ping client to finish */
+int vhost_wait_ping(vhost_manager_t *mgr, uint32_t host_id, uint32_t timeout_ms)
 {
     if (!mgr || host_id >= mgr->num_hosts) {
-        printf("[PKTGEN_START] Invalid mgr or host_id=%u >= %u\n", host_id, mgr ? mgr->num_hosts : 0);
         return -1;
     }
     
-    vhost_instance_t *host = &mgr->hosts[host_id];
-    
-    if (host->pktgen.enabled) {
-        printf("[PKTGEN_START] Host %u already running\n", host_id);
-        return 0;  /* Already running */
+    vhost_ping_t *ping = &mgr->hosts[host_id].ping;
+    uint64_t deadline = vhost_now_ns() + timeout_ms * 1000000ULL;
+    struct timespec ts = {
+        .tv_sec = deadline / 1000000000ULL,
+        .tv_nsec = deadline % 1000000000ULL
+    };
+    int ret = 0;
+    
+    pthread_mutex_lock(&ping->lock);
+    while (ping->enabled && ret != ETIMEDOUT) {
+        ret = pthread_cond_timedwait(&ping->done, &ping->lock, &ts);
     }
+    ret = ping->enabled ? -ETIMEDOUT : 0;
+    pthread_mutex_unlock(&ping->lock);
     
-    if (host->pktgen.pps == 0) {
-        printf("[PKTGEN_START] Host %u not configured (pps=0)\n", host_id);
-        return -1;  /* Not configured */
+    return ret;
+}
+
+/* Get ping statistics */
+int vhost_get_ping_stats(vhost_manager_t *mgr, uint32_t host_id, vhost_ping_stats_t *stats)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !stats) {
+        return -1;
     }
     
-    printf("[PKTGEN_START] Starting pktgen for host %u (running=%d, pps=%u)\n", 
-           host_id, host->running, host->pktgen.pps);
-    
-    host->pktgen.enabled = true;
+    vhost_ping_t *ping = &mgr->hosts[host_id].ping;
     
-    if (pthread_create(&host->pktgen_thread, NULL, pktgen_thread_func, host) != 0) {
-        printf("[PKTGEN_START] pthread_create failed for host %u\n", host_id);
-        host->pktgen.enabled = false;
-        return -1;
-    }
+    pthread_mutex_lock(&ping->lock);
+    memcpy(stats, &ping->stats, sizeof(*stats));
+    pthread_mutex_unlock(&ping->lock);
     
-    printf("[PKTGEN_START] pthread created successfully for host %u\n", host_id);
     return 0;
 }
 
-/* Stop packet generator */
-int vhost_stop_pktgen(vhost_manager_t *mgr, uint32_t host_id)
+/* Print ping statistics */
+void vhost_print_ping_stats(vhost_manager_t *mgr, uint32_t host_id)
 {
-    if (!mgr || host_id >= mgr->num_hosts) {
-        return -1;
+    vhost_ping_stats_t stats;
+    
+    if (vhost_get_ping_stats(mgr, host_id, &stats) != 0 || stats.sent == 0) {
+        return;
     }
     
-    vhost_instance_t *host = &mgr->hosts[host_id];
+    vhost_ping_config_t *cfg = &mgr->hosts[host_id].ping.config;
+    uint64_t lost = stats.sent - stats.received;
     
-    if (!host->pktgen.enabled) {
-        return 0;  /* Already stopped */
+    printf("Host %u: ping %u.%u.%u.%u every %u us, %u B\n",
+           host_id, cfg->dst_ip[0], cfg->dst_ip[1], cfg->dst_ip[2], cfg->dst_ip[3],
+           cfg->interval_us, cfg->payload_size);
+    printf("  Probes: %lu sent, %lu received, %.2f%% loss, %lu late, %lu send errors\n",
+           stats.sent, stats.received, 100.0 * lost / stats.sent,
+           stats.late, stats.send_errors);
+    vhost_hist_print(&stats.rtt, "RTT");
+}
+
+/* Deliver a frame received by a shared engine */
+void vhost_receive_frame(vhost_manager_t *mgr, uint32_t host_id,
+                         const uint8_t *data, uint16_t size)
+{
+    if (!mgr || host_id >= mgr->num_hosts || !mgr->hosts[host_id].running) {
+        return;
     }
     
-    host->pktgen.enabled = false;
-    pthread_join(host->pktgen_thread, NULL);
-    
-    return 0;
+    vhost_rx_callback(&mgr->hosts[host_id], data, size);
 }
 
 /* Set custom packet handler callback */
@@ -479,27 +1903,16 @@ void vhost_print_stats(vhost_manager_t *mgr)
         printf("  RX: %lu pkts / %lu bytes (errors: %lu, drops: %lu)\n",
                host->stats.rx_packets, host->stats.rx_bytes,
                host->stats.rx_errors, host->stats.rx_drops);
-    }
-}
-
-/* Helper: Calculate checksum */
-static uint16_t calculate_checksum(const uint8_t *data, uint16_t len)
-{
-    uint32_t sum = 0;
-    
-    for (uint16_t i = 0; i < len; i += 2) {
-        if (i + 1 < len) {
-            sum += (data[i] << 8) | data[i + 1];
-        } else {
-            sum += data[i] << 8;
+        printf("  ARP: %lu requests / %lu replies sent, %lu received (neighbor drops: %lu)\n",
+               host->stats.arp_requests_tx, host->stats.arp_replies_tx,
+               host->stats.arp_rx, host->stats.neigh_drops);
+        printf("  ICMP: %lu received, %lu echo replies sent\n",
+               host->stats.icmp_rx, host->stats.icmp_echo_replies_tx);
+        if (host->rpc.server_port != 0 || host->rpc.stats.requests_tx > 0) {
+            vhost_print_rpc_stats(mgr, i);
         }
+        vhost_print_ping_stats(mgr, i);
     }
-    
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    
-    return ~sum;
 }
 
 /* Helper: Generate Ethernet frame */
@@ -560,7 +1973,7 @@ uint16_t vhost_build_udp_packet(uint8_t *packet, uint16_t max_size,
     memcpy(ip + 12, src_ip, 4);
     memcpy(ip + 16, dst_ip, 4);
     
-    uint16_t ip_checksum = calculate_checksum(ip, 20);
+    uint16_t ip_checksum = net_checksum(ip, 20);
     ip[10] = (ip_checksum >> 8) & 0xFF;
     ip[11] = ip_checksum & 0xFF;
     
@@ -573,11 +1986,15 @@ uint16_t vhost_build_udp_packet(uint8_t *packet, uint16_t max_size,
     udp[3] = dst_port & 0xFF;
     udp[4] = (udp_len >> 8) & 0xFF;
     udp[5] = udp_len & 0xFF;
-    udp[6] = udp[7] = 0;  /* Checksum (optional for UDP) */
+    udp[6] = udp[7] = 0;
     
     /* Payload */
     memcpy(udp + 8, payload, payload_len);
     
+    uint16_t udp_checksum = net_udp_checksum_ipv4(src_ip, dst_ip, udp, udp_len);
+    udp[6] = (udp_checksum >> 8) & 0xFF;
+    udp[7] = udp_checksum & 0xFF;
+    
     return total_len;
 }
 
@@ -686,3 +2103,161 @@ uint16_t vhost_build_arp_reply(uint8_t *packet, uint16_t max_size,
     
     return total_len;
 }
+
+/* Build ICMP echo request packet */
+uint16_t vhost_build_icmp_echo(uint8_t *packet, uint16_t max_size,
+                               const uint8_t *dst_mac, const uint8_t *src_mac,
+                               const uint8_t *dst_ip, const uint8_t *src_ip,
+                               uint16_t ident, uint16_t seq,
+                               const uint8_t *payload, uint16_t payload_len)
+{
+    uint16_t ip_len = 20 + 8 + payload_len;
+    uint16_t total_len = 14 + ip_len;
+    
+    if (total_len > max_size) {
+        return 0;
+    }
+    
+    /* Ethernet header */
+    memcpy(packet, dst_mac, 6);
+    memcpy(packet + 6, src_mac, 6);
+    packet[12] = 0x08;  /* EtherType: IPv4 */
+    packet[13] = 0x00;
+    
+    /* IP header */
+    uint8_t *ip = packet + 14;
+    ip[0] = 0x45;  /* Version 4, IHL 5 */
+    ip[1] = 0x00;  /* DSCP/ECN */
+    ip[2] = (ip_len >> 8) & 0xFF;
+    ip[3] = ip_len & 0xFF;
+    ip[4] = (seq >> 8) & 0xFF;  /* ID */
+    ip[5] = seq & 0xFF;
+    ip[6] = ip[7] = 0;  /* Flags/Fragment */
+    ip[8] = 64;    /* TTL */
+    ip[9] = 1;     /* Protocol: ICMP */
+    ip[10] = ip[11] = 0;
+    memcpy(ip + 12, src_ip, 4);
+    memcpy(ip + 16, dst_ip, 4);
+    
+    uint16_t ip_checksum = net_checksum(ip, 20);
+    ip[10] = (ip_checksum >> 8) & 0xFF;
+    ip[11] = ip_checksum & 0xFF;
+    
+    /* ICMP echo request */
+    uint8_t *icmp = ip + 20;
+    icmp[0] = 8;   /* Type: echo request */
+    icmp[1] = 0;   /* Code */
+    icmp[2] = icmp[3] = 0;
+    icmp[4] = (ident >> 8) & 0xFF;
+    icmp[5] = ident & 0xFF;
+    icmp[6] = (seq >> 8) & 0xFF;
+    icmp[7] = seq & 0xFF;
+    memcpy(icmp + 8, payload, payload_len);
+    
+    uint16_t icmp_checksum = net_checksum(icmp, 8 + payload_len);
+    icmp[2] = (icmp_checksum >> 8) & 0xFF;
+    icmp[3] = icmp_checksum & 0xFF;
+    
+    return total_len;
+}
+
+/* Build gratuitous ARP packet */
+uint16_t vhost_build_gratuitous_arp(uint8_t *packet, uint16_t max_size,
+                                    const uint8_t *src_mac, const uint8_t *src_ip)
+{
+    /* RFC 5227 announcement: ARP request with sender IP == target IP */
+    return vhost_build_arp_request(packet, max_size, src_mac, src_ip, src_ip);
+}
+
+/* Histogram bucket of a value: exact below 2^SUB_BITS, log-linear above */
+static inline uint32_t hist_bucket(uint64_t value)
+{
+    if (value < (1ULL << VHOST_HIST_SUB_BITS)) {
+        return (uint32_t)value;
+    }
+    
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - VHOST_HIST_SUB_BITS;
+    
+    return ((shift + 1) << VHOST_HIST_SUB_BITS) +
+           (uint32_t)((value >> shift) & ((1ULL << VHOST_HIST_SUB_BITS) - 1));
+}
+
+/* Largest value that falls into a bucket */
+static inline uint64_t hist_bucket_max(uint32_t bucket)
+{
+    if (bucket < (1U << VHOST_HIST_SUB_BITS)) {
+        return bucket;
+    }
+    
+    uint32_t shift = (bucket >> VHOST_HIST_SUB_BITS) - 1;
+    uint64_t sub = bucket & ((1U << VHOST_HIST_SUB_BITS) - 1);
+    uint64_t base = ((1ULL << VHOST_HIST_SUB_BITS) | sub) << shift;
+    
+    return base + ((1ULL << shift) - 1);
+}
+
+/* Histogram: clear all samples */
+void vhost_hist_reset(vhost_hist_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+/* Histogram: record one value */
+void vhost_hist_record(vhost_hist_t *hist, uint64_t value)
+{
+    hist->buckets[hist_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+/* Histogram: value at percentile */
+uint64_t vhost_hist_percentile(const vhost_hist_t *hist, double pct)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+    
+    uint64_t rank = (uint64_t)(pct / 100.0 * hist->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    if (rank > hist->count) {
+        rank = hist->count;
+    }
+    
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < VHOST_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_max(i);
+            return v > hist->max ? hist->max : v;
+        }
+    }
+    
+    return hist->max;
+}
+
+/* Histogram: print ns samples in us */
+void vhost_hist_print(const vhost_hist_t *hist, const char *label)
+{
+    if (hist->count == 0) {
+        printf("  %s: no samples\n", label);
+        return;
+    }
+    
+    printf("  %s (us): min %.1f  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  (%lu samples)\n",
+           label, hist->min / 1e3, (double)hist->sum / hist->count / 1e3,
+           vhost_hist_percentile(hist, 50.0) / 1e3,
+           vhost_hist_percentile(hist, 90.0) / 1e3,
+           vhost_hist_percentile(hist, 99.0) / 1e3,
+           vhost_hist_percentile(hist, 99.9) / 1e3,
+           hist->max / 1e3, hist->count);
+}
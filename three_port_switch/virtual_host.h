@@ -13,10 +13,31 @@
 #include <pthread.h>
 #include "virtual_link.h"
 
-#define MAX_VHOSTS 64
+#define MAX_VHOSTS 4096
 #define VHOST_MAC_LEN 6
 #define VHOST_IP_LEN 4
 
+/* Neighbor (ARP) cache */
+#define VHOST_NEIGH_TABLE_SIZE 256       /* Entries per host, power of 2 */
+#define VHOST_NEIGH_MAX_PENDING 16       /* Packets held per unresolved neighbor */
+#define VHOST_ARP_RETRANS_MS 1000        /* ARP request retransmit interval */
+#define VHOST_ARP_MAX_PROBES 3           /* Requests sent before resolution fails */
+#define VHOST_NEIGH_REACHABLE_MS 30000   /* Entry is refreshed after this age */
+
+/* Closed-loop RPC generator */
+#define VHOST_RPC_MAX_OUTSTANDING 256    /* Upper bound on requests in flight */
+#define VHOST_RPC_MAGIC 0x52504331       /* "RPC1" */
+#define VHOST_RPC_SRC_PORT 40000         /* Client source UDP port */
+#define VHOST_RPC_DEFAULT_TIMEOUT_MS 1000
+
+/* ICMP echo (ping) */
+#define VHOST_PING_WINDOW 1024           /* Probes tracked for matching, power of 2 */
+#define VHOST_PING_DEFAULT_TIMEOUT_MS 1000
+
+/* Latency histogram: log-linear buckets, 2^SUB_BITS per power of two */
+#define VHOST_HIST_SUB_BITS 4
+#define VHOST_HIST_BUCKETS ((64 - VHOST_HIST_SUB_BITS + 1) << VHOST_HIST_SUB_BITS)
+
 /* Virtual host statistics */
 typedef struct {
     uint64_t tx_packets;
@@ -26,8 +47,160 @@ typedef struct {
     uint64_t tx_errors;
     uint64_t rx_errors;
     uint64_t rx_drops;
+    uint64_t arp_requests_tx;
+    uint64_t arp_replies_tx;
+    uint64_t arp_rx;
+    uint64_t neigh_drops;     /* Packets dropped waiting for ARP resolution */
+    uint64_t icmp_rx;
+    uint64_t icmp_echo_replies_tx;
 } vhost_stats_t;
 
+/* Neighbor entry state */
+typedef enum {
+    VHOST_NEIGH_FREE = 0,
+    VHOST_NEIGH_INCOMPLETE,   /* ARP request sent, waiting for reply */
+    VHOST_NEIGH_REACHABLE,    /* Resolved by ARP */
+    VHOST_NEIGH_STATIC        /* Configured, never overwritten by ARP */
+} vhost_neigh_state_t;
+
+/* Packet held while its next hop is being resolved */
+typedef struct vhost_pending_pkt {
+    struct vhost_pending_pkt *next;
+    uint16_t size;
+    uint8_t data[];
+} vhost_pending_pkt_t;
+
+/* Neighbor (IPv4 -> MAC) entry */
+typedef struct {
+    uint32_t ip;              /* Network byte order */
+    uint8_t mac[VHOST_MAC_LEN];
+    vhost_neigh_state_t state;
+    uint8_t probes;           /* ARP requests sent in current resolution */
+    uint64_t updated_us;      /* Last confirmation */
+    uint64_t probe_us;        /* Last ARP request */
+    vhost_pending_pkt_t *pending_head;
+    vhost_pending_pkt_t *pending_tail;
+    uint16_t pending_count;
+} vhost_neigh_entry_t;
+
+/* Per-host neighbor table (open addressing, keyed by IPv4) */
+typedef struct {
+    vhost_neigh_entry_t entries[VHOST_NEIGH_TABLE_SIZE];
+    uint32_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t resolved;  /* Signalled whenever an entry resolves */
+} vhost_neigh_table_t;
+
+/* Latency histogram (values in ns, relative bucket error <= 1/16) */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[VHOST_HIST_BUCKETS];
+} vhost_hist_t;
+
+/* RPC message types */
+typedef enum {
+    VHOST_RPC_REQUEST = 1,
+    VHOST_RPC_RESPONSE = 2
+} vhost_rpc_type_t;
+
+/* RPC header carried at the start of the UDP payload */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;           /* VHOST_RPC_MAGIC */
+    uint8_t type;             /* vhost_rpc_type_t */
+    uint8_t reserved;
+    uint16_t slot;            /* Client slot the request belongs to */
+    uint32_t seq;             /* Matches a response to its request */
+    uint32_t resp_size;       /* Payload size the server answers with */
+} vhost_rpc_hdr_t;
+
+/* Closed-loop RPC client configuration */
+typedef struct {
+    uint8_t dst_ip[VHOST_IP_LEN];
+    uint16_t dst_port;
+    uint32_t outstanding;     /* Requests kept in flight (K) */
+    uint32_t req_size;        /* UDP payload bytes per request */
+    uint32_t resp_size;       /* UDP payload bytes per response */
+    uint32_t count;           /* Transactions to complete (0 = until stopped) */
+    uint32_t timeout_ms;      /* Request is retried after this long */
+} vhost_rpc_config_t;
+
+/* RPC statistics */
+typedef struct {
+    uint64_t requests_tx;
+    uint64_t responses_rx;
+    uint64_t timeouts;        /* Requests retried after timeout_ms */
+    uint64_t late_responses;  /* Responses to requests already retried */
+    uint64_t send_errors;
+    uint64_t server_requests; /* Requests answered as server */
+    uint64_t elapsed_ns;      /* Client run time */
+    double tps;               /* Completed transactions per second */
+    vhost_hist_t rtt;         /* Request -> response round trip, ns */
+} vhost_rpc_stats_t;
+
+/* Request slot; each one keeps a single request in flight */
+typedef struct {
+    uint32_t seq;             /* 0 = idle */
+    uint64_t sent_ns;
+} vhost_rpc_slot_t;
+
+/* Per-host RPC state (client and/or server) */
+typedef struct {
+    vhost_rpc_config_t config;
+    bool client_enabled;
+    bool client_joinable;     /* client_thread has not been joined yet */
+    pthread_t client_thread;
+    uint16_t server_port;     /* 0 = server disabled */
+    uint32_t next_seq;
+    uint64_t issued;          /* New transactions started */
+    uint64_t completed;
+    uint64_t start_ns;
+    vhost_rpc_slot_t slots[VHOST_RPC_MAX_OUTSTANDING];
+    vhost_rpc_stats_t stats;
+    pthread_mutex_t lock;
+    pthread_cond_t done;      /* Signalled when count transactions complete */
+} vhost_rpc_t;
+
+/* Ping client configuration */
+typedef struct {
+    uint8_t dst_ip[VHOST_IP_LEN];
+    uint32_t interval_us;     /* Probe spacing (high-rate probing: tens of us) */
+    uint32_t count;           /* Probes to send (0 = until stopped) */
+    uint16_t payload_size;    /* ICMP data bytes, >= 8 */
+    uint32_t timeout_ms;      /* Wait for stragglers after the last probe */
+} vhost_ping_config_t;
+
+/* Ping statistics */
+typedef struct {
+    uint64_t sent;
+    uint64_t received;
+    uint64_t late;            /* Duplicate or outside the tracking window */
+    uint64_t send_errors;
+    vhost_hist_t rtt;         /* Echo request -> reply, ns */
+} vhost_ping_stats_t;
+
+/* Probe awaiting its reply */
+typedef struct {
+    uint16_t seq;
+    bool pending;
+    uint64_t sent_ns;
+} vhost_ping_probe_t;
+
+/* Per-host ping client state */
+typedef struct {
+    vhost_ping_config_t config;
+    bool enabled;
+    bool joinable;            /* thread has not been joined yet */
+    pthread_t thread;
+    uint16_t ident;           /* ICMP identifier of this host's probes */
+    vhost_ping_probe_t window[VHOST_PING_WINDOW];
+    vhost_ping_stats_t stats;
+    pthread_mutex_t lock;
+    pthread_cond_t done;      /* Signalled when the client finishes */
+} vhost_ping_t;
+
 /* Virtual host configuration */
 typedef struct {
     char name[64];
@@ -48,6 +221,8 @@ typedef struct {
     uint16_t dst_port;
 } vhost_pktgen_config_t;
 
+struct vhost_engine;
+
 /* Virtual host instance */
 typedef struct {
     uint32_t host_id;
@@ -58,6 +233,9 @@ typedef struct {
     uint32_t pci_link_id;
     vlink_manager_t *link_mgr;
     
+    /* Shared host engine (NULL = host owns its link RX and pktgen threads) */
+    struct vhost_engine *engine;
+    
     /* Packet generator */
     vhost_pktgen_config_t pktgen;
     pthread_t pktgen_thread;
@@ -65,6 +243,15 @@ typedef struct {
     /* Receive handler */
     pthread_t rx_thread;
     
+    /* ARP neighbor cache */
+    vhost_neigh_table_t neigh;
+    
+    /* Closed-loop RPC client/server */
+    vhost_rpc_t rpc;
+    
+    /* Ping client (echo replies are always answered) */
+    vhost_ping_t ping;
+    
     /* Control */
     bool running;
     pthread_mutex_t lock;
@@ -76,7 +263,7 @@ typedef struct {
 
 /* Virtual host manager */
 typedef struct {
-    vhost_instance_t hosts[MAX_VHOSTS];
+    vhost_instance_t *hosts;      /* MAX_VHOSTS entries */
     uint32_t num_hosts;
     vlink_manager_t *link_mgr;
     pthread_mutex_t mgr_lock;
@@ -137,6 +324,122 @@ int vhost_start_pktgen(vhost_manager_t *mgr, uint32_t host_id);
  */
 int vhost_stop_pktgen(vhost_manager_t *mgr, uint32_t host_id);
 
+/*
+ * Send an IPv4 frame, filling in the destination MAC from the neighbor cache.
+ * If the next hop is unresolved the frame is queued, an ARP request is sent
+ * and the frame goes out when the reply arrives.
+ */
+int vhost_send_ip_packet(vhost_manager_t *mgr, uint32_t host_id,
+                         const uint8_t *dst_ip, uint8_t *frame, uint16_t size);
+
+/*
+ * Resolve an IPv4 address to a MAC, blocking until the ARP reply arrives
+ * or timeout_ms expires
+ */
+int vhost_resolve(vhost_manager_t *mgr, uint32_t host_id,
+                  const uint8_t *ip, uint8_t *mac, uint32_t timeout_ms);
+
+/*
+ * Add a static neighbor entry
+ */
+int vhost_add_neighbor(vhost_manager_t *mgr, uint32_t host_id,
+                       const uint8_t *ip, const uint8_t *mac);
+
+/*
+ * Look up a resolved neighbor entry (non-blocking)
+ */
+int vhost_lookup_neighbor(vhost_manager_t *mgr, uint32_t host_id,
+                          const uint8_t *ip, uint8_t *mac);
+
+/*
+ * Flush all dynamic neighbor entries and drop queued packets
+ */
+int vhost_flush_neighbors(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Announce host IP/MAC with a gratuitous ARP
+ */
+int vhost_send_gratuitous_arp(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Print neighbor table of a host
+ */
+void vhost_print_neighbors(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Configure closed-loop RPC client. The client keeps config->outstanding
+ * requests in flight to dst_ip:dst_port and issues a new request as soon
+ * as a response arrives.
+ */
+int vhost_configure_rpc(vhost_manager_t *mgr, uint32_t host_id,
+                        const vhost_rpc_config_t *config);
+
+/*
+ * Start RPC client
+ */
+int vhost_start_rpc_client(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Stop RPC client
+ */
+int vhost_stop_rpc_client(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Wait until the RPC client has completed its configured count
+ * (or timeout_ms expires)
+ */
+int vhost_wait_rpc_client(vhost_manager_t *mgr, uint32_t host_id, uint32_t timeout_ms);
+
+/*
+ * Answer RPC requests on a UDP port from the host's RX path (0 = disable)
+ */
+int vhost_start_rpc_server(vhost_manager_t *mgr, uint32_t host_id, uint16_t port);
+
+/*
+ * Get RPC statistics, including the RTT histogram
+ */
+int vhost_get_rpc_stats(vhost_manager_t *mgr, uint32_t host_id, vhost_rpc_stats_t *stats);
+
+/*
+ * Print RPC client/server statistics of a host
+ */
+void vhost_print_rpc_stats(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Start pinging config->dst_ip; replies are matched in the RX path
+ */
+int vhost_start_ping(vhost_manager_t *mgr, uint32_t host_id,
+                     const vhost_ping_config_t *config);
+
+/*
+ * Stop ping client
+ */
+int vhost_stop_ping(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Wait until the ping client has sent its count and collected replies
+ * (or timeout_ms expires)
+ */
+int vhost_wait_ping(vhost_manager_t *mgr, uint32_t host_id, uint32_t timeout_ms);
+
+/*
+ * Get ping statistics, including the RTT histogram
+ */
+int vhost_get_ping_stats(vhost_manager_t *mgr, uint32_t host_id, vhost_ping_stats_t *stats);
+
+/*
+ * Print ping statistics of a host
+ */
+void vhost_print_ping_stats(vhost_manager_t *mgr, uint32_t host_id);
+
+/*
+ * Deliver a received frame to a host's stack (ARP, RPC, packet handler).
+ * Used when the host's link is polled by a shared engine instead of a
+ * per-link RX thread.
+ */
+void vhost_receive_frame(vhost_manager_t *mgr, uint32_t host_id,
+                         const uint8_t *data, uint16_t size);
+
 /*
  * Set custom packet handler callback
  */
@@ -194,4 +497,39 @@ uint16_t vhost_build_arp_reply(uint8_t *packet, uint16_t max_size,
                                const uint8_t *src_mac, const uint8_t *src_ip,
                                const uint8_t *dst_mac, const uint8_t *dst_ip);
 
+/*
+ * Helper: Generate ICMP echo request packet
+ */
+uint16_t vhost_build_icmp_echo(uint8_t *packet, uint16_t max_size,
+                               const uint8_t *dst_mac, const uint8_t *src_mac,
+                               const uint8_t *dst_ip, const uint8_t *src_ip,
+                               uint16_t ident, uint16_t seq,
+                               const uint8_t *payload, uint16_t payload_len);
+
+/*
+ * Helper: Generate gratuitous ARP packet (request with sender IP == target IP)
+ */
+uint16_t vhost_build_gratuitous_arp(uint8_t *packet, uint16_t max_size,
+                                    const uint8_t *src_mac, const uint8_t *src_ip);
+
+/*
+ * Histogram: clear all samples
+ */
+void vhost_hist_reset(vhost_hist_t *hist);
+
+/*
+ * Histogram: record one value
+ */
+void vhost_hist_record(vhost_hist_t *hist, uint64_t value);
+
+/*
+ * Histogram: value at percentile pct (0-100), upper bound of its bucket
+ */
+uint64_t vhost_hist_percentile(const vhost_hist_t *hist, double pct);
+
+/*
+ * Histogram: print count, min/mean/percentiles/max of ns samples in us
+ */
+void vhost_hist_print(const vhost_hist_t *hist, const char *label);
+
 #endif /* VIRTUAL_HOST_H */
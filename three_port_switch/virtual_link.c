@@ -30,18 +30,27 @@ static int queue_init(vlink_queue_t *queue)
 {
     memset(queue, 0, sizeof(*queue));
     
+    /* calloc keeps untouched slots unbacked; links only pay for what they queue */
+    queue->packets = calloc(VLINK_QUEUE_SIZE, sizeof(vlink_packet_t));
+    if (!queue->packets) {
+        return -1;
+    }
+    
     if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+        free(queue->packets);
         return -1;
     }
     
     if (pthread_cond_init(&queue->not_empty, NULL) != 0) {
         pthread_mutex_destroy(&queue->lock);
+        free(queue->packets);
         return -1;
     }
     
     if (pthread_cond_init(&queue->not_full, NULL) != 0) {
         pthread_mutex_destroy(&queue->lock);
         pthread_cond_destroy(&queue->not_empty);
+        free(queue->packets);
         return -1;
     }
     
@@ -54,6 +63,8 @@ static void queue_cleanup(vlink_queue_t *queue)
     pthread_cond_destroy(&queue->not_full);
     pthread_cond_destroy(&queue->not_empty);
     pthread_mutex_destroy(&queue->lock);
+    free(queue->packets);
+    queue->packets = NULL;
 }
 
 /* Enqueue packet (non-blocking) */
@@ -123,6 +134,40 @@ static int queue_dequeue(vlink_queue_t *queue, uint8_t *data, uint16_t *size,
     return 0;
 }
 
+/* Dequeue packet without waiting */
+static int queue_try_dequeue(vlink_queue_t *queue, uint8_t *data, uint16_t *size,
+                             uint16_t max_size)
+{
+    /* Unlocked peek: an empty queue costs no lock round trip */
+    if (queue->head == queue->tail) {
+        return -EAGAIN;
+    }
+    
+    pthread_mutex_lock(&queue->lock);
+    
+    if (queue->head == queue->tail) {
+        pthread_mutex_unlock(&queue->lock);
+        return -EAGAIN;
+    }
+    
+    vlink_packet_t *pkt = &queue->packets[queue->tail];
+    
+    if (pkt->size > max_size) {
+        pthread_mutex_unlock(&queue->lock);
+        return -EMSGSIZE;
+    }
+    
+    memcpy(data, pkt->data, pkt->size);
+    *size = pkt->size;
+    
+    queue->tail = (queue->tail + 1) % VLINK_QUEUE_SIZE;
+    
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    
+    return 0;
+}
+
 /* RX thread for callback mode */
 static void *rx_thread_func(void *arg)
 {
@@ -300,8 +345,17 @@ int vlink_send(vlink_manager_t *mgr, uint32_t link_id,
         usleep(total_delay);
     }
     
-    /* Enqueue to TX queue */
-    int ret = queue_enqueue(&link->tx_queue, data, size);
+    /*
+     * Deliver into the peer's RX queue. Only unconnected links keep frames
+     * in their own TX queue; mirroring every frame there filled it after
+     * VLINK_QUEUE_SIZE sends, since nothing drains it.
+     */
+    vlink_queue_t *queue = &link->tx_queue;
+    if (link->peer_id != UINT32_MAX && link->peer_id < mgr->num_links) {
+        queue = &mgr->links[link->peer_id].rx_queue;
+    }
+    
+    int ret = queue_enqueue(queue, data, size);
     if (ret != 0) {
         link->stats.drops++;
         return ret;
@@ -310,12 +364,6 @@ int vlink_send(vlink_manager_t *mgr, uint32_t link_id,
     link->stats.tx_packets++;
     link->stats.tx_bytes += size;
     
-    /* Also put in peer's RX queue if connected */
-    if (link->peer_id != UINT32_MAX && link->peer_id < mgr->num_links) {
-        vlink_endpoint_t *peer = &mgr->links[link->peer_id];
-        queue_enqueue(&peer->rx_queue, data, size);
-    }
-    
     return 0;
 }
 
@@ -337,6 +385,24 @@ int vlink_recv(vlink_manager_t *mgr, uint32_t link_id,
     return ret;
 }
 
+int vlink_poll(vlink_manager_t *mgr, uint32_t link_id,
+               uint8_t *data, uint16_t *size, uint16_t max_size)
+{
+    if (link_id >= mgr->num_links) {
+        return -EINVAL;
+    }
+    
+    vlink_endpoint_t *link = &mgr->links[link_id];
+    
+    int ret = queue_try_dequeue(&link->rx_queue, data, size, max_size);
+    if (ret == 0) {
+        link->stats.rx_packets++;
+        link->stats.rx_bytes += *size;
+    }
+    
+    return ret;
+}
+
 int vlink_start(vlink_manager_t *mgr, uint32_t link_id)
 {
     if (link_id >= mgr->num_links) {
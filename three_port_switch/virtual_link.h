@@ -12,7 +12,7 @@
 #include <stdbool.h>
 #include <pthread.h>
 
-#define MAX_VLINKS 32
+#define MAX_VLINKS 256
 #define MAX_PACKET_SIZE 9000
 #define VLINK_QUEUE_SIZE 16384  /* High-rate testing: <5000 pkts/host */
 
@@ -34,9 +34,9 @@ typedef struct {
     uint32_t seq_num;
 } vlink_packet_t;
 
-/* Virtual link queue (ring buffer) */
+/* Virtual link queue (ring buffer, slots allocated at link creation) */
 typedef struct {
-    vlink_packet_t packets[VLINK_QUEUE_SIZE];
+    vlink_packet_t *packets;
     volatile uint32_t head;
     volatile uint32_t tail;
     pthread_mutex_t lock;
@@ -127,6 +127,13 @@ int vlink_send(vlink_manager_t *mgr, uint32_t link_id,
 int vlink_recv(vlink_manager_t *mgr, uint32_t link_id,
                uint8_t *data, uint16_t *size, uint16_t max_size);
 
+/*
+ * Receive packet without waiting; returns -EAGAIN if the RX queue is empty.
+ * For event loops that service many links from one thread.
+ */
+int vlink_poll(vlink_manager_t *mgr, uint32_t link_id,
+               uint8_t *data, uint16_t *size, uint16_t max_size);
+
 /*
  * Start virtual link (enables RX thread if callback is set)
  */
@@ -13,6 +13,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include "virtual_link.h"
+#include "l2_fwd.h"
 
 /* Switch instance */
 typedef struct {
@@ -24,6 +25,9 @@ typedef struct {
     uint32_t eth0_link_id;     /* Port 1 - Ethernet 0 */
     uint32_t eth1_link_id;     /* Port 2 - Ethernet 1 */
     
+    /* MAC learning forwarding plane */
+    l2_fwd_t fwd;
+    
     /* Port statistics */
     struct {
         uint64_t rx_packets;
@@ -52,75 +56,55 @@ void signal_handler(int sig)
     printf("\nShutdown requested...\n");
 }
 
-/* Forward packet based on three-port switch logic */
-static uint8_t get_forward_port(uint8_t input_port)
+/* Link attached to a switch port */
+static uint32_t port_link(const switch_instance_t *sw, uint8_t port)
 {
-    switch (input_port) {
-        case 0: return 1;  /* PCI -> Eth0 */
-        case 1: return 2;  /* Eth0 -> Eth1 */
-        case 2: return 0;  /* Eth1 -> PCI */
-        default: return 0;
+    switch (port) {
+        case 0: return sw->pci_link_id;
+        case 1: return sw->eth0_link_id;
+        default: return sw->eth1_link_id;
     }
 }
 
-/* RX callback for PCI port */
-static void pci_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+/* Learn, look up and send a frame received on in_port to its egress ports */
+static void switch_port_rx(switch_instance_t *sw, uint8_t in_port,
+                           const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
+    sw->port_stats[in_port].rx_packets++;
+    sw->port_stats[in_port].rx_bytes += size;
     
-    sw->port_stats[0].rx_packets++;
-    sw->port_stats[0].rx_bytes += size;
+    uint32_t out_ports = l2_fwd_forward(&sw->fwd, in_port, data, size,
+                                        l2_fwd_now_ms());
     
-    /* Forward to Eth0 (port 1) */
-    uint8_t out_port = get_forward_port(0);
-    uint32_t out_link = (out_port == 1) ? sw->eth0_link_id : sw->eth1_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, data, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
+    for (uint8_t out_port = 0; out_port < 3; out_port++) {
+        if (!(out_ports & (1u << out_port))) {
+            continue;
+        }
+        if (vlink_send(sw->link_mgr, port_link(sw, out_port), data, size) == 0) {
+            sw->port_stats[out_port].tx_packets++;
+            sw->port_stats[out_port].tx_bytes += size;
+        } else {
+            sw->port_stats[out_port].drops++;
+        }
     }
 }
 
+/* RX callback for PCI port */
+static void pci_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
+{
+    switch_port_rx((switch_instance_t *)ctx, 0, data, size);
+}
+
 /* RX callback for Eth0 port */
 static void eth0_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
-    
-    sw->port_stats[1].rx_packets++;
-    sw->port_stats[1].rx_bytes += size;
-    
-    /* Forward to Eth1 (port 2) */
-    uint8_t out_port = get_forward_port(1);
-    uint32_t out_link = (out_port == 2) ? sw->eth1_link_id : sw->pci_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, data, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
-    }
+    switch_port_rx((switch_instance_t *)ctx, 1, data, size);
 }
 
 /* RX callback for Eth1 port */
 static void eth1_rx_callback(void *ctx, const uint8_t *data, uint16_t size)
 {
-    switch_instance_t *sw = (switch_instance_t *)ctx;
-    
-    sw->port_stats[2].rx_packets++;
-    sw->port_stats[2].rx_bytes += size;
-    
-    /* Forward to PCI (port 0) */
-    uint8_t out_port = get_forward_port(2);
-    uint32_t out_link = (out_port == 0) ? sw->pci_link_id : sw->eth0_link_id;
-    
-    if (vlink_send(sw->link_mgr, out_link, data, size) == 0) {
-        sw->port_stats[out_port].tx_packets++;
-        sw->port_stats[out_port].tx_bytes += size;
-    } else {
-        sw->port_stats[out_port].drops++;
-    }
+    switch_port_rx((switch_instance_t *)ctx, 2, data, size);
 }
 
 /* Create a switch instance */
@@ -138,6 +122,11 @@ static int create_switch(uint32_t switch_id, const char *name)
     sw->link_mgr = &global_link_mgr;
     sw->running = true;
     
+    if (l2_fwd_init(&sw->fwd, 3, 0, 0) != 0) {
+        num_switches--;
+        return -1;
+    }
+    
     /* Create virtual links for each port */
     char link_name[64];
     
@@ -178,8 +167,13 @@ static void connect_ring_topology(void)
                      switches[i].eth1_link_id,
                      switches[next].eth0_link_id);
         
-        printf("  Switch %u (eth1) <-> Switch %u (eth0)\n", i, next);
+        printf("  Switch %u (eth1) <-> Switch %u (eth0)%s\n", i, next,
+               next == 0 ? " [blocked]" : "");
     }
+    
+    /* Block the link closing the ring, as spanning tree would, so floods end */
+    l2_fwd_set_port_state(&switches[num_switches - 1].fwd, 2, L2_PORT_BLOCKING);
+    l2_fwd_set_port_state(&switches[0].fwd, 1, L2_PORT_BLOCKING);
 }
 
 /* Connect switches in a line topology */
@@ -211,8 +205,13 @@ static void connect_mesh_topology(void)
                      switches[i].eth0_link_id,
                      switches[next1].eth1_link_id);
         
-        printf("  Switch %u (eth0) <-> Switch %u (eth1)\n", i, next1);
+        printf("  Switch %u (eth0) <-> Switch %u (eth1)%s\n", i, next1,
+               next1 == 0 ? " [blocked]" : "");
     }
+    
+    /* The partial mesh is a ring too; block its closing link */
+    l2_fwd_set_port_state(&switches[num_switches - 1].fwd, 1, L2_PORT_BLOCKING);
+    l2_fwd_set_port_state(&switches[0].fwd, 2, L2_PORT_BLOCKING);
 }
 
 /* Print statistics for all switches */
@@ -238,23 +237,35 @@ static void print_all_stats(void)
                sw->port_stats[2].rx_packets, sw->port_stats[2].rx_bytes,
                sw->port_stats[2].tx_packets, sw->port_stats[2].tx_bytes,
                sw->port_stats[2].drops);
+        l2_fwd_print_stats(&sw->fwd, sw->name);
     }
     
     vlink_print_stats(&global_link_mgr);
 }
 
-/* Send test traffic */
+/*
+ * Send test traffic: station i behind switch i's PCI port sends one frame
+ * to station i+1. The first round floods until each station has been
+ * seen; later rounds follow the learned path only.
+ */
 static void send_test_traffic(void)
 {
     printf("\nSending test traffic...\n");
     
     uint8_t test_packet[128];
     memset(test_packet, 0xAA, sizeof(test_packet));
+    test_packet[12] = 0x88;  /* Local experimental EtherType */
+    test_packet[13] = 0xB5;
     
     /* Inject packets into each switch's PCI port */
     for (uint32_t i = 0; i < num_switches; i++) {
+        uint8_t dst[6] = {0x02, 0x00, 0x00, 0x00, 0x01, (uint8_t)((i + 1) % num_switches)};
+        uint8_t src[6] = {0x02, 0x00, 0x00, 0x00, 0x01, (uint8_t)i};
+        memcpy(test_packet, dst, 6);
+        memcpy(test_packet + 6, src, 6);
+        
         printf("  Switch %u: Injecting packet on PCI port\n", i);
-        vlink_send(&global_link_mgr, switches[i].pci_link_id, test_packet, sizeof(test_packet));
+        switch_port_rx(&switches[i], 0, test_packet, sizeof(test_packet));
         usleep(10000);  /* 10ms delay between packets */
     }
     
@@ -360,6 +371,10 @@ int main(int argc, char *argv[])
         if (send_traffic && iteration % 6 == 0) {
             send_test_traffic();
         }
+        
+        for (uint32_t i = 0; i < num_switches; i++) {
+            l2_fwd_age(&switches[i].fwd, l2_fwd_now_ms());
+        }
     }
     
     /* Print final statistics */
@@ -374,6 +389,9 @@ int main(int argc, char *argv[])
     }
     
     vlink_manager_cleanup(&global_link_mgr);
+    for (uint32_t i = 0; i < num_switches; i++) {
+        l2_fwd_cleanup(&switches[i].fwd);
+    }
     
     printf("Done.\n");
     